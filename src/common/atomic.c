@@ -24,6 +24,10 @@ extern inline int dt_atomic_add_int(dt_atomic_int *var, int incr);
 extern inline int dt_atomic_sub_int(dt_atomic_int *var, int decr);
 extern inline int dt_atomic_exch_int(dt_atomic_int *var, int value);
 extern inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value);
+extern inline void dt_atomic_set_size(dt_atomic_size_t *var, size_t value);
+extern inline size_t dt_atomic_get_size(dt_atomic_size_t *var);
+extern inline size_t dt_atomic_add_size(dt_atomic_size_t *var, size_t incr);
+extern inline size_t dt_atomic_sub_size(dt_atomic_size_t *var, size_t decr);
 
 #if !defined(__STDC_NO_ATOMICS__)
 // using C11 atomics, everything is handled in the header file, so we don't need to define anything in this file
@@ -41,11 +41,18 @@ inline int dt_atomic_exch_int(dt_atomic_int *var, int value) { return std::atomi
 inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value)
 { return std::atomic_compare_exchange_strong(var,expected,value); }
 
+typedef std::atomic<size_t> dt_atomic_size_t;
+inline void dt_atomic_set_size(dt_atomic_size_t *var, size_t value) { std::atomic_store(var,value); }
+inline size_t dt_atomic_get_size(dt_atomic_size_t *var) { return std::atomic_load(var); }
+inline size_t dt_atomic_add_size(dt_atomic_size_t *var, size_t incr) { return std::atomic_fetch_add(var,incr); }
+inline size_t dt_atomic_sub_size(dt_atomic_size_t *var, size_t decr) { return std::atomic_fetch_sub(var,decr); }
+
 extern "C" { // restart C linkage block
 
 #elif !defined(__STDC_NO_ATOMICS__)
 
 #include <stdatomic.h>
+#include <stddef.h>
 
 typedef atomic_int dt_atomic_int;
 inline void dt_atomic_set_int(dt_atomic_int *var, int value) { atomic_store(var,value); }
@@ -56,9 +63,16 @@ inline int dt_atomic_exch_int(dt_atomic_int *var, int value) { return atomic_exc
 inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value)
 { return atomic_compare_exchange_strong(var,expected,value); }
 
+typedef atomic_size_t dt_atomic_size_t;
+inline void dt_atomic_set_size(dt_atomic_size_t *var, size_t value) { atomic_store(var,value); }
+inline size_t dt_atomic_get_size(dt_atomic_size_t *var) { return atomic_load(var); }
+inline size_t dt_atomic_add_size(dt_atomic_size_t *var, size_t incr) { return atomic_fetch_add(var,incr); }
+inline size_t dt_atomic_sub_size(dt_atomic_size_t *var, size_t decr) { return atomic_fetch_sub(var,decr); }
+
 #elif defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNU_MINOR__ >= 8))
 // we don't have or aren't supposed to use C11 atomics, but the compiler is a recent-enough version of GCC
 // that we can use GNU intrinsics corresponding to the C11 atomics
+#include <stddef.h>
 
 typedef volatile int dt_atomic_int;
 inline void dt_atomic_set_int(dt_atomic_int *var, int value) { __atomic_store(var,&value,__ATOMIC_SEQ_CST); }
@@ -72,10 +86,20 @@ inline int dt_atomic_exch_int(dt_atomic_int *var, int value)
 inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value)
 { return __atomic_compare_exchange(var,expected,&value,0,__ATOMIC_SEQ_CST,__ATOMIC_SEQ_CST); }
 
+typedef volatile size_t dt_atomic_size_t;
+inline void dt_atomic_set_size(dt_atomic_size_t *var, size_t value) { __atomic_store(var,&value,__ATOMIC_SEQ_CST); }
+inline size_t dt_atomic_get_size(dt_atomic_size_t *var)
+{ size_t value ; __atomic_load(var,&value,__ATOMIC_SEQ_CST); return value; }
+inline size_t dt_atomic_add_size(dt_atomic_size_t *var, size_t incr)
+{ return __atomic_fetch_add(var,incr,__ATOMIC_SEQ_CST); }
+inline size_t dt_atomic_sub_size(dt_atomic_size_t *var, size_t decr)
+{ return __atomic_fetch_sub(var,decr,__ATOMIC_SEQ_CST); }
+
 #else
 // we don't have or aren't supposed to use C11 atomics, and don't have GNU intrinsics, so
 // fall back to using a mutex for synchronization
 #include <pthread.h>
+#include <stddef.h>
 
 extern pthread_mutex_t dt_atom_mutex;
 
@@ -137,4 +161,38 @@ inline int dt_atomic_CAS_int(dt_atomic_int *var, int *expected, int value)
   return success;
 }
 
+typedef size_t dt_atomic_size_t;
+inline void dt_atomic_set_size(dt_atomic_size_t *var, size_t value)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  *var = value;
+  pthread_mutex_unlock(&dt_atom_mutex);
+}
+
+inline size_t dt_atomic_get_size(dt_atomic_size_t *var)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  size_t value = *var;
+  pthread_mutex_unlock(&dt_atom_mutex);
+  return value;
+}
+
+inline size_t dt_atomic_add_size(dt_atomic_size_t *var, size_t incr)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  size_t value = *var;
+  *var += incr;
+  pthread_mutex_unlock(&dt_atom_mutex);
+  return value;
+}
+
+inline size_t dt_atomic_sub_size(dt_atomic_size_t *var, size_t decr)
+{
+  pthread_mutex_lock(&dt_atom_mutex);
+  size_t value = *var;
+  *var -= decr;
+  pthread_mutex_unlock(&dt_atom_mutex);
+  return value;
+}
+
 #endif // __STDC_NO_ATOMICS__
@@ -18,6 +18,7 @@
 
 #include "common/bilateral.h"
 #include "common/darktable.h" // for CLAMPS, dt_alloc_align, dt_free_align
+#include "control/conf.h"     // for dt_conf_get_int
 #include <glib.h>             // for MIN, MAX
 #include <math.h>             // for roundf
 #include <stdlib.h>           // for size_t, free, malloc, NULL
@@ -28,6 +29,106 @@
 // mode (only 1mpix there).
 #define DT_COMMON_BILATERAL_MAX_RES_S 3000
 #define DT_COMMON_BILATERAL_MAX_RES_R 50
+// Grid buffers are handed back to a small pool rather than freed, the same modules tend to ask for the same grid
+// sizes over and over while an image is being edited.  Huge grids are not worth holding on to, and all of them
+// together stay within a share of host_memory_limit.  The pool is emptied when leaving darkroom and after exports.
+#define DT_COMMON_BILATERAL_POOL 4
+#define DT_COMMON_BILATERAL_POOL_MAX_BYTES ((size_t)64 << 20)
+
+static GMutex pool_lock;
+static size_t pool_bytes = 0;
+static struct
+{
+  float *buf;
+  size_t size;
+} pool[DT_COMMON_BILATERAL_POOL];
+
+// bytes the pool may hold in total
+static size_t pool_budget(void)
+{
+  const size_t max_bytes = DT_COMMON_BILATERAL_POOL * DT_COMMON_BILATERAL_POOL_MAX_BYTES;
+  const int host_memory_limit = darktable.conf ? dt_conf_get_int("host_memory_limit") : 0;
+  if(host_memory_limit <= 0) return max_bytes;
+  return MIN(max_bytes, (size_t)host_memory_limit * 1024 * 1024 / 16);
+}
+
+// get a buffer of at least *size bytes, *size is set to the actual size of the buffer
+static float *pool_alloc(size_t *size)
+{
+  float *buf = NULL;
+  g_mutex_lock(&pool_lock);
+  int best = -1;
+  for(int k = 0; k < DT_COMMON_BILATERAL_POOL; k++)
+  {
+    // don't hand out buffers a lot larger than needed, they can serve bigger grids later on
+    if(pool[k].buf && pool[k].size >= *size && pool[k].size <= 2 * *size
+       && (best < 0 || pool[k].size < pool[best].size))
+      best = k;
+  }
+  if(best >= 0)
+  {
+    buf = pool[best].buf;
+    *size = pool[best].size;
+    pool[best].buf = NULL;
+    pool_bytes -= *size;
+  }
+  g_mutex_unlock(&pool_lock);
+  return buf ? buf : dt_alloc_align(64, *size);
+}
+
+static void pool_free(float *buf, const size_t size)
+{
+  if(!buf) return;
+  const size_t budget = pool_budget();
+  if(size <= DT_COMMON_BILATERAL_POOL_MAX_BYTES && size <= budget)
+  {
+    g_mutex_lock(&pool_lock);
+    // take a free slot or the one of the smallest buffer, if that's smaller than this one
+    int slot = -1;
+    for(int k = 0; k < DT_COMMON_BILATERAL_POOL; k++)
+    {
+      if(!pool[k].buf)
+      {
+        slot = k;
+        break;
+      }
+      if(pool[k].size < size && (slot < 0 || pool[k].size < pool[slot].size)) slot = k;
+    }
+    if(slot >= 0)
+    {
+      float *const old = pool[slot].buf;
+      pool_bytes += size - (old ? pool[slot].size : 0);
+      pool[slot].buf = buf;
+      pool[slot].size = size;
+      buf = old;
+      // make room by dropping the smallest grids, this one stays as it is the most likely to be asked for next
+      while(pool_bytes > budget)
+      {
+        int smallest = -1;
+        for(int k = 0; k < DT_COMMON_BILATERAL_POOL; k++)
+          if(k != slot && pool[k].buf && (smallest < 0 || pool[k].size < pool[smallest].size)) smallest = k;
+        if(smallest < 0) break;
+        dt_free_align(pool[smallest].buf);
+        pool[smallest].buf = NULL;
+        pool_bytes -= pool[smallest].size;
+      }
+    }
+    g_mutex_unlock(&pool_lock);
+  }
+  if(buf) dt_free_align(buf);
+}
+
+void dt_bilateral_free_pool(void)
+{
+  g_mutex_lock(&pool_lock);
+  for(int k = 0; k < DT_COMMON_BILATERAL_POOL; k++)
+  {
+    if(pool[k].buf) dt_free_align(pool[k].buf);
+    pool[k].buf = NULL;
+  }
+  pool_bytes = 0;
+  g_mutex_unlock(&pool_lock);
+}
 
 void dt_bilateral_grid_size(dt_bilateral_t *b, const int width, const int height, const float L_range,
                             float sigma_s, const float sigma_r)
@@ -66,12 +167,8 @@ size_t dt_bilateral_memory_use(const int width,     // width of input image
   dt_bilateral_t b;
   dt_bilateral_grid_size(&b,width,height,100.0f,sigma_s,sigma_r);
   size_t grid_size = b.size_x * b.size_y * b.size_z;
-#ifdef HAVE_OPENCL
-  // OpenCL path needs two buffers
-  return 2 * grid_size * sizeof(float);
-#else
-  return (grid_size + 3 * darktable.num_openmp_threads * b.size_x * b.size_z) * sizeof(float);
-#endif /* HAVE_OPENCL */
+  // both the OpenCL path and the blur of the CPU path need two grids, the latter plus some rows per thread
+  return (2 * grid_size + 8 * darktable.num_openmp_threads * b.size_x * b.size_z) * sizeof(float);
 }
 
 #ifndef HAVE_OPENCL
@@ -109,30 +206,33 @@ size_t dt_bilateral_singlebuffer_size2(const int width,
 }
 #endif /* !HAVE_OPENCL */
 
-static size_t image_to_grid(const dt_bilateral_t *const b, const int i, const int j, const float L,
-                            float *xf, float *yf, float *zf)
+// offset of the grid column left of each column of the image and the weight of the one to its right. the same
+// for all rows, so it's worked out once per call rather than for every pixel.
+static void image_to_gridcols(const dt_bilateral_t *const b, size_t *const col, float *const xf)
+{
+  for(int i = 0; i < b->width; i++)
+  {
+    const float x = CLAMPS(i / b->sigma_s, 0, b->size_x - 1);
+    const int xi = MIN((int)x, b->size_x - 2);
+    xf[i] = x - xi;
+    col[i] = (size_t)xi * b->size_z;
+  }
+}
+
+static inline size_t image_to_gridrow(const dt_bilateral_t *const b, const int j, float *yf)
 {
-  float x = CLAMPS(i / b->sigma_s, 0, b->size_x - 1);
-  float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
-  float z = CLAMPS(L / b->sigma_r, 0, b->size_z - 1);
-  const int xi = MIN((int)x, b->size_x - 2);
+  const float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
   const int yi = MIN((int)y, b->size_y - 2);
-  const int zi = MIN((int)z, b->size_z - 2);
-  *xf = x - xi;
   *yf = y - yi;
-  *zf = z - zi;
-  return ((xi + yi * b->size_x) * b->size_z) + zi;
+  return (size_t)yi * b->size_x * b->size_z;
 }
 
-static size_t image_to_relgrid(const dt_bilateral_t *const b, const int i, const float L, float *xf, float *zf)
+static inline size_t image_to_gridz(const dt_bilateral_t *const b, const float L, float *zf)
 {
-  float x = CLAMPS(i / b->sigma_s, 0, b->size_x - 1);
-  float z = CLAMPS(L / b->sigma_r, 0, b->size_z - 1);
-  const int xi = MIN((int)x, b->size_x - 2);
+  const float z = CLAMPS(L / b->sigma_r, 0, b->size_z - 1);
   const int zi = MIN((int)z, b->size_z - 2);
-  *xf = x - xi;
   *zf = z - zi;
-  return (xi * b->size_z) + zi;
+  return zi;
 }
 
 dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
@@ -148,7 +248,9 @@ dt_bilateral_t *dt_bilateral_init(const int width,     // width of input image
   b->numslices = darktable.num_openmp_threads;
   b->sliceheight = (height + b->numslices - 1) / b->numslices;
   b->slicerows = (b->size_y + b->numslices - 1) / b->numslices + 2;
-  b->buf = dt_alloc_align(64, b->size_x * b->size_z * b->numslices * b->slicerows * sizeof(float));
+  size_t buf_size = b->size_x * b->size_z * b->numslices * b->slicerows * sizeof(float);
+  b->buf = pool_alloc(&buf_size);
+  b->buf_size = buf_size;
   if (b->buf)
   {
     memset(b->buf, 0, b->size_x * b->size_z * b->numslices * b->slicerows * sizeof(float));
@@ -174,6 +276,9 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
   float *const buf = b->buf;
 
   if (!buf) return;
+  size_t *const col = dt_alloc_align(64, sizeof(size_t) * b->width);
+  float *const colf = dt_alloc_align(64, sizeof(float) * b->width);
+  image_to_gridcols(b, col, colf);
   // splat into downsampled grid
   const int nthreads = darktable.num_openmp_threads;
   const size_t offsets[8] =
@@ -190,7 +295,7 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, oy, oz, ox, sigma_s, buf, offsets) \
+  dt_omp_firstprivate(in, oy, oz, ox, sigma_s, buf, offsets, col, colf) \
   shared(b)
 #endif
   for(int slice = 0; slice < b->numslices; slice++)
@@ -203,17 +308,16 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     // now iterate over the rows of the current horizontal slice
     for(int j = firstrow; j < lastrow; j++)
     {
-      float y = CLAMPS(j / b->sigma_s, 0, b->size_y - 1);
-      const int yi = MIN((int)y, b->size_y - 2);
-      const float yf = y - yi;
-      const size_t base = (yi + slice_offset) * oy;
+      float yf;
+      const size_t base = image_to_gridrow(b, j, &yf) + (size_t)slice_offset * oy;
       for(int i = 0; i < b->width; i++)
       {
-        size_t index = 4 * (j * b->width + i);
-        float xf, zf;
+        size_t index = 4 * ((size_t)j * b->width + i);
+        float zf;
+        const float xf = colf[i];
         const float L = in[index];
         // nearest neighbour splatting:
-        const size_t grid_index = base + image_to_relgrid(b, i, L, &xf, &zf);
+        const size_t grid_index = base + col[i] + image_to_gridz(b, L, &zf);
         // sum up payload here
         const float contrib[4] =
         {
@@ -234,6 +338,9 @@ void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in)
     }
   }
 
+  dt_free_align(col);
+  dt_free_align(colf);
+
   // merge the per-thread results into the final result
   for (int slice = 1 ; slice < nthreads; slice++)
   {
@@ -344,10 +451,108 @@ static void blur_line(float *buf, const int offset1, const int offset2, const in
 }
 
 
-void dt_bilateral_blur(const dt_bilateral_t *b)
+// blur one plane of the grid along x into dest. neighbours along x are size_z apart, so this works on the plane as
+// a whole: long loops even for the few nodes along z of a typical grid.
+static inline void blur_plane_x(const float *const src, float *const dest, const int size_x, const int size_z)
+{
+  const float w0 = 6.f / 16.f;
+  const float w1 = 4.f / 16.f;
+  const float w2 = 1.f / 16.f;
+  const size_t n = (size_t)size_x * size_z;
+  const size_t o1 = size_z, o2 = 2 * o1;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for(size_t k = o2; k < n - o2; k++)
+    dest[k] = w0 * src[k] + w1 * (src[k - o1] + src[k + o1]) + w2 * (src[k - o2] + src[k + o2]);
+  // the two columns at either border, nodes beyond it are zero (the grid is at least 5 nodes wide)
+  for(size_t k = 0; k < o2; k++)
+    dest[k] = w0 * src[k] + w1 * ((k >= o1 ? src[k - o1] : 0.0f) + src[k + o1]) + w2 * src[k + o2];
+  for(size_t k = n - o2; k < n; k++)
+    dest[k] = w0 * src[k] + w1 * (src[k - o1] + (k + o1 < n ? src[k + o1] : 0.0f)) + w2 * src[k - o2];
+}
+
+// the same gaussians along x and y and -2 derivative of the gaussian along z as the three passes of blur_line()
+// and blur_line_z() used to do, fused into a single sweep over y: each thread works through a band of planes,
+// keeping the last five planes blurred along x in a ring, combining them along y into the output plane and
+// blurring that along z while it is still in cache.
+static gboolean blur_fused(dt_bilateral_t *b)
+{
+  const int size_x = b->size_x, size_y = b->size_y, size_z = b->size_z;
+  const size_t oy = (size_t)size_x * size_z;
+  const int nthreads = MIN(darktable.num_openmp_threads, size_y);
+  const int band = (size_y + nthreads - 1) / nthreads;
+  // the z pass works on a padded copy of each line of nodes
+  if(size_z > DT_COMMON_BILATERAL_MAX_RES_R + 1) return FALSE;
+
+  size_t out_size = (oy * size_y + 5 * oy * nthreads) * sizeof(float);
+  float *const out = pool_alloc(&out_size);
+  if(!out) return FALSE;
+  const float *const in = b->buf;
+  float *const rings = out + oy * size_y;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, out, rings, oy, band, nthreads, size_x, size_y, size_z) \
+  schedule(static)
+#endif
+  for(int t = 0; t < nthreads; t++)
+  {
+    const float w0 = 6.f / 16.f;
+    const float w1 = 4.f / 16.f;
+    const float w2 = 1.f / 16.f;
+    const float v1 = 4.f / 16.f;
+    const float v2 = 2.f / 16.f;
+    float *const ring = rings + 5 * oy * t;
+    const int y0 = t * band, y1 = MIN(size_y, y0 + band);
+
+    // add plane q blurred along x to the ring, which then holds planes q - 4 to q as needed for output plane q - 2
+    for(int q = y0 - 2; q < y1 + 2; q++)
+    {
+      float *const plane = ring + (size_t)((q + 5) % 5) * oy;
+      if(q < 0 || q >= size_y)
+        memset(plane, 0, oy * sizeof(float));
+      else
+        blur_plane_x(in + q * oy, plane, size_x, size_z);
+      const int y = q - 2;
+      if(y < y0) continue;
+
+      // gaussian along y
+      const float *const p0 = ring + (size_t)((y + 5) % 5) * oy;
+      const float *const m1 = ring + (size_t)((y + 4) % 5) * oy;
+      const float *const m2 = ring + (size_t)((y + 3) % 5) * oy;
+      const float *const p1 = ring + (size_t)((y + 6) % 5) * oy;
+      const float *const p2 = ring + (size_t)((y + 7) % 5) * oy;
+      float *const dest = out + y * oy;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(size_t k = 0; k < oy; k++) dest[k] = w0 * p0[k] + w1 * (m1[k] + p1[k]) + w2 * (m2[k] + p2[k]);
+
+      // derivative along z
+      for(int x = 0; x < size_x; x++)
+      {
+        float line[DT_COMMON_BILATERAL_MAX_RES_R + 5] = { 0.0f };
+        float *const d = dest + (size_t)x * size_z;
+        for(int z = 0; z < size_z; z++) line[z + 2] = d[z];
+        for(int z = 0; z < size_z; z++) d[z] = v1 * (line[z + 3] - line[z + 1]) + v2 * (line[z + 4] - line[z]);
+      }
+    }
+  }
+
+  pool_free(b->buf, b->buf_size);
+  b->buf = out;
+  b->buf_size = out_size;
+  return TRUE;
+}
+
+void dt_bilateral_blur(dt_bilateral_t *b)
 {
   if (!b || !b->buf)
     return;
+  if(blur_fused(b)) return;
+
+  // no memory for a second grid, blur in place
   const int ox = b->size_z;
   const int oy = b->size_x * b->size_z;
   const int oz = 1;
@@ -375,20 +580,26 @@ void dt_bilateral_slice(const dt_bilateral_t *const b, const float *const in, fl
   const int height = b->height;
 
   if (!buf) return;
+  size_t *const col = dt_alloc_align(64, sizeof(size_t) * width);
+  float *const colf = dt_alloc_align(64, sizeof(float) * width);
+  image_to_gridcols(b, col, colf);
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(b, in, norm, ox, oy, oz, height, width, buf) \
-    shared(out) collapse(2)
+  dt_omp_firstprivate(b, in, norm, ox, oy, oz, height, width, buf, col, colf) \
+    shared(out) schedule(static)
 #endif
   for(int j = 0; j < height; j++)
   {
+    float yf;
+    const size_t row = image_to_gridrow(b, j, &yf);
     for(int i = 0; i < width; i++)
     {
-      size_t index = 4 * (j * width + i);
-      float xf, yf, zf;
+      size_t index = 4 * ((size_t)j * width + i);
+      float zf;
+      const float xf = colf[i];
       const float L = in[index];
       // trilinear lookup:
-      const size_t gi = image_to_grid(b, i, j, L, &xf, &yf, &zf);
+      const size_t gi = row + col[i] + image_to_gridz(b, L, &zf);
       const float Lout = L
                          + norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
                                    + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
@@ -405,6 +616,9 @@ void dt_bilateral_slice(const dt_bilateral_t *const b, const float *const in, fl
       out[index + 3] = in[index + 3];
     }
   }
+
+  dt_free_align(col);
+  dt_free_align(colf);
 }
 
 #ifdef _OPENMP
@@ -423,20 +637,26 @@ void dt_bilateral_slice_to_output(const dt_bilateral_t *const b, const float *co
   const int height = b->height;
 
   if (!buf) return;
+  size_t *const col = dt_alloc_align(64, sizeof(size_t) * width);
+  float *const colf = dt_alloc_align(64, sizeof(float) * width);
+  image_to_gridcols(b, col, colf);
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(b, in, norm, oy, oz, ox, buf, width, height) \
-  shared(out) collapse(2)
+  dt_omp_firstprivate(b, in, norm, oy, oz, ox, buf, width, height, col, colf) \
+  shared(out) schedule(static)
 #endif
   for(int j = 0; j < height; j++)
   {
+    float yf;
+    const size_t row = image_to_gridrow(b, j, &yf);
     for(int i = 0; i < width; i++)
     {
-      size_t index = 4 * (j * width + i);
-      float xf, yf, zf;
+      size_t index = 4 * ((size_t)j * width + i);
+      float zf;
+      const float xf = colf[i];
       const float L = in[index];
       // trilinear lookup:
-      const size_t gi = image_to_grid(b, i, j, L, &xf, &yf, &zf);
+      const size_t gi = row + col[i] + image_to_gridz(b, L, &zf);
       const float Lout = norm * (buf[gi] * (1.0f - xf) * (1.0f - yf) * (1.0f - zf)
                                  + buf[gi + ox] * (xf) * (1.0f - yf) * (1.0f - zf)
                                  + buf[gi + oy] * (1.0f - xf) * (yf) * (1.0f - zf)
@@ -448,17 +668,22 @@ void dt_bilateral_slice_to_output(const dt_bilateral_t *const b, const float *co
       out[index] = MAX(0.0f, out[index] + Lout);
     }
   }
+
+  dt_free_align(col);
+  dt_free_align(colf);
 }
 
 void dt_bilateral_free(dt_bilateral_t *b)
 {
   if(!b) return;
-  dt_free_align(b->buf);
+  pool_free(b->buf, b->buf_size);
   free(b);
 }
 
 #undef DT_COMMON_BILATERAL_MAX_RES_S
 #undef DT_COMMON_BILATERAL_MAX_RES_R
+#undef DT_COMMON_BILATERAL_POOL
+#undef DT_COMMON_BILATERAL_POOL_MAX_BYTES
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
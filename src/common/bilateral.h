@@ -26,6 +26,7 @@ typedef struct dt_bilateral_t
   int width, height;
   int numslices, sliceheight, slicerows; //height--in input image, rows--in grid
   float sigma_s, sigma_r;
+  size_t buf_size; // bytes in buf, it goes back to the pool in the end
   float *buf __attribute__((aligned(64)));
 } __attribute__((packed)) dt_bilateral_t;
 
@@ -59,7 +60,8 @@ dt_bilateral_t *dt_bilateral_init(const int width,      // width of input image
 
 void dt_bilateral_splat(const dt_bilateral_t *b, const float *const in);
 
-void dt_bilateral_blur(const dt_bilateral_t *b);
+// blurs the grid along all three axes in one sweep. the result lands in a new buffer, b->buf changes.
+void dt_bilateral_blur(dt_bilateral_t *b);
 
 void dt_bilateral_slice(const dt_bilateral_t *const b, const float *const in, float *out, const float detail);
 
@@ -68,6 +70,9 @@ void dt_bilateral_slice_to_output(const dt_bilateral_t *const b, const float *co
 
 void dt_bilateral_free(dt_bilateral_t *b);
 
+// frees the grid buffers kept around for the next dt_bilateral_init()
+void dt_bilateral_free_pool(void);
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -27,56 +27,194 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-// this implements a concurrent LRU cache
+// this implements a concurrent LRU cache. the key space is split over
+// DT_CACHE_SHARDS shards, each with its own lock, hashtable and intrusive lru
+// list, and the total cost is accounted for atomically.
+
+static inline dt_cache_shard_t *_cache_shard(dt_cache_t *cache, const uint32_t key)
+{
+  // mipmap keys carry the mip level in the top bits and image ids are
+  // sequential, so scramble before picking the shard.
+  return cache->shard + ((key * 0x9E3779B1u) >> (32 - DT_CACHE_SHARD_BITS));
+}
+
+static inline void _lru_unlink(dt_cache_shard_t *shard, dt_cache_entry_t *entry)
+{
+  if(entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+  else shard->lru_head = entry->lru_next;
+  if(entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+  else shard->lru_tail = entry->lru_prev;
+  entry->lru_prev = entry->lru_next = NULL;
+}
+
+static inline void _lru_append(dt_cache_shard_t *shard, dt_cache_entry_t *entry)
+{
+  entry->lru_next = NULL;
+  entry->lru_prev = shard->lru_tail;
+  if(shard->lru_tail) shard->lru_tail->lru_next = entry;
+  else shard->lru_head = entry;
+  shard->lru_tail = entry;
+}
+
+// bubble up in lru list:
+static inline void _lru_touch(dt_cache_shard_t *shard, dt_cache_entry_t *entry)
+{
+  if(shard->lru_tail == entry) return;
+  _lru_unlink(shard, entry);
+  _lru_append(shard, entry);
+}
+
+// release the data of a write locked entry which is no longer reachable from the cache
+static void _cache_entry_free(dt_cache_t *cache, dt_cache_entry_t *entry)
+{
+  if(cache->cleanup)
+  {
+    assert(entry->data_size);
+    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+
+    cache->cleanup(cache->cleanup_data, entry);
+  }
+  else
+    dt_free_align(entry->data);
+
+  dt_pthread_rwlock_unlock(&entry->lock);
+  dt_pthread_rwlock_destroy(&entry->lock);
+  dt_atomic_sub_size(&cache->cost, entry->cost);
+  g_slice_free1(sizeof(*entry), entry);
+}
 
 void dt_cache_init(
     dt_cache_t *cache,
     size_t entry_size,
     size_t cost_quota)
 {
-  cache->cost = 0;
-  cache->lru = 0;
+  dt_atomic_set_size(&cache->cost, 0);
+  dt_atomic_set_int(&cache->gc_shard, 0);
   cache->entry_size = entry_size;
   cache->cost_quota = cost_quota;
-  dt_pthread_mutex_init(&cache->lock, 0);
   cache->allocate = 0;
   cache->allocate_data = 0;
   cache->cleanup = 0;
   cache->cleanup_data = 0;
-  cache->hashtable = g_hash_table_new(0, 0);
+  cache->gc_thread_running = 0;
+  cache->gc_thread_stop = 0;
+  dt_atomic_set_int(&cache->gc_pending, 0);
+  cache->gc_low = cache->gc_high = 0.8f;
+  cache->gc_name = NULL;
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    dt_cache_shard_t *shard = cache->shard + k;
+    dt_pthread_mutex_init(&shard->lock, 0);
+    shard->hashtable = g_hash_table_new(0, 0);
+    shard->lru_head = shard->lru_tail = NULL;
+  }
+}
+
+static void *_cache_gc_thread(void *data)
+{
+  dt_cache_t *cache = (dt_cache_t *)data;
+  dt_pthread_setname(cache->gc_name);
+  dt_pthread_mutex_lock(&cache->gc_mutex);
+  while(!cache->gc_thread_stop)
+  {
+    if(!dt_atomic_get_int(&cache->gc_pending))
+    {
+      dt_pthread_cond_wait(&cache->gc_cond, &cache->gc_mutex);
+      continue;
+    }
+    dt_pthread_mutex_unlock(&cache->gc_mutex);
+
+    // requests arriving while we collect will trigger another round
+    dt_atomic_set_int(&cache->gc_pending, 0);
+    if(dt_atomic_get_size(&cache->cost) > cache->gc_high * cache->cost_quota)
+      dt_cache_gc(cache, cache->gc_low);
+
+    dt_pthread_mutex_lock(&cache->gc_mutex);
+  }
+  dt_pthread_mutex_unlock(&cache->gc_mutex);
+  return NULL;
+}
+
+static void _cache_gc_wake(dt_cache_t *cache)
+{
+  // only the first request after a collection started has to take the mutex
+  if(dt_atomic_exch_int(&cache->gc_pending, 1)) return;
+  dt_pthread_mutex_lock(&cache->gc_mutex);
+  pthread_cond_signal(&cache->gc_cond);
+  dt_pthread_mutex_unlock(&cache->gc_mutex);
+}
+
+void dt_cache_start_gc_thread(
+    dt_cache_t *cache,
+    const char *name,
+    const float low_ratio,
+    const float high_ratio)
+{
+  if(cache->gc_thread_running) return;
+  cache->gc_low = low_ratio;
+  cache->gc_high = MAX(low_ratio, high_ratio);
+  cache->gc_name = name;
+  cache->gc_thread_stop = 0;
+  dt_pthread_mutex_init(&cache->gc_mutex, NULL);
+  pthread_cond_init(&cache->gc_cond, NULL);
+  if(dt_pthread_create(&cache->gc_thread, _cache_gc_thread, cache))
+  {
+    fprintf(stderr, "[dt_cache_start_gc_thread] could not start %s, collecting inline\n", name);
+    pthread_cond_destroy(&cache->gc_cond);
+    dt_pthread_mutex_destroy(&cache->gc_mutex);
+    return;
+  }
+  cache->gc_thread_running = 1;
 }
 
 void dt_cache_cleanup(dt_cache_t *cache)
 {
-  g_hash_table_destroy(cache->hashtable);
-  GList *l = cache->lru;
-  while(l)
+  if(cache->gc_thread_running)
   {
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)l->data;
+    dt_pthread_mutex_lock(&cache->gc_mutex);
+    cache->gc_thread_stop = 1;
+    pthread_cond_signal(&cache->gc_cond);
+    dt_pthread_mutex_unlock(&cache->gc_mutex);
+    pthread_join(cache->gc_thread, NULL);
+    pthread_cond_destroy(&cache->gc_cond);
+    dt_pthread_mutex_destroy(&cache->gc_mutex);
+    cache->gc_thread_running = 0;
+  }
 
-    if(cache->cleanup)
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    dt_cache_shard_t *shard = cache->shard + k;
+    g_hash_table_destroy(shard->hashtable);
+    dt_cache_entry_t *entry = shard->lru_head;
+    while(entry)
     {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+      dt_cache_entry_t *next = entry->lru_next;
 
-      cache->cleanup(cache->cleanup_data, entry);
-    }
-    else
-      dt_free_align(entry->data);
+      if(cache->cleanup)
+      {
+        assert(entry->data_size);
+        ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
 
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
-    l = g_list_next(l);
+        cache->cleanup(cache->cleanup_data, entry);
+      }
+      else
+        dt_free_align(entry->data);
+
+      dt_pthread_rwlock_destroy(&entry->lock);
+      g_slice_free1(sizeof(*entry), entry);
+      entry = next;
+    }
+    shard->lru_head = shard->lru_tail = NULL;
+    dt_pthread_mutex_destroy(&shard->lock);
   }
-  g_list_free(cache->lru);
-  dt_pthread_mutex_destroy(&cache->lock);
 }
 
 int32_t dt_cache_contains(dt_cache_t *cache, const uint32_t key)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  int32_t result = g_hash_table_contains(cache->hashtable, GINT_TO_POINTER(key));
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
+  dt_pthread_mutex_lock(&shard->lock);
+  int32_t result = g_hash_table_contains(shard->hashtable, GINT_TO_POINTER(key));
+  dt_pthread_mutex_unlock(&shard->lock);
   return result;
 }
 
@@ -85,22 +223,26 @@ int dt_cache_for_all(
     int (*process)(const uint32_t key, const void *data, void *user_data),
     void *user_data)
 {
-  dt_pthread_mutex_lock(&cache->lock);
-  GHashTableIter iter;
-  gpointer key, value;
-
-  g_hash_table_iter_init (&iter, cache->hashtable);
-  while (g_hash_table_iter_next (&iter, &key, &value))
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
   {
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
-    const int err = process(GPOINTER_TO_INT(key), entry->data, user_data);
-    if(err)
+    dt_cache_shard_t *shard = cache->shard + k;
+    dt_pthread_mutex_lock(&shard->lock);
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init (&iter, shard->hashtable);
+    while (g_hash_table_iter_next (&iter, &key, &value))
     {
-      dt_pthread_mutex_unlock(&cache->lock);
-      return err;
+      dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
+      const int err = process(GPOINTER_TO_INT(key), entry->data, user_data);
+      if(err)
+      {
+        dt_pthread_mutex_unlock(&shard->lock);
+        return err;
+      }
     }
+    dt_pthread_mutex_unlock(&shard->lock);
   }
-  dt_pthread_mutex_unlock(&cache->lock);
   return 0;
 }
 
@@ -111,9 +253,10 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char m
   gpointer orig_key, value;
   gboolean res;
   double start = dt_get_wtime();
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
+  dt_pthread_mutex_lock(&shard->lock);
   res = g_hash_table_lookup_extended(
-      cache->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
+      shard->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
   if(res)
   {
     dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
@@ -123,13 +266,11 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char m
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       return 0;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_touch(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
     double end = dt_get_wtime();
     if(end - start > 0.1)
       fprintf(stderr, "try+ wait time %.06fs mode %c \n", end - start, mode);
@@ -144,7 +285,7 @@ dt_cache_entry_t *dt_cache_testget(dt_cache_t *cache, const uint32_t key, char m
 
     return entry;
   }
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   double end = dt_get_wtime();
   if(end - start > 0.1)
     fprintf(stderr, "try- wait time %.06fs\n", end - start);
@@ -159,11 +300,13 @@ dt_cache_entry_t *dt_cache_get_with_caller(dt_cache_t *cache, const uint32_t key
   gpointer orig_key, value;
   gboolean res;
   int result;
+  gboolean collected = FALSE;
   double start = dt_get_wtime();
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_pthread_mutex_lock(&shard->lock);
   res = g_hash_table_lookup_extended(
-      cache->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
+      shard->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
   if(res)
   { // yay, found. read lock and pass on.
     dt_cache_entry_t *entry = (dt_cache_entry_t *)value;
@@ -172,14 +315,12 @@ restart:
     if(result)
     { // need to give up mutex so other threads have a chance to get in between and
       // free the lock we're trying to acquire:
-      dt_pthread_mutex_unlock(&cache->lock);
+      dt_pthread_mutex_unlock(&shard->lock);
       g_usleep(5);
       goto restart;
     }
-    // bubble up in lru list:
-    cache->lru = g_list_remove_link(cache->lru, entry->link);
-    cache->lru = g_list_concat(cache->lru, entry->link);
-    dt_pthread_mutex_unlock(&cache->lock);
+    _lru_touch(shard, entry);
+    dt_pthread_mutex_unlock(&shard->lock);
 
 #ifdef _DEBUG
     const pthread_t writer = dt_pthread_rwlock_get_writer(&entry->lock);
@@ -206,12 +347,20 @@ restart:
 
   // else, not found, need to allocate.
 
-  // first try to clean up.
-  // also wait if we can't free more than the requested fill ratio.
-  if(cache->cost > 0.8f * cache->cost_quota)
+  // first try to clean up. garbage collection visits the other shards, so it
+  // has to run without our shard lock, after which the lookup is repeated in
+  // case another thread inserted the key in between. with a background
+  // reclaimer we only hand over the work, unless it can't keep up.
+  const size_t cost = dt_atomic_get_size(&cache->cost);
+  if(cache->gc_thread_running && cost > cache->gc_high * cache->cost_quota)
+    _cache_gc_wake(cache);
+  if(!collected
+     && (cache->gc_thread_running ? cost >= cache->cost_quota : cost > cache->gc_high * cache->cost_quota))
   {
-    // need to roll back all the way to get a consistent lock state:
-    dt_cache_gc(cache, 0.8f);
+    dt_pthread_mutex_unlock(&shard->lock);
+    dt_cache_gc(cache, cache->gc_high);
+    collected = TRUE;
+    goto restart;
   }
 
   // here dies your 32-bit system:
@@ -221,11 +370,11 @@ restart:
   entry->data = 0;
   entry->data_size = cache->entry_size;
   entry->cost = 1;
-  entry->link = g_list_append(0, entry);
+  entry->lru_prev = entry->lru_next = NULL;
   entry->key = key;
   entry->_lock_demoting = 0;
 
-  g_hash_table_insert(cache->hashtable, GINT_TO_POINTER(key), entry);
+  g_hash_table_insert(shard->hashtable, GINT_TO_POINTER(key), entry);
 
   assert(cache->allocate || entry->data_size);
 
@@ -244,12 +393,12 @@ restart:
   if(write) dt_pthread_rwlock_wrlock_with_caller(&entry->lock, file, line);
   else      dt_pthread_rwlock_rdlock_with_caller(&entry->lock, file, line);
 
-  cache->cost += entry->cost;
+  dt_atomic_add_size(&cache->cost, entry->cost);
 
   // put at end of lru list (most recently used):
-  cache->lru = g_list_concat(cache->lru, entry->link);
+  _lru_append(shard, entry);
 
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   double end = dt_get_wtime();
   if(end - start > 0.1)
     fprintf(stderr, "wait time %.06fs\n", end - start);
@@ -265,22 +414,23 @@ int dt_cache_remove(dt_cache_t *cache, const uint32_t key)
   gboolean res;
   int result;
   dt_cache_entry_t *entry;
+  dt_cache_shard_t *shard = _cache_shard(cache, key);
 restart:
-  dt_pthread_mutex_lock(&cache->lock);
+  dt_pthread_mutex_lock(&shard->lock);
 
   res = g_hash_table_lookup_extended(
-      cache->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
+      shard->hashtable, GINT_TO_POINTER(key), &orig_key, &value);
   entry = (dt_cache_entry_t *)value;
   if(!res)
   { // not found in cache, not deleting.
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     return 1;
   }
   // need write lock to be able to delete:
   result = dt_pthread_rwlock_trywrlock(&entry->lock);
   if(result)
   {
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
@@ -289,48 +439,28 @@ restart:
   {
     // oops, we are currently demoting (rw -> r) lock to this entry in some thread. do not touch!
     dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_mutex_unlock(&cache->lock);
+    dt_pthread_mutex_unlock(&shard->lock);
     g_usleep(5);
     goto restart;
   }
 
-  gboolean removed = g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(key));
+  gboolean removed = g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(key));
   (void)removed; // make non-assert compile happy
   assert(removed);
-  cache->lru = g_list_delete_link(cache->lru, entry->link);
-
-  if(cache->cleanup)
-  {
-    assert(entry->data_size);
-    ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
+  _lru_unlink(shard, entry);
 
-    cache->cleanup(cache->cleanup_data, entry);
-  }
-  else
-    dt_free_align(entry->data);
+  _cache_entry_free(cache, entry);
 
-  dt_pthread_rwlock_unlock(&entry->lock);
-  dt_pthread_rwlock_destroy(&entry->lock);
-  cache->cost -= entry->cost;
-  g_slice_free1(sizeof(*entry), entry);
-
-  dt_pthread_mutex_unlock(&cache->lock);
+  dt_pthread_mutex_unlock(&shard->lock);
   return 0;
 }
 
-// best-effort garbage collection. never blocks, never fails. well, sometimes it just doesn't free anything.
-void dt_cache_gc(dt_cache_t *cache, const float fill_ratio)
+// evict the least recently used entry of the shard nobody holds a lock on.
+// returns FALSE if every entry of the shard is in use.
+static gboolean _cache_shard_evict(dt_cache_t *cache, dt_cache_shard_t *shard)
 {
-  GList *l = cache->lru;
-  int cnt = 0;
-  while(l)
+  for(dt_cache_entry_t *entry = shard->lru_head; entry; entry = entry->lru_next)
   {
-    cnt++;
-    dt_cache_entry_t *entry = (dt_cache_entry_t *)l->data;
-    assert(entry->link->data == entry);
-    l = g_list_next(l); // we might remove this element, so walk to the next one while we still have the pointer..
-    if(cache->cost < cache->cost_quota * fill_ratio) break;
-
     // if still locked by anyone else give up:
     if(dt_pthread_rwlock_trywrlock(&entry->lock)) continue;
 
@@ -342,23 +472,34 @@ void dt_cache_gc(dt_cache_t *cache, const float fill_ratio)
     }
 
     // delete!
-    g_hash_table_remove(cache->hashtable, GINT_TO_POINTER(entry->key));
-    cache->lru = g_list_delete_link(cache->lru, entry->link);
-    cache->cost -= entry->cost;
+    g_hash_table_remove(shard->hashtable, GINT_TO_POINTER(entry->key));
+    _lru_unlink(shard, entry);
+    _cache_entry_free(cache, entry);
+    return TRUE;
+  }
+  return FALSE;
+}
 
-    if(cache->cleanup)
+// best-effort garbage collection. never blocks on an entry, never fails. well, sometimes it just doesn't free anything.
+void dt_cache_gc(dt_cache_t *cache, const float fill_ratio)
+{
+  const size_t target = cache->cost_quota * fill_ratio;
+  // take turns in evicting the oldest entry of every shard, which approximates
+  // a global lru order without ever holding more than one shard lock. start
+  // where the last collection left off so that concurrent callers spread out.
+  const int first = dt_atomic_add_int(&cache->gc_shard, 1);
+  gboolean progress = TRUE;
+  while(progress && dt_atomic_get_size(&cache->cost) >= target)
+  {
+    progress = FALSE;
+    for(int k = 0; k < DT_CACHE_SHARDS; k++)
     {
-      assert(entry->data_size);
-      ASAN_UNPOISON_MEMORY_REGION(entry->data, entry->data_size);
-
-      cache->cleanup(cache->cleanup_data, entry);
+      if(dt_atomic_get_size(&cache->cost) < target) break;
+      dt_cache_shard_t *shard = cache->shard + ((first + k) & (DT_CACHE_SHARDS - 1));
+      dt_pthread_mutex_lock(&shard->lock);
+      if(_cache_shard_evict(cache, shard)) progress = TRUE;
+      dt_pthread_mutex_unlock(&shard->lock);
     }
-    else
-      dt_free_align(entry->data);
-
-    dt_pthread_rwlock_unlock(&entry->lock);
-    dt_pthread_rwlock_destroy(&entry->lock);
-    g_slice_free1(sizeof(*entry), entry);
   }
 }
 
@@ -18,17 +18,22 @@
 
 #pragma once
 
+#include "common/atomic.h"
 #include "common/dtpthread.h"
 #include <glib.h>
 #include <inttypes.h>
 #include <stddef.h>
 
+// number of independently locked shards of a cache, must be a power of two
+#define DT_CACHE_SHARD_BITS 4
+#define DT_CACHE_SHARDS (1 << DT_CACHE_SHARD_BITS)
+
 typedef struct dt_cache_entry_t
 {
   void *data;
   size_t data_size;
   size_t cost;
-  GList *link;
+  struct dt_cache_entry_t *lru_prev, *lru_next; // intrusive lru list of the owning shard
   dt_pthread_rwlock_t lock;
   int _lock_demoting;
   uint32_t key;
@@ -38,16 +43,36 @@ dt_cache_entry_t;
 typedef void((*dt_cache_allocate_t)(void *userdata, dt_cache_entry_t *entry));
 typedef void((*dt_cache_cleanup_t)(void *userdata, dt_cache_entry_t *entry));
 
-typedef struct dt_cache_t
+// keys are distributed over the shards by hash, so threads working on different
+// images rarely wait for each other.
+typedef struct dt_cache_shard_t
 {
-  dt_pthread_mutex_t lock; // big fat lock. we're only expecting a couple hand full of cpu threads to use this concurrently.
+  dt_pthread_mutex_t lock; // protects hashtable and lru list of this shard only
 
-  size_t entry_size; // cache line allocation
-  size_t cost;       // user supplied cost per cache line (bytes?)
-  size_t cost_quota; // quota to try and meet. but don't use as hard limit.
+  GHashTable *hashtable;       // stores (key, entry) pairs
+  dt_cache_entry_t *lru_head;  // least recently used, first to be kicked from cache.
+  dt_cache_entry_t *lru_tail;  // most recently used.
+}
+dt_cache_shard_t;
 
-  GHashTable *hashtable; // stores (key, entry) pairs
-  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
+typedef struct dt_cache_t
+{
+  dt_cache_shard_t shard[DT_CACHE_SHARDS];
+
+  size_t entry_size;      // cache line allocation
+  dt_atomic_size_t cost;  // user supplied cost per cache line (bytes?)
+  size_t cost_quota;      // quota to try and meet. but don't use as hard limit.
+  dt_atomic_int gc_shard; // shard the next garbage collection starts at
+
+  // optional background reclaimer, see dt_cache_start_gc_thread()
+  int gc_thread_running;
+  int gc_thread_stop;
+  dt_atomic_int gc_pending; // a collection has been requested and not yet started
+  float gc_low, gc_high;    // fill ratio to evict down to, fill ratio to wake up at
+  const char *gc_name;
+  dt_pthread_mutex_t gc_mutex;
+  pthread_cond_t gc_cond;
+  pthread_t gc_thread;
 
   // callback functions for cache misses/garbage collection
   dt_cache_allocate_t allocate;
@@ -60,6 +85,13 @@ dt_cache_t;
 // entry size is only used if alloc callback is 0
 void dt_cache_init(dt_cache_t *cache, size_t entry_size, size_t cost_quota);
 void dt_cache_cleanup(dt_cache_t *cache);
+// start a thread which evicts entries down to a fill of low_ratio as soon as the
+// cache grows above high_ratio of its quota. this keeps cleanup callbacks (such
+// as writing thumbnails to disk) off the threads requesting entries, which only
+// collect inline once the quota itself is exceeded. call once after setting the
+// callbacks, dt_cache_cleanup() stops the thread.
+void dt_cache_start_gc_thread(dt_cache_t *cache, const char *name, const float low_ratio,
+                              const float high_ratio);
 
 static inline void dt_cache_set_allocate_callback(dt_cache_t *cache, dt_cache_allocate_t allocate_cb,
                                                   void *allocate_data)
@@ -87,10 +119,16 @@ void dt_cache_release_with_caller(dt_cache_t *cache, dt_cache_entry_t *entry, co
 int32_t dt_cache_contains(dt_cache_t *cache, const uint32_t key);
 // returns 0 on success, 1 if the key was not found.
 int32_t dt_cache_remove(dt_cache_t *cache, const uint32_t key);
-// removes from the tip of the lru list, until the fill ratio of the hashtable
-// goes below the given parameter, in terms of the user defined cost measure.
-// will never lock and never fail, but sometimes not free memory (in case all
-// is locked)
+// current fill of the cache in terms of the user defined cost measure
+static inline size_t dt_cache_get_cost(dt_cache_t *cache)
+{
+  return dt_atomic_get_size(&cache->cost);
+}
+// removes from the tip of the lru lists of all shards in turn, until the fill
+// ratio of the cache goes below the given parameter, in terms of the user
+// defined cost measure. takes the shard locks one at a time, so it must not be
+// called while holding one. will never wait for an entry and never fail, but
+// sometimes not free memory (in case all is locked)
 void dt_cache_gc(dt_cache_t *cache, const float fill_ratio);
 
 // iterate over all currently contained data blocks.
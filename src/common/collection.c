@@ -42,6 +42,8 @@
 
 #define SELECT_QUERY "SELECT DISTINCT * FROM %s"
 #define LIMIT_QUERY "LIMIT ?1, ?2"
+// above that many changed images, rebuilding the collected images is cheaper than checking them one by one
+#define DT_COLLECTION_DELTA_MAX 500
 
 static const char *comparators[] = {
   "<",  // DT_COLLECTION_RATING_COMP_LT = 0,
@@ -70,6 +72,7 @@ static void _collection_update_aspect_ratio(const dt_collection_t *collection);
 const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
 {
   dt_collection_t *collection = g_malloc0(sizeof(dt_collection_t));
+  g_mutex_init(&collection->collected_lock);
 
   /* initialize collection context*/
   if(clone) /* if clone is provided let's copy it into this context */
@@ -115,6 +118,12 @@ void dt_collection_free(const dt_collection_t *collection)
   g_free(collection->query);
   g_free(collection->query_no_group);
   g_strfreev(collection->where_ext);
+  g_free(collection->collected);
+  if(collection->collected_rowids) g_hash_table_destroy(collection->collected_rowids);
+  g_mutex_clear((GMutex *)&collection->collected_lock);
+  g_free(collection->ids_pre);
+  g_free(collection->ids_post);
+  g_free(collection->ids_post_no_group);
   g_free((dt_collection_t *)collection);
 }
 
@@ -154,6 +163,10 @@ void dt_collection_memory_update()
   gchar *query = g_strdup(dt_collection_get_query(darktable.collection));
   if(!query) return;
 
+  // the table and the rows kept in memory are replaced together, a delta update can't slip in between
+  dt_collection_t *collection = (dt_collection_t *)darktable.collection;
+  g_mutex_lock(&collection->collected_lock);
+
   // we have a new query for the collection of images to display. For speed reason we collect all images into
   // a temporary (in-memory) table (collected_images).
 
@@ -177,6 +190,236 @@ void dt_collection_memory_update()
 
   g_free(query);
   g_free(ins_query);
+
+  // 3. keep the rows in memory as well, thumbtable and friends look them up all the time
+  GArray *imgids = g_array_new(FALSE, FALSE, sizeof(int));
+  GHashTable *rowids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT rowid, imgid FROM memory.collected_images ORDER BY rowid", -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int imgid = sqlite3_column_int(stmt, 1);
+    g_array_append_val(imgids, imgid);
+    g_hash_table_insert(rowids, GINT_TO_POINTER(imgid), GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  }
+  sqlite3_finalize(stmt);
+
+  g_free(collection->collected);
+  if(collection->collected_rowids) g_hash_table_destroy(collection->collected_rowids);
+  collection->collected_count = imgids->len;
+  collection->collected = (int *)g_array_free(imgids, FALSE);
+  collection->collected_rowids = rowids;
+  g_mutex_unlock(&collection->collected_lock);
+}
+
+int dt_collection_collected_count(const dt_collection_t *collection)
+{
+  GMutex *lock = (GMutex *)&collection->collected_lock;
+  g_mutex_lock(lock);
+  const int count = collection->collected_count;
+  g_mutex_unlock(lock);
+  return count;
+}
+
+int dt_collection_collected_imgid(const dt_collection_t *collection, const int rowid)
+{
+  GMutex *lock = (GMutex *)&collection->collected_lock;
+  g_mutex_lock(lock);
+  const int imgid = (rowid > 0 && rowid <= (int)collection->collected_count) ? collection->collected[rowid - 1] : -1;
+  g_mutex_unlock(lock);
+  return imgid;
+}
+
+int dt_collection_collected_rowid(const dt_collection_t *collection, const int imgid)
+{
+  GMutex *lock = (GMutex *)&collection->collected_lock;
+  g_mutex_lock(lock);
+  const int rowid = collection->collected_rowids
+                        ? GPOINTER_TO_INT(g_hash_table_lookup(collection->collected_rowids, GINT_TO_POINTER(imgid)))
+                        : 0;
+  g_mutex_unlock(lock);
+  return rowid > 0 ? rowid : -1;
+}
+
+int dt_collection_collected_imgids(const dt_collection_t *collection, const int rowid, const int count,
+                                   int *imgids)
+{
+  GMutex *lock = (GMutex *)&collection->collected_lock;
+  g_mutex_lock(lock);
+  const int first = MAX(rowid, 1);
+  const int last = MIN(rowid + count - 1, (int)collection->collected_count);
+  const int n = MAX(last - first + 1, 0);
+  if(n) memcpy(imgids, collection->collected + first - 1, sizeof(int) * n);
+  g_mutex_unlock(lock);
+  return n;
+}
+
+// the images of the list that the collection query matches, in collection order
+static GArray *_dt_collection_match_ids(const dt_collection_t *collection, const gchar *ids,
+                                        const gboolean no_group)
+{
+  GArray *matched = g_array_new(FALSE, FALSE, sizeof(int));
+  gchar *query = g_strconcat(collection->ids_pre, ids,
+                             no_group ? collection->ids_post_no_group : collection->ids_post, NULL);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int imgid = sqlite3_column_int(stmt, 0);
+    g_array_append_val(matched, imgid);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+  return matched;
+}
+
+static gchar *_dt_collection_ids_to_string(const int *imgids, const int count)
+{
+  GString *ids = g_string_sized_new(8 * count);
+  for(int k = 0; k < count; k++) g_string_append_printf(ids, k ? ",%d" : "%d", imgids[k]);
+  return g_string_free(ids, FALSE);
+}
+
+/* patches memory.collected_images after the images of list changed, assuming nothing else did.
+ * only the changed images get checked against the collection query: the ones it no longer matches are
+ * removed, the others have to stay in order with their neighbours. returns FALSE if that isn't the
+ * case or an image joins the collection, the caller has to rebuild the table then. */
+static gboolean _dt_collection_memory_update_delta(const dt_collection_t *collection, GList *list)
+{
+  const int nb_changed = g_list_length(list);
+  if(collection != darktable.collection || !collection->ids_pre || nb_changed == 0
+     || nb_changed > DT_COLLECTION_DELTA_MAX)
+    return FALSE;
+
+  // the whole merge works on one version of the collected images, a full update waits until it is done
+  dt_collection_t *c = (dt_collection_t *)collection;
+  g_mutex_lock(&c->collected_lock);
+  if(!c->collected)
+  {
+    g_mutex_unlock(&c->collected_lock);
+    return FALSE;
+  }
+
+  const int count = c->collected_count;
+  int *changed = g_malloc_n(nb_changed, sizeof(int));
+  int k = 0;
+  for(GList *l = list; l; l = g_list_next(l)) changed[k++] = GPOINTER_TO_INT(l->data);
+  gchar *ids = _dt_collection_ids_to_string(changed, nb_changed);
+  GArray *matched = _dt_collection_match_ids(collection, ids, FALSE);
+  g_free(ids);
+
+  GHashTable *now_in = g_hash_table_new(g_direct_hash, g_direct_equal);
+  for(guint i = 0; i < matched->len; i++)
+    g_hash_table_add(now_in, GINT_TO_POINTER(g_array_index(matched, int, i)));
+  g_array_free(matched, TRUE);
+
+  // rows to drop, in rowid order. a changed image that wasn't collected before would need its place in the
+  // order found, leave that to the full query.
+  gboolean ok = TRUE;
+  int8_t *drop = g_malloc0(count + 1);
+  int8_t *touched = g_malloc0(count + 1);
+  int nb_drop = 0;
+  for(k = 0; k < nb_changed && ok; k++)
+  {
+    const int found = GPOINTER_TO_INT(g_hash_table_lookup(c->collected_rowids, GINT_TO_POINTER(changed[k])));
+    const int rowid = found > 0 ? found : -1;
+    const gboolean in = g_hash_table_contains(now_in, GINT_TO_POINTER(changed[k]));
+    if(rowid < 0 && in)
+      ok = FALSE;
+    else if(rowid > 0 && !in && !drop[rowid])
+    {
+      drop[rowid] = 1;
+      nb_drop++;
+    }
+    else if(rowid > 0)
+      touched[rowid] = 1;
+  }
+  g_hash_table_destroy(now_in);
+
+  // the remaining images in their old order
+  int *kept = g_malloc_n(MAX(count - nb_drop, 1), sizeof(int));
+  int nb_kept = 0;
+  for(int r = 1; r <= count; r++)
+    if(!drop[r]) kept[nb_kept++] = c->collected[r - 1];
+
+  // the new count has to match, otherwise something else changed too (groups for instance)
+  if(ok && nb_kept != (int)dt_collection_get_count(collection)) ok = FALSE;
+
+  // the changed images that stay, together with their neighbours, have to come back in the same order
+  if(ok)
+  {
+    int8_t *check = g_malloc0(nb_kept);
+    for(int r = 1, n = 0; r <= count; r++)
+    {
+      if(drop[r]) continue;
+      if(touched[r])
+        for(int i = MAX(n - 1, 0); i <= MIN(n + 1, nb_kept - 1); i++) check[i] = 1;
+      n++;
+    }
+    int *expected = g_malloc_n(MAX(nb_kept, 1), sizeof(int));
+    int nb_expected = 0;
+    for(int i = 0; i < nb_kept; i++)
+      if(check[i]) expected[nb_expected++] = kept[i];
+    if(nb_expected)
+    {
+      ids = _dt_collection_ids_to_string(expected, nb_expected);
+      GArray *order = _dt_collection_match_ids(collection, ids, FALSE);
+      g_free(ids);
+      ok = order->len == (guint)nb_expected && !memcmp(order->data, expected, sizeof(int) * nb_expected);
+      g_array_free(order, TRUE);
+    }
+    g_free(expected);
+    g_free(check);
+  }
+
+  if(ok && nb_drop)
+  {
+    // delete the rows and close the gaps. rowids shift down by the number of dropped rows before them, going
+    // through negative values as the rowid has to stay unique all the time.
+    int *dropped = g_malloc_n(nb_drop, sizeof(int));
+    GString *shift = g_string_new("0");
+    for(int r = 1, n = 0; r <= count; r++)
+      if(drop[r])
+      {
+        dropped[n++] = r;
+        g_string_append_printf(shift, "+(rowid>%d)", r);
+      }
+    ids = _dt_collection_ids_to_string(dropped, nb_drop);
+    gchar *query = g_strdup_printf("DELETE FROM memory.collected_images WHERE rowid IN (%s)", ids);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query, NULL, NULL, NULL);
+    g_free(query);
+    query = g_strdup_printf("UPDATE memory.collected_images SET rowid=-(rowid-(%s)) WHERE rowid>%d", shift->str,
+                            dropped[0]);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query, NULL, NULL, NULL);
+    g_free(query);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db),
+                          "UPDATE memory.collected_images SET rowid=-rowid WHERE rowid<0", NULL, NULL, NULL);
+    g_free(ids);
+    g_string_free(shift, TRUE);
+    g_free(dropped);
+
+    GHashTable *rowids = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for(int i = 0; i < nb_kept; i++)
+      g_hash_table_insert(rowids, GINT_TO_POINTER(kept[i]), GINT_TO_POINTER(i + 1));
+
+    g_free(c->collected);
+    g_hash_table_destroy(c->collected_rowids);
+    c->collected = kept;
+    c->collected_count = nb_kept;
+    c->collected_rowids = rowids;
+    kept = NULL;
+  }
+  g_mutex_unlock(&c->collected_lock);
+
+  if(ok)
+    dt_print(DT_DEBUG_SQL, "[collection] %d changed images, %d removed from the collected images in place\n",
+             nb_changed, nb_drop);
+
+  g_free(kept);
+  g_free(drop);
+  g_free(touched);
+  g_free(changed);
+  return ok;
 }
 
 static void _dt_collection_set_selq_pre_sort(const dt_collection_t *collection, char **selq_pre)
@@ -449,6 +692,20 @@ int dt_collection_update(const dt_collection_t *collection)
                         (collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT) ? " " LIMIT_QUERY : "");
   result = _dt_collection_store(collection, query, query_no_group);
 
+  /* and the parts to run it on a few images only */
+  dt_collection_t *c = (dt_collection_t *)collection;
+  g_free(c->ids_pre);
+  g_free(c->ids_post);
+  g_free(c->ids_post_no_group);
+  c->ids_pre = c->ids_post = c->ids_post_no_group = NULL;
+  if(!(collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT))
+  {
+    c->ids_pre = g_strconcat(selq_pre, "mi.id IN (", NULL);
+    c->ids_post = g_strconcat(") AND (", wq, ")", selq_post ? selq_post : "", " ", sq ? sq : "", NULL);
+    c->ids_post_no_group
+        = g_strconcat(") AND (", wq_no_group, ")", selq_post ? selq_post : "", " ", sq ? sq : "", NULL);
+  }
+
 #ifdef _DEBUG
   printf("SQL Collection for 1st:%d and 2nd:%d: %s\n\n",collection->params.sort,collection->params.sort_second_order,query);/*only for debugging*/
 #endif
@@ -2047,11 +2304,33 @@ void dt_collection_update_query(const dt_collection_t *collection, dt_collection
   /* update query and at last the visual */
   dt_collection_update(collection);
 
+  // patch the collected images for the changed ones only if possible
+  const gboolean delta = !collection->clone && query_change == DT_COLLECTION_CHANGE_RELOAD
+                         && _dt_collection_memory_update_delta(collection, list);
+
   // remove from selected images where not in this query.
   sqlite3_stmt *stmt = NULL;
   const gchar *cquery = dt_collection_get_query_no_group(collection);
   gchar *complete_query = NULL;
-  if(cquery && cquery[0] != '\0')
+  if(delta)
+  {
+    // only the changed images can have left the collection
+    int *changed = g_malloc_n(g_list_length(list), sizeof(int));
+    int n = 0;
+    for(GList *l = list; l; l = g_list_next(l)) changed[n++] = GPOINTER_TO_INT(l->data);
+    gchar *ids = _dt_collection_ids_to_string(changed, n);
+    GArray *matched = _dt_collection_match_ids(collection, ids, TRUE);
+    gchar *still = _dt_collection_ids_to_string((int *)matched->data, matched->len);
+    complete_query = g_strdup_printf("DELETE FROM main.selected_images WHERE imgid IN (%s) AND imgid NOT IN (%s)",
+                                     ids, still);
+    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), complete_query, NULL, NULL, NULL);
+    g_free(complete_query);
+    g_free(still);
+    g_array_free(matched, TRUE);
+    g_free(ids);
+    g_free(changed);
+  }
+  else if(cquery && cquery[0] != '\0')
   {
     complete_query
         = dt_util_dstrcat(complete_query, "DELETE FROM main.selected_images WHERE imgid NOT IN (%s)", cquery);
@@ -2068,7 +2347,7 @@ void dt_collection_update_query(const dt_collection_t *collection, dt_collection
   /* raise signal of collection change, only if this is an original */
   if(!collection->clone)
   {
-    dt_collection_memory_update();
+    if(!delta) dt_collection_memory_update();
     DT_DEBUG_CONTROL_SIGNAL_RAISE(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED, query_change, list, next);
   }
 }
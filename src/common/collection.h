@@ -167,6 +167,13 @@ typedef struct dt_collection_t
   unsigned int tagid;
   dt_collection_params_t params;
   dt_collection_params_t store;
+  // the content of memory.collected_images, rowid n being at collected[n-1]
+  int *collected;
+  unsigned int collected_count;
+  GHashTable *collected_rowids; // imgid -> rowid
+  GMutex collected_lock;
+  // query and query_no_group without limit, split where a list of image ids restricts them
+  gchar *ids_pre, *ids_post, *ids_post_no_group;
 } dt_collection_t;
 
 /* returns the name for the given collection property */
@@ -272,6 +279,17 @@ void dt_collection_move_before(const int32_t image_id, GList * selected_images);
 /* initialize memory table */
 void dt_collection_memory_update();
 
+/* the collected images as the memory table holds them, without querying it. rowids start at 1 */
+/** get the number of collected images */
+int dt_collection_collected_count(const dt_collection_t *collection);
+/** get the image at rowid, -1 if there is none */
+int dt_collection_collected_imgid(const dt_collection_t *collection, const int rowid);
+/** get the rowid of an image, -1 if it isn't collected */
+int dt_collection_collected_rowid(const dt_collection_t *collection, const int imgid);
+/** copy the images of up to count rows starting at rowid into imgids. @return the number of images copied */
+int dt_collection_collected_imgids(const dt_collection_t *collection, const int rowid, const int count,
+                                   int *imgids);
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -42,13 +42,12 @@ typedef struct dt_undo_colorlabels_t
 int dt_colorlabels_get_labels(const int imgid)
 {
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT color FROM main.color_labels WHERE imgid = ?1", -1, &stmt, NULL);
+  stmt = dt_database_get_statement(darktable.db, "SELECT color FROM main.color_labels WHERE imgid = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   int colors = 0;
   while(sqlite3_step(stmt) == SQLITE_ROW)
     colors |= (1<<sqlite3_column_int(stmt, 0));
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
   return colors;
 }
 
@@ -94,34 +93,30 @@ static void _colorlabels_undo_data_free(gpointer data)
 
 void dt_colorlabels_remove_labels(const int imgid)
 {
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.color_labels WHERE imgid=?1", -1,
-                              &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_get_statement(darktable.db, "DELETE FROM main.color_labels WHERE imgid=?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 }
 
 void dt_colorlabels_set_label(const int imgid, const int color)
 {
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "INSERT INTO main.color_labels (imgid, color) VALUES (?1, ?2)", -1, &stmt, NULL);
+  stmt = dt_database_get_statement(darktable.db, "INSERT INTO main.color_labels (imgid, color) VALUES (?1, ?2)");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, color);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 }
 
 void dt_colorlabels_remove_label(const int imgid, const int color)
 {
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "DELETE FROM main.color_labels WHERE imgid=?1 AND color=?2", -1, &stmt, NULL);
+  stmt = dt_database_get_statement(darktable.db, "DELETE FROM main.color_labels WHERE imgid=?1 AND color=?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, color);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 }
 
 typedef enum dt_colorlabels_actions_t
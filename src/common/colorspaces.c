@@ -273,6 +273,396 @@ int dt_colorspaces_get_matrix_from_output_profile(cmsHPROFILE prof, float *matri
   return dt_colorspaces_get_matrix_from_profile(prof, matrix, lutr, lutg, lutb, lutsize, 0, intent);
 }
 
+// smallest and largest table tried before giving up on a transform
+#define CLUT_MIN_SIZE 33
+#define CLUT_MAX_SIZE 65
+// unused shared tables kept around for the next pipe
+#define CLUT_CACHED 16
+// number of random samples the tables are checked with
+#define CLUT_CHECK_SAMPLES 4096
+
+// node coordinates of the pixel in, returns whether it's covered by the table
+static inline gboolean _clut_coord(const dt_colorspaces_clut_t *const clut, const float *const in,
+                                   float *const coord)
+{
+  const float n = clut->size - 1.0f;
+  gboolean inside = TRUE;
+  for(int c = 0; c < 3; c++)
+  {
+    const float t = (in[c] - clut->offset[c]) * clut->scale[c];
+    inside = inside && t >= 0.0f && t <= 1.0f;
+    coord[c] = n * (clut->shaped ? sqrtf(MAX(t, 0.0f)) : t);
+  }
+  return inside;
+}
+
+// interpolates the 4 channels at node coordinates x, y, z, pixels outside of the table are clamped to its border
+static inline void _clut_lookup(const dt_colorspaces_clut_t *const clut, float x, float y, float z,
+                                float *const res)
+{
+  const int n = clut->size;
+  x = CLAMPS(x, 0.0f, n - 1.0f);
+  y = CLAMPS(y, 0.0f, n - 1.0f);
+  z = CLAMPS(z, 0.0f, n - 1.0f);
+  const int i = MIN((int)x, n - 2);
+  const int j = MIN((int)y, n - 2);
+  const int k = MIN((int)z, n - 2);
+  const float rx = x - i, ry = y - j, rz = z - k;
+
+  const size_t dx = 4, dy = (size_t)4 * n, dz = (size_t)4 * n * n;
+  const float *const c000 = clut->table + k * dz + j * dy + i * dx;
+  const float *const c111 = c000 + dx + dy + dz;
+
+  // walk from c000 to c111 along the edges of the tetrahedron containing the point
+  const float *a, *b;
+  float w1, w2, w3;
+  if(rx >= ry)
+  {
+    if(ry >= rz)      { a = c000 + dx; b = a + dy; w1 = rx; w2 = ry; w3 = rz; }
+    else if(rx >= rz) { a = c000 + dx; b = a + dz; w1 = rx; w2 = rz; w3 = ry; }
+    else              { a = c000 + dz; b = a + dx; w1 = rz; w2 = rx; w3 = ry; }
+  }
+  else
+  {
+    if(rx >= rz)      { a = c000 + dy; b = a + dx; w1 = ry; w2 = rx; w3 = rz; }
+    else if(ry >= rz) { a = c000 + dy; b = a + dz; w1 = ry; w2 = rz; w3 = rx; }
+    else              { a = c000 + dz; b = a + dy; w1 = rz; w2 = ry; w3 = rx; }
+  }
+
+#ifdef _OPENMP
+#pragma omp simd aligned(c000, c111 : 16)
+#endif
+  for(int c = 0; c < 4; c++)
+    res[c] = c000[c] + w1 * (a[c] - c000[c]) + w2 * (b[c] - a[c]) + w3 * (c111[c] - b[c]);
+}
+
+void dt_colorspaces_clut_apply(const dt_colorspaces_clut_t *const clut, const float *const in, float *const out,
+                               const size_t npixels)
+{
+  // pick up whatever isn't covered by the table before in gets overwritten, in might be out
+  size_t outside = 0;
+  if(!clut->clipping)
+    for(size_t p = 0; p < npixels; p++)
+    {
+      float coord[3];
+      if(!_clut_coord(clut, in + 4 * p, coord)) outside++;
+    }
+
+  float *buf = NULL;
+  size_t *index = NULL;
+  if(outside)
+  {
+    buf = dt_alloc_align(64, sizeof(float) * 4 * outside);
+    index = malloc(sizeof(size_t) * outside);
+    size_t k = 0;
+    for(size_t p = 0; p < npixels; p++)
+    {
+      float coord[3];
+      if(_clut_coord(clut, in + 4 * p, coord)) continue;
+      for(int c = 0; c < 4; c++) buf[4 * k + c] = in[4 * p + c];
+      index[k++] = p;
+    }
+  }
+
+  for(size_t p = 0; p < npixels; p++)
+  {
+    float coord[3], res[4] DT_ALIGNED_PIXEL;
+    _clut_coord(clut, in + 4 * p, coord);
+    _clut_lookup(clut, coord[0], coord[1], coord[2], res);
+    for(int c = 0; c < 3; c++) out[4 * p + c] = res[c];
+  }
+
+  if(!outside) return;
+
+  // and hand those to lcms in one go
+  cmsDoTransform(clut->xform, buf, buf, outside);
+  for(size_t k = 0; k < outside; k++)
+    for(int c = 0; c < 3; c++) out[4 * index[k] + c] = buf[4 * k + c];
+  dt_free_align(buf);
+  free(index);
+}
+
+// largest CIE76 difference between the outputs a and b of npixels
+static float _clut_delta_e(cmsHTRANSFORM to_lab, float *const a, float *const b, const size_t npixels)
+{
+  if(to_lab)
+  {
+    cmsDoTransform(to_lab, a, a, npixels);
+    cmsDoTransform(to_lab, b, b, npixels);
+  }
+  float delta_e = 0.0f;
+  for(size_t p = 0; p < npixels; p++)
+  {
+    const float dL = a[4 * p] - b[4 * p], da = a[4 * p + 1] - b[4 * p + 1], db = a[4 * p + 2] - b[4 * p + 2];
+    const float d = sqrtf(dL * dL + da * da + db * db);
+    // also catches nan
+    if(!(d <= delta_e)) delta_e = isfinite(d) ? d : INFINITY;
+  }
+  return delta_e;
+}
+
+// fill in with npixels random samples of the range the table covers, stretched by extend times its width on
+// each side. every other sample is squared towards the lower end, where most transforms are steepest. a fixed
+// seed keeps the check reproducible.
+static void _clut_random_input(const dt_colorspaces_clut_t *const clut, float *const in, const size_t npixels,
+                               const float extend)
+{
+  uint32_t state = 0x9e3779b9u;
+  for(size_t p = 0; p < npixels; p++)
+  {
+    for(int c = 0; c < 3; c++)
+    {
+      state = state * 1664525u + 1013904223u;
+      float u = (state >> 8) * (1.0f / 16777216.0f);
+      if(p & 1) u *= u;
+      in[4 * p + c] = clut->offset[c] + (u * (1.0f + 2.0f * extend) - extend) / clut->scale[c];
+    }
+    in[4 * p + 3] = 0.0f;
+  }
+}
+
+// sample xform on the nodes of clut and return the largest error on the check samples in
+static float _clut_fill(dt_colorspaces_clut_t *const clut, const float *const in, float *const ref,
+                        float *const res, cmsHTRANSFORM to_lab)
+{
+  const int n = clut->size;
+  const size_t nodes = (size_t)n * n * n;
+  for(size_t k = 0; k < nodes; k++)
+  {
+    const size_t node[3] = { k % n, (k / n) % n, k / ((size_t)n * n) };
+    for(int c = 0; c < 3; c++)
+    {
+      const float u = node[c] / (n - 1.0f);
+      clut->table[4 * k + c] = clut->offset[c] + (clut->shaped ? u * u : u) / clut->scale[c];
+    }
+    clut->table[4 * k + 3] = 0.0f;
+  }
+  cmsDoTransform(clut->xform, clut->table, clut->table, nodes);
+
+  // the check samples are all inside, don't let them go through lcms
+  clut->clipping = TRUE;
+  cmsDoTransform(clut->xform, in, ref, CLUT_CHECK_SAMPLES);
+  dt_colorspaces_clut_apply(clut, in, res, CLUT_CHECK_SAMPLES);
+  return _clut_delta_e(to_lab, ref, res, CLUT_CHECK_SAMPLES);
+}
+
+static void _checksum_profile(GChecksum *sum, cmsHPROFILE profile)
+{
+  cmsUInt32Number len = 0;
+  if(profile && cmsSaveProfileToMem(profile, NULL, &len) && len)
+  {
+    uint8_t *buf = g_malloc(len);
+    if(!cmsSaveProfileToMem(profile, buf, &len)) len = 0;
+    g_checksum_update(sum, buf, len);
+    g_free(buf);
+  }
+  g_checksum_update(sum, (const guchar *)&len, sizeof(len));
+}
+
+gchar *dt_colorspaces_clut_key(cmsHPROFILE in, cmsHPROFILE out, cmsHPROFILE proof, const int intent,
+                               const uint32_t flags)
+{
+  // by contents, profiles of the same type can differ between images (embedded) or over time (display)
+  GChecksum *sum = g_checksum_new(G_CHECKSUM_SHA1);
+  _checksum_profile(sum, in);
+  _checksum_profile(sum, out);
+  _checksum_profile(sum, proof);
+  const uint32_t params[2] = { intent, flags };
+  g_checksum_update(sum, (const guchar *)params, sizeof(params));
+  gchar *key = g_strdup(g_checksum_get_string(sum));
+  g_checksum_free(sum);
+  return key;
+}
+
+// a table in darktable.color_profiles->cluts
+typedef struct dt_colorspaces_clut_shared_t
+{
+  float *table; // NULL if the transform can't be sampled
+  int size;
+  gboolean shaped;
+  gboolean clipping;
+  int users;
+} dt_colorspaces_clut_shared_t;
+
+static void _clut_shared_free(gpointer data)
+{
+  dt_colorspaces_clut_shared_t *shared = (dt_colorspaces_clut_shared_t *)data;
+  dt_free_align(shared->table);
+  free(shared);
+}
+
+static gboolean _clut_shared_unused(gpointer key, gpointer value, gpointer user_data)
+{
+  return ((dt_colorspaces_clut_shared_t *)value)->users == 0;
+}
+
+// use the shared table for key if there is one, returns whether there was. clut_lock has to be held.
+static gboolean _clut_shared_get(dt_colorspaces_clut_t *clut, const gchar *key)
+{
+  dt_colorspaces_clut_shared_t *shared
+      = (dt_colorspaces_clut_shared_t *)g_hash_table_lookup(darktable.color_profiles->cluts, key);
+  if(!shared) return FALSE;
+  if(shared->table)
+  {
+    shared->users++;
+    clut->table = shared->table;
+    clut->size = shared->size;
+    clut->shaped = shared->shaped;
+    clut->clipping = shared->clipping;
+  }
+  return TRUE;
+}
+
+// hand the table of clut over to the shared ones, NULL for a transform which can't be sampled.
+// clut_lock has to be held.
+static void _clut_shared_put(dt_colorspaces_clut_t *clut, const gchar *key)
+{
+  GHashTable *cluts = darktable.color_profiles->cluts;
+  if(g_hash_table_size(cluts) >= CLUT_CACHED) g_hash_table_foreach_remove(cluts, _clut_shared_unused, NULL);
+  dt_colorspaces_clut_shared_t *shared = calloc(1, sizeof(dt_colorspaces_clut_shared_t));
+  if(clut)
+  {
+    shared->table = clut->table;
+    shared->size = clut->size;
+    shared->shaped = clut->shaped;
+    shared->clipping = clut->clipping;
+    shared->users = 1;
+  }
+  g_hash_table_insert(cluts, g_strdup(key), shared);
+}
+
+dt_colorspaces_clut_t *dt_colorspaces_clut_create(cmsHTRANSFORM xform, const float min[3], const float max[3],
+                                                  cmsHTRANSFORM to_lab, const float max_delta_e,
+                                                  const char *key, const size_t npixels)
+{
+  if(!xform) return NULL;
+
+  dt_colorspaces_clut_t *clut = calloc(1, sizeof(dt_colorspaces_clut_t));
+  clut->xform = xform;
+  for(int c = 0; c < 3; c++)
+  {
+    clut->offset[c] = min[c];
+    clut->scale[c] = 1.0f / (max[c] - min[c]);
+  }
+
+  // the same profiles can still be sampled over another range or for other pixel formats
+  if(key)
+  {
+    clut->key = g_strdup_printf("%s %x %x %g %g %g %g %g %g %g", key, cmsGetTransformInputFormat(xform),
+                                cmsGetTransformOutputFormat(xform), min[0], min[1], min[2], max[0], max[1],
+                                max[2], max_delta_e);
+    dt_pthread_mutex_lock(&darktable.color_profiles->clut_lock);
+    const gboolean found = _clut_shared_get(clut, clut->key);
+    dt_pthread_mutex_unlock(&darktable.color_profiles->clut_lock);
+    if(found)
+    {
+      if(clut->table) return clut;
+      g_free(clut->key);
+      free(clut);
+      return NULL;
+    }
+  }
+
+  // the nodes go through lcms, for small images that costs more than transforming the pixels themselves
+  int max_size = 0;
+  for(int n = CLUT_MIN_SIZE; n <= CLUT_MAX_SIZE; n = 2 * n - 1)
+    if(npixels >= (size_t)n * n * n) max_size = n;
+  if(!max_size)
+  {
+    g_free(clut->key);
+    free(clut);
+    return NULL;
+  }
+
+  float *const in = dt_alloc_align(64, sizeof(float) * 4 * CLUT_CHECK_SAMPLES);
+  float *const ref = dt_alloc_align(64, sizeof(float) * 4 * CLUT_CHECK_SAMPLES);
+  float *const res = dt_alloc_align(64, sizeof(float) * 4 * CLUT_CHECK_SAMPLES);
+  _clut_random_input(clut, in, CLUT_CHECK_SAMPLES, 0.0f);
+
+  // the error of the interpolation goes down with the square of the node distance. try evenly spaced nodes
+  // first, and then ones packed towards 0 for gamma encoded or Lab output.
+  float delta_e = INFINITY;
+  for(int shaped = 0; shaped < 2 && !(delta_e <= max_delta_e); shaped++)
+    for(int n = CLUT_MIN_SIZE; n <= max_size && !(delta_e <= max_delta_e); n = 2 * n - 1)
+    {
+      if(n != clut->size)
+      {
+        dt_free_align(clut->table);
+        clut->table = dt_alloc_align(64, sizeof(float) * 4 * n * n * n);
+      }
+      clut->shaped = shaped;
+      clut->size = n;
+      delta_e = _clut_fill(clut, in, ref, res, to_lab);
+    }
+
+  if(delta_e <= max_delta_e)
+  {
+    // does lcms clip the input to the same range? then the table does everything.
+    _clut_random_input(clut, in, CLUT_CHECK_SAMPLES, 0.5f);
+    cmsDoTransform(xform, in, ref, CLUT_CHECK_SAMPLES);
+    dt_colorspaces_clut_apply(clut, in, res, CLUT_CHECK_SAMPLES);
+    clut->clipping = _clut_delta_e(to_lab, ref, res, CLUT_CHECK_SAMPLES) <= max_delta_e;
+
+    dt_print(DT_DEBUG_PERF, "[colorspaces] sampled transform into a %d^3 %s table, max dE %.3f, %s input\n",
+             clut->size, clut->shaped ? "shaped" : "linear", delta_e, clut->clipping ? "clipped" : "unbounded");
+
+    if(clut->key)
+    {
+      // another pipe might have been quicker
+      dt_pthread_mutex_lock(&darktable.color_profiles->clut_lock);
+      const dt_colorspaces_clut_shared_t *shared
+          = (dt_colorspaces_clut_shared_t *)g_hash_table_lookup(darktable.color_profiles->cluts, clut->key);
+      float *table = clut->table;
+      if(shared && shared->table && _clut_shared_get(clut, clut->key))
+        dt_free_align(table);
+      else
+        _clut_shared_put(clut, clut->key);
+      dt_pthread_mutex_unlock(&darktable.color_profiles->clut_lock);
+    }
+  }
+  else
+  {
+    dt_print(DT_DEBUG_PERF, "[colorspaces] transform can't be sampled into a table, max dE %.3f\n", delta_e);
+    // remember that, unless the image was too small to try all sizes
+    if(clut->key && max_size == CLUT_MAX_SIZE)
+    {
+      dt_pthread_mutex_lock(&darktable.color_profiles->clut_lock);
+      if(!g_hash_table_contains(darktable.color_profiles->cluts, clut->key)) _clut_shared_put(NULL, clut->key);
+      dt_pthread_mutex_unlock(&darktable.color_profiles->clut_lock);
+    }
+    dt_colorspaces_clut_free(clut);
+    clut = NULL;
+  }
+
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(res);
+  return clut;
+}
+
+void dt_colorspaces_clut_free(dt_colorspaces_clut_t *clut)
+{
+  if(!clut) return;
+  dt_colorspaces_clut_shared_t *shared = NULL;
+  if(clut->key)
+  {
+    dt_pthread_mutex_lock(&darktable.color_profiles->clut_lock);
+    shared = (dt_colorspaces_clut_shared_t *)g_hash_table_lookup(darktable.color_profiles->cluts, clut->key);
+    if(shared && shared->table && shared->table == clut->table)
+      shared->users--;
+    else
+      shared = NULL;
+    dt_pthread_mutex_unlock(&darktable.color_profiles->clut_lock);
+    g_free(clut->key);
+  }
+  // unused shared tables stay for the next pipe
+  if(!shared) dt_free_align(clut->table);
+  free(clut);
+}
+
+#undef CLUT_MAX_SIZE
+#undef CLUT_CHECK_SAMPLES
+
 static cmsHPROFILE dt_colorspaces_create_lab_profile()
 {
   return cmsCreateLab4Profile(cmsD50_xyY());
@@ -1410,6 +1800,8 @@ dt_colorspaces_t *dt_colorspaces_init()
   _compute_prequantized_primaries(&D65xyY, &Rec709_Primaries, &Rec709_Primaries_Prequantized);
 
   pthread_rwlock_init(&res->xprofile_lock, NULL);
+  dt_pthread_mutex_init(&res->clut_lock, NULL);
+  res->cluts = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, _clut_shared_free);
 
   int in_pos = -1,
       out_pos = -1,
@@ -1623,6 +2015,8 @@ void dt_colorspaces_cleanup(dt_colorspaces_t *self)
   g_list_free_full(self->profiles, free);
 
   pthread_rwlock_destroy(&self->xprofile_lock);
+  g_hash_table_destroy(self->cluts);
+  dt_pthread_mutex_destroy(&self->clut_lock);
   g_free(self->colord_profile_file);
   g_free(self->xprofile_data);
 
@@ -133,6 +133,9 @@ typedef struct dt_colorspaces_t
   cmsHTRANSFORM transform_srgb_to_display, transform_adobe_rgb_to_display;
   cmsHTRANSFORM transform_srgb_to_display2, transform_adobe_rgb_to_display2;
 
+  // tables sampled by dt_colorspaces_clut_create(), shared by all pipes
+  dt_pthread_mutex_t clut_lock;
+  GHashTable *cluts;
 } dt_colorspaces_t;
 
 typedef struct dt_colorspaces_color_profile_t
@@ -150,6 +153,18 @@ typedef struct dt_colorspaces_color_profile_t
   int work_pos;                             // position in working combo box, -1 if not applicable
 } dt_colorspaces_color_profile_t;
 
+/** a lcms transform sampled into a 3D table, see dt_colorspaces_clut_create() */
+typedef struct dt_colorspaces_clut_t
+{
+  int size;                 // number of nodes along each axis
+  float offset[3], scale[3]; // map the input of the transform onto [0, 1]
+  gboolean shaped;          // nodes are spaced by the square of that, for transforms steep near 0
+  float *table;             // size^3 nodes of 4 floats, the first input channel runs fastest
+  cmsHTRANSFORM xform;      // the sampled transform, not owned by the table
+  gboolean clipping;        // the transform clips its input to the sampled range by itself
+  gchar *key;               // the shared table this one uses, NULL if the table is owned
+} dt_colorspaces_clut_t;
+
 int mat3inv_float(float *const dst, const float *const src);
 int mat3inv_double(double *const dst, const double *const src);
 int mat3inv(float *const dst, const float *const src);
@@ -189,6 +204,31 @@ cmsHPROFILE dt_colorspaces_get_rgb_profile_from_mem(uint8_t *data, uint32_t size
 /** free the resources of a profile created with the functions above. */
 void dt_colorspaces_cleanup_profile(cmsHPROFILE p);
 
+/** identifies the transform between the contents of the given profiles for dt_colorspaces_clut_create().
+ * proof may be NULL. g_free() the result. */
+gchar *dt_colorspaces_clut_key(cmsHPROFILE in, cmsHPROFILE out, cmsHPROFILE proof, const int intent,
+                               const uint32_t flags);
+
+/** sample a float transform with 4 channels per pixel on both sides over the input range [min, max] and check
+ * the tetrahedral interpolation against lcms. to_lab converts the output of xform to Lab for the check, pass
+ * NULL if xform outputs Lab already. returns NULL if the table can't reproduce xform within max_delta_e (CIE76).
+ * xform must outlive the table.
+ * with a key from dt_colorspaces_clut_key() the table is shared with all other pipes using the same transform,
+ * and only sampled if none of them did so yet. npixels is about what the pipe transforms per run: sampling
+ * doesn't pay off below the size of the table, NULL is returned then. */
+dt_colorspaces_clut_t *dt_colorspaces_clut_create(cmsHTRANSFORM xform, const float min[3], const float max[3],
+                                                  cmsHTRANSFORM to_lab, const float max_delta_e,
+                                                  const char *key, const size_t npixels);
+
+/** free a table created with dt_colorspaces_clut_create(), NULL is fine. */
+void dt_colorspaces_clut_free(dt_colorspaces_clut_t *clut);
+
+/** drop-in replacement for cmsDoTransform() on the sampled transform, in and out may be the same buffer. pixels
+ * outside of the sampled range still go through lcms unless the transform clips them anyway. the 4th channel of
+ * out is left alone like lcms does. */
+void dt_colorspaces_clut_apply(const dt_colorspaces_clut_t *const clut, const float *const in, float *const out,
+                               const size_t npixels);
+
 /** extracts tonecurves and color matrix prof to XYZ from a given input profile, returns 0 on success (curves
  * and matrix are inverted for input) */
 int dt_colorspaces_get_matrix_from_input_profile(cmsHPROFILE prof, float *matrix, float *lutr, float *lutg,
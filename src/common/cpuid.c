@@ -57,7 +57,24 @@ dt_cpu_flags_t dt_detect_cpu_features()
       if(cx & 0x00040000) cpuflags |= CPU_FLAG_SSE4_1;
       if(cx & 0x00080000) cpuflags |= CPU_FLAG_SSE4_2;
 
-      if(cx & 0x08000000) cpuflags |= CPU_FLAG_AVX;
+      // the avx registers are only usable if the os saves them on context switches
+      if((cx & 0x18000000) == 0x18000000)
+      {
+        guint32 xcr0, xcr0_hi;
+        __asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+        if((xcr0 & 0x06) == 0x06)
+        {
+          cpuflags |= CPU_FLAG_AVX;
+          if(cx & 0x00001000) cpuflags |= CPU_FLAG_FMA;
+
+          /* Request for extended features */
+          if(__get_cpuid_count(0x00000007, 0, &ax, &bx, &cx, &dx))
+          {
+            if(bx & 0x00000020) cpuflags |= CPU_FLAG_AVX2;
+            if((bx & 0x00010000) && (xcr0 & 0xe0) == 0xe0) cpuflags |= CPU_FLAG_AVX512F;
+          }
+        }
+      }
     }
 
     /* Are there extensions? */
@@ -28,6 +28,7 @@
 #include <sys/malloc.h>
 #endif
 
+#include "common/bilateral.h"
 #include "common/collection.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
@@ -61,6 +62,7 @@
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/pixelpipe_cache.h"
 #include "gui/gtk.h"
 #include "gui/guides.h"
 #include "gui/presets.h"
@@ -121,7 +123,7 @@ static int usage(const char *argv0)
   printf("  --configdir <user config directory>\n");
   printf("  -d {all,cache,camctl,camsupport,control,dev,fswatch,imageio,input,\n");
   printf("      ioporder,lighttable,lua,masks,memory,nan,opencl,params,perf,\n");
-  printf("      pwstorage,print,signal,sql,undo}\n");
+  printf("      pwstorage,print,signal,sql,tiling,undo}\n");
   printf("  --d-signal <signal> \n");
   printf("  --d-signal-act <all,raise,connect,disconnect");
 #ifdef DT_HAVE_SIGNAL_TRACE
@@ -311,15 +313,30 @@ static void dt_codepaths_init()
   {
 #ifdef HAVE_BUILTIN_CPU_SUPPORTS
     darktable.codepath.SSE2 = (__builtin_cpu_supports("sse") && __builtin_cpu_supports("sse2"));
+#ifdef HAVE_CODEPATH_CLONES
+    darktable.codepath.AVX2 = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"));
+    darktable.codepath.AVX512 = __builtin_cpu_supports("avx512f") != 0;
+#endif
 #else
     dt_cpu_flags_t flags = dt_detect_cpu_features();
     darktable.codepath.SSE2 = ((flags & (CPU_FLAG_SSE)) && (flags & (CPU_FLAG_SSE2)));
+#ifdef HAVE_CODEPATH_CLONES
+    darktable.codepath.AVX2 = ((flags & (CPU_FLAG_AVX2)) && (flags & (CPU_FLAG_FMA)));
+    darktable.codepath.AVX512 = (flags & (CPU_FLAG_AVX512F)) != 0;
+#endif
 #endif
   }
 
   // second, apply overrides from conf
   // NOTE: all intrinsics sets can only be overridden to OFF
   if(!dt_conf_get_bool("codepaths/sse2")) darktable.codepath.SSE2 = 0;
+  if(!dt_conf_get_bool("codepaths/avx2")) darktable.codepath.AVX2 = 0;
+  if(!dt_conf_get_bool("codepaths/avx512")) darktable.codepath.AVX512 = 0;
+  if(!darktable.codepath.AVX2) darktable.codepath.AVX512 = 0;
+
+  dt_print(DT_DEBUG_PERF, "[dt_codepaths_init] SSE2 %s, AVX2 %s, AVX-512 %s\n",
+           darktable.codepath.SSE2 ? "on" : "off", darktable.codepath.AVX2 ? "on" : "off",
+           darktable.codepath.AVX512 ? "on" : "off");
 
   // last: do we have any intrinsics sets enabled?
   darktable.codepath._no_intrinsics = !(darktable.codepath.SSE2);
@@ -470,6 +487,11 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 #else
                "  SSE2 optimized codepath disabled\n"
 #endif
+#ifdef HAVE_CODEPATH_CLONES
+               "  AVX2 and AVX-512 codepaths enabled\n"
+#else
+               "  AVX2 and AVX-512 codepaths disabled\n"
+#endif
 #ifdef _OPENMP
                "  OpenMP support enabled\n"
 #else
@@ -616,6 +638,8 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
           darktable.unmuted |= DT_DEBUG_SIGNAL; // signal information on console
         else if(!strcmp(argv[k + 1], "params"))
           darktable.unmuted |= DT_DEBUG_PARAMS; // iop module params checks on console
+        else if(!strcmp(argv[k + 1], "tiling"))
+          darktable.unmuted |= DT_DEBUG_TILING; // timing of tiled processing
         else
           return usage(argv[0]);
         k++;
@@ -1042,6 +1066,20 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   darktable.mipmap_cache = (dt_mipmap_cache_t *)calloc(1, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
 
+  // intermediate buffers shared by all pixelpipes
+  const int64_t pixelpipe_cache_memory = dt_conf_get_int64("cache_pixelpipe_memory");
+  darktable.pixelpipe_cache = (dt_dev_pixelpipe_cache_shared_t *)calloc(1, sizeof(dt_dev_pixelpipe_cache_shared_t));
+  dt_dev_pixelpipe_cache_shared_init(darktable.pixelpipe_cache, MAX(pixelpipe_cache_memory, 0));
+  if(dt_conf_get_bool("cache_pixelpipe_disk_backend"))
+  {
+    char cachedir[PATH_MAX] = { 0 };
+    dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+    gchar *pixelpipe_cachedir = g_build_filename(cachedir, "pixelpipe", NULL);
+    dt_dev_pixelpipe_cache_shared_set_disk(darktable.pixelpipe_cache, pixelpipe_cachedir,
+                                           MAX(dt_conf_get_int64("cache_pixelpipe_disk_size"), 0));
+    g_free(pixelpipe_cachedir);
+  }
+
   // The GUI must be initialized before the views, because the init()
   // functions of the views depend on darktable.control->accels_* to register
   // their keyboard accelerators
@@ -1261,6 +1299,9 @@ void dt_cleanup()
   free(darktable.image_cache);
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
   free(darktable.mipmap_cache);
+  if(darktable.unmuted & DT_DEBUG_CACHE) dt_dev_pixelpipe_cache_shared_print(darktable.pixelpipe_cache);
+  dt_dev_pixelpipe_cache_shared_cleanup(darktable.pixelpipe_cache);
+  free(darktable.pixelpipe_cache);
   if(init_gui)
   {
     dt_control_cleanup(darktable.control);
@@ -1273,6 +1314,7 @@ void dt_cleanup()
   dt_points_cleanup(darktable.points);
   free(darktable.points);
   dt_iop_unload_modules_so();
+  dt_bilateral_free_pool();
   g_list_free_full(darktable.iop_order_list, free);
   darktable.iop_order_list = NULL;
   g_list_free_full(darktable.iop_order_rules, free);
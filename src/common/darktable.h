@@ -249,15 +249,45 @@ typedef enum dt_debug_thread_t
   DT_DEBUG_UNDO           = 1 << 19,
   DT_DEBUG_SIGNAL         = 1 << 20,
   DT_DEBUG_PARAMS         = 1 << 21,
+  DT_DEBUG_TILING         = 1 << 22,
 } dt_debug_thread_t;
 
 typedef struct dt_codepath_t
 {
   unsigned int SSE2 : 1;
+  unsigned int AVX2 : 1;   // AVX2 and FMA
+  unsigned int AVX512 : 1; // AVX-512F, only set together with AVX2
   unsigned int _no_intrinsics : 1;
   unsigned int OPENMP_SIMD : 1; // always stays the last one
 } dt_codepath_t;
 
+/* kernels listed in src/CMakeLists.txt are compiled two more times from their plain C code, for AVX2 and for
+ * AVX-512. in those builds DT_CODEPATH_CLONE is set to the name of the instruction set, DT_CODEPATH_NAME()
+ * appends it to the entry points and DT_CODEPATH_PLAIN forces the plain codepath.
+ * DT_CODEPATH_DECLARE() declares all variants of an entry point, DT_CODEPATH_SELECT() picks the one matching
+ * darktable.codepath once it has been detected at startup. */
+#ifdef DT_CODEPATH_CLONE
+#define DT_CODEPATH_NAME(name) DT_CODEPATH_NAME_(name, DT_CODEPATH_CLONE)
+#define DT_CODEPATH_NAME_(name, isa) DT_CODEPATH_NAME__(name, isa)
+#define DT_CODEPATH_NAME__(name, isa) name##_##isa
+#define DT_CODEPATH_PLAIN 1
+#else
+#define DT_CODEPATH_NAME(name) name
+#define DT_CODEPATH_PLAIN (darktable.codepath.OPENMP_SIMD)
+#endif
+
+#ifdef HAVE_CODEPATH_CLONES
+#define DT_CODEPATH_DECLARE(type, name, args)                                                                  \
+  type name args;                                                                                              \
+  type name##_avx2 args;                                                                                       \
+  type name##_avx512 args
+#define DT_CODEPATH_SELECT(name)                                                                               \
+  (darktable.codepath.AVX512 ? name##_avx512 : darktable.codepath.AVX2 ? name##_avx2 : name)
+#else
+#define DT_CODEPATH_DECLARE(type, name, args) type name args
+#define DT_CODEPATH_SELECT(name) (name)
+#endif
+
 typedef struct darktable_t
 {
   dt_codepath_t codepath;
@@ -278,6 +308,7 @@ typedef struct darktable_t
   struct dt_gui_gtk_t *gui;
   struct dt_mipmap_cache_t *mipmap_cache;
   struct dt_image_cache_t *image_cache;
+  struct dt_dev_pixelpipe_cache_shared_t *pixelpipe_cache;
   struct dt_bauhaus_t *bauhaus;
   const struct dt_database_t *db;
   const struct dt_pwstorage_t *pwstorage;
@@ -62,8 +62,32 @@ typedef struct dt_database_t
 
   gchar *error_message, *error_dbfilename;
   int error_other_pid;
+
+  /* prepared statements kept for reuse, see dt_database_get_statement() */
+  GHashTable *statements; // sql -> dt_database_statement_t
+  GHashTable *statements_in_use; // sqlite3_stmt -> dt_database_cached_stmt_t
+  GMutex statements_lock;
 } dt_database_t;
 
+/* all prepared statements of one sql text, with the usage stats shown by -d sql */
+typedef struct dt_database_statement_t
+{
+  gchar *sql;
+  GSList *free; // dt_database_cached_stmt_t not handed out
+  uint64_t calls, prepared;
+  double time;
+} dt_database_statement_t;
+
+typedef struct dt_database_cached_stmt_t
+{
+  sqlite3_stmt *stmt;
+  dt_database_statement_t *statement;
+  double start;
+} dt_database_cached_stmt_t;
+
+// more statements than that per sql text only happen with recursion, don't keep them
+#define DT_DATABASE_STATEMENTS_FREE_MAX 4
+
 
 /* migrates database from old place to new */
 static void _database_migrate_to_xdg_structure();
@@ -2549,6 +2573,7 @@ start:
 
   /* create database */
   dt_database_t *db = (dt_database_t *)g_malloc0(sizeof(dt_database_t));
+  g_mutex_init(&db->statements_lock);
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
 
@@ -3047,8 +3072,141 @@ error:
   return db;
 }
 
+static void _database_statement_free(gpointer data)
+{
+  dt_database_statement_t *statement = (dt_database_statement_t *)data;
+  for(GSList *l = statement->free; l; l = g_slist_next(l))
+  {
+    dt_database_cached_stmt_t *cached = (dt_database_cached_stmt_t *)l->data;
+    sqlite3_finalize(cached->stmt);
+    g_free(cached);
+  }
+  g_slist_free(statement->free);
+  g_free(statement->sql);
+  g_free(statement);
+}
+
+static gint _database_statement_time_cmp(gconstpointer a, gconstpointer b)
+{
+  const dt_database_statement_t *sa = (const dt_database_statement_t *)a;
+  const dt_database_statement_t *sb = (const dt_database_statement_t *)b;
+  return (sa->time < sb->time) - (sa->time > sb->time);
+}
+
+static void _database_statements_cleanup(dt_database_t *db)
+{
+  if(!db->statements) return;
+
+  if(darktable.unmuted & DT_DEBUG_SQL)
+  {
+    GList *statements = g_list_sort(g_hash_table_get_values(db->statements), _database_statement_time_cmp);
+    dt_print(DT_DEBUG_SQL, "[sql] cached statements, by time spent:\n");
+    for(GList *l = statements; l; l = g_list_next(l))
+    {
+      const dt_database_statement_t *statement = (dt_database_statement_t *)l->data;
+      dt_print(DT_DEBUG_SQL, "[sql] %9" PRIu64 " calls %9.3f secs, prepared %" PRIu64 " times: \"%s\"\n",
+               statement->calls, statement->time, statement->prepared, statement->sql);
+    }
+    g_list_free(statements);
+  }
+
+  // whatever wasn't given back has to be finalized too, or the data base can't be closed
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, db->statements_in_use);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    sqlite3_finalize((sqlite3_stmt *)key);
+    g_free(value);
+  }
+  g_hash_table_destroy(db->statements_in_use);
+  g_hash_table_destroy(db->statements);
+  db->statements = db->statements_in_use = NULL;
+}
+
+sqlite3_stmt *dt_database_get_statement(const dt_database_t *db, const char *sql)
+{
+  dt_database_t *d = (dt_database_t *)db;
+  dt_database_cached_stmt_t *cached = NULL;
+
+  g_mutex_lock(&d->statements_lock);
+  if(!d->statements)
+  {
+    d->statements = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, _database_statement_free);
+    d->statements_in_use = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+  dt_database_statement_t *statement = g_hash_table_lookup(d->statements, sql);
+  if(!statement)
+  {
+    statement = g_malloc0(sizeof(dt_database_statement_t));
+    statement->sql = g_strdup(sql);
+    g_hash_table_insert(d->statements, statement->sql, statement);
+  }
+  if(statement->free)
+  {
+    cached = (dt_database_cached_stmt_t *)statement->free->data;
+    statement->free = g_slist_delete_link(statement->free, statement->free);
+  }
+  statement->calls++;
+  g_mutex_unlock(&d->statements_lock);
+
+  const gboolean prepare = !cached;
+  if(prepare)
+  {
+    // in use somewhere else or never prepared yet
+    sqlite3_stmt *stmt = NULL;
+    DT_DEBUG_SQLITE3_PREPARE_V2(db->handle, sql, -1, &stmt, NULL);
+    if(!stmt) return NULL;
+    cached = g_malloc(sizeof(dt_database_cached_stmt_t));
+    cached->stmt = stmt;
+    cached->statement = statement;
+  }
+  cached->start = (darktable.unmuted & DT_DEBUG_SQL) ? dt_get_wtime() : 0.0;
+
+  g_mutex_lock(&d->statements_lock);
+  if(prepare) statement->prepared++;
+  g_hash_table_insert(d->statements_in_use, cached->stmt, cached);
+  g_mutex_unlock(&d->statements_lock);
+  return cached->stmt;
+}
+
+void dt_database_release_statement(const dt_database_t *db, sqlite3_stmt *stmt)
+{
+  if(!stmt) return;
+  dt_database_t *d = (dt_database_t *)db;
+
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+
+  gboolean keep = FALSE;
+  g_mutex_lock(&d->statements_lock);
+  dt_database_cached_stmt_t *cached
+      = d->statements_in_use ? g_hash_table_lookup(d->statements_in_use, stmt) : NULL;
+  if(cached)
+  {
+    g_hash_table_remove(d->statements_in_use, stmt);
+    dt_database_statement_t *statement = cached->statement;
+    if(darktable.unmuted & DT_DEBUG_SQL) statement->time += dt_get_wtime() - cached->start;
+    if(g_slist_length(statement->free) < DT_DATABASE_STATEMENTS_FREE_MAX)
+    {
+      statement->free = g_slist_prepend(statement->free, cached);
+      keep = TRUE;
+    }
+  }
+  g_mutex_unlock(&d->statements_lock);
+
+  // not from the cache, or too many of them
+  if(!keep)
+  {
+    sqlite3_finalize(stmt);
+    g_free(cached);
+  }
+}
+
 void dt_database_destroy(const dt_database_t *db)
 {
+  _database_statements_cleanup((dt_database_t *)db);
+  g_mutex_clear(&((dt_database_t *)db)->statements_lock);
   sqlite3_close(db->handle);
   if (db->lockfile_data)
   {
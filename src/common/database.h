@@ -28,6 +28,11 @@ struct dt_database_t *dt_database_init(const char *alternative, const gboolean l
 void dt_database_destroy(const struct dt_database_t *);
 /** get handle */
 struct sqlite3 *dt_database_get(const struct dt_database_t *);
+/** get a prepared statement for sql from the cache, ready to bind and step. the sql text has to be the same for
+ * every call, so use bound parameters rather than printing values into it. */
+struct sqlite3_stmt *dt_database_get_statement(const struct dt_database_t *db, const char *sql);
+/** give a statement from dt_database_get_statement() back instead of finalizing it */
+void dt_database_release_statement(const struct dt_database_t *db, struct sqlite3_stmt *stmt);
 /** Returns database path */
 const gchar *dt_database_get_path(const struct dt_database_t *db);
 /** test if database was already locked by another instance */
@@ -194,8 +194,9 @@ static inline __m128 weight_sse2(const __m128 *c1, const __m128 *c2, const float
   pcoarse += 4;
 #endif
 
-void eaw_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
-                   const int scale, const float sharpen, const int32_t width, const int32_t height)
+void DT_CODEPATH_NAME(eaw_decompose)(float *const restrict out, const float *const restrict in,
+                                     float *const restrict detail, const int scale, const float sharpen,
+                                     const int32_t width, const int32_t height)
 {
   const int mult = 1 << scale;
   static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
@@ -315,7 +316,7 @@ void eaw_decompose(float *const restrict out, const float *const restrict in, fl
 #undef SUM_PIXEL_EPILOGUE
 
 
-#if defined(__SSE2__)
+#if defined(__SSE2__) && !defined(DT_CODEPATH_CLONE)
 void eaw_decompose_sse2(float *const restrict out, const float *const restrict in, float *const restrict detail,
                         const int scale, const float sharpen, const int32_t width, const int32_t height)
 {
@@ -439,9 +440,9 @@ void eaw_decompose_sse2(float *const restrict out, const float *const restrict i
 #undef SUM_PIXEL_EPILOGUE_SSE
 #endif
 
-void eaw_synthesize(float *const restrict out, const float *const restrict in, const float *const restrict detail,
-                    const float *const restrict threshold, const float *const restrict boost,
-                    const int32_t width, const int32_t height)
+void DT_CODEPATH_NAME(eaw_synthesize)(float *const restrict out, const float *const restrict in,
+                                      const float *const restrict detail, const float *const restrict threshold,
+                                      const float *const restrict boost, const int32_t width, const int32_t height)
 {
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
@@ -466,7 +467,7 @@ void eaw_synthesize(float *const restrict out, const float *const restrict in, c
   }
 }
 
-#if defined(__SSE2__)
+#if defined(__SSE2__) && !defined(DT_CODEPATH_CLONE)
 void eaw_synthesize_sse2(float *const restrict out, const float *const restrict in, const float *const restrict detail,
                          const float *const restrict thrsf, const float *const restrict boostf,
                          const int32_t width, const int32_t height)
@@ -493,6 +494,9 @@ void eaw_synthesize_sse2(float *const restrict out, const float *const restrict
 }
 #endif
 
+// the denoising wavelets are not built for the wider codepaths
+#ifndef DT_CODEPATH_CLONE
+
 // =====================================================================================
 // begin wavelet code from denoiseprofile.c
 // =====================================================================================
@@ -804,3 +808,4 @@ void eaw_dn_decompose_sse(float *const restrict out, const float *const restrict
 #undef SUM_PIXEL_EPILOGUE_SSE
 #endif
 
+#endif /* DT_CODEPATH_CLONE */
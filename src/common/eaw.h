@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "common/darktable.h"
 #include <stdint.h>
 #include <stdlib.h>
 
@@ -28,11 +29,13 @@ typedef void((*eaw_synthesize_t)(float *const restrict out, const float *const r
                                  const float *const restrict thrsf, const float *const restrict boostf,
                                  const int32_t width, const int32_t height));
 
-void eaw_decompose(float *const restrict out, const float *const restrict in, float *const restrict detail,
-                   const int scale, const float sharpen, const int32_t width, const int32_t height) ;
-void eaw_synthesize(float *const restrict out, const float *const restrict in, const float *const restrict detail,
-                    const float *const restrict thrsf, const float *const restrict boostf,
-                    const int32_t width, const int32_t height);
+DT_CODEPATH_DECLARE(void, eaw_decompose,
+                    (float *const restrict out, const float *const restrict in, float *const restrict detail,
+                     const int scale, const float sharpen, const int32_t width, const int32_t height));
+DT_CODEPATH_DECLARE(void, eaw_synthesize,
+                    (float *const restrict out, const float *const restrict in, const float *const restrict detail,
+                     const float *const restrict thrsf, const float *const restrict boostf,
+                     const int32_t width, const int32_t height));
 
 void eaw_decompose_sse2(float *const restrict out, const float *const restrict in, float *const restrict detail,
                         const int scale, const float sharpen, const int32_t width, const int32_t height);
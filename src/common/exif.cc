@@ -1410,7 +1410,40 @@ int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char
 /** read the metadata of an image.
  * XMP data trumps IPTC data trumps EXIF data
  */
+struct dt_exif_image_t
+{
+  std::unique_ptr<Exiv2::Image> image;
+};
+
+dt_exif_image_t *dt_exif_image_open(const char *path)
+{
+  try
+  {
+    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+    assert(image.get() != 0);
+    read_metadata_threadsafe(image);
+    dt_exif_image_t *exif = new dt_exif_image_t;
+    exif->image = std::move(image);
+    return exif;
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    // the caller reads the file again and reports the error then
+    return NULL;
+  }
+}
+
+void dt_exif_image_free(dt_exif_image_t *exif)
+{
+  delete exif;
+}
+
 int dt_exif_read(dt_image_t *img, const char *path)
+{
+  return dt_exif_read_image(img, path, NULL);
+}
+
+int dt_exif_read_image(dt_image_t *img, const char *path, dt_exif_image_t *exif)
 {
   // at least set datetime taken to something useful in case there is no exif data in this file (pfm, png,
   // ...)
@@ -1424,9 +1457,14 @@ int dt_exif_read(dt_image_t *img, const char *path)
 
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
+    std::unique_ptr<Exiv2::Image> opened;
+    if(!exif)
+    {
+      opened = std::unique_ptr<Exiv2::Image>(Exiv2::ImageFactory::open(WIDEN(path)));
+      assert(opened.get() != 0);
+      read_metadata_threadsafe(opened);
+    }
+    Exiv2::Image *image = exif ? exif->image.get() : opened.get();
     bool res = true;
 
     // EXIF metadata
@@ -2715,6 +2753,11 @@ static gboolean _image_altered_deprecated(const uint32_t imgid)
 
 // need a write lock on *img (non-const) to write stars (and soon color labels).
 int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_only)
+{
+  return dt_exif_xmp_read_image(img, filename, history_only, NULL);
+}
+
+int dt_exif_xmp_read_image(dt_image_t *img, const char *filename, const int history_only, dt_exif_image_t *exif)
 {
   // exclude pfm to avoid stupid errors on the console
   const char *c = filename + strlen(filename) - 4;
@@ -2722,9 +2765,14 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
   try
   {
     // read xmp sidecar
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(filename)));
-    assert(image.get() != 0);
-    read_metadata_threadsafe(image);
+    std::unique_ptr<Exiv2::Image> opened;
+    if(!exif)
+    {
+      opened = std::unique_ptr<Exiv2::Image>(Exiv2::ImageFactory::open(WIDEN(filename)));
+      assert(opened.get() != 0);
+      read_metadata_threadsafe(opened);
+    }
+    Exiv2::Image *image = exif ? exif->image.get() : opened.get();
     Exiv2::XmpData &xmpData = image->xmpData();
 
     sqlite3_stmt *stmt;
@@ -2837,7 +2885,8 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
 
     // now add all masks that are not used for cloning. keeping them might be useful.
     // TODO: make this configurable? or remove it altogether?
-    sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+    // savepoints rather than transactions, the import may have one open already
+    sqlite3_exec(dt_database_get(darktable.db), "SAVEPOINT xmp_masks", NULL, NULL, NULL);
     if(version < 3)
     {
       g_hash_table_foreach(mask_entries, add_non_clone_mask_entries_to_db, &img->id);
@@ -2854,7 +2903,7 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
         m_entries = g_list_next(m_entries);
       }
     }
-    sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "RELEASE xmp_masks", NULL, NULL, NULL);
 
     // history
     int num = 0;
@@ -2877,7 +2926,7 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
       return 1;
     }
 
-    sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+    sqlite3_exec(dt_database_get(darktable.db), "SAVEPOINT xmp_history", NULL, NULL, NULL);
 
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.history WHERE imgid = ?1", -1,
                                 &stmt, NULL);
@@ -3116,7 +3165,7 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
 
     if(all_ok)
     {
-      sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+      sqlite3_exec(dt_database_get(darktable.db), "RELEASE xmp_history", NULL, NULL, NULL);
 
       // history_hash
       dt_history_hash_values_t hash = {NULL, 0, NULL, 0, NULL, 0};
@@ -3152,7 +3201,8 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
     else
     {
       std::cerr << "[exif] error reading history from '" << filename << "'" << std::endl;
-      sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK TO xmp_history", NULL, NULL, NULL);
+      sqlite3_exec(dt_database_get(darktable.db), "RELEASE xmp_history", NULL, NULL, NULL);
       return 1;
     }
 
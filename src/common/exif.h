@@ -33,9 +33,19 @@ void dt_exif_set_exiv2_taglist();
 /** must not be freed */
 const GList * const dt_exif_get_exiv2_taglist();
 
+/** metadata of a file as exiv2 read it, not decoded yet */
+typedef struct dt_exif_image_t dt_exif_image_t;
+
+/** open a file and read its metadata, so that this can be done ahead of dt_exif_read_image() or
+ * dt_exif_xmp_read_image() on another thread. returns NULL if the file can't be read. */
+dt_exif_image_t *dt_exif_image_open(const char *path);
+void dt_exif_image_free(dt_exif_image_t *exif);
+
 /** read metadata from file with full path name, XMP data trumps IPTC data trumps EXIF data, store to image
  * struct. returns 0 on success. */
 int dt_exif_read(dt_image_t *img, const char *path);
+/** same, from the metadata dt_exif_image_open() read already. reads the file if exif is NULL. */
+int dt_exif_read_image(dt_image_t *img, const char *path, dt_exif_image_t *exif);
 
 /** read exif data to image struct from given data blob, wherever you got it from. */
 int dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size);
@@ -62,6 +72,8 @@ char *dt_exif_xmp_read_string(const int imgid);
 
 /** read xmp sidecar file. */
 int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_only);
+/** same, from the sidecar dt_exif_image_open() read already. reads the file if exif is NULL. */
+int dt_exif_xmp_read_image(dt_image_t *img, const char *filename, const int history_only, dt_exif_image_t *exif);
 
 /** apply default import metadata */
 void dt_exif_apply_default_metadata(dt_image_t *img);
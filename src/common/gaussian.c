@@ -33,6 +33,9 @@
 
 #define BLOCKSIZE (1 << 6)
 
+// number of adjacent columns filtered together by the vertical pass
+#define COLUMNS 16
+
 static void compute_gauss_params(const float sigma, dt_gaussian_order_t order, float *a0, float *a1,
                                  float *a2, float *a3, float *b1, float *b2, float *coefp, float *coefn)
 {
@@ -155,95 +158,116 @@ error:
 }
 
 
-void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+/* vertical pass of the recursive filter. instead of walking down one column at a time, which
+   touches a new cache line for every sample, a block of adjacent columns is filtered together: each
+   row of the block is contiguous in memory and the inner loop over it vectorizes. */
+static void _blur_vertical(const float *const in, float *const temp, const int width, const int height,
+                           const int ch, const float *const Labmin, const float *const Labmax, const float a0,
+                           const float a1, const float a2, const float a3, const float b1, const float b2,
+                           const float coefp, const float coefn)
 {
+  // clamping bounds laid out like a row of the block
+  float lo[COLUMNS * 4], hi[COLUMNS * 4];
+  for(int m = 0; m < COLUMNS * ch; m++)
+  {
+    lo[m] = Labmin[m % ch];
+    hi[m] = Labmax[m % ch];
+  }
 
-  const int width = g->width;
-  const int height = g->height;
-  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
-
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
-
-  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
-
-  float *temp = g->buf;
-
-  float *Labmax = g->max;
-  float *Labmin = g->min;
+  const size_t stride = (size_t)width * ch;
 
-// vertical blur column by column
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, width, height, ch) \
-  shared(temp, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  dt_omp_firstprivate(in, temp, width, height, ch, stride, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  shared(lo, hi) \
   schedule(static)
 #endif
-  for(int i = 0; i < width; i++)
+  for(int i = 0; i < width; i += COLUMNS)
   {
-    float xp[4] = {0.0f};
-    float yb[4] = {0.0f};
-    float yp[4] = {0.0f};
-    float xc[4] = {0.0f};
-    float yc[4] = {0.0f};
-    float xn[4] = {0.0f};
-    float xa[4] = {0.0f};
-    float yn[4] = {0.0f};
-    float ya[4] = {0.0f};
+    const int n = MIN(COLUMNS, width - i) * ch;
+    const float *const inblock = in + (size_t)i * ch;
+    float *const tempblock = temp + (size_t)i * ch;
+
+    float xp[COLUMNS * 4], yb[COLUMNS * 4], yp[COLUMNS * 4];
+    float xn[COLUMNS * 4], xa[COLUMNS * 4], yn[COLUMNS * 4], ya[COLUMNS * 4];
 
     // forward filter
-    for(int k = 0; k < ch; k++)
+    for(int m = 0; m < n; m++)
     {
-      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
-      xc[k] = yc[k] = xn[k] = xa[k] = yn[k] = ya[k] = 0.0f;
+      xp[m] = CLAMPF(inblock[m], lo[m], hi[m]);
+      yb[m] = xp[m] * coefp;
+      yp[m] = yb[m];
     }
 
     for(int j = 0; j < height; j++)
     {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
+      const float *const inrow = inblock + j * stride;
+      float *const temprow = tempblock + j * stride;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int m = 0; m < n; m++)
       {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+        const float xc = CLAMPF(inrow[m], lo[m], hi[m]);
+        const float yc = (a0 * xc) + (a1 * xp[m]) - (b1 * yp[m]) - (b2 * yb[m]);
 
-        temp[offset + k] = yc[k];
+        temprow[m] = yc;
 
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
+        xp[m] = xc;
+        yb[m] = yp[m];
+        yp[m] = yc;
       }
     }
 
     // backward filter
-    for(int k = 0; k < ch; k++)
+    for(int m = 0; m < n; m++)
     {
-      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
-      xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
-      ya[k] = yn[k];
+      xn[m] = CLAMPF(inblock[(height - 1) * stride + m], lo[m], hi[m]);
+      xa[m] = xn[m];
+      yn[m] = xn[m] * coefn;
+      ya[m] = yn[m];
     }
 
     for(int j = height - 1; j > -1; j--)
     {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
+      const float *const inrow = inblock + j * stride;
+      float *const temprow = tempblock + j * stride;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int m = 0; m < n; m++)
       {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+        const float xc = CLAMPF(inrow[m], lo[m], hi[m]);
+        const float yc = (a2 * xn[m]) + (a3 * xa[m]) - (b1 * yn[m]) - (b2 * ya[m]);
 
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
+        xa[m] = xn[m];
+        xn[m] = xc;
+        ya[m] = yn[m];
+        yn[m] = yc;
 
-        temp[offset + k] += yc[k];
+        temprow[m] += yc;
       }
     }
   }
+}
+
+void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+{
+
+  const int width = g->width;
+  const int height = g->height;
+  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
+
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+
+  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+
+  float *temp = g->buf;
+
+  float *Labmax = g->max;
+  float *Labmin = g->min;
+
+  _blur_vertical(in, temp, width, height, ch, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn);
 
 // horizontal blur line by line
 #ifdef _OPENMP
@@ -341,77 +365,7 @@ static void dt_gaussian_blur_4c_sse(dt_gaussian_t *g, const float *const in, flo
 
   float *temp = g->buf;
 
-
-// vertical blur column by column
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, Labmin, Labmax, width, height, ch) \
-  shared(temp, a0, a1, a2, a3, b1, b2, coefp, coefn) \
-  schedule(static)
-#endif
-  for(int i = 0; i < width; i++)
-  {
-    __m128 xp = _mm_setzero_ps();
-    __m128 yb = _mm_setzero_ps();
-    __m128 yp = _mm_setzero_ps();
-    __m128 xc = _mm_setzero_ps();
-    __m128 yc = _mm_setzero_ps();
-    __m128 xn = _mm_setzero_ps();
-    __m128 xa = _mm_setzero_ps();
-    __m128 yn = _mm_setzero_ps();
-    __m128 ya = _mm_setzero_ps();
-
-    // forward filter
-    xp = MMCLAMPPS(_mm_load_ps(in + i * ch), Labmin, Labmax);
-    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
-    yp = yb;
-
-
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
-
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xc, _mm_set_ps1(a0)),
-          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
-                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
-
-      _mm_store_ps(temp + offset, yc);
-
-      xp = xc;
-      yb = yp;
-      yp = yc;
-    }
-
-    // backward filter
-    xn = MMCLAMPPS(_mm_load_ps(in + ((size_t)(height - 1) * width + i) * ch), Labmin, Labmax);
-    xa = xn;
-    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
-    ya = yn;
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xn, _mm_set_ps1(a2)),
-          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
-                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
-
-
-      xa = xn;
-      xn = xc;
-      ya = yn;
-      yn = yc;
-
-      _mm_store_ps(temp + offset, _mm_add_ps(_mm_load_ps(temp + offset), yc));
-    }
-  }
+  _blur_vertical(in, temp, width, height, ch, g->min, g->max, a0, a1, a2, a3, b1, b2, coefp, coefn);
 
 // horizontal blur line by line
 #ifdef _OPENMP
@@ -1276,8 +1276,40 @@ static void _image_read_duplicates(const uint32_t id, const char *filename)
   g_list_free_full(files, g_free);
 }
 
+struct dt_image_import_prefetch_t
+{
+  dt_exif_image_t *exif; // the file itself
+  dt_exif_image_t *xmp;  // its sidecar, NULL if there is none
+};
+
+dt_image_import_prefetch_t *dt_image_import_prefetch(const char *filename)
+{
+  char *normalized_filename = dt_util_normalize_path(filename);
+  if(!normalized_filename || !g_file_test(normalized_filename, G_FILE_TEST_IS_REGULAR))
+  {
+    g_free(normalized_filename);
+    return NULL;
+  }
+  dt_image_import_prefetch_t *prefetch = g_malloc0(sizeof(dt_image_import_prefetch_t));
+  prefetch->exif = dt_exif_image_open(normalized_filename);
+  gchar *xmpfilename = g_strconcat(normalized_filename, ".xmp", NULL);
+  if(g_file_test(xmpfilename, G_FILE_TEST_IS_REGULAR)) prefetch->xmp = dt_exif_image_open(xmpfilename);
+  g_free(xmpfilename);
+  g_free(normalized_filename);
+  return prefetch;
+}
+
+void dt_image_import_prefetch_free(dt_image_import_prefetch_t *prefetch)
+{
+  if(!prefetch) return;
+  if(prefetch->exif) dt_exif_image_free(prefetch->exif);
+  if(prefetch->xmp) dt_exif_image_free(prefetch->xmp);
+  g_free(prefetch);
+}
+
 static uint32_t _image_import_internal(const int32_t film_id, const char *filename,
-                                       gboolean override_ignore_jpegs, gboolean lua_locking)
+                                       gboolean override_ignore_jpegs, gboolean lua_locking,
+                                       dt_image_import_prefetch_t *prefetch)
 {
   char *normalized_filename = dt_util_normalize_path(filename);
   if(!normalized_filename
@@ -1320,17 +1352,16 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
   uint32_t id = 0;
   // select from images; if found => return
   gchar *imgfname = g_path_get_basename(normalized_filename);
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2", -1, &stmt, NULL);
+  // the queries below run for every imported image, they come from the statement cache
+  sqlite3_stmt *stmt
+      = dt_database_get_statement(darktable.db, "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, imgfname, -1, SQLITE_STATIC);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
     id = sqlite3_column_int(stmt, 0);
+    dt_database_release_statement(darktable.db, stmt);
     g_free(imgfname);
-    sqlite3_finalize(stmt);
     dt_image_t *img = dt_image_cache_get(darktable.image_cache, id, 'w');
     img->flags &= ~DT_IMAGE_REMOVE;
     dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
@@ -1344,7 +1375,7 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
                                   g_list_copy((GList *)imgs), 0);
     return id;
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   // also need to set the no-legacy bit, to make sure we get the right presets (new ones)
   uint32_t flags = dt_conf_get_int("ui_last/import_initial_rating");
@@ -1369,13 +1400,12 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
   }
 
   //insert a v0 record (which may be updated later if no v0 xmp exists)
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
+  stmt = dt_database_get_statement
+    (darktable.db,
      "INSERT INTO main.images (id, film_id, filename, license, sha1sum, flags, version, "
      "                         max_version, history_end, position, import_timestamp)"
      " SELECT NULL, ?1, ?2, '', '', ?3, 0, 0, 0, (IFNULL(MAX(position),0) & 0xFFFFFFFF00000000)  + (1 << 32), ?4 "
-     " FROM images",
-     -1, &stmt, NULL);
+     " FROM images");
 
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, imgfname, -1, SQLITE_TRANSIENT);
@@ -1384,15 +1414,13 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
 
   rc = sqlite3_step(stmt);
   if(rc != SQLITE_DONE) fprintf(stderr, "sqlite3 error %d\n", rc);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2", -1, &stmt, NULL);
+  stmt = dt_database_get_statement(darktable.db, "SELECT id FROM main.images WHERE film_id = ?1 AND filename = ?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, film_id);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, imgfname, -1, SQLITE_STATIC);
   if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   // Try to find out if this should be grouped already.
   gchar *basename = g_strdup(imgfname);
@@ -1405,13 +1433,11 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
   // in case we are not a jpg check if we need to change group representative
   if(strcmp(ext, "jpg") != 0 && strcmp(ext, "jpeg") != 0)
   {
-    sqlite3_stmt *stmt2;
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
+    sqlite3_stmt *stmt2 = dt_database_get_statement
+      (darktable.db,
        "SELECT group_id"
        " FROM main.images"
-       " WHERE film_id = ?1 AND filename LIKE ?2 AND id = group_id", -1, &stmt2,
-      NULL);
+       " WHERE film_id = ?1 AND filename LIKE ?2 AND id = group_id");
     DT_DEBUG_SQLITE3_BIND_INT(stmt2, 1, film_id);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt2, 2, sql_pattern, -1, SQLITE_TRANSIENT);
     // if we have a group already
@@ -1457,16 +1483,15 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
     {
       group_id = id;
     }
-    sqlite3_finalize(stmt2);
+    dt_database_release_statement(darktable.db, stmt2);
   }
   else
   {
-    sqlite3_stmt *stmt2;
-    DT_DEBUG_SQLITE3_PREPARE_V2
-      (dt_database_get(darktable.db),
+    sqlite3_stmt *stmt2 = dt_database_get_statement
+      (darktable.db,
        "SELECT group_id"
        " FROM main.images"
-       " WHERE film_id = ?1 AND filename LIKE ?2 AND id != ?3", -1, &stmt2, NULL);
+       " WHERE film_id = ?1 AND filename LIKE ?2 AND id != ?3");
     DT_DEBUG_SQLITE3_BIND_INT(stmt2, 1, film_id);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt2, 2, sql_pattern, -1, SQLITE_TRANSIENT);
     DT_DEBUG_SQLITE3_BIND_INT(stmt2, 3, id);
@@ -1474,16 +1499,13 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
       group_id = sqlite3_column_int(stmt2, 0);
     else
       group_id = id;
-    sqlite3_finalize(stmt2);
+    dt_database_release_statement(darktable.db, stmt2);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2
-    (dt_database_get(darktable.db),
-     "UPDATE main.images SET group_id = ?1 WHERE id = ?2",
-     -1, &stmt, NULL);
+  stmt = dt_database_get_statement(darktable.db, "UPDATE main.images SET group_id = ?1 WHERE id = ?2");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, group_id);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, id);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   // printf("[image_import] importing `%s' to img id %d\n", imgfname, id);
 
@@ -1492,13 +1514,15 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
   img->group_id = group_id;
 
   // read dttags and exif for database queries!
-  (void)dt_exif_read(img, normalized_filename);
+  (void)dt_exif_read_image(img, normalized_filename, prefetch ? prefetch->exif : NULL);
   char dtfilename[PATH_MAX] = { 0 };
   g_strlcpy(dtfilename, normalized_filename, sizeof(dtfilename));
   // dt_image_path_append_version(id, dtfilename, sizeof(dtfilename));
   g_strlcat(dtfilename, ".xmp", sizeof(dtfilename));
 
-  const int res = dt_exif_xmp_read(img, dtfilename, 0);
+  // a prefetch without sidecar means there was none to read
+  const int res = !prefetch ? dt_exif_xmp_read(img, dtfilename, 0)
+                  : prefetch->xmp ? dt_exif_xmp_read_image(img, dtfilename, 0, prefetch->xmp) : 1;
 
   // write through to db, but not to xmp.
   dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
@@ -1562,12 +1586,18 @@ static uint32_t _image_import_internal(const int32_t film_id, const char *filena
 
 uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
 {
-  return _image_import_internal(film_id, filename, override_ignore_jpegs, TRUE);
+  return _image_import_internal(film_id, filename, override_ignore_jpegs, TRUE, NULL);
 }
 
 uint32_t dt_image_import_lua(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
 {
-  return _image_import_internal(film_id, filename, override_ignore_jpegs, FALSE);
+  return _image_import_internal(film_id, filename, override_ignore_jpegs, FALSE, NULL);
+}
+
+uint32_t dt_image_import_prefetched(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                    dt_image_import_prefetch_t *prefetch)
+{
+  return _image_import_internal(film_id, filename, override_ignore_jpegs, TRUE, prefetch);
 }
 
 void dt_image_init(dt_image_t *img)
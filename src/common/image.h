@@ -276,6 +276,14 @@ GList* dt_image_find_duplicates(const char* filename);
 uint32_t dt_image_import(int32_t film_id, const char *filename, gboolean override_ignore_jpegs);
 /** imports a new image from raw/etc file and adds it to the data base and image cache. Use from lua thread.*/
 uint32_t dt_image_import_lua(int32_t film_id, const char *filename, gboolean override_ignore_jpegs);
+/** metadata of a file and its sidecar, read ahead of the import. */
+typedef struct dt_image_import_prefetch_t dt_image_import_prefetch_t;
+/** reads the metadata of a file to import without touching the data base, can run on any thread. */
+dt_image_import_prefetch_t *dt_image_import_prefetch(const char *filename);
+void dt_image_import_prefetch_free(dt_image_import_prefetch_t *prefetch);
+/** same as dt_image_import(), decoding the metadata dt_image_import_prefetch() read. */
+uint32_t dt_image_import_prefetched(int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                    dt_image_import_prefetch_t *prefetch);
 /** removes the given image from the database. */
 void dt_image_remove(const int32_t imgid);
 /** duplicates the given image in the database with the duplicate getting the supplied version number. if that
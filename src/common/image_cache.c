@@ -27,146 +27,163 @@
 #include <sqlite3.h>
 #include <inttypes.h>
 
-void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
+// the columns _image_cache_read_row() expects
+#define IMAGE_CACHE_COLUMNS                                                                                       \
+  "SELECT id, group_id, film_id, width, height, filename, maker, model, lens, exposure,"                          \
+  "       aperture, iso, focal_length, datetime_taken, flags, crop, orientation,"                                 \
+  "       focus_distance, raw_parameters, longitude, latitude, altitude, color_matrix,"                           \
+  "       colorspace, version, raw_black, raw_maximum, aspect_ratio, exposure_bias,"                              \
+  "       import_timestamp, change_timestamp, export_timestamp, print_timestamp"                                  \
+  "  FROM main.images"
+
+static void _image_cache_read_row(dt_image_t *img, sqlite3_stmt *stmt)
 {
-  entry->cost = sizeof(dt_image_t);
+  img->id = sqlite3_column_int(stmt, 0);
+  img->group_id = sqlite3_column_int(stmt, 1);
+  img->film_id = sqlite3_column_int(stmt, 2);
+  img->width = sqlite3_column_int(stmt, 3);
+  img->height = sqlite3_column_int(stmt, 4);
+  img->crop_x = img->crop_y = img->crop_width = img->crop_height = 0;
+  img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0]
+      = img->exif_datetime_taken[0] = '\0';
+  char *str;
+  str = (char *)sqlite3_column_text(stmt, 5);
+  if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
+  str = (char *)sqlite3_column_text(stmt, 6);
+  if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
+  str = (char *)sqlite3_column_text(stmt, 7);
+  if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
+  str = (char *)sqlite3_column_text(stmt, 8);
+  if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
+  img->exif_exposure = sqlite3_column_double(stmt, 9);
+  img->exif_aperture = sqlite3_column_double(stmt, 10);
+  img->exif_iso = sqlite3_column_double(stmt, 11);
+  img->exif_focal_length = sqlite3_column_double(stmt, 12);
+  str = (char *)sqlite3_column_text(stmt, 13);
+  if(str) g_strlcpy(img->exif_datetime_taken, str, sizeof(img->exif_datetime_taken));
+  img->flags = sqlite3_column_int(stmt, 14);
+  img->loader = LOADER_UNKNOWN;
+  img->exif_crop = sqlite3_column_double(stmt, 15);
+  img->orientation = sqlite3_column_int(stmt, 16);
+  img->exif_focus_distance = sqlite3_column_double(stmt, 17);
+  if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = 1;
+  uint32_t tmp = sqlite3_column_int(stmt, 18);
+  memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
+  if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
+    img->geoloc.longitude = sqlite3_column_double(stmt, 19);
+  else
+    img->geoloc.longitude = NAN;
+  if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
+    img->geoloc.latitude = sqlite3_column_double(stmt, 20);
+  else
+    img->geoloc.latitude = NAN;
+  if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
+    img->geoloc.elevation = sqlite3_column_double(stmt, 21);
+  else
+    img->geoloc.elevation = NAN;
+  const void *color_matrix = sqlite3_column_blob(stmt, 22);
+  if(color_matrix)
+    memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
+  else
+    img->d65_color_matrix[0] = NAN;
+  g_free(img->profile);
+  img->profile = NULL;
+  img->profile_size = 0;
+  img->colorspace = sqlite3_column_int(stmt, 23);
+  img->version = sqlite3_column_int(stmt, 24);
+  img->raw_black_level = sqlite3_column_int(stmt, 25);
+  for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
+  img->raw_white_point = sqlite3_column_int(stmt, 26);
+  if(sqlite3_column_type(stmt, 27) == SQLITE_FLOAT)
+    img->aspect_ratio = sqlite3_column_double(stmt, 27);
+  else
+    img->aspect_ratio = 0.0;
+  if(sqlite3_column_type(stmt, 28) == SQLITE_FLOAT)
+    img->exif_exposure_bias = sqlite3_column_double(stmt, 28);
+  else
+    img->exif_exposure_bias = NAN;
+  img->import_timestamp = sqlite3_column_int(stmt, 29);
+  img->change_timestamp = sqlite3_column_int(stmt, 30);
+  img->export_timestamp = sqlite3_column_int(stmt, 31);
+  img->print_timestamp = sqlite3_column_int(stmt, 32);
 
-  dt_image_t *img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
-  dt_image_init(img);
-  entry->data = img;
-  // load stuff from db and store in cache:
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "SELECT id, group_id, film_id, width, height, filename, maker, model, lens, exposure,"
-      "       aperture, iso, focal_length, datetime_taken, flags, crop, orientation,"
-      "       focus_distance, raw_parameters, longitude, latitude, altitude, color_matrix,"
-      "       colorspace, version, raw_black, raw_maximum, aspect_ratio, exposure_bias,"
-      "       import_timestamp, change_timestamp, export_timestamp, print_timestamp"
-      "  FROM main.images"
-      "  WHERE id = ?1",
-      -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  // buffer size? colorspace?
+  if(img->flags & DT_IMAGE_LDR)
   {
-    img->id = sqlite3_column_int(stmt, 0);
-    img->group_id = sqlite3_column_int(stmt, 1);
-    img->film_id = sqlite3_column_int(stmt, 2);
-    img->width = sqlite3_column_int(stmt, 3);
-    img->height = sqlite3_column_int(stmt, 4);
-    img->crop_x = img->crop_y = img->crop_width = img->crop_height = 0;
-    img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0]
-        = img->exif_datetime_taken[0] = '\0';
-    char *str;
-    str = (char *)sqlite3_column_text(stmt, 5);
-    if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
-    str = (char *)sqlite3_column_text(stmt, 6);
-    if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
-    str = (char *)sqlite3_column_text(stmt, 7);
-    if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
-    str = (char *)sqlite3_column_text(stmt, 8);
-    if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
-    img->exif_exposure = sqlite3_column_double(stmt, 9);
-    img->exif_aperture = sqlite3_column_double(stmt, 10);
-    img->exif_iso = sqlite3_column_double(stmt, 11);
-    img->exif_focal_length = sqlite3_column_double(stmt, 12);
-    str = (char *)sqlite3_column_text(stmt, 13);
-    if(str) g_strlcpy(img->exif_datetime_taken, str, sizeof(img->exif_datetime_taken));
-    img->flags = sqlite3_column_int(stmt, 14);
-    img->loader = LOADER_UNKNOWN;
-    img->exif_crop = sqlite3_column_double(stmt, 15);
-    img->orientation = sqlite3_column_int(stmt, 16);
-    img->exif_focus_distance = sqlite3_column_double(stmt, 17);
-    if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = 1;
-    uint32_t tmp = sqlite3_column_int(stmt, 18);
-    memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
-    if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
-      img->geoloc.longitude = sqlite3_column_double(stmt, 19);
-    else
-      img->geoloc.longitude = NAN;
-    if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
-      img->geoloc.latitude = sqlite3_column_double(stmt, 20);
-    else
-      img->geoloc.latitude = NAN;
-    if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
-      img->geoloc.elevation = sqlite3_column_double(stmt, 21);
-    else
-      img->geoloc.elevation = NAN;
-    const void *color_matrix = sqlite3_column_blob(stmt, 22);
-    if(color_matrix)
-      memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
-    else
-      img->d65_color_matrix[0] = NAN;
-    g_free(img->profile);
-    img->profile = NULL;
-    img->profile_size = 0;
-    img->colorspace = sqlite3_column_int(stmt, 23);
-    img->version = sqlite3_column_int(stmt, 24);
-    img->raw_black_level = sqlite3_column_int(stmt, 25);
-    for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
-    img->raw_white_point = sqlite3_column_int(stmt, 26);
-    if(sqlite3_column_type(stmt, 27) == SQLITE_FLOAT)
-      img->aspect_ratio = sqlite3_column_double(stmt, 27);
-    else
-      img->aspect_ratio = 0.0;
-    if(sqlite3_column_type(stmt, 28) == SQLITE_FLOAT)
-      img->exif_exposure_bias = sqlite3_column_double(stmt, 28);
-    else
-      img->exif_exposure_bias = NAN;
-    img->import_timestamp = sqlite3_column_int(stmt, 29);
-    img->change_timestamp = sqlite3_column_int(stmt, 30);
-    img->export_timestamp = sqlite3_column_int(stmt, 31);
-    img->print_timestamp = sqlite3_column_int(stmt, 32);
-
-    // buffer size? colorspace?
-    if(img->flags & DT_IMAGE_LDR)
+    img->buf_dsc.channels = 4;
+    img->buf_dsc.datatype = TYPE_FLOAT;
+    img->buf_dsc.cst = iop_cs_rgb;
+  }
+  else if(img->flags & DT_IMAGE_HDR)
+  {
+    if(img->flags & DT_IMAGE_RAW)
     {
-      img->buf_dsc.channels = 4;
+      img->buf_dsc.channels = 1;
       img->buf_dsc.datatype = TYPE_FLOAT;
-      img->buf_dsc.cst = iop_cs_rgb;
-    }
-    else if(img->flags & DT_IMAGE_HDR)
-    {
-      if(img->flags & DT_IMAGE_RAW)
-      {
-        img->buf_dsc.channels = 1;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-        img->buf_dsc.cst = iop_cs_RAW;
-      }
-      else
-      {
-        img->buf_dsc.channels = 4;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-        img->buf_dsc.cst = iop_cs_rgb;
-      }
+      img->buf_dsc.cst = iop_cs_RAW;
     }
     else
     {
-      // raw
-      img->buf_dsc.channels = 1;
-      img->buf_dsc.datatype = TYPE_UINT16;
-      img->buf_dsc.cst = iop_cs_RAW;
+      img->buf_dsc.channels = 4;
+      img->buf_dsc.datatype = TYPE_FLOAT;
+      img->buf_dsc.cst = iop_cs_rgb;
     }
   }
   else
   {
-    img->id = -1;
-    fprintf(stderr, "[image_cache_allocate] failed to open image %" PRIu32 " from database: %s\n", entry->key,
-            sqlite3_errmsg(dt_database_get(darktable.db)));
+    // raw
+    img->buf_dsc.channels = 1;
+    img->buf_dsc.datatype = TYPE_UINT16;
+    img->buf_dsc.cst = iop_cs_RAW;
   }
-  sqlite3_finalize(stmt);
+}
+
+void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
+{
+  dt_image_cache_t *cache = (dt_image_cache_t *)data;
+  entry->cost = sizeof(dt_image_t);
+
+  // read ahead by dt_image_cache_prefetch()?
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  dt_image_t *img = g_hash_table_lookup(cache->prefetched, GINT_TO_POINTER(entry->key));
+  if(img) g_hash_table_steal(cache->prefetched, GINT_TO_POINTER(entry->key));
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+
+  if(!img)
+  {
+    img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
+    dt_image_init(img);
+    // load stuff from db and store in cache:
+    sqlite3_stmt *stmt = dt_database_get_statement(darktable.db, IMAGE_CACHE_COLUMNS "  WHERE id = ?1");
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
+      _image_cache_read_row(img, stmt);
+    else
+    {
+      img->id = -1;
+      fprintf(stderr, "[image_cache_allocate] failed to open image %" PRIu32 " from database: %s\n", entry->key,
+              sqlite3_errmsg(dt_database_get(darktable.db)));
+    }
+    dt_database_release_statement(darktable.db, stmt);
+  }
+  entry->data = img;
   img->cache_entry = entry; // init backref
   // could downgrade lock write->read on entry->lock if we were using concurrencykit..
   dt_image_refresh_makermodel(img);
 }
 
-void dt_image_cache_deallocate(void *data, dt_cache_entry_t *entry)
+static void _image_cache_free_image(gpointer data)
 {
-  dt_image_t *img = (dt_image_t *)entry->data;
+  dt_image_t *img = (dt_image_t *)data;
   g_free(img->profile);
   g_free(img);
 }
 
+void dt_image_cache_deallocate(void *data, dt_cache_entry_t *entry)
+{
+  _image_cache_free_image(entry->data);
+}
+
 void dt_image_cache_init(dt_image_cache_t *cache)
 {
   // the image cache does no serialization.
@@ -178,6 +195,8 @@ void dt_image_cache_init(dt_image_cache_t *cache)
   const uint32_t max_mem = 50 * 1024 * 1024;
   const uint32_t num = (uint32_t)(1.5f * max_mem / sizeof(dt_image_t));
   dt_cache_init(&cache->cache, sizeof(dt_image_t), max_mem);
+  cache->prefetched = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, _image_cache_free_image);
+  dt_pthread_mutex_init(&cache->prefetch_lock, NULL);
   dt_cache_set_allocate_callback(&cache->cache, &dt_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &dt_image_cache_deallocate, cache);
 
@@ -187,13 +206,70 @@ void dt_image_cache_init(dt_image_cache_t *cache)
 void dt_image_cache_cleanup(dt_image_cache_t *cache)
 {
   dt_cache_cleanup(&cache->cache);
+  g_hash_table_destroy(cache->prefetched);
+  dt_pthread_mutex_destroy(&cache->prefetch_lock);
 }
 
 void dt_image_cache_print(dt_image_cache_t *cache)
 {
-  printf("[image cache] fill %.2f/%.2f MB (%.2f%%)\n", cache->cache.cost / (1024.0 * 1024.0),
+  printf("[image cache] fill %.2f/%.2f MB (%.2f%%)\n", dt_cache_get_cost(&cache->cache) / (1024.0 * 1024.0),
          cache->cache.cost_quota / (1024.0 * 1024.0),
-         (float)cache->cache.cost / (float)cache->cache.cost_quota);
+         (float)dt_cache_get_cost(&cache->cache) / (float)cache->cache.cost_quota);
+}
+
+void dt_image_cache_prefetch(dt_image_cache_t *cache, const int32_t *imgids, const int count)
+{
+  // only the ones not in the cache yet
+  GString *ids = g_string_new(NULL);
+  int missing = 0;
+  for(int k = 0; k < count; k++)
+  {
+    if(imgids[k] <= 0 || dt_cache_contains(&cache->cache, imgids[k])) continue;
+    g_string_append_printf(ids, missing ? ",%d" : "%d", imgids[k]);
+    missing++;
+  }
+  if(!missing)
+  {
+    g_string_free(ids, TRUE);
+    return;
+  }
+
+  // one query for all of them
+  const double start = dt_get_wtime();
+  gchar *query = g_strdup_printf(IMAGE_CACHE_COLUMNS " WHERE id IN (%s)", ids->str);
+  g_string_free(ids, TRUE);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  GArray *loaded = g_array_sized_new(FALSE, FALSE, sizeof(int32_t), missing);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_image_t *img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
+    dt_image_init(img);
+    _image_cache_read_row(img, stmt);
+    g_array_append_val(loaded, img->id);
+    // hand it to dt_image_cache_allocate(), which owns it from now on
+    dt_pthread_mutex_lock(&cache->prefetch_lock);
+    g_hash_table_insert(cache->prefetched, GINT_TO_POINTER(img->id), img);
+    dt_pthread_mutex_unlock(&cache->prefetch_lock);
+  }
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  for(guint k = 0; k < loaded->len; k++)
+  {
+    const int32_t imgid = g_array_index(loaded, int32_t, k);
+    dt_cache_entry_t *entry = dt_cache_get(&cache->cache, imgid, 'r');
+    dt_cache_release(&cache->cache, entry);
+
+    // still there if the image got in the cache otherwise in the meantime
+    dt_pthread_mutex_lock(&cache->prefetch_lock);
+    g_hash_table_remove(cache->prefetched, GINT_TO_POINTER(imgid));
+    dt_pthread_mutex_unlock(&cache->prefetch_lock);
+  }
+
+  dt_print(DT_DEBUG_CACHE, "[image_cache] prefetched %u of %d images in %.3f secs\n", loaded->len, count,
+           dt_get_wtime() - start);
+  g_array_free(loaded, TRUE);
 }
 
 dt_image_t *dt_image_cache_get(dt_image_cache_t *cache, const int32_t imgid, char mode)
@@ -244,8 +320,8 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
   if(img->id <= 0) return;
 
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
+  stmt = dt_database_get_statement(
+      darktable.db,
       "UPDATE main.images"
       " SET width = ?1, height = ?2, filename = ?3, maker = ?4, model = ?5,"
       "     lens = ?6, exposure = ?7, aperture = ?8, iso = ?9, focal_length = ?10,"
@@ -256,8 +332,7 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
       "     aspect_ratio = ROUND(?26,1), exposure_bias = ?27,"
       "     import_timestamp = ?28, change_timestamp = ?29, export_timestamp = ?30,"
       "     print_timestamp = ?31"
-      " WHERE id = ?32",
-      -1, &stmt, NULL);
+      " WHERE id = ?32");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, img->width);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, img->height);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, img->filename, -1, SQLITE_STATIC);
@@ -293,7 +368,7 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 32, img->id);
   const int rc = sqlite3_step(stmt);
   if(rc != SQLITE_DONE) fprintf(stderr, "[image_cache_write_release] sqlite3 error %d\n", rc);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   // TODO: make this work in relaxed mode, too.
   if(mode == DT_IMAGE_CACHE_SAFE)
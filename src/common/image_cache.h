@@ -24,6 +24,9 @@
 typedef struct dt_image_cache_t
 {
   dt_cache_t cache;
+  // images read by dt_image_cache_prefetch(), waiting to be taken by the cache
+  GHashTable *prefetched;
+  dt_pthread_mutex_t prefetch_lock;
 }
 dt_image_cache_t;
 
@@ -51,6 +54,10 @@ void dt_image_cache_print(dt_image_cache_t *cache);
 // point where sql and xmp can be synched (unsafe setting).
 dt_image_t *dt_image_cache_get(dt_image_cache_t *cache, const int32_t imgid, char mode);
 
+// loads the image structs of all these ids which aren't in the cache yet,
+// with one sql query instead of one per image on the first get.
+void dt_image_cache_prefetch(dt_image_cache_t *cache, const int32_t *imgids, const int count);
+
 // same as read_get, but doesn't block and returns NULL if the image
 // is currently unavailable.
 dt_image_t *dt_image_cache_testget(dt_image_cache_t *cache, const int32_t imgid, char mode);
@@ -52,6 +52,7 @@
 #include "develop/blend.h"
 #include "develop/develop.h"
 #include "develop/imageop.h"
+#include "develop/tiling.h"
 
 #ifdef HAVE_GRAPHICSMAGICK
 #include <magick/api.h>
@@ -629,6 +630,131 @@ void dt_imageio_to_fractional(float in, uint32_t *num, uint32_t *den)
   }
 }
 
+// converts processed float pixels in place to what a format with the given bpp expects
+static void _export_convert_pixels(void *const buf, const size_t npixels, const int bpp,
+                                   const gboolean display_byteorder)
+{
+  const float *const inbuf = (float *)buf;
+  if(bpp == 8)
+  {
+    uint8_t *const outbuf = (uint8_t *)buf;
+    const int r_pos = display_byteorder ? 2 : 0;
+    const int b_pos = display_byteorder ? 0 : 2;
+    for(size_t k = 0; k < npixels; k++)
+    {
+      // convert in place, this is unfortunately very serial..
+      const uint8_t r = CLAMP(inbuf[4 * k + r_pos] * 0xff, 0, 0xff);
+      const uint8_t g = CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff);
+      const uint8_t b = CLAMP(inbuf[4 * k + b_pos] * 0xff, 0, 0xff);
+      outbuf[4 * k + 0] = r;
+      outbuf[4 * k + 1] = g;
+      outbuf[4 * k + 2] = b;
+    }
+  }
+  else if(bpp == 16)
+  {
+    // uint16_t per color channel
+    uint16_t *const buf16 = (uint16_t *)buf;
+    for(size_t k = 0; k < npixels; k++)
+      for(int i = 0; i < 3; i++) buf16[4 * k + i] = CLAMP(inbuf[4 * k + i] * 0x10000, 0, 0xffff);
+  }
+  // else output float, no further harm done to the pixels :)
+}
+
+// rows of context a band needs on top and below so that the rows it delivers come out
+// as if the whole image had been processed at once. -1 if one of the modules can't
+// work on parts of the image.
+static int _export_band_overlap(dt_dev_pixelpipe_t *pipe, const int width, const int height,
+                                const double scale)
+{
+  const dt_iop_roi_t roi = { 0, 0, width, height, scale };
+  unsigned overlap = 0;
+  for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    dt_iop_module_t *module = piece->module;
+    if(!piece->enabled || !strcmp(module->op, "gamma") || !strcmp(module->op, "finalscale")) continue;
+
+    // same promise as for tiling: processing a part with enough overlap gives the same pixels
+    if(!(module->flags() & IOP_FLAGS_ALLOW_TILING))
+    {
+      dt_print(DT_DEBUG_IMAGEIO, "[dt_imageio_export] module '%s' can't be processed in bands\n", module->op);
+      return -1;
+    }
+
+    dt_develop_tiling_t tiling = { 0 };
+    module->tiling_callback(module, piece, &roi, &roi, &tiling);
+    unsigned module_overlap = tiling.overlap;
+    if(piece->blendop_data
+       && ((dt_develop_blend_params_t *)piece->blendop_data)->mask_mode != DEVELOP_MASK_DISABLED)
+    {
+      dt_develop_tiling_t tiling_blendop = { 0 };
+      tiling_callback_blendop(module, piece, &roi, &roi, &tiling_blendop);
+      module_overlap = MAX(module_overlap, tiling_blendop.overlap);
+    }
+    overlap += module_overlap;
+  }
+  // overlaps are given in the pixels of the module, never smaller than output pixels unless upscaling
+  return ceil(overlap * fmax(scale, 1.0));
+}
+
+// number of rows per band if the image is better pushed through the pipe and written
+// in bands, 0 if it should be processed as a whole
+static int _export_band_height(const int width, const int height)
+{
+  // bands only pay off if the whole image doesn't fit into the memory we are allowed to use
+  if(dt_tiling_piece_fits_host_memory(width, height, 4 * sizeof(float), 2.0f, 0)) return 0;
+
+  // give each band a fraction of it: every module keeps an input and an output buffer
+  // plus what it needs on top
+  const int host_memory_limit = dt_conf_get_int("host_memory_limit");
+  const size_t budget = (size_t)host_memory_limit * 1024 * 1024 / 16;
+  return CLAMP(budget / ((size_t)width * 4 * sizeof(float)), 16, height);
+}
+
+// runs the pipe on horizontal bands of the output and hands every finished band to the format.
+// returns non zero on error.
+static int _export_in_bands(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_imageio_module_format_t *format,
+                            dt_imageio_module_data_t *format_params, void *handle, const int width,
+                            const int height, const double scale, const int bpp, const gboolean display_byteorder,
+                            const int band_height, const int overlap)
+{
+  dt_print(DT_DEBUG_IMAGEIO, "[dt_imageio_export] processing %ix%i in bands of %i rows with %i rows overlap\n",
+           width, height, band_height, overlap);
+
+  for(int y = 0; y < height; y += band_height)
+  {
+    const int rows = MIN(band_height, height - y);
+    const int y_in = MAX(y - overlap, 0);
+    const int rows_in = MIN(y + rows + overlap, height) - y_in;
+
+    // 8-bit comes out of gamma like it does when the image is processed as a whole, so both round the same
+    if(bpp == 8)
+    {
+      if(dt_dev_pixelpipe_process(pipe, dev, 0, y_in, width, rows_in, scale)) return 1;
+      uint8_t *const band = (uint8_t *)pipe->backbuf + (size_t)4 * width * (y - y_in);
+      if(!display_byteorder)
+      {
+        for(size_t k = 0; k < (size_t)width * rows; k++)
+        {
+          const uint8_t tmp = band[4 * k + 0];
+          band[4 * k + 0] = band[4 * k + 2];
+          band[4 * k + 2] = tmp;
+        }
+      }
+      if(format->write_image_rows(format_params, handle, band, rows)) return 1;
+      continue;
+    }
+
+    if(dt_dev_pixelpipe_process_no_gamma(pipe, dev, 0, y_in, width, rows_in, scale)) return 1;
+
+    float *band = (float *)pipe->backbuf + (size_t)4 * width * (y - y_in);
+    _export_convert_pixels(band, (size_t)width * rows, bpp, display_byteorder);
+    if(format->write_image_rows(format_params, handle, band, rows)) return 1;
+  }
+  return 0;
+}
+
 int dt_imageio_export(const int32_t imgid, const char *filename, dt_imageio_module_format_t *format,
                       dt_imageio_module_data_t *format_params, const gboolean high_quality, const gboolean upscale,
                       const gboolean copy_metadata, const gboolean export_masks,
@@ -661,6 +787,11 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   dt_dev_init(&dev, 0);
   dt_dev_load_image(&dev, imgid);
 
+  uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes max, but if original size is close to that,
+                                // adding new tags could make it go over that... so let it be and see what
+                                // happens when we write the image
+  int exif_len = 0;
+
   const int buf_is_downscaled
       = (thumbnail_export && dt_conf_get_bool("plugins/lighttable/low_quality_thumbnails"));
 
@@ -896,6 +1027,55 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
 
   const int bpp = format->bpp(format_params);
 
+  format_params->width = processed_width;
+  format_params->height = processed_height;
+
+  if(!ignore_exif)
+  {
+    char pathname[PATH_MAX] = { 0 };
+    gboolean from_cache = TRUE;
+    dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
+    // last param is dng mode, it's false here
+    exif_len = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
+  }
+
+  // images too large to be processed as a whole are pushed through the pipe in horizontal
+  // bands which go straight into the file, if the format can write them like that.
+  const int band_height
+      = (thumbnail_export || export_masks || high_quality_processing || !format->write_image_begin)
+            ? 0
+            : _export_band_height(processed_width, processed_height);
+  if(band_height > 0)
+  {
+    // finalscale is only used for high quality processing
+    dt_dev_pixelpipe_iop_t *finalscale = NULL;
+    for(GList *nodes = pipe.nodes; nodes; nodes = g_list_next(nodes))
+      if(!strcmp(((dt_dev_pixelpipe_iop_t *)nodes->data)->module->op, "finalscale"))
+        finalscale = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(finalscale) finalscale->enabled = 0;
+
+    const int overlap = _export_band_overlap(&pipe, processed_width, processed_height, scale);
+    void *handle = overlap < 0 ? NULL
+                               : format->write_image_begin(format_params, filename, icc_type, icc_filename,
+                                                           exif_profile, exif_len, imgid);
+    if(handle)
+    {
+      dt_get_times(&start);
+      res = _export_in_bands(&pipe, &dev, format, format_params, handle, processed_width, processed_height, scale,
+                             bpp, display_byteorder, band_height, overlap);
+      res = format->write_image_end(format_params, handle) || res;
+      dt_show_times(&start, "[dev_process_export] pixel pipeline processing in bands");
+      if(finalscale) finalscale->enabled = 1;
+      if(res)
+      {
+        g_unlink(filename);
+        goto error;
+      }
+      goto written;
+    }
+    if(finalscale) finalscale->enabled = 1;
+  }
+
   dt_get_times(&start);
   if(high_quality_processing)
   {
@@ -943,105 +1123,43 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   uint8_t *outbuf = pipe.backbuf;
 
   // downconversion to low-precision formats:
-  if(bpp == 8)
+  if(high_quality_processing)
   {
-    if(display_byteorder)
-    {
-      if(high_quality_processing)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff);
-          const uint8_t g = CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff);
-          const uint8_t b = CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff);
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      // else processing output was 8-bit already, and no need to swap order
-    }
-    else // need to flip
+    _export_convert_pixels(outbuf, (size_t)processed_width * processed_height, bpp, display_byteorder);
+  }
+  else if(bpp == 8)
+  {
+    // processing output was 8-bit already
+    if(!display_byteorder) // need to flip
     {
-      // ldr output: char
-      if(high_quality_processing)
-      {
-        const float *const inbuf = (float *)outbuf;
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          // convert in place, this is unfortunately very serial..
-          const uint8_t r = CLAMP(inbuf[4 * k + 0] * 0xff, 0, 0xff);
-          const uint8_t g = CLAMP(inbuf[4 * k + 1] * 0xff, 0, 0xff);
-          const uint8_t b = CLAMP(inbuf[4 * k + 2] * 0xff, 0, 0xff);
-          outbuf[4 * k + 0] = r;
-          outbuf[4 * k + 1] = g;
-          outbuf[4 * k + 2] = b;
-        }
-      }
-      else
-      { // !display_byteorder, need to swap:
-        uint8_t *const buf8 = pipe.backbuf;
+      uint8_t *const buf8 = pipe.backbuf;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(processed_width, processed_height, buf8) \
   schedule(static)
 #endif
-        // just flip byte order
-        for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
-        {
-          uint8_t tmp = buf8[4 * k + 0];
-          buf8[4 * k + 0] = buf8[4 * k + 2];
-          buf8[4 * k + 2] = tmp;
-        }
-      }
-    }
-  }
-  else if(bpp == 16)
-  {
-    // uint16_t per color channel
-    float *buff = (float *)outbuf;
-    uint16_t *buf16 = (uint16_t *)outbuf;
-    for(int y = 0; y < processed_height; y++)
-      for(int x = 0; x < processed_width; x++)
+      // just flip byte order
+      for(size_t k = 0; k < (size_t)processed_width * processed_height; k++)
       {
-        // convert in place
-        const size_t k = (size_t)processed_width * y + x;
-        for(int i = 0; i < 3; i++) buf16[4 * k + i] = CLAMP(buff[4 * k + i] * 0x10000, 0, 0xffff);
+        uint8_t tmp = buf8[4 * k + 0];
+        buf8[4 * k + 0] = buf8[4 * k + 2];
+        buf8[4 * k + 2] = tmp;
       }
-  }
-  // else output float, no further harm done to the pixels :)
-
-  format_params->width = processed_width;
-  format_params->height = processed_height;
-
-  if(!ignore_exif)
-  {
-    int length;
-    uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes max, but if original size is close to that,
-                                  // adding new tags could make it go over that... so let it be and see what
-                                  // happens when we write the image
-    char pathname[PATH_MAX] = { 0 };
-    gboolean from_cache = TRUE;
-    dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
-    // last param is dng mode, it's false here
-    length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
-
-    res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, exif_profile, length, imgid,
-                              num, total, &pipe, export_masks);
-
-    free(exif_profile);
+    }
   }
   else
   {
-    res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, NULL, 0, imgid, num, total,
-                              &pipe, export_masks);
+    _export_convert_pixels(outbuf, (size_t)processed_width * processed_height, bpp, display_byteorder);
   }
 
+  res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, exif_profile, exif_len, imgid,
+                            num, total, &pipe, export_masks);
+
   if(res)
     goto error;
 
+written:
+  free(exif_profile);
   dt_dev_pixelpipe_cleanup(&pipe);
   dt_dev_cleanup(&dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
@@ -1085,6 +1203,7 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   return 0; // success
 
 error:
+  free(exif_profile);
   dt_dev_pixelpipe_cleanup(&pipe);
 error_early:
   dt_dev_cleanup(&dev);
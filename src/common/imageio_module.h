@@ -122,6 +122,12 @@ typedef struct dt_imageio_module_format_t
                      dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                      void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
                      const gboolean export_masks);
+  /* optional streaming version of write_image(), for images too large to be kept in memory as a whole. */
+  void *(*write_image_begin)(dt_imageio_module_data_t *data, const char *filename,
+                             dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                             void *exif, int exif_len, int imgid);
+  int (*write_image_rows)(dt_imageio_module_data_t *data, void *handle, const void *in, const int rows);
+  int (*write_image_end)(dt_imageio_module_data_t *data, void *handle);
   /* flag that describes the available precision/levels of output format. mainly used for dithering. */
   int (*levels)(dt_imageio_module_data_t *data);
 
@@ -183,6 +189,8 @@ typedef struct dt_imageio_module_storage_t
                dt_iop_color_intent_t icc_intent, dt_export_metadata_t *metadata_flags);
   /* called once at the end (after exporting all images), if implemented. */
   void (*finalize_store)(struct dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data);
+  /* if implemented and returning TRUE, store() may be called for several images at the same time. */
+  int (*parallel)(struct dt_imageio_module_storage_t *self);
 
   void *(*legacy_params)(struct dt_imageio_module_storage_t *self, const void *const old_params,
                          const size_t old_params_size, const int old_version, const int new_version,
@@ -476,6 +476,9 @@ static inline __m128 lanczos_sse2(__m128 width, __m128 t)
 
 #undef DT_LANCZOS_EPSILON
 
+// the AVX2 and AVX-512 builds of this file only provide the resampling code
+#ifndef DT_CODEPATH_CLONE
+
 /* --------------------------------------------------------------------------
  * All our known interpolators
  * ------------------------------------------------------------------------*/
@@ -520,6 +523,8 @@ static const struct dt_interpolation dt_interpolator[] = {
   },
 };
 
+#endif /* DT_CODEPATH_CLONE */
+
 /* --------------------------------------------------------------------------
  * Kernel utility methods
  * ------------------------------------------------------------------------*/
@@ -630,7 +635,7 @@ static inline void compute_upsampling_kernel_sse(const struct dt_interpolation *
 static inline void compute_upsampling_kernel(const struct dt_interpolation *itor, float *kernel, float *norm,
                                              int *first, float t)
 {
-  if(darktable.codepath.OPENMP_SIMD) return compute_upsampling_kernel_plain(itor, kernel, norm, first, t);
+  if(DT_CODEPATH_PLAIN) return compute_upsampling_kernel_plain(itor, kernel, norm, first, t);
 #if defined(__SSE2__)
   else if(darktable.codepath.SSE2)
     return compute_upsampling_kernel_sse(itor, kernel, norm, first, t);
@@ -760,7 +765,7 @@ static inline void compute_downsampling_kernel_sse(const struct dt_interpolation
 static inline void compute_downsampling_kernel(const struct dt_interpolation *itor, int *taps, int *first,
                                                float *kernel, float *norm, float outoinratio, int xout)
 {
-  if(darktable.codepath.OPENMP_SIMD)
+  if(DT_CODEPATH_PLAIN)
     return compute_downsampling_kernel_plain(itor, taps, first, kernel, norm, outoinratio, xout);
 #if defined(__SSE2__)
   else if(darktable.codepath.SSE2)
@@ -770,6 +775,8 @@ static inline void compute_downsampling_kernel(const struct dt_interpolation *it
     dt_unreachable_codepath();
 }
 
+#ifndef DT_CODEPATH_CLONE
+
 /* --------------------------------------------------------------------------
  * Sample interpolation function (see usage in iop/lens.c and iop/clipping.c)
  * ------------------------------------------------------------------------*/
@@ -1225,6 +1232,8 @@ const struct dt_interpolation *dt_interpolation_new(enum dt_interpolation_type t
   return itor;
 }
 
+#endif /* DT_CODEPATH_CLONE */
+
 /* --------------------------------------------------------------------------
  * Image resampling
  * ------------------------------------------------------------------------*/
@@ -1604,7 +1613,7 @@ exit:
   dt_free_align(vlength);
 }
 
-#if defined(__SSE2__)
+#if defined(__SSE2__) && !defined(DT_CODEPATH_CLONE)
 static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, float *out,
                                           const dt_iop_roi_t *const roi_out, const int32_t out_stride,
                                           const float *const in, const dt_iop_roi_t *const roi_in,
@@ -1769,14 +1778,18 @@ exit:
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
-void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
-                               const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                               const float *const in, const dt_iop_roi_t *const roi_in,
-                               const int32_t in_stride)
+void DT_CODEPATH_NAME(dt_interpolation_resample)(const struct dt_interpolation *itor, float *out,
+                                                 const dt_iop_roi_t *const roi_out, const int32_t out_stride,
+                                                 const float *const in, const dt_iop_roi_t *const roi_in,
+                                                 const int32_t in_stride)
 {
-  if(darktable.codepath.OPENMP_SIMD)
+#if defined(HAVE_CODEPATH_CLONES) && !defined(DT_CODEPATH_CLONE)
+  if(darktable.codepath.AVX2)
+    return DT_CODEPATH_SELECT(dt_interpolation_resample)(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+#endif
+  if(DT_CODEPATH_PLAIN)
     return dt_interpolation_resample_plain(itor, out, roi_out, out_stride, in, roi_in, in_stride);
-#if defined(__SSE2__)
+#if defined(__SSE2__) && !defined(DT_CODEPATH_CLONE)
   else if(darktable.codepath.SSE2)
     return dt_interpolation_resample_sse(itor, out, roi_out, out_stride, in, roi_in, in_stride);
 #endif
@@ -1784,6 +1797,8 @@ void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
     dt_unreachable_codepath();
 }
 
+#ifndef DT_CODEPATH_CLONE
+
 /** Applies resampling (re-scaling) on a specific region-of-interest of an image. The input
  *  and output buffers hold exactly those roi's. roi_in and roi_out define the relative
  *  positions of the roi's within the full input and output image, respectively.
@@ -2055,6 +2070,8 @@ int dt_interpolation_resample_roi_cl(const struct dt_interpolation *itor, int de
 }
 #endif
 
+#endif /* DT_CODEPATH_CLONE */
+
 static void dt_interpolation_resample_1c_plain(const struct dt_interpolation *itor, float *out,
                                                const dt_iop_roi_t *const roi_out, const int32_t out_stride,
                                                const float *const in, const dt_iop_roi_t *const roi_in,
@@ -2214,14 +2231,20 @@ static void dt_interpolation_resample_1c_plain(const struct dt_interpolation *it
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
-void dt_interpolation_resample_1c(const struct dt_interpolation *itor, float *out,
-                                  const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                                  const float *const in, const dt_iop_roi_t *const roi_in,
-                                  const int32_t in_stride)
+void DT_CODEPATH_NAME(dt_interpolation_resample_1c)(const struct dt_interpolation *itor, float *out,
+                                                    const dt_iop_roi_t *const roi_out, const int32_t out_stride,
+                                                    const float *const in, const dt_iop_roi_t *const roi_in,
+                                                    const int32_t in_stride)
 {
+#if defined(HAVE_CODEPATH_CLONES) && !defined(DT_CODEPATH_CLONE)
+  if(darktable.codepath.AVX2)
+    return DT_CODEPATH_SELECT(dt_interpolation_resample_1c)(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+#endif
   return dt_interpolation_resample_1c_plain(itor, out, roi_out, out_stride, in, roi_in, in_stride);
 }
 
+#ifndef DT_CODEPATH_CLONE
+
 /** Applies resampling (re-scaling) on a specific region-of-interest of an image. The input
  *  and output buffers hold exactly those roi's. roi_in and roi_out define the relative
  *  positions of the roi's within the full input and output image, respectively.
@@ -2240,6 +2263,8 @@ void dt_interpolation_resample_roi_1c(const struct dt_interpolation *itor, float
   dt_interpolation_resample_1c(itor, out, &oroi, out_stride, in, &iroi, in_stride);
 }
 
+#endif /* DT_CODEPATH_CLONE */
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
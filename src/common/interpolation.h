@@ -137,10 +137,10 @@ const struct dt_interpolation *dt_interpolation_new(enum dt_interpolation_type t
  * @param roi_in [in] Region of interest of the original image
  * @param in_stride [in] Input line stride in <strong>bytes</strong>
  */
-void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
-                               const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                               const float *const in, const dt_iop_roi_t *const roi_in,
-                               const int32_t in_stride);
+DT_CODEPATH_DECLARE(void, dt_interpolation_resample,
+                    (const struct dt_interpolation *itor, float *out, const dt_iop_roi_t *const roi_out,
+                     const int32_t out_stride, const float *const in, const dt_iop_roi_t *const roi_in,
+                     const int32_t in_stride));
 
 void dt_interpolation_resample_roi(const struct dt_interpolation *itor, float *out,
                                    const dt_iop_roi_t *const roi_out, const int32_t out_stride,
@@ -190,10 +190,10 @@ int dt_interpolation_resample_roi_cl(const struct dt_interpolation *itor, int de
 #endif
 
 // same as above for single channel images (i.e., masks). no SSE or CPU code paths for now
-void dt_interpolation_resample_1c(const struct dt_interpolation *itor, float *out,
-                                  const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                                  const float *const in, const dt_iop_roi_t *const roi_in,
-                                  const int32_t in_stride);
+DT_CODEPATH_DECLARE(void, dt_interpolation_resample_1c,
+                    (const struct dt_interpolation *itor, float *out, const dt_iop_roi_t *const roi_out,
+                     const int32_t out_stride, const float *const in, const dt_iop_roi_t *const roi_in,
+                     const int32_t in_stride));
 
 void dt_interpolation_resample_roi_1c(const struct dt_interpolation *itor, float *out,
                                       const dt_iop_roi_t *const roi_out, const int32_t out_stride,
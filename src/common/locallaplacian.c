@@ -19,6 +19,7 @@
 #include "common/darktable.h"
 #include "common/locallaplacian.h"
 
+#include <float.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -36,6 +37,66 @@
 
 //#define DEBUG_DUMP
 
+struct local_laplacian_workspace_t
+{
+  dt_pthread_mutex_t lock;       // held by the one run using the blocks
+  size_t size;                   // number of floats in each of the blocks below
+  float *pyramid[num_gamma + 2]; // padded input, output and one per gamma level, allocated on first use
+};
+
+local_laplacian_workspace_t *local_laplacian_workspace_init(void)
+{
+  local_laplacian_workspace_t *ws = calloc(1, sizeof(local_laplacian_workspace_t));
+  dt_pthread_mutex_init(&ws->lock, NULL);
+  return ws;
+}
+
+void local_laplacian_workspace_free(local_laplacian_workspace_t *ws)
+{
+  if(!ws) return;
+  for(int k=0;k<num_gamma+2;k++) dt_free_align(ws->pyramid[k]);
+  dt_pthread_mutex_destroy(&ws->lock);
+  free(ws);
+}
+
+void local_laplacian_workspace_trim(local_laplacian_workspace_t *ws, const size_t max_bytes)
+{
+  if(!ws) return;
+  dt_pthread_mutex_lock(&ws->lock);
+  size_t bytes = 0;
+  for(int k=0;k<num_gamma+2;k++)
+    if(ws->pyramid[k]) bytes += sizeof(float)*ws->size;
+  if(bytes > max_bytes)
+  {
+    for(int k=0;k<num_gamma+2;k++)
+    {
+      dt_free_align(ws->pyramid[k]);
+      ws->pyramid[k] = NULL;
+    }
+    ws->size = 0;
+  }
+  dt_pthread_mutex_unlock(&ws->lock);
+}
+
+// returns block k of the workspace with room for at least size floats
+static float *ll_workspace_get(
+    local_laplacian_workspace_t *ws,
+    const int k,
+    const size_t size)
+{
+  if(ws->size < size)
+  { // the image grew, none of the blocks fit any more
+    for(int p=0;p<num_gamma+2;p++)
+    {
+      dt_free_align(ws->pyramid[p]);
+      ws->pyramid[p] = NULL;
+    }
+    ws->size = size;
+  }
+  if(!ws->pyramid[k]) ws->pyramid[k] = dt_alloc_align(64, sizeof(float)*ws->size);
+  return ws->pyramid[k];
+}
+
 // downsample width/height to given level
 static inline int dl(int size, const int level)
 {
@@ -116,20 +177,6 @@ static inline void ll_fill_boundary1(
   memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
 }
 
-// helper to fill in two pixels boundary by copying it
-static inline void ll_fill_boundary2(
-    float *const input,
-    const int wd,
-    const int ht)
-{
-  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
-  if(wd & 1) for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
-  else       for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2] = input[j*wd+wd-3];
-  memcpy(input, input+wd, sizeof(float)*wd);
-  if(!(ht & 1)) memcpy(input+wd*(ht-2), input+wd*(ht-3), sizeof(float)*wd);
-  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
-}
-
 static void pad_by_replication(
     float *buf,			// the buffer to be padded
     const uint32_t w,		// width of a line
@@ -148,24 +195,6 @@ static void pad_by_replication(
   }
 }
 
-static inline void gauss_expand(
-    const float *const input, // coarse input
-    float *const fine,        // upsampled, blurry output
-    const int wd,             // fine res
-    const int ht)
-{
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(fine, input, wd, ht) \
-  schedule(static) \
-  collapse(2)
-#endif
-  for(int j=1;j<((ht-1)&~1);j++)  // even ht: two px boundary. odd ht: one px.
-    for(int i=1;i<((wd-1)&~1);i++)
-      fine[j*wd+i] = ll_expand_gaussian(input, i, j, wd, ht);
-  ll_fill_boundary2(fine, wd, ht);
-}
-
 #if defined(__SSE2__)
 static inline __m128 convolve14641_vert(const float *in, const int wd)
 {
@@ -269,10 +298,11 @@ static inline void gauss_reduce(
   ll_fill_boundary1(coarse, cw, ch);
 }
 
-// allocate output buffer with monochrome brightness channel from input, padded
+// fill output buffer with monochrome brightness channel from input, padded
 // up by max_supp on all four sides, dimensions written to wd2 ht2
-static inline float *ll_pad_input(
+static inline void ll_pad_input(
     const float *const input,
+    float *const out,
     const int wd,
     const int ht,
     const int max_supp,
@@ -283,7 +313,6 @@ static inline float *ll_pad_input(
   const int stride = 4;
   *wd2 = 2*max_supp + wd;
   *ht2 = 2*max_supp + ht;
-  float *const out = dt_alloc_align(64, *wd2**ht2*sizeof(*out));
 
   if(b && b->mode == 2)
   { // pad by preview buffer
@@ -379,21 +408,36 @@ static inline float *ll_pad_input(
     dump_PFM("/tmp/padded.pfm",out,*wd2,*ht2);
   }
 #endif
-  return out;
 }
 
 
-static inline float ll_laplacian(
-    const float *const coarse,   // coarse res gaussian
-    const float *const fine,     // fine res gaussian
-    const int i,                 // fine index
+// one pixel of an output level: the expanded coarser output level plus the coefficients, interpolated between
+// the two gamma levels around the brightness of the input. the expansion is read at ic, jc.
+static inline void ll_assemble(
+    float *const out,                   // output level
+    const float *const coarse,          // coarser output level
+    const float *const padded,          // input gaussian at the level of out
+    const float *const *const fine_k,   // gamma pyramids at the level of out
+    const float *const *const coarse_k, // gamma pyramids one level coarser
+    const float *const gamma,
+    const int k0,                       // first and last gamma level present
+    const int k1,
+    const int i,
     const int j,
-    const int wd,                // fine width
-    const int ht)                // fine height
+    const int ic,
+    const int jc,
+    const int wd,                       // fine width
+    const int ht)                       // fine height
 {
-  const float c = ll_expand_gaussian(coarse,
-      CLAMPS(i, 1, ((wd-1)&~1)-1), CLAMPS(j, 1, ((ht-1)&~1)-1), wd, ht);
-  return fine[j*wd+i] - c;
+  const size_t idx = (size_t)j*wd+i;
+  const float v = padded[idx];
+  int hi = k0+1;
+  for(;hi<k1 && gamma[hi] <= v;hi++);
+  const int lo = hi-1;
+  const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
+  const float l0 = fine_k[lo][idx] - ll_expand_gaussian(coarse_k[lo], ic, jc, wd, ht);
+  const float l1 = fine_k[hi][idx] - ll_expand_gaussian(coarse_k[hi], ic, jc, wd, ht);
+  out[idx] = ll_expand_gaussian(coarse, ic, jc, wd, ht) + (l0 * (1.0f-a) + l1 * a);
 }
 
 static inline float curve_scalar(
@@ -570,6 +614,7 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     const int use_sse2,         // flag whether to use SSE version
+    local_laplacian_workspace_t *ws,
     local_laplacian_boundary_t *b)
 {
   if(wd <= 1 || ht <= 1) return;
@@ -580,21 +625,35 @@ void local_laplacian_internal(
   if(b && b->mode == 2) // higher number here makes it less prone to aliasing and slower.
     last_level = num_levels > 4 ? 4 : num_levels-1;
   const int max_supp = 1<<last_level;
-  int w, h;
-  float *padded[max_levels] = {0};
-  if(b && b->mode == 2)
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
-  else
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+  int w = 2*max_supp + wd, h = 2*max_supp + ht;
 
-  // allocate pyramid pointers for padded input
-  for(int l=1;l<=last_level;l++)
-    padded[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
-
-  // allocate pyramid pointers for output
+  // all pyramids share the same layout, levels start at cache line boundaries
+  size_t offset[max_levels+1] = {0};
+  for(int l=0;l<=last_level;l++)
+    offset[l+1] = offset[l] + (((size_t)dl(w,l)*dl(h,l) + 15) & ~(size_t)15);
+  // runs sharing a workspace at the same time (tiles of one piece processed in parallel) get their own
+  if(ws && dt_pthread_mutex_trylock(&ws->lock)) ws = NULL;
+  const int own_ws = ws != NULL;
+  local_laplacian_workspace_t *const tmp_ws = ws ? NULL : local_laplacian_workspace_init();
+  if(!ws) ws = tmp_ws;
+
+  // the preview pass hands the padded input and the output pyramid on, these can't live in the workspace
+  const int pass_on = b && b->mode == 1;
+  float *padded[max_levels] = {0};
   float *output[max_levels] = {0};
+  float *const padded_ws = ll_workspace_get(ws, 0, offset[last_level+1]);
+  float *const output_ws = pass_on ? NULL : ll_workspace_get(ws, 1, offset[last_level+1]);
   for(int l=0;l<=last_level;l++)
-    output[l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
+  {
+    padded[l] = padded_ws + offset[l];
+    output[l] = pass_on ? dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l)) : output_ws + offset[l];
+  }
+  if(pass_on) padded[0] = dt_alloc_align(64, sizeof(float)*w*h);
+
+  if(b && b->mode == 2)
+    ll_pad_input(input, padded[0], wd, ht, max_supp, &w, &h, b);
+  else
+    ll_pad_input(input, padded[0], wd, ht, max_supp, &w, &h, 0);
 
   // create gauss pyramid of padded input, write coarse directly to output
 #if defined(__SSE2__)
@@ -617,15 +676,41 @@ void local_laplacian_internal(
   for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
   // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
 
-  // allocate memory for intermediate laplacian pyramids
+  // every level of the gaussian pyramid is a blur of the padded input, so the brightness range of
+  // the latter decides which gamma levels the output can ever interpolate between. dark or flat
+  // images only need a few of them, skip the pyramids for the rest.
+  const float *const pad0 = padded[0];
+  const size_t npad = (size_t)w * h;
+  float vmin = FLT_MAX, vmax = -FLT_MAX;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(pad0, npad) \
+  reduction(min : vmin) reduction(max : vmax) \
+  schedule(static)
+#endif
+  for(size_t k=0;k<npad;k++)
+  {
+    vmin = MIN(vmin, pad0[k]);
+    vmax = MAX(vmax, pad0[k]);
+  }
+  // first and last level used, found the same way as in the lookup below
+  int k0 = 1, k1 = 1;
+  for(;k0<num_gamma-1 && gamma[k0] <= vmin;k0++);
+  for(;k1<num_gamma-1 && gamma[k1] <= vmax;k1++);
+  k0--;
+
+  // intermediate laplacian pyramids
   float *buf[num_gamma][max_levels] = {{0}};
-  for(int k=0;k<num_gamma;k++) for(int l=0;l<=last_level;l++)
-    buf[k][l] = dt_alloc_align(64, sizeof(float)*dl(w,l)*dl(h,l));
+  for(int k=k0;k<=k1;k++)
+  {
+    float *const buf_ws = ll_workspace_get(ws, 2+k, offset[last_level+1]);
+    for(int l=0;l<=last_level;l++) buf[k][l] = buf_ws + offset[l];
+  }
 
   // the paper says remapping only level 3 not 0 does the trick, too
   // (but i really like the additional octave of sharpness we get,
   // willing to pay the cost).
-  for(int k=0;k<num_gamma;k++)
+  for(int k=k0;k<=k1;k++)
   { // process images
 #if defined(__SSE2__)
     if(use_sse2)
@@ -707,30 +792,39 @@ void local_laplacian_internal(
   {
     const int pw = dl(w,l), ph = dl(h,l);
 
-    gauss_expand(output[l+1], output[l], pw, ph);
-    // go through all coefficients in the upsampled gauss buffer:
+    // upsample the coarser output and add the coefficients in the same pass. the expansion
+    // needs a boundary (two px for even sizes, one px for odd ones) which repeats the pixels next to it.
+    const int imax = ((pw-1)&~1)-1, jmax = ((ph-1)&~1)-1;
+    float *const dest = output[l];
+    const float *const coarse = output[l+1];
+    const float *const pad = padded[l];
+    const float *fine_k[num_gamma] = {0}, *coarse_k[num_gamma] = {0};
+    for(int k=k0;k<=k1;k++)
+    {
+      fine_k[k] = buf[k][l];
+      coarse_k[k] = buf[k][l+1];
+    }
+    // we could use the laplacian of padded[] at l == 0 to save on memory (no need for finest buf[][]).
+    // unfortunately it results in a quite noticeable loss of sharpness, i think
+    // the extra level is worth it.
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-    dt_omp_firstprivate(ph, pw) \
-    shared(w,h,buf,output,l,gamma,padded) \
-    schedule(static) \
-    collapse(2)
+    dt_omp_firstprivate(ph, pw, k0, k1, imax, jmax, dest, coarse, pad, fine_k, coarse_k, gamma) \
+    schedule(static)
 #endif
-    for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
+    for(int j=0;j<ph;j++)
     {
-      const float v = padded[l][j*pw+i];
-      int hi = 1;
-      for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
-      int lo = hi-1;
-      const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
-      const float l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
-      const float l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
-      output[l][j*pw+i] += l0 * (1.0f-a) + l1 * a;
-      // we could do this to save on memory (no need for finest buf[][]).
-      // unfortunately it results in a quite noticeable loss of sharpness, i think
-      // the extra level is worth it.
-      // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
-      //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
+      const int jc = CLAMPS(j, 1, jmax);
+      ll_assemble(dest, coarse, pad, fine_k, coarse_k, gamma, k0, k1, 0, j, 1, jc, pw, ph);
+      // inner pixels in pairs, this way the stencil of ll_expand_gaussian() is known for both
+      int m = 0;
+      for(;2*m+2<imax;m++)
+      {
+        ll_assemble(dest, coarse, pad, fine_k, coarse_k, gamma, k0, k1, 2*m+1, j, 2*m+1, jc, pw, ph);
+        ll_assemble(dest, coarse, pad, fine_k, coarse_k, gamma, k0, k1, 2*m+2, j, 2*m+2, jc, pw, ph);
+      }
+      for(int i=2*m+1;i<pw;i++)
+        ll_assemble(dest, coarse, pad, fine_k, coarse_k, gamma, k0, k1, i, j, MIN(i, imax), jc, pw, ph);
     }
   }
 #ifdef _OPENMP
@@ -756,13 +850,9 @@ void local_laplacian_internal(
     b->num_levels = num_levels;
     for(int l=0;l<num_levels;l++) b->output[l] = output[l];
   }
-  // free all buffers except the ones passed out for preview rendering
-  for(int l=0;l<max_levels;l++)
-  {
-    if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
-    if(!b || b->mode != 1)        dt_free_align(output[l]);
-    for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
-  }
+  // everything else stays in the workspace for the next image
+  if(own_ws) dt_pthread_mutex_unlock(&ws->lock);
+  local_laplacian_workspace_free(tmp_ws);
 }
 
 
@@ -37,6 +37,18 @@ typedef struct local_laplacian_boundary_t
 }
 local_laplacian_boundary_t;
 
+// buffers for all pyramids, to be kept with the pixelpipe piece and reused for every image it processes.
+// they are only allocated again when the image gets larger. a run finding the workspace in use by another
+// one works on buffers of its own.
+typedef struct local_laplacian_workspace_t local_laplacian_workspace_t;
+
+local_laplacian_workspace_t *local_laplacian_workspace_init(void);
+
+void local_laplacian_workspace_free(local_laplacian_workspace_t *ws);
+
+// frees the pyramids again if they take up more than max_bytes, the workspace itself stays usable
+void local_laplacian_workspace_trim(local_laplacian_workspace_t *ws, const size_t max_bytes);
+
 void local_laplacian_boundary_free(
     local_laplacian_boundary_t *b)
 {
@@ -55,6 +67,7 @@ void local_laplacian_internal(
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
     const int use_sse2,         // switch on sse optimised version, if available
+    local_laplacian_workspace_t *ws, // buffers to reuse (can be 0)
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
     local_laplacian_boundary_t *b);
 
@@ -67,9 +80,10 @@ void local_laplacian(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
+    local_laplacian_workspace_t *ws, // can be 0
     local_laplacian_boundary_t *b) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, ws, b);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
@@ -90,8 +104,9 @@ void local_laplacian_sse2(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
+    local_laplacian_workspace_t *ws, // can be 0
     local_laplacian_boundary_t *b) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, ws, b);
 }
 #endif
@@ -184,15 +184,14 @@ static gboolean _compare_metadata(gconstpointer a, gconstpointer b)
   return g_strcmp0(a, b);
 }
 
-static gchar *_get_tb_removed_metadata_string_values(GList *before, GList *after)
+// removes the keys of before which after doesn't have with the same value
+static void _remove_changed_metadata(const int img, GList *before, GList *after)
 {
-  GList *b = before;
-  GList *a = after;
-  gchar *metadata_list = NULL;
-
-  while(b)
+  if(img <= 0) return;
+  sqlite3_stmt *stmt = NULL;
+  for(GList *b = before; b; b = g_list_next(g_list_next(b)))
   {
-    GList *same_key = g_list_find_custom(a, b->data, _compare_metadata);
+    GList *same_key = g_list_find_custom(after, b->data, _compare_metadata);
     GList *b2 = g_list_next(b);
     gboolean different_value = FALSE;
     const char *value = (char *)b2->data; // if empty we can remove it
@@ -203,24 +202,24 @@ static gchar *_get_tb_removed_metadata_string_values(GList *before, GList *after
     }
     if(!same_key || different_value || !value[0])
     {
-      metadata_list = dt_util_dstrcat(metadata_list, "%d,", atoi(b->data));
+      if(!stmt)
+        stmt = dt_database_get_statement(darktable.db, "DELETE FROM main.meta_data WHERE id = ?1 AND key = ?2");
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, img);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, atoi(b->data));
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
     }
-    b = g_list_next(b);
-    b = g_list_next(b);
   }
-  if(metadata_list) metadata_list[strlen(metadata_list) - 1] = '\0';
-  return metadata_list;
+  if(stmt) dt_database_release_statement(darktable.db, stmt);
 }
 
-static gchar *_get_tb_added_metadata_string_values(const int img, GList *before, GList *after)
+// adds the non empty keys of after which before doesn't have with the same value
+static void _add_changed_metadata(const int img, GList *before, GList *after)
 {
-  GList *b = before;
-  GList *a = after;
-  gchar *metadata_list = NULL;
-
-  while(a)
+  sqlite3_stmt *stmt = NULL;
+  for(GList *a = after; a; a = g_list_next(g_list_next(a)))
   {
-    GList *same_key = g_list_find_custom(b, a->data, _compare_metadata);
+    GList *same_key = g_list_find_custom(before, a->data, _compare_metadata);
     GList *a2 = g_list_next(a);
     gboolean different_value = FALSE;
     const char *value = (char *)a2->data; // if empty we don't add it to database
@@ -231,55 +230,23 @@ static gchar *_get_tb_added_metadata_string_values(const int img, GList *before,
     }
     if((!same_key || different_value) && value[0])
     {
-      char *escaped_text = sqlite3_mprintf("%q", value);
-      metadata_list = dt_util_dstrcat(metadata_list, "(%d,%d,'%s'),", GPOINTER_TO_INT(img), atoi(a->data), escaped_text);
-      sqlite3_free(escaped_text);
+      if(!stmt)
+        stmt = dt_database_get_statement(darktable.db,
+                                         "INSERT INTO main.meta_data (id, key, value) VALUES (?1, ?2, ?3)");
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, img);
+      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, atoi(a->data));
+      DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 3, value, -1, SQLITE_STATIC);
+      sqlite3_step(stmt);
+      sqlite3_reset(stmt);
     }
-    a = g_list_next(a);
-    a = g_list_next(a);
-  }
-  if(metadata_list) metadata_list[strlen(metadata_list) - 1] = '\0';
-  return metadata_list;
-}
-
-static void _bulk_remove_metadata(const int img, const gchar *metadata_list)
-{
-  if(img > 0 && metadata_list)
-  {
-    char *query = NULL;
-    sqlite3_stmt *stmt;
-    query = dt_util_dstrcat(query, "DELETE FROM main.meta_data WHERE id = %d AND key IN (%s)", img, metadata_list);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    g_free(query);
-  }
-}
-
-static void _bulk_add_metadata(gchar *metadata_list)
-{
-  if(metadata_list)
-  {
-    char *query = NULL;
-    sqlite3_stmt *stmt;
-    query = dt_util_dstrcat(query, "INSERT INTO main.meta_data (id, key, value) VALUES %s", metadata_list);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    g_free(query);
   }
+  if(stmt) dt_database_release_statement(darktable.db, stmt);
 }
 
 static void _pop_undo_execute(const int imgid, GList *before, GList *after)
 {
-  gchar *tobe_removed_list = _get_tb_removed_metadata_string_values(before, after);
-  gchar *tobe_added_list = _get_tb_added_metadata_string_values(imgid, before, after);
-
-  _bulk_remove_metadata(imgid, tobe_removed_list);
-  _bulk_add_metadata(tobe_added_list);
-
-  g_free(tobe_removed_list);
-  g_free(tobe_added_list);
+  _remove_changed_metadata(imgid, before, after);
+  _add_changed_metadata(imgid, before, after);
 }
 
 static void _pop_undo(gpointer user_data, const dt_undo_type_t type, dt_undo_data_t data, const dt_undo_action_t action, GList **imgs)
@@ -306,9 +273,7 @@ static void _pop_undo(gpointer user_data, const dt_undo_type_t type, dt_undo_dat
 GList *dt_metadata_get_list_id(const int id)
 {
   GList *metadata = NULL;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT key, value FROM main.meta_data WHERE id=?1", -1, &stmt, NULL);
+  sqlite3_stmt *stmt = dt_database_get_statement(darktable.db, "SELECT key, value FROM main.meta_data WHERE id=?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -318,7 +283,7 @@ GList *dt_metadata_get_list_id(const int id)
     metadata = g_list_append(metadata, (gpointer)ckey);
     metadata = g_list_append(metadata, (gpointer)cvalue);
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
   return metadata;
 }
 
@@ -367,14 +332,13 @@ GList *dt_metadata_get(const int id, const char *key, uint32_t *count)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT flags FROM main.images WHERE id IN "
-                                                                   "(SELECT imgid FROM main.selected_images)",
-                                    -1, &stmt, NULL);
+        stmt = dt_database_get_statement(darktable.db,
+                                         "SELECT flags FROM main.images WHERE id IN "
+                                         "(SELECT imgid FROM main.selected_images)");
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT flags FROM main.images WHERE id = ?1",
-                                    -1, &stmt, NULL);
+        stmt = dt_database_get_statement(darktable.db, "SELECT flags FROM main.images WHERE id = ?1");
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
       }
       while(sqlite3_step(stmt) == SQLITE_ROW)
@@ -384,24 +348,22 @@ GList *dt_metadata_get(const int id, const char *key, uint32_t *count)
         stars = (stars & 0x7) - 1;
         result = g_list_append(result, GINT_TO_POINTER(stars));
       }
-      sqlite3_finalize(stmt);
+      dt_database_release_statement(darktable.db, stmt);
     }
     else if(strncmp(key, "Xmp.dc.subject", 14) == 0)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                    "SELECT name FROM data.tags t JOIN main.tagged_images i ON "
-                                    "i.tagid = t.id WHERE imgid IN "
-                                    "(SELECT imgid FROM main.selected_images)",
-                                    -1, &stmt, NULL);
+        stmt = dt_database_get_statement(darktable.db,
+                                         "SELECT name FROM data.tags t JOIN main.tagged_images i ON "
+                                         "i.tagid = t.id WHERE imgid IN "
+                                         "(SELECT imgid FROM main.selected_images)");
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                    "SELECT name FROM data.tags t JOIN main.tagged_images i ON "
-                                    "i.tagid = t.id WHERE imgid = ?1",
-                                    -1, &stmt, NULL);
+        stmt = dt_database_get_statement(darktable.db,
+                                         "SELECT name FROM data.tags t JOIN main.tagged_images i ON "
+                                         "i.tagid = t.id WHERE imgid = ?1");
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
       }
       while(sqlite3_step(stmt) == SQLITE_ROW)
@@ -409,22 +371,20 @@ GList *dt_metadata_get(const int id, const char *key, uint32_t *count)
         local_count++;
         result = g_list_append(result, g_strdup((char *)sqlite3_column_text(stmt, 0)));
       }
-      sqlite3_finalize(stmt);
+      dt_database_release_statement(darktable.db, stmt);
     }
     else if(strncmp(key, "Xmp.darktable.colorlabels", 25) == 0)
     {
       if(id == -1)
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                    "SELECT color FROM main.color_labels WHERE imgid IN "
-                                    "(SELECT imgid FROM main.selected_images)",
-                                    -1, &stmt, NULL);
+        stmt = dt_database_get_statement(darktable.db,
+                                         "SELECT color FROM main.color_labels WHERE imgid IN "
+                                         "(SELECT imgid FROM main.selected_images)");
       }
       else // single image under mouse cursor
       {
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                    "SELECT color FROM main.color_labels WHERE imgid=?1 ORDER BY color",
-                                    -1, &stmt, NULL);
+        stmt = dt_database_get_statement(darktable.db,
+                                         "SELECT color FROM main.color_labels WHERE imgid=?1 ORDER BY color");
         DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
       }
       while(sqlite3_step(stmt) == SQLITE_ROW)
@@ -432,7 +392,7 @@ GList *dt_metadata_get(const int id, const char *key, uint32_t *count)
         local_count++;
         result = g_list_append(result, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
       }
-      sqlite3_finalize(stmt);
+      dt_database_release_statement(darktable.db, stmt);
     }
     if(count != NULL) *count = local_count;
     return result;
@@ -441,17 +401,15 @@ GList *dt_metadata_get(const int id, const char *key, uint32_t *count)
   // So we got this far -- it has to be a generic key-value entry from meta_data
   if(id == -1)
   {
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT value FROM main.meta_data WHERE id IN "
-                                "(SELECT imgid FROM main.selected_images) AND key = ?1 ORDER BY value",
-                                -1, &stmt, NULL);
+    stmt = dt_database_get_statement(darktable.db,
+                                     "SELECT value FROM main.meta_data WHERE id IN "
+                                     "(SELECT imgid FROM main.selected_images) AND key = ?1 ORDER BY value");
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, keyid);
   }
   else // single image under mouse cursor
   {
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT value FROM main.meta_data WHERE id = ?1 AND key = ?2 ORDER BY value", -1,
-                                &stmt, NULL);
+    stmt = dt_database_get_statement(darktable.db,
+                                     "SELECT value FROM main.meta_data WHERE id = ?1 AND key = ?2 ORDER BY value");
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
     DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, keyid);
   }
@@ -461,7 +419,7 @@ GList *dt_metadata_get(const int id, const char *key, uint32_t *count)
     char *value = (char *)sqlite3_column_text(stmt, 0);
     result = g_list_append(result, g_strdup(value ? value : "")); // to avoid NULL value
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
   if(count != NULL) *count = local_count;
   return result;
 }
@@ -26,6 +26,7 @@
 #include "common/imageio.h"
 #include "common/imageio_jpeg.h"
 #include "common/imageio_module.h"
+#include "common/mipmap_pack.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
@@ -56,6 +57,11 @@
 #define DT_MIPMAP_CACHE_FILE_MAGIC 0xD71337
 #define DT_MIPMAP_CACHE_FILE_VERSION 23
 #define DT_MIPMAP_CACHE_DEFAULT_FILE_NAME "mipmaps"
+// seconds within which a thumbnail requested for display should start loading
+#define DT_MIPMAP_BEST_EFFORT_DEADLINE 0.1
+
+// see dt_mipmap_cache_set_load_owner()
+static __thread const void *_load_owner = NULL;
 
 typedef enum dt_mipmap_buffer_dsc_flags
 {
@@ -64,22 +70,6 @@ typedef enum dt_mipmap_buffer_dsc_flags
   DT_MIPMAP_BUFFER_DSC_FLAG_INVALIDATE = 1 << 1
 } dt_mipmap_buffer_dsc_flags;
 
-// the embedded Exif data to tag thumbnails as sRGB or AdobeRGB
-static const uint8_t dt_mipmap_cache_exif_data_srgb[] = {
-  0x45, 0x78, 0x69, 0x66, 0x00, 0x00, 0x49, 0x49, 0x2a, 0x00, 0x08, 0x00, 0x00, 0x00, 0x01, 0x00, 0x69,
-  0x87, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
-  0x01, 0xa0, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-};
-static const uint8_t dt_mipmap_cache_exif_data_adobergb[] = {
-  0x45, 0x78, 0x69, 0x66, 0x00, 0x00, 0x49, 0x49, 0x2a, 0x00, 0x08, 0x00, 0x00, 0x00, 0x01, 0x00, 0x69,
-  0x87, 0x04, 0x00, 0x01, 0x00, 0x00, 0x00, 0x1a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
-  0x01, 0xa0, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-};
-static const int dt_mipmap_cache_exif_data_srgb_length
-                      = sizeof(dt_mipmap_cache_exif_data_srgb) / sizeof(*dt_mipmap_cache_exif_data_srgb);
-static const int dt_mipmap_cache_exif_data_adobergb_length
-                      = sizeof(dt_mipmap_cache_exif_data_adobergb) / sizeof(*dt_mipmap_cache_exif_data_adobergb);
-
 struct dt_mipmap_buffer_dsc
 {
   uint32_t width;
@@ -307,6 +297,77 @@ void *dt_mipmap_cache_alloc(dt_mipmap_buffer_t *buf, const dt_image_t *img)
   return dsc + 1;
 }
 
+static inline void _legacy_thumbnail_filename(const dt_mipmap_cache_t *cache, const dt_mipmap_size_t mip,
+                                              const uint32_t imgid, char *filename, const size_t size)
+{
+  snprintf(filename, size, "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip, imgid);
+}
+
+static void _unlink_legacy_thumbnail(const dt_mipmap_cache_t *cache, const dt_mipmap_size_t mip,
+                                     const uint32_t imgid)
+{
+  if(!cache->cachedir[0]) return;
+  char filename[PATH_MAX] = { 0 };
+  _legacy_thumbnail_filename(cache, mip, imgid, filename, sizeof(filename));
+  g_unlink(filename);
+}
+
+static int _thumbnail_decompress(const dt_mipmap_cache_t *cache, const dt_mipmap_size_t mip, const uint8_t *blob,
+                                 const size_t len, dt_imageio_jpeg_t *jpg, uint8_t *out)
+{
+  return dt_imageio_jpeg_decompress_header(blob, len, jpg)
+         || jpg->width > cache->max_width[mip] || jpg->height > cache->max_height[mip]
+         || dt_imageio_jpeg_decompress(jpg, out);
+}
+
+// earlier versions stored one jpeg file per thumbnail. move them into the
+// pack as they are used, so the old directories empty out over time.
+static int _load_legacy_thumbnail(dt_mipmap_cache_t *cache, const dt_mipmap_size_t mip, const uint32_t imgid,
+                                  struct dt_mipmap_buffer_dsc *dsc)
+{
+  char filename[PATH_MAX] = {0};
+  _legacy_thumbnail_filename(cache, mip, imgid, filename, sizeof(filename));
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return 0;
+
+  int loaded = 0;
+  uint8_t *blob = 0;
+  fseek(f, 0, SEEK_END);
+  const long len = ftell(f);
+  if(len <= 0) goto read_error; // coverity madness
+  blob = (uint8_t *)dt_alloc_align(64, len);
+  if(!blob) goto read_error;
+  fseek(f, 0, SEEK_SET);
+  const int rd = fread(blob, sizeof(uint8_t), len, f);
+  if(rd != len) goto read_error;
+  dt_colorspaces_color_profile_type_t color_space;
+  dt_imageio_jpeg_t jpg;
+  if(dt_imageio_jpeg_decompress_header(blob, len, &jpg)
+     || (jpg.width > cache->max_width[mip] || jpg.height > cache->max_height[mip])
+     || ((color_space = dt_imageio_jpeg_read_color_space(&jpg)) == DT_COLORSPACE_NONE) // pointless test to keep it in the if clause
+     || dt_imageio_jpeg_decompress(&jpg, (uint8_t *)(dsc + 1)))
+  {
+    fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %" PRIu32 " from `%s'!\n", imgid,
+            filename);
+    goto read_error;
+  }
+  dt_print(DT_DEBUG_CACHE, "[mipmap_cache] grab mip %d for image %" PRIu32 " from legacy disk cache\n", mip,
+           imgid);
+  dsc->width = jpg.width;
+  dsc->height = jpg.height;
+  dsc->iscale = 1.0f;
+  dsc->color_space = color_space;
+  dt_mipmap_pack_put(cache->pack[mip], imgid, jpg.width, jpg.height, color_space, blob, len);
+  loaded = 1;
+
+read_error:
+  dt_free_align(blob);
+  fclose(f);
+  // either broken or moved into the pack
+  g_unlink(filename);
+  return loaded;
+}
+
 // callback for the cache backend to initialize payload pointers
 void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
 {
@@ -369,51 +430,36 @@ void dt_mipmap_cache_allocate_dynamic(void *data, dt_cache_entry_t *entry)
   int loaded_from_disk = 0;
   if(mip < DT_MIPMAP_F)
   {
-    if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
-                              || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
+    if(cache->pack[mip] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
+                            || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
     {
       // try and load from disk, if successful set flag
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
-               get_imgid(entry->key));
-      FILE *f = g_fopen(filename, "rb");
-      if(f)
+      const uint32_t imgid = get_imgid(entry->key);
+      dt_mipmap_pack_blob_t blob;
+      if(dt_mipmap_pack_get(cache->pack[mip], imgid, &blob))
       {
-        uint8_t *blob = 0;
-        fseek(f, 0, SEEK_END);
-        const long len = ftell(f);
-        if(len <= 0) goto read_error; // coverity madness
-        blob = (uint8_t *)dt_alloc_align(64, len);
-        if(!blob) goto read_error;
-        fseek(f, 0, SEEK_SET);
-        const int rd = fread(blob, sizeof(uint8_t), len, f);
-        if(rd != len) goto read_error;
-        dt_colorspaces_color_profile_type_t color_space;
+        // decode straight out of the mapped pack
         dt_imageio_jpeg_t jpg;
-        if(dt_imageio_jpeg_decompress_header(blob, len, &jpg)
-           || (jpg.width > cache->max_width[mip] || jpg.height > cache->max_height[mip])
-           || ((color_space = dt_imageio_jpeg_read_color_space(&jpg)) == DT_COLORSPACE_NONE) // pointless test to keep it in the if clause
-           || dt_imageio_jpeg_decompress(&jpg, entry->data + sizeof(*dsc)))
+        if(_thumbnail_decompress(cache, mip, blob.data, blob.length, &jpg, (uint8_t *)entry->data + sizeof(*dsc)))
         {
           fprintf(stderr, "[mipmap_cache] failed to decompress thumbnail for image %" PRIu32 " from `%s'!\n",
-                  get_imgid(entry->key), filename);
-          goto read_error;
+                  imgid, cache->cachedir);
+          dt_mipmap_pack_remove(cache->pack[mip], imgid);
         }
-        dt_print(DT_DEBUG_CACHE, "[mipmap_cache] grab mip %d for image %" PRIu32 " from disk cache\n", mip,
-                 get_imgid(entry->key));
-        dsc->width = jpg.width;
-        dsc->height = jpg.height;
-        dsc->iscale = 1.0f;
-        dsc->color_space = color_space;
-        loaded_from_disk = 1;
-        if(0)
+        else
         {
-read_error:
-          g_unlink(filename);
+          dt_print(DT_DEBUG_CACHE, "[mipmap_cache] grab mip %d for image %" PRIu32 " from disk cache\n", mip,
+                   imgid);
+          dsc->width = jpg.width;
+          dsc->height = jpg.height;
+          dsc->iscale = 1.0f;
+          dsc->color_space = blob.color_space;
+          loaded_from_disk = 1;
         }
-        dt_free_align(blob);
-        fclose(f);
+        dt_mipmap_pack_release(&blob);
       }
+      else
+        loaded_from_disk = _load_legacy_thumbnail(cache, mip, imgid, dsc);
     }
   }
 
@@ -435,15 +481,11 @@ static void dt_mipmap_cache_unlink_ondisk_thumbnail(void *data, uint32_t imgid,
 {
   dt_mipmap_cache_t *cache = (dt_mipmap_cache_t *)data;
 
-  // also remove jpg backing (always try to do that, in case user just temporarily switched it off,
+  // also remove the disk backing (always try to do that, in case user just temporarily switched it off,
   // to avoid inconsistencies.
   // if(dt_conf_get_bool("cache_disk_backend"))
-  if(cache->cachedir[0])
-  {
-    char filename[PATH_MAX] = { 0 };
-    snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, imgid);
-    g_unlink(filename);
-  }
+  if(cache->pack[mip]) dt_mipmap_pack_remove(cache->pack[mip], imgid);
+  _unlink_legacy_thumbnail(cache, mip, imgid);
 }
 
 void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
@@ -460,58 +502,40 @@ void dt_mipmap_cache_deallocate_dynamic(void *data, dt_cache_entry_t *entry)
       {
         dt_mipmap_cache_unlink_ondisk_thumbnail(data, get_imgid(entry->key), mip);
       }
-      else if(cache->cachedir[0] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
-                                     || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
+      else if(cache->pack[mip] && ((dt_conf_get_bool("cache_disk_backend") && mip < DT_MIPMAP_8)
+                                   || (dt_conf_get_bool("cache_disk_backend_full") && mip == DT_MIPMAP_8)))
       {
-        // serialize to disk
-        char filename[PATH_MAX] = {0};
-        snprintf(filename, sizeof(filename), "%s.d/%d", cache->cachedir, mip);
-        const int mkd = g_mkdir_with_parents(filename, 0750);
-        if(!mkd)
+        const uint32_t imgid = get_imgid(entry->key);
+        // Don't write existing thumbnails as both performance and quality (lossy jpg) suffer
+        if(!dt_mipmap_pack_contains(cache->pack[mip], imgid))
         {
-          snprintf(filename, sizeof(filename), "%s.d/%d/%" PRIu32 ".jpg", cache->cachedir, (int)mip,
-                   get_imgid(entry->key));
-          // Don't write existing files as both performance and quality (lossy jpg) suffer
-          FILE *f = NULL;
-          if (!g_file_test(filename, G_FILE_TEST_EXISTS) && (f = g_fopen(filename, "wb")))
+          // first check the disk isn't full
+          char cachedir[PATH_MAX] = { 0 };
+          dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+          struct statvfs vfsbuf;
+          if(statvfs(cachedir, &vfsbuf))
           {
-            // first check the disk isn't full
-            struct statvfs vfsbuf;
-            if (!statvfs(filename, &vfsbuf))
-            {
-              const int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
-              if (free_mb < 100)
-              {
-                fprintf(stderr, "Aborting image write as only %" PRId64 " MB free to write %s\n", free_mb, filename);
-                goto write_error;
-              }
-            }
-            else
-            {
-              fprintf(stderr, "Aborting image write since couldn't determine free space available to write %s\n", filename);
-              goto write_error;
-            }
-
+            fprintf(stderr, "Aborting thumbnail write since couldn't determine free space available in %s\n", cachedir);
+          }
+          else if(((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20) < 100)
+          {
+            const int64_t free_mb = ((vfsbuf.f_frsize * vfsbuf.f_bavail) >> 20);
+            fprintf(stderr, "Aborting thumbnail write as only %" PRId64 " MB free in %s\n", free_mb, cachedir);
+          }
+          else
+          {
+            // the color space is kept in the pack, no need for exif tags
             const int cache_quality = dt_conf_get_int("database_cache_quality");
-            const uint8_t *exif = NULL;
-            int exif_len = 0;
-            if(dsc->color_space == DT_COLORSPACE_SRGB)
-            {
-              exif = dt_mipmap_cache_exif_data_srgb;
-              exif_len = dt_mipmap_cache_exif_data_srgb_length;
-            }
-            else if(dsc->color_space == DT_COLORSPACE_ADOBERGB)
-            {
-              exif = dt_mipmap_cache_exif_data_adobergb;
-              exif_len = dt_mipmap_cache_exif_data_adobergb_length;
-            }
-            if(dt_imageio_jpeg_write(filename, entry->data + sizeof(*dsc), dsc->width, dsc->height, MIN(100, MAX(10, cache_quality)), exif, exif_len))
-            {
-write_error:
-              g_unlink(filename);
-            }
+            uint8_t *blob = dt_alloc_align(64, (size_t)4 * dsc->width * dsc->height);
+            const int len = blob ? dt_imageio_jpeg_compress((uint8_t *)entry->data + sizeof(*dsc), blob, dsc->width,
+                                                            dsc->height, MIN(100, MAX(10, cache_quality)))
+                                 : 0;
+            // 1 means failure
+            if(len > 1)
+              dt_mipmap_pack_put(cache->pack[mip], imgid, dsc->width, dsc->height, dsc->color_space, blob, len);
+            dt_free_align(blob);
+            _unlink_legacy_thumbnail(cache, mip, imgid);
           }
-          if(f) fclose(f);
         }
       }
     }
@@ -529,6 +553,14 @@ static uint32_t nearest_power_of_two(const uint32_t value)
 void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
 {
   dt_mipmap_cache_get_filename(cache->cachedir, sizeof(cache->cachedir));
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+  {
+    cache->pack[k] = NULL;
+    if(!cache->cachedir[0]) continue;
+    char filename[PATH_MAX] = { 0 };
+    snprintf(filename, sizeof(filename), "%s.d/%d.pack", cache->cachedir, k);
+    cache->pack[k] = dt_mipmap_pack_open(filename);
+  }
   // make sure static memory is initialized
   struct dt_mipmap_buffer_dsc *dsc = (struct dt_mipmap_buffer_dsc *)dt_mipmap_cache_static_dead_image;
   dead_image_f((dt_mipmap_buffer_t *)(dsc + 1));
@@ -586,6 +618,9 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
   dt_cache_init(&cache->mip_thumbs.cache, 0, max_mem);
   dt_cache_set_allocate_callback(&cache->mip_thumbs.cache, dt_mipmap_cache_allocate_dynamic, cache);
   dt_cache_set_cleanup_callback(&cache->mip_thumbs.cache, dt_mipmap_cache_deallocate_dynamic, cache);
+  // evicting thumbnails writes them to disk, let a background thread do that
+  // before the cache runs full instead of the thread which is waiting for a new one.
+  dt_cache_start_gc_thread(&cache->mip_thumbs.cache, "mipmap gc", 0.7f, 0.8f);
 
   const int full_entries
       = MAX(2, parallel); // even with one thread you want two buffers. one for dr one for thumbs.
@@ -606,25 +641,64 @@ void dt_mipmap_cache_init(dt_mipmap_cache_t *cache)
                                           * cache->max_height[DT_MIPMAP_F];
 }
 
+// drop the thumbnails of images that are gone from the library, removed while darktable wasn't running or by
+// another program. the packs belong to this library only, so anything it doesn't know about is stale.
+static void _mipmap_cache_purge_packs(dt_mipmap_cache_t *cache)
+{
+  gboolean have_packs = FALSE;
+  for(int k = 0; k < DT_MIPMAP_F; k++) have_packs |= cache->pack[k] != NULL;
+  if(!have_packs) return;
+
+  sqlite3_stmt *stmt;
+  if(sqlite3_prepare_v2(dt_database_get(darktable.db), "SELECT id FROM main.images", -1, &stmt, NULL) != SQLITE_OK)
+    return;
+  GHashTable *ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  int rc;
+  while((rc = sqlite3_step(stmt)) == SQLITE_ROW) g_hash_table_add(ids, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+
+  // a failed query would look like an empty library
+  if(rc == SQLITE_DONE)
+  {
+    for(int k = 0; k < DT_MIPMAP_F; k++)
+    {
+      if(!cache->pack[k]) continue;
+      GList *imgids = dt_mipmap_pack_get_imgids(cache->pack[k]);
+      for(GList *l = imgids; l; l = g_list_next(l))
+        if(!g_hash_table_contains(ids, l->data)) dt_mipmap_pack_remove(cache->pack[k], GPOINTER_TO_UINT(l->data));
+      g_list_free(imgids);
+    }
+  }
+  g_hash_table_destroy(ids);
+}
+
 void dt_mipmap_cache_cleanup(dt_mipmap_cache_t *cache)
 {
   dt_cache_cleanup(&cache->mip_thumbs.cache);
   dt_cache_cleanup(&cache->mip_full.cache);
   dt_cache_cleanup(&cache->mip_f.cache);
+  // after the caches, which write out their thumbnails on cleanup. closing the packs compacts them if the
+  // purge left a lot of dead records behind.
+  _mipmap_cache_purge_packs(cache);
+  for(int k = 0; k < DT_MIPMAP_F; k++)
+  {
+    dt_mipmap_pack_close(cache->pack[k]);
+    cache->pack[k] = NULL;
+  }
 }
 
 void dt_mipmap_cache_print(dt_mipmap_cache_t *cache)
 {
   printf("[mipmap_cache] thumbs fill %.2f/%.2f MB (%.2f%%)\n",
-         cache->mip_thumbs.cache.cost / (1024.0 * 1024.0),
+         dt_cache_get_cost(&cache->mip_thumbs.cache) / (1024.0 * 1024.0),
          cache->mip_thumbs.cache.cost_quota / (1024.0 * 1024.0),
-         100.0f * (float)cache->mip_thumbs.cache.cost / (float)cache->mip_thumbs.cache.cost_quota);
+         100.0f * (float)dt_cache_get_cost(&cache->mip_thumbs.cache) / (float)cache->mip_thumbs.cache.cost_quota);
   printf("[mipmap_cache] float fill %"PRIu32"/%"PRIu32" slots (%.2f%%)\n",
-         (uint32_t)cache->mip_f.cache.cost, (uint32_t)cache->mip_f.cache.cost_quota,
-         100.0f * (float)cache->mip_f.cache.cost / (float)cache->mip_f.cache.cost_quota);
+         (uint32_t)dt_cache_get_cost(&cache->mip_f.cache), (uint32_t)cache->mip_f.cache.cost_quota,
+         100.0f * (float)dt_cache_get_cost(&cache->mip_f.cache) / (float)cache->mip_f.cache.cost_quota);
   printf("[mipmap_cache] full  fill %"PRIu32"/%"PRIu32" slots (%.2f%%)\n",
-         (uint32_t)cache->mip_full.cache.cost, (uint32_t)cache->mip_full.cache.cost_quota,
-         100.0f * (float)cache->mip_full.cache.cost / (float)cache->mip_full.cache.cost_quota);
+         (uint32_t)dt_cache_get_cost(&cache->mip_full.cache), (uint32_t)cache->mip_full.cache.cost_quota,
+         100.0f * (float)dt_cache_get_cost(&cache->mip_full.cache) / (float)cache->mip_full.cache.cost_quota);
 
   uint64_t sum = 0;
   uint64_t sum_fetches = 0;
@@ -732,13 +806,10 @@ void dt_mipmap_cache_get_with_caller(
   else if(flags == DT_MIPMAP_PREFETCH_DISK)
   {
     // only prefetch if the disk cache exists:
-    if(!cache->cachedir[0]) return;
     if(mip > DT_MIPMAP_FULL || (int)mip < DT_MIPMAP_0)
       return; // remove the (int) once we no longer have to support gcc < 4.8 :/
-    char filename[PATH_MAX] = {0};
-    snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
     // don't attempt to load if disk cache doesn't exist
-    if(!g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    if(!dt_mipmap_cache_is_on_disk(cache, imgid, mip)) return;
     dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, dt_image_load_job_create(imgid, mip));
   }
   else if(flags == DT_MIPMAP_BLOCKING)
@@ -900,7 +971,14 @@ void dt_mipmap_cache_get_with_caller(
       if(mip == k)
       {
         __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_near_match), 1);
-        dt_mipmap_cache_get(cache, buf, imgid, mip, DT_MIPMAP_PREFETCH, 'r');
+        // unlike a plain prefetch, somebody is waiting to show this one
+        if(mip <= DT_MIPMAP_FULL)
+        {
+          dt_job_t *job = dt_image_load_job_create(imgid, mip);
+          if(job && _load_owner) dt_image_load_job_set_owner(job, _load_owner);
+          dt_control_job_set_deadline(job, DT_MIPMAP_BEST_EFFORT_DEADLINE);
+          dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, job);
+        }
       }
     }
     // couldn't find a smaller thumb, try larger ones only now (these will be slightly slower due to cairo rescaling):
@@ -918,13 +996,8 @@ void dt_mipmap_cache_get_with_caller(
     __sync_fetch_and_add(&(_get_cache(cache, mip)->stats_misses), 1);
     // in case we don't even have a disk cache for our requested thumbnail,
     // prefetch at least mip0, in case we have that in the disk caches:
-    if(cache->cachedir[0])
-    {
-      char filename[PATH_MAX] = {0};
-      snprintf(filename, sizeof(filename), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, key);
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
-        dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
-    }
+    if(dt_mipmap_cache_is_on_disk(cache, imgid, mip))
+      dt_mipmap_cache_get(cache, 0, imgid, DT_MIPMAP_0, DT_MIPMAP_PREFETCH_DISK, 0);
     // nothing found :(
     buf->buf = NULL;
     buf->imgid = 0;
@@ -1242,7 +1315,7 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
   if(res)
   {
     // try the real thing: rawspeed + pixelpipe
-    dt_imageio_module_format_t format;
+    dt_imageio_module_format_t format = { 0 };
     _dummy_data_t dat;
     format.bpp = _bpp;
     format.write_image = _write_image;
@@ -1285,6 +1358,11 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
   // TODO: if output is cropped, don't use mipf!
 }
 
+void dt_mipmap_cache_set_load_owner(const void *owner)
+{
+  _load_owner = owner;
+}
+
 dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace()
 {
   if(dt_conf_get_bool("cache_color_managed"))
@@ -1292,17 +1370,29 @@ dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace()
   return DT_COLORSPACE_DISPLAY;
 }
 
+gboolean dt_mipmap_cache_is_on_disk(const dt_mipmap_cache_t *cache, const uint32_t imgid, const dt_mipmap_size_t mip)
+{
+  if(mip >= DT_MIPMAP_F || !cache->pack[mip]) return FALSE;
+  if(dt_mipmap_pack_contains(cache->pack[mip], imgid)) return TRUE;
+  // not yet moved into the pack
+  char filename[PATH_MAX] = { 0 };
+  _legacy_thumbnail_filename(cache, mip, imgid, filename, sizeof(filename));
+  return g_file_test(filename, G_FILE_TEST_EXISTS);
+}
+
 void dt_mipmap_cache_copy_thumbnails(const dt_mipmap_cache_t *cache, const uint32_t dst_imgid, const uint32_t src_imgid)
 {
   if(cache->cachedir[0] && dt_conf_get_bool("cache_disk_backend"))
   {
     for(dt_mipmap_size_t mip = DT_MIPMAP_0; mip < DT_MIPMAP_F; mip++)
     {
-      // try and load from disk, if successful set flag
+      if(!dt_mipmap_pack_copy(cache->pack[mip], dst_imgid, src_imgid)) continue;
+
+      // the source might still be a jpeg of an earlier version
       char srcpath[PATH_MAX] = {0};
       char dstpath[PATH_MAX] = {0};
-      snprintf(srcpath, sizeof(srcpath), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, src_imgid);
-      snprintf(dstpath, sizeof(dstpath), "%s.d/%d/%"PRIu32".jpg", cache->cachedir, (int)mip, dst_imgid);
+      _legacy_thumbnail_filename(cache, mip, src_imgid, srcpath, sizeof(srcpath));
+      _legacy_thumbnail_filename(cache, mip, dst_imgid, dstpath, sizeof(dstpath));
       GFile *src = g_file_new_for_path(srcpath);
       GFile *dst = g_file_new_for_path(dstpath);
       GError *gerror = NULL;
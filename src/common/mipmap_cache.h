@@ -85,6 +85,8 @@ typedef struct dt_mipmap_cache_one_t
   long int stats_standin;    // texture used as stand-in
 } dt_mipmap_cache_one_t;
 
+struct dt_mipmap_pack_t;
+
 typedef struct dt_mipmap_cache_t
 {
   // real width and height are stored per element
@@ -99,6 +101,8 @@ typedef struct dt_mipmap_cache_t
   dt_mipmap_cache_one_t mip_f;
   dt_mipmap_cache_one_t mip_full;
   char cachedir[PATH_MAX]; // cached sha1sum filename for faster access
+  // on-disk thumbnails, one pack file per mip level
+  struct dt_mipmap_pack_t *pack[DT_MIPMAP_F];
 } dt_mipmap_cache_t;
 
 // dynamic memory allocation interface for imageio backend: a write locked
@@ -157,11 +161,18 @@ dt_mipmap_size_t dt_mipmap_cache_get_matching_size(
     const int32_t width,
     const int32_t height);
 
+// tags the loads dt_mipmap_cache_get() schedules for best effort requests on this thread with owner,
+// until called again with NULL. see dt_image_load_job_set_owner().
+void dt_mipmap_cache_set_load_owner(const void *owner);
+
 // returns the colorspace to use for created thumbnails, takes config into account
 dt_colorspaces_color_profile_type_t dt_mipmap_cache_get_colorspace();
 
+// whether the disk cache holds a thumbnail of the image at the given size
+gboolean dt_mipmap_cache_is_on_disk(const dt_mipmap_cache_t *cache, const uint32_t imgid, const dt_mipmap_size_t mip);
+
 // copy over thumbnails. used by file operation that copies raw files, to speed up thumbnail generation.
-// only copies over the jpg backend on disk, doesn't directly affect the in-memory cache.
+// only copies over the thumbnails on disk, doesn't directly affect the in-memory cache.
 void dt_mipmap_cache_copy_thumbnails(const dt_mipmap_cache_t *cache, const uint32_t dst_imgid, const uint32_t src_imgid);
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -0,0 +1,493 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mipmap_pack.h"
+#include "common/darktable.h"
+#include "common/dtpthread.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DT_MIPMAP_PACK_MAGIC 0x6b63706du        // "mpck"
+#define DT_MIPMAP_PACK_INDEX_MAGIC 0x78646970u  // "pidx"
+#define DT_MIPMAP_PACK_RECORD_MAGIC 0x6268746du // "mthb"
+#define DT_MIPMAP_PACK_VERSION 1
+// records start at multiples of this, so the index can store 32-bit slots
+#define DT_MIPMAP_PACK_ALIGN 16
+
+typedef struct dt_mipmap_pack_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation; // changes whenever the file is rewritten, ties the saved index to it
+} dt_mipmap_pack_header_t;
+
+typedef struct dt_mipmap_pack_record_t
+{
+  uint32_t magic;
+  uint32_t imgid;
+  uint32_t length; // of the payload following the record, 0 marks a removed thumbnail
+  uint32_t width, height;
+  int32_t color_space;
+  uint32_t checksum; // of the payload, catches records torn by a crash
+  uint32_t reserved;
+} dt_mipmap_pack_record_t;
+
+typedef struct dt_mipmap_pack_index_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t generation;
+  uint64_t length; // bytes of the pack covered by the index
+  uint64_t dead;   // replaced or removed records in that range
+  uint64_t count;  // number of (imgid, slot) pairs following
+} dt_mipmap_pack_index_header_t;
+
+struct dt_mipmap_pack_t
+{
+  dt_pthread_mutex_t lock;
+  gchar *filename;
+  FILE *f;           // append handle, opened on the first write
+  gboolean broken;   // a write failed, don't append anything in this session
+  uint64_t generation;
+  uint64_t length;   // end of the last valid record, 0 if there is no file yet
+  uint64_t dead;     // number of replaced or removed records
+  GHashTable *index; // imgid -> record offset / DT_MIPMAP_PACK_ALIGN
+  GMappedFile *map;
+  uint64_t map_length;
+};
+
+static inline uint64_t _record_size(const uint32_t length)
+{
+  const uint64_t size = sizeof(dt_mipmap_pack_record_t) + (uint64_t)length;
+  return (size + DT_MIPMAP_PACK_ALIGN - 1) & ~(uint64_t)(DT_MIPMAP_PACK_ALIGN - 1);
+}
+
+static uint32_t _checksum(const uint8_t *data, const size_t length)
+{
+  // fnv-1a, we only need to notice torn writes
+  uint32_t h = 2166136261u;
+  for(size_t k = 0; k < length; k++) h = (h ^ data[k]) * 16777619u;
+  return h;
+}
+
+static inline uint64_t _new_generation()
+{
+  return ((uint64_t)g_random_int() << 32) | g_random_int();
+}
+
+static inline gchar *_index_filename(const dt_mipmap_pack_t *pack)
+{
+  return g_strconcat(pack->filename, ".idx", NULL);
+}
+
+// make sure the mapping covers the first needed bytes of the file. readers
+// hold their own reference, so an old mapping stays valid for them.
+static gboolean _pack_map(dt_mipmap_pack_t *pack, const uint64_t needed)
+{
+  if(pack->map && pack->map_length >= needed) return TRUE;
+  if(pack->map) g_mapped_file_unref(pack->map);
+  pack->map = g_mapped_file_new(pack->filename, FALSE, NULL);
+  pack->map_length = pack->map ? g_mapped_file_get_length(pack->map) : 0;
+  return pack->map_length >= needed;
+}
+
+static const dt_mipmap_pack_record_t *_pack_record(dt_mipmap_pack_t *pack, const uint64_t offset)
+{
+  if(!_pack_map(pack, offset + sizeof(dt_mipmap_pack_record_t))) return NULL;
+  const dt_mipmap_pack_record_t *rec
+      = (const dt_mipmap_pack_record_t *)(g_mapped_file_get_contents(pack->map) + offset);
+  if(rec->magic != DT_MIPMAP_PACK_RECORD_MAGIC) return NULL;
+  if(!_pack_map(pack, offset + _record_size(rec->length))) return NULL;
+  // the mapping might have been replaced
+  return (const dt_mipmap_pack_record_t *)(g_mapped_file_get_contents(pack->map) + offset);
+}
+
+static void _index_set(dt_mipmap_pack_t *pack, const uint32_t imgid, const uint64_t offset)
+{
+  gpointer key = GUINT_TO_POINTER(imgid);
+  if(g_hash_table_contains(pack->index, key)) pack->dead++;
+  if(offset)
+    g_hash_table_insert(pack->index, key, GUINT_TO_POINTER((guint)(offset / DT_MIPMAP_PACK_ALIGN)));
+  else
+    g_hash_table_remove(pack->index, key);
+}
+
+// add the records from offset on to the index. returns the end of the last valid one.
+static uint64_t _pack_scan(dt_mipmap_pack_t *pack, uint64_t offset)
+{
+  const uint8_t *base = (const uint8_t *)g_mapped_file_get_contents(pack->map);
+  while(offset + sizeof(dt_mipmap_pack_record_t) <= pack->map_length)
+  {
+    const dt_mipmap_pack_record_t *rec = (const dt_mipmap_pack_record_t *)(base + offset);
+    if(rec->magic != DT_MIPMAP_PACK_RECORD_MAGIC || offset + _record_size(rec->length) > pack->map_length
+       || _checksum((const uint8_t *)(rec + 1), rec->length) != rec->checksum)
+      break;
+    _index_set(pack, rec->imgid, rec->length ? offset : 0);
+    if(!rec->length) pack->dead++;
+    offset += _record_size(rec->length);
+  }
+  return offset;
+}
+
+static void _pack_load(dt_mipmap_pack_t *pack)
+{
+  if(!_pack_map(pack, sizeof(dt_mipmap_pack_header_t))) return; // nothing written yet
+
+  const dt_mipmap_pack_header_t *header = (const dt_mipmap_pack_header_t *)g_mapped_file_get_contents(pack->map);
+  if(header->magic != DT_MIPMAP_PACK_MAGIC || header->version != DT_MIPMAP_PACK_VERSION)
+  {
+    fprintf(stderr, "[mipmap_pack] dropping `%s' of unknown format\n", pack->filename);
+    g_mapped_file_unref(pack->map);
+    pack->map = NULL;
+    pack->map_length = 0;
+    g_unlink(pack->filename);
+    return;
+  }
+  pack->generation = header->generation;
+  uint64_t offset = sizeof(dt_mipmap_pack_header_t);
+
+  gchar *idxname = _index_filename(pack);
+  gchar *contents = NULL;
+  gsize length = 0;
+  if(g_file_get_contents(idxname, &contents, &length, NULL) && length >= sizeof(dt_mipmap_pack_index_header_t))
+  {
+    const dt_mipmap_pack_index_header_t *idx = (const dt_mipmap_pack_index_header_t *)contents;
+    const uint32_t *entry = (const uint32_t *)(idx + 1);
+    if(idx->magic == DT_MIPMAP_PACK_INDEX_MAGIC && idx->version == DT_MIPMAP_PACK_VERSION
+       && idx->generation == pack->generation && idx->length >= offset && idx->length <= pack->map_length
+       && length == sizeof(*idx) + idx->count * 2 * sizeof(uint32_t))
+    {
+      for(uint64_t k = 0; k < idx->count; k++)
+        g_hash_table_insert(pack->index, GUINT_TO_POINTER(entry[2 * k]), GUINT_TO_POINTER(entry[2 * k + 1]));
+      pack->dead = idx->dead;
+      offset = idx->length;
+    }
+  }
+  g_free(contents);
+  g_free(idxname);
+
+  // records appended after the index has been saved, or all of them without one
+  pack->length = _pack_scan(pack, offset);
+}
+
+static void _pack_save_index(dt_mipmap_pack_t *pack)
+{
+  const guint count = g_hash_table_size(pack->index);
+  const size_t size = sizeof(dt_mipmap_pack_index_header_t) + (size_t)count * 2 * sizeof(uint32_t);
+  dt_mipmap_pack_index_header_t *idx = g_malloc(size);
+  idx->magic = DT_MIPMAP_PACK_INDEX_MAGIC;
+  idx->version = DT_MIPMAP_PACK_VERSION;
+  idx->generation = pack->generation;
+  idx->length = pack->length;
+  idx->dead = pack->dead;
+  idx->count = count;
+
+  uint32_t *entry = (uint32_t *)(idx + 1);
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, pack->index);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    *entry++ = GPOINTER_TO_UINT(key);
+    *entry++ = GPOINTER_TO_UINT(value);
+  }
+
+  gchar *idxname = _index_filename(pack);
+  if(!g_file_set_contents(idxname, (const gchar *)idx, size, NULL))
+    fprintf(stderr, "[mipmap_pack] could not write `%s'\n", idxname);
+  g_free(idxname);
+  g_free(idx);
+}
+
+static gint _slot_cmp(gconstpointer a, gconstpointer b)
+{
+  const guint sa = *(const guint *)a, sb = *(const guint *)b;
+  return (sa > sb) - (sa < sb);
+}
+
+// rewrite the pack with only the current thumbnails, keeping their order
+static gboolean _pack_compact(dt_mipmap_pack_t *pack)
+{
+  if(!_pack_map(pack, pack->length)) return FALSE;
+
+  gchar *tmpname = g_strconcat(pack->filename, ".tmp", NULL);
+  FILE *f = g_fopen(tmpname, "wb");
+  if(!f)
+  {
+    g_free(tmpname);
+    return FALSE;
+  }
+
+  GArray *slots = g_array_sized_new(FALSE, FALSE, sizeof(guint), g_hash_table_size(pack->index));
+  GHashTableIter iter;
+  gpointer key, value;
+  g_hash_table_iter_init(&iter, pack->index);
+  while(g_hash_table_iter_next(&iter, &key, &value))
+  {
+    const guint slot = GPOINTER_TO_UINT(value);
+    g_array_append_val(slots, slot);
+  }
+  g_array_sort(slots, _slot_cmp);
+
+  GHashTable *index = g_hash_table_new(NULL, NULL);
+  const dt_mipmap_pack_header_t header = { DT_MIPMAP_PACK_MAGIC, DT_MIPMAP_PACK_VERSION, _new_generation() };
+  gboolean ok = fwrite(&header, sizeof(header), 1, f) == 1;
+  uint64_t length = sizeof(header);
+  const uint8_t *base = (const uint8_t *)g_mapped_file_get_contents(pack->map);
+  for(guint k = 0; ok && k < slots->len; k++)
+  {
+    const uint64_t offset = (uint64_t)g_array_index(slots, guint, k) * DT_MIPMAP_PACK_ALIGN;
+    const dt_mipmap_pack_record_t *rec = (const dt_mipmap_pack_record_t *)(base + offset);
+    if(offset + sizeof(*rec) > pack->length || rec->magic != DT_MIPMAP_PACK_RECORD_MAGIC
+       || offset + _record_size(rec->length) > pack->length)
+      continue;
+    const uint64_t size = _record_size(rec->length);
+    ok = fwrite(rec, size, 1, f) == 1;
+    g_hash_table_insert(index, GUINT_TO_POINTER(rec->imgid), GUINT_TO_POINTER((guint)(length / DT_MIPMAP_PACK_ALIGN)));
+    length += size;
+  }
+  ok = (fclose(f) == 0) && ok;
+  g_array_free(slots, TRUE);
+
+  if(ok)
+  {
+    g_mapped_file_unref(pack->map);
+    pack->map = NULL;
+    pack->map_length = 0;
+    if(pack->f) fclose(pack->f);
+    pack->f = NULL;
+    ok = !g_rename(tmpname, pack->filename);
+  }
+
+  if(ok)
+  {
+    g_hash_table_destroy(pack->index);
+    pack->index = index;
+    pack->generation = header.generation;
+    pack->length = length;
+    pack->dead = 0;
+  }
+  else
+  {
+    fprintf(stderr, "[mipmap_pack] could not rewrite `%s'\n", pack->filename);
+    g_unlink(tmpname);
+    g_hash_table_destroy(index);
+  }
+  g_free(tmpname);
+  return ok;
+}
+
+static void _pack_write_failed(dt_mipmap_pack_t *pack)
+{
+  fprintf(stderr, "[mipmap_pack] could not write to `%s', not storing any more thumbnails in it\n",
+          pack->filename);
+  if(pack->f) fclose(pack->f);
+  pack->f = NULL;
+  pack->broken = TRUE;
+}
+
+static gboolean _pack_open_append(dt_mipmap_pack_t *pack)
+{
+  if(pack->f) return TRUE;
+  if(pack->broken) return FALSE;
+
+  if(!pack->length)
+  {
+    gchar *dirname = g_path_get_dirname(pack->filename);
+    g_mkdir_with_parents(dirname, 0750);
+    g_free(dirname);
+
+    const dt_mipmap_pack_header_t header = { DT_MIPMAP_PACK_MAGIC, DT_MIPMAP_PACK_VERSION, _new_generation() };
+    pack->f = g_fopen(pack->filename, "wb");
+    if(!pack->f || fwrite(&header, sizeof(header), 1, pack->f) != 1 || fflush(pack->f))
+    {
+      _pack_write_failed(pack);
+      return FALSE;
+    }
+    if(pack->map) g_mapped_file_unref(pack->map);
+    pack->map = NULL;
+    pack->map_length = 0;
+    g_hash_table_remove_all(pack->index);
+    pack->generation = header.generation;
+    pack->length = sizeof(header);
+    pack->dead = 0;
+    return TRUE;
+  }
+
+  // the file ends right after the last valid record, see dt_mipmap_pack_open()
+  pack->f = g_fopen(pack->filename, "ab");
+  if(!pack->f)
+  {
+    _pack_write_failed(pack);
+    return FALSE;
+  }
+  return TRUE;
+}
+
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *filename)
+{
+  dt_mipmap_pack_t *pack = (dt_mipmap_pack_t *)g_malloc0(sizeof(dt_mipmap_pack_t));
+  dt_pthread_mutex_init(&pack->lock, NULL);
+  pack->filename = g_strdup(filename);
+  pack->index = g_hash_table_new(NULL, NULL);
+
+  _pack_load(pack);
+
+  // a crash left a torn record at the end. we can't append behind it, as
+  // everything after it would be lost on the next start.
+  if(pack->length && pack->length < pack->map_length && !_pack_compact(pack))
+    pack->broken = TRUE;
+
+  dt_print(DT_DEBUG_CACHE, "[mipmap_pack] `%s' holds %u thumbnails\n", filename,
+           g_hash_table_size(pack->index));
+  return pack;
+}
+
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack)
+{
+  if(!pack) return;
+  if(pack->f) fclose(pack->f);
+  pack->f = NULL;
+
+  if(pack->length)
+  {
+    if(pack->dead > 1024 && pack->dead > g_hash_table_size(pack->index)) _pack_compact(pack);
+    _pack_save_index(pack);
+  }
+
+  if(pack->map) g_mapped_file_unref(pack->map);
+  g_hash_table_destroy(pack->index);
+  dt_pthread_mutex_destroy(&pack->lock);
+  g_free(pack->filename);
+  g_free(pack);
+}
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const uint32_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  const gboolean found = g_hash_table_contains(pack->index, GUINT_TO_POINTER(imgid));
+  dt_pthread_mutex_unlock(&pack->lock);
+  return found;
+}
+
+gboolean dt_mipmap_pack_get(dt_mipmap_pack_t *pack, const uint32_t imgid, dt_mipmap_pack_blob_t *blob)
+{
+  memset(blob, 0, sizeof(*blob));
+  dt_pthread_mutex_lock(&pack->lock);
+  const guint slot = GPOINTER_TO_UINT(g_hash_table_lookup(pack->index, GUINT_TO_POINTER(imgid)));
+  const dt_mipmap_pack_record_t *rec = slot ? _pack_record(pack, (uint64_t)slot * DT_MIPMAP_PACK_ALIGN) : NULL;
+  if(!rec || rec->imgid != imgid || !rec->length)
+  {
+    // index and file disagree, don't try again
+    if(slot) g_hash_table_remove(pack->index, GUINT_TO_POINTER(imgid));
+    dt_pthread_mutex_unlock(&pack->lock);
+    return FALSE;
+  }
+  blob->data = (const uint8_t *)(rec + 1);
+  blob->length = rec->length;
+  blob->width = rec->width;
+  blob->height = rec->height;
+  blob->color_space = rec->color_space;
+  blob->map = g_mapped_file_ref(pack->map);
+  dt_pthread_mutex_unlock(&pack->lock);
+  return TRUE;
+}
+
+void dt_mipmap_pack_release(dt_mipmap_pack_blob_t *blob)
+{
+  if(blob->map) g_mapped_file_unref(blob->map);
+  memset(blob, 0, sizeof(*blob));
+}
+
+int dt_mipmap_pack_put(dt_mipmap_pack_t *pack, const uint32_t imgid, const uint32_t width, const uint32_t height,
+                       const int32_t color_space, const void *data, const size_t length)
+{
+  if(!length || length > UINT32_MAX - DT_MIPMAP_PACK_ALIGN) return 1;
+
+  static const uint8_t pad[DT_MIPMAP_PACK_ALIGN] = { 0 };
+  const dt_mipmap_pack_record_t rec = { DT_MIPMAP_PACK_RECORD_MAGIC, imgid, (uint32_t)length, width, height,
+                                        color_space, _checksum(data, length), 0 };
+  const uint64_t size = _record_size(rec.length);
+  const size_t padding = size - sizeof(rec) - length;
+
+  int err = 1;
+  dt_pthread_mutex_lock(&pack->lock);
+  // slots are 32 bits wide
+  if(_pack_open_append(pack) && (pack->length + size) / DT_MIPMAP_PACK_ALIGN <= UINT32_MAX)
+  {
+    if(fwrite(&rec, sizeof(rec), 1, pack->f) == 1 && fwrite(data, length, 1, pack->f) == 1
+       && (!padding || fwrite(pad, padding, 1, pack->f) == 1) && !fflush(pack->f))
+    {
+      _index_set(pack, imgid, pack->length);
+      pack->length += size;
+      err = 0;
+    }
+    else
+      _pack_write_failed(pack);
+  }
+  dt_pthread_mutex_unlock(&pack->lock);
+  return err;
+}
+
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const uint32_t imgid)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  if(g_hash_table_contains(pack->index, GUINT_TO_POINTER(imgid)))
+  {
+    // append a tombstone, so the thumbnail stays removed after a restart
+    const dt_mipmap_pack_record_t rec = { DT_MIPMAP_PACK_RECORD_MAGIC, imgid, 0, 0, 0, 0, _checksum(NULL, 0), 0 };
+    if(_pack_open_append(pack))
+    {
+      if(fwrite(&rec, sizeof(rec), 1, pack->f) == 1 && !fflush(pack->f))
+      {
+        pack->length += sizeof(rec);
+        pack->dead++;
+      }
+      else
+        _pack_write_failed(pack);
+    }
+    // at least forget about it for this session
+    _index_set(pack, imgid, 0);
+  }
+  dt_pthread_mutex_unlock(&pack->lock);
+}
+
+GList *dt_mipmap_pack_get_imgids(dt_mipmap_pack_t *pack)
+{
+  dt_pthread_mutex_lock(&pack->lock);
+  GList *imgids = g_hash_table_get_keys(pack->index);
+  dt_pthread_mutex_unlock(&pack->lock);
+  return imgids;
+}
+
+int dt_mipmap_pack_copy(dt_mipmap_pack_t *pack, const uint32_t dst_imgid, const uint32_t src_imgid)
+{
+  dt_mipmap_pack_blob_t blob;
+  if(!dt_mipmap_pack_get(pack, src_imgid, &blob)) return 1;
+  const int err
+      = dt_mipmap_pack_put(pack, dst_imgid, blob.width, blob.height, blob.color_space, blob.data, blob.length);
+  dt_mipmap_pack_release(&blob);
+  return err;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,65 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+// a pack keeps the on-disk thumbnails of one mip level in a single file.
+// records are only ever appended to it, reads are served from a mapping of
+// the file and the index by image id lives in memory. the index is saved
+// next to the pack on close so that opening a large pack doesn't have to
+// touch every record.
+typedef struct dt_mipmap_pack_t dt_mipmap_pack_t;
+
+// a thumbnail found in a pack. data points into the mapping of the pack
+// and stays valid until dt_mipmap_pack_release() is called.
+typedef struct dt_mipmap_pack_blob_t
+{
+  const uint8_t *data;
+  size_t length;
+  uint32_t width, height;
+  int32_t color_space;
+  GMappedFile *map;
+} dt_mipmap_pack_blob_t;
+
+// open the pack in filename. the file and its directory are only created
+// once the first thumbnail is written.
+dt_mipmap_pack_t *dt_mipmap_pack_open(const char *filename);
+// save the index and close the pack. rewrites the file first if most of it is
+// taken by replaced or removed thumbnails.
+void dt_mipmap_pack_close(dt_mipmap_pack_t *pack);
+
+gboolean dt_mipmap_pack_contains(dt_mipmap_pack_t *pack, const uint32_t imgid);
+// returns TRUE and fills blob if the pack holds a thumbnail for imgid.
+gboolean dt_mipmap_pack_get(dt_mipmap_pack_t *pack, const uint32_t imgid, dt_mipmap_pack_blob_t *blob);
+void dt_mipmap_pack_release(dt_mipmap_pack_blob_t *blob);
+// append a thumbnail, replacing an older one of the same image. returns non zero on error.
+int dt_mipmap_pack_put(dt_mipmap_pack_t *pack, const uint32_t imgid, const uint32_t width, const uint32_t height,
+                       const int32_t color_space, const void *data, const size_t length);
+void dt_mipmap_pack_remove(dt_mipmap_pack_t *pack, const uint32_t imgid);
+// the ids of all images the pack holds a thumbnail for, free with g_list_free().
+GList *dt_mipmap_pack_get_imgids(dt_mipmap_pack_t *pack);
+// store the thumbnail of src_imgid for dst_imgid as well. returns non zero if there is none.
+int dt_mipmap_pack_copy(dt_mipmap_pack_t *pack, const uint32_t dst_imgid, const uint32_t src_imgid);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -273,7 +273,7 @@ static void init_column_sums(float *const col_sums, const patch_t *const patch,
   return;
 }
 
-#if defined(__SSE2__)
+#if defined(__SSE2__) && !defined(DT_CODEPATH_CLONE)
 static void init_column_sums_sse2(float *const col_sums, const patch_t *const patch, const float *const in,
                                   const int row, const int chunk_left, const int chunk_right,
                                   const int height, const int width, const int stride,
@@ -377,9 +377,9 @@ static int compute_slice_width(const int width)
   return sl_width;
 }
 
-void nlmeans_denoise(const float *const inbuf, float *const outbuf,
-                     const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
-                     const dt_nlmeans_param_t *const params)
+void DT_CODEPATH_NAME(nlmeans_denoise)(const float *const inbuf, float *const outbuf,
+                                       const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                                       const dt_nlmeans_param_t *const params)
 {
   // define the factors for applying blending between the original image and the denoised version
   // if running in RGB space, 'luma' should equal 'chroma'
@@ -602,7 +602,7 @@ void nlmeans_denoise(const float *const inbuf, float *const outbuf,
   return;
 }
 
-#if defined(__SSE2__)
+#if defined(__SSE2__) && !defined(DT_CODEPATH_CLONE)
 void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
                           const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                           const dt_nlmeans_param_t *const params)
@@ -822,6 +822,9 @@ void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
 }
 #endif /* __SSE2__ */
 
+// the OpenCL code is not built for the wider codepaths
+#ifndef DT_CODEPATH_CLONE
+
 /**************************************************************/
 /**************************************************************/
 /*      Everything from here to end of file is WIP!!          */
@@ -1101,3 +1104,5 @@ error:
   return err;
 }
 #endif /* HAVE_OPENCL */
+
+#endif /* DT_CODEPATH_CLONE */
@@ -17,6 +17,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include "common/darktable.h"
 #include "iop/iop_api.h"
 
 struct dt_nlmeans_param_t
@@ -40,9 +41,9 @@ struct dt_nlmeans_param_t
 };
 typedef struct dt_nlmeans_param_t dt_nlmeans_param_t;
 
-void nlmeans_denoise(const float *const inbuf, float *const outbuf,
-                     const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
-                     const dt_nlmeans_param_t *const params);
+DT_CODEPATH_DECLARE(void, nlmeans_denoise,
+                    (const float *const inbuf, float *const outbuf, const dt_iop_roi_t *const roi_in,
+                     const dt_iop_roi_t *const roi_out, const dt_nlmeans_param_t *const params));
 
 void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
                           const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
@@ -159,18 +159,17 @@ gboolean dt_tag_new(const char *name, guint *tagid)
 
   if(!name || name[0] == '\0') return FALSE; // no tagid name.
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT id FROM data.tags WHERE name = ?1", -1, &stmt,
-                              NULL);
+  stmt = dt_database_get_statement(darktable.db, "SELECT id FROM data.tags WHERE name = ?1");
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, name, -1, SQLITE_TRANSIENT);
   rt = sqlite3_step(stmt);
   if(rt == SQLITE_ROW)
   {
     // tagid already exists.
     if(tagid != NULL) *tagid = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
+    dt_database_release_statement(darktable.db, stmt);
     return TRUE;
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   if(g_strstr_len(name, -1, "darktable|") == name)
   {
@@ -178,20 +177,18 @@ gboolean dt_tag_new(const char *name, guint *tagid)
     DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM memory.darktable_tags", NULL, NULL, NULL);
   }
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "INSERT INTO data.tags (id, name) VALUES (NULL, ?1)",
-                              -1, &stmt, NULL);
+  stmt = dt_database_get_statement(darktable.db, "INSERT INTO data.tags (id, name) VALUES (NULL, ?1)");
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, name, -1, SQLITE_TRANSIENT);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   if(tagid != NULL)
   {
     *tagid = 0;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT id FROM data.tags WHERE name = ?1", -1,
-                                &stmt, NULL);
+    stmt = dt_database_get_statement(darktable.db, "SELECT id FROM data.tags WHERE name = ?1");
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, name, -1, SQLITE_TRANSIENT);
     if(sqlite3_step(stmt) == SQLITE_ROW) *tagid = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    dt_database_release_statement(darktable.db, stmt);
   }
 
   return TRUE;
@@ -291,13 +288,11 @@ gchar *dt_tag_get_name(const guint tagid)
 {
   int rt;
   char *name = NULL;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT name FROM data.tags WHERE id= ?1", -1, &stmt,
-                              NULL);
+  sqlite3_stmt *stmt = dt_database_get_statement(darktable.db, "SELECT name FROM data.tags WHERE id= ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, tagid);
   rt = sqlite3_step(stmt);
   if(rt == SQLITE_ROW) name = g_strdup((const char *)sqlite3_column_text(stmt, 0));
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   return name;
 }
@@ -321,21 +316,19 @@ void dt_tag_rename(const guint tagid, const gchar *new_tagname)
 gboolean dt_tag_exists(const char *name, guint *tagid)
 {
   int rt;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT id FROM data.tags WHERE name = ?1", -1, &stmt,
-                              NULL);
+  sqlite3_stmt *stmt = dt_database_get_statement(darktable.db, "SELECT id FROM data.tags WHERE name = ?1");
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, name, -1, SQLITE_TRANSIENT);
   rt = sqlite3_step(stmt);
 
   if(rt == SQLITE_ROW)
   {
     if(tagid != NULL) *tagid = sqlite3_column_int64(stmt, 0);
-    sqlite3_finalize(stmt);
+    dt_database_release_statement(darktable.db, stmt);
     return TRUE;
   }
 
   if(tagid != NULL) *tagid = -1;
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
   return FALSE;
 }
 
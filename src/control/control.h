@@ -211,8 +211,15 @@ typedef struct dt_control_t
   pthread_t *thread, kick_on_workers_thread, update_gphoto_thread;
   dt_job_t **job;
 
-  GList *queues[DT_JOB_QUEUE_MAX];
-  size_t queue_length[DT_JOB_QUEUE_MAX];
+  GQueue queues[DT_JOB_QUEUE_MAX];
+  GPtrArray *deadlines[DT_JOB_QUEUE_MAX]; // per queue min heap of the queued jobs with a deadline
+
+  // per queue statistics, printed with -d perf
+  struct
+  {
+    size_t run, discarded, missed_deadlines, max_length;
+    double wait, max_wait;
+  } queue_stats[DT_JOB_QUEUE_MAX];
 
   dt_pthread_mutex_t res_mutex;
   dt_job_t *job_res[DT_CTL_WORKER_RESERVED];
@@ -46,6 +46,10 @@ typedef struct _dt_job_t
   dt_job_state_t state;
   unsigned char priority;
   dt_job_queue_t queue;
+  double queued;   // when the job was added to its queue
+  double deadline; // when the job should start, 0 if there's no hurry
+  GList *link;     // our node in control->queues[queue], so it can be unlinked without a search
+  gint heap_pos;   // our index in control->deadlines[queue], -1 if we're not in there
 
   dt_job_state_change_callback state_changed_cb;
 
@@ -129,6 +133,7 @@ dt_job_t *dt_control_job_create(dt_job_execute_callback execute, const char *msg
 
   job->execute = execute;
   job->state = DT_JOB_STATE_INITIALIZED;
+  job->heap_pos = -1;
 
   dt_pthread_mutex_init(&job->state_mutex, NULL);
   dt_pthread_mutex_init(&job->wait_mutex, NULL);
@@ -167,6 +172,25 @@ void dt_control_job_cancel(_dt_job_t *job)
   dt_control_job_set_state(job, DT_JOB_STATE_CANCELLED);
 }
 
+void dt_control_job_set_deadline(_dt_job_t *job, double seconds)
+{
+  // once the job got added to the queue it may not be changed from the outside
+  if(dt_control_job_get_state(job) != DT_JOB_STATE_INITIALIZED) return;
+  job->deadline = dt_get_wtime() + MAX(seconds, 0.0);
+}
+
+double dt_control_job_get_deadline(const _dt_job_t *job)
+{
+  if(!job) return 0.0;
+  return job->deadline;
+}
+
+dt_job_execute_callback dt_control_job_get_execute(const _dt_job_t *job)
+{
+  if(!job) return NULL;
+  return job->execute;
+}
+
 void dt_control_job_wait(_dt_job_t *job)
 {
   if(!job) return;
@@ -186,6 +210,70 @@ void dt_control_job_wait(_dt_job_t *job)
   }
 }
 
+/* the jobs with a deadline are additionally kept in a binary min heap per queue, ordered by deadline and
+ * then by the time they were queued. that way the scheduler only has to look at the heap tops instead of
+ * walking every queue. all of these have to be called with the queue_mutex held. */
+static inline gboolean _deadline_before(const _dt_job_t *a, const _dt_job_t *b)
+{
+  return a->deadline < b->deadline || (a->deadline == b->deadline && a->queued < b->queued);
+}
+
+static inline void _deadline_heap_set(GPtrArray *heap, const guint pos, _dt_job_t *job)
+{
+  g_ptr_array_index(heap, pos) = job;
+  job->heap_pos = pos;
+}
+
+static void _deadline_heap_sift(GPtrArray *heap, guint pos)
+{
+  _dt_job_t *job = (_dt_job_t *)g_ptr_array_index(heap, pos);
+
+  // up
+  while(pos > 0)
+  {
+    const guint parent = (pos - 1) / 2;
+    _dt_job_t *other = (_dt_job_t *)g_ptr_array_index(heap, parent);
+    if(!_deadline_before(job, other)) break;
+    _deadline_heap_set(heap, pos, other);
+    pos = parent;
+  }
+
+  // down
+  for(;;)
+  {
+    guint child = 2 * pos + 1;
+    if(child >= heap->len) break;
+    if(child + 1 < heap->len
+       && _deadline_before(g_ptr_array_index(heap, child + 1), g_ptr_array_index(heap, child)))
+      child++;
+    _dt_job_t *other = (_dt_job_t *)g_ptr_array_index(heap, child);
+    if(!_deadline_before(other, job)) break;
+    _deadline_heap_set(heap, pos, other);
+    pos = child;
+  }
+
+  _deadline_heap_set(heap, pos, job);
+}
+
+static void _deadline_heap_push(GPtrArray *heap, _dt_job_t *job)
+{
+  if(job->deadline <= 0.0) return;
+  g_ptr_array_add(heap, job);
+  _deadline_heap_sift(heap, heap->len - 1);
+}
+
+static void _deadline_heap_remove(GPtrArray *heap, _dt_job_t *job)
+{
+  if(job->heap_pos < 0) return;
+  const guint pos = job->heap_pos;
+  _dt_job_t *last = (_dt_job_t *)g_ptr_array_index(heap, heap->len - 1);
+  g_ptr_array_set_size(heap, heap->len - 1);
+  job->heap_pos = -1;
+  if(last == job) return;
+  _deadline_heap_set(heap, pos, last);
+  _deadline_heap_sift(heap, pos);
+}
+
 static int32_t dt_control_run_job_res(dt_control_t *control, int32_t res)
 {
   if(((unsigned int)res) >= DT_CTL_WORKER_RESERVED) return -1;
@@ -235,26 +323,40 @@ static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
    *   * user background
    *   * system background
    * - the jobs that didn't get picked this round get their priority incremented
+   * jobs with a deadline skip all that, the one which is due first is picked before any other.
    */
 
   dt_pthread_mutex_lock(&control->queue_mutex);
 
-  // find the job
+  // find the job. the earliest deadline is at the top of one of the heaps
   _dt_job_t *job = NULL;
   int winner_queue = DT_JOB_QUEUE_MAX;
-  int max_priority = -1;
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(control->queues[i] == NULL) continue;
+    if(control->deadlines[i]->len == 0) continue;
+    if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
+    _dt_job_t *_job = (_dt_job_t *)g_ptr_array_index(control->deadlines[i], 0);
+    if(!job || _job->deadline < job->deadline)
+    {
+      job = _job;
+      winner_queue = i;
+    }
+  }
+
+  int max_priority = -1;
+  for(int i = 0; i < DT_JOB_QUEUE_MAX && !job; i++)
+  {
+    if(g_queue_is_empty(&control->queues[i])) continue;
     if(control->export_scheduled && i == DT_JOB_QUEUE_USER_EXPORT) continue;
-    _dt_job_t *_job = (_dt_job_t *)control->queues[i]->data;
+    _dt_job_t *_job = (_dt_job_t *)g_queue_peek_head(&control->queues[i]);
     if(_job->priority > max_priority)
     {
       max_priority = _job->priority;
-      job = _job;
       winner_queue = i;
     }
   }
+  if(!job && winner_queue < DT_JOB_QUEUE_MAX)
+    job = (_dt_job_t *)g_queue_peek_head(&control->queues[winner_queue]);
 
   if(!job)
   {
@@ -267,19 +369,26 @@ static _dt_job_t *dt_control_schedule_job(dt_control_t *control)
   // invariant -> job is the one we are looking for
 
   // remove the to be scheduled job from its queue
-  GList **queue = &control->queues[winner_queue];
-  *queue = g_list_delete_link(*queue, *queue);
-  control->queue_length[winner_queue]--;
+  g_queue_delete_link(&control->queues[winner_queue], job->link);
+  job->link = NULL;
+  _deadline_heap_remove(control->deadlines[winner_queue], job);
   if(winner_queue == DT_JOB_QUEUE_USER_EXPORT) control->export_scheduled = TRUE;
 
+  const double now = dt_get_wtime();
+  const double wait = now - job->queued;
+  control->queue_stats[winner_queue].run++;
+  control->queue_stats[winner_queue].wait += wait;
+  control->queue_stats[winner_queue].max_wait = MAX(control->queue_stats[winner_queue].max_wait, wait);
+  if(job->deadline > 0.0 && now > job->deadline) control->queue_stats[winner_queue].missed_deadlines++;
+
   // and place it in scheduled job array (for job deduping)
   control->job[dt_control_get_threadid()] = job;
 
   // increment the priorities of the others
   for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
   {
-    if(i == winner_queue || control->queues[i] == NULL) continue;
-    ((_dt_job_t *)control->queues[i]->data)->priority++;
+    if(i == winner_queue || g_queue_is_empty(&control->queues[i])) continue;
+    ((_dt_job_t *)g_queue_peek_head(&control->queues[i]))->priority++;
   }
 
   dt_pthread_mutex_unlock(&control->queue_mutex);
@@ -387,15 +496,16 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
   }
 
   job->queue = queue_id;
+  job->queued = dt_get_wtime();
 
   _dt_job_t *job_for_disposal = NULL;
 
   dt_pthread_mutex_lock(&control->queue_mutex);
 
-  GList **queue = &control->queues[queue_id];
-  size_t length = control->queue_length[queue_id];
+  GQueue *queue = &control->queues[queue_id];
+  GPtrArray *deadlines = control->deadlines[queue_id];
 
-  dt_print(DT_DEBUG_CONTROL, "[add_job] %zu | ", length);
+  dt_print(DT_DEBUG_CONTROL, "[add_job] %u | ", queue->length);
   dt_control_job_print(job);
   dt_print(DT_DEBUG_CONTROL, "\n");
 
@@ -424,7 +534,7 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
     }
 
     // if the job is already in the queue -> move it to the top
-    for(GList *iter = *queue; iter; iter = g_list_next(iter))
+    for(GList *iter = queue->head; iter; iter = g_list_next(iter))
     {
       _dt_job_t *other_job = (_dt_job_t *)iter->data;
       if(dt_control_job_equal(job, other_job))
@@ -433,8 +543,13 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
         dt_control_job_print(other_job);
         dt_print(DT_DEBUG_CONTROL, "\n");
 
-        *queue = g_list_delete_link(*queue, iter);
-        length--;
+        g_queue_delete_link(queue, iter);
+        other_job->link = NULL;
+        _deadline_heap_remove(deadlines, other_job);
+
+        // the earlier deadline counts
+        if(job->deadline > 0.0 && (other_job->deadline == 0.0 || job->deadline < other_job->deadline))
+          other_job->deadline = job->deadline;
 
         job_for_disposal = job;
 
@@ -444,20 +559,19 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
     }
 
     // now we can add the new job to the list
-    *queue = g_list_prepend(*queue, job);
-    length++;
+    g_queue_push_head(queue, job);
+    job->link = queue->head;
+    _deadline_heap_push(deadlines, job);
 
     // and take care of the maximal queue size
-    if(length > DT_CONTROL_MAX_JOBS)
+    if(queue->length > DT_CONTROL_MAX_JOBS)
     {
-      GList *last = g_list_last(*queue);
-      dt_control_job_set_state((_dt_job_t *)last->data, DT_JOB_STATE_DISCARDED);
-      dt_control_job_dispose((_dt_job_t *)last->data);
-      *queue = g_list_delete_link(*queue, last);
-      length--;
+      _dt_job_t *last = (_dt_job_t *)g_queue_pop_tail(queue);
+      _deadline_heap_remove(deadlines, last);
+      dt_control_job_set_state(last, DT_JOB_STATE_DISCARDED);
+      dt_control_job_dispose(last);
+      control->queue_stats[queue_id].discarded++;
     }
-
-    control->queue_length[queue_id] = length;
   }
   else
   {
@@ -468,9 +582,11 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
       job->priority = 0;
     else
       job->priority = DT_CONTROL_FG_PRIORITY;
-    *queue = g_list_append(*queue, job);
-    control->queue_length[queue_id]++;
+    g_queue_push_tail(queue, job);
+    job->link = queue->tail;
+    _deadline_heap_push(deadlines, job);
   }
+  control->queue_stats[queue_id].max_length = MAX(control->queue_stats[queue_id].max_length, queue->length);
   dt_control_job_set_state(job, DT_JOB_STATE_QUEUED);
   dt_pthread_mutex_unlock(&control->queue_mutex);
 
@@ -486,6 +602,65 @@ int dt_control_add_job(dt_control_t *control, dt_job_queue_t queue_id, _dt_job_t
   return 0;
 }
 
+int dt_control_discard_jobs(dt_control_t *control, dt_job_queue_t queue_id,
+                            gboolean (*stale)(dt_job_t *job, void *data), void *data)
+{
+  if(((unsigned int)queue_id) >= DT_JOB_QUEUE_MAX) return 0;
+
+  GList *discarded = NULL;
+  dt_pthread_mutex_lock(&control->queue_mutex);
+  GQueue *queue = &control->queues[queue_id];
+  GList *iter = queue->head;
+  while(iter)
+  {
+    GList *next = g_list_next(iter);
+    _dt_job_t *job = (_dt_job_t *)iter->data;
+    if(stale(job, data))
+    {
+      g_queue_unlink(queue, iter);
+      discarded = g_list_concat(iter, discarded);
+      job->link = NULL;
+      _deadline_heap_remove(control->deadlines[queue_id], job);
+      control->queue_stats[queue_id].discarded++;
+    }
+    iter = next;
+  }
+  dt_pthread_mutex_unlock(&control->queue_mutex);
+
+  const int count = g_list_length(discarded);
+  for(iter = discarded; iter; iter = g_list_next(iter))
+  {
+    _dt_job_t *job = (_dt_job_t *)iter->data;
+    dt_print(DT_DEBUG_CONTROL, "[discard_jobs] ");
+    dt_control_job_print(job);
+    dt_print(DT_DEBUG_CONTROL, "\n");
+    dt_control_job_set_state(job, DT_JOB_STATE_DISCARDED);
+    dt_control_job_dispose(job);
+  }
+  g_list_free(discarded);
+  return count;
+}
+
+static void dt_control_jobs_print_stats(dt_control_t *control)
+{
+  static const char *queue_names[DT_JOB_QUEUE_MAX]
+      = { "user foreground", "system foreground", "user background", "user export", "system background" };
+
+  dt_pthread_mutex_lock(&control->queue_mutex);
+  for(int i = 0; i < DT_JOB_QUEUE_MAX; i++)
+  {
+    const size_t run = control->queue_stats[i].run;
+    const size_t length = control->queues[i].length;
+    if(!run && !length) continue;
+    dt_print(DT_DEBUG_PERF,
+             "[jobs] %-17s: %3zu queued (max %3zu), %6zu run, wait %.3f avg %.3f max, %zu late, %zu discarded\n",
+             queue_names[i], length, control->queue_stats[i].max_length, run,
+             run ? control->queue_stats[i].wait / run : 0.0, control->queue_stats[i].max_wait,
+             control->queue_stats[i].missed_deadlines, control->queue_stats[i].discarded);
+  }
+  dt_pthread_mutex_unlock(&control->queue_mutex);
+}
+
 static __thread int threadid = -1;
 
 int32_t dt_control_get_threadid()
@@ -535,9 +710,12 @@ static void *dt_control_worker_kicker(void *ptr)
 {
   dt_control_t *control = (dt_control_t *)ptr;
   dt_pthread_setname("kicker");
+  int kicks = 0;
   while(dt_control_running())
   {
     sleep(2);
+    // every 10 seconds
+    if((darktable.unmuted & DT_DEBUG_PERF) && ++kicks % 5 == 0) dt_control_jobs_print_stats(control);
     dt_pthread_mutex_lock(&control->cond_mutex);
     pthread_cond_broadcast(&control->cond);
     dt_pthread_mutex_unlock(&control->cond_mutex);
@@ -608,6 +786,11 @@ void dt_control_jobs_init(dt_control_t *control)
   control->num_threads = CLAMP(dt_conf_get_int("worker_threads"), 1, 8);
   control->thread = (pthread_t *)calloc(control->num_threads, sizeof(pthread_t));
   control->job = (dt_job_t **)calloc(control->num_threads, sizeof(dt_job_t *));
+  for(int k = 0; k < DT_JOB_QUEUE_MAX; k++)
+  {
+    g_queue_init(&control->queues[k]);
+    control->deadlines[k] = g_ptr_array_new();
+  }
   dt_pthread_mutex_lock(&control->run_mutex);
   control->running = 1;
   dt_pthread_mutex_unlock(&control->run_mutex);
@@ -641,8 +824,14 @@ void dt_control_jobs_init(dt_control_t *control)
 
 void dt_control_jobs_cleanup(dt_control_t *control)
 {
+  if(darktable.unmuted & DT_DEBUG_PERF) dt_control_jobs_print_stats(control);
   free(control->job);
   free(control->thread);
+  for(int k = 0; k < DT_JOB_QUEUE_MAX; k++)
+  {
+    g_ptr_array_free(control->deadlines[k], TRUE);
+    control->deadlines[k] = NULL;
+  }
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -64,6 +64,13 @@ void dt_control_job_dispose(dt_job_t *job);
 void dt_control_job_set_state_callback(dt_job_t *job, dt_job_state_change_callback cb);
 /** cancel a job, running or in queue. */
 void dt_control_job_cancel(dt_job_t *job);
+/** ask for the job to be started within the given number of seconds, e.g. because its result is about to be
+  * shown on screen. queued jobs with a deadline are run before all others, the one due first wins. */
+void dt_control_job_set_deadline(dt_job_t *job, double seconds);
+/** the point in time (dt_get_wtime()) the job should start at, 0 if it has no deadline. */
+double dt_control_job_get_deadline(const dt_job_t *job);
+/** the function the job will run. */
+dt_job_execute_callback dt_control_job_get_execute(const dt_job_t *job);
 dt_job_state_t dt_control_job_get_state(dt_job_t *job);
 /** wait for a job to finish execution. */
 void dt_control_job_wait(dt_job_t *job);
@@ -87,6 +94,10 @@ void dt_control_jobs_cleanup(struct dt_control_t *control);
 
 int dt_control_add_job(struct dt_control_t *control, dt_job_queue_t queue_id, dt_job_t *job);
 int32_t dt_control_add_job_res(struct dt_control_t *s, dt_job_t *job, int32_t res);
+/** drop all jobs of a queue which haven't started yet and for which stale() returns TRUE, e.g. thumbnails
+  * which were scrolled out of view. stale() is called with the queue locked. returns the number of jobs dropped. */
+int dt_control_discard_jobs(struct dt_control_t *control, dt_job_queue_t queue_id,
+                            gboolean (*stale)(dt_job_t *job, void *data), void *data);
 
 int32_t dt_control_get_threadid();
 
@@ -16,6 +16,7 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "control/jobs/control_jobs.h"
+#include "common/bilateral.h"
 #include "common/collection.h"
 #include "common/darktable.h"
 #include "common/debug.h"
@@ -1260,6 +1261,148 @@ static int32_t dt_control_refresh_exif_run(dt_job_t *job)
 }
 
 
+// shared between the threads of one export job
+typedef struct dt_control_export_run_t
+{
+  dt_job_t *job;
+  dt_control_export_t *settings;
+  dt_imageio_module_format_t *mformat;
+  dt_imageio_module_storage_t *mstorage;
+  const dt_imageio_module_data_t *fdata; // template for the fdata of additional threads
+  dt_export_metadata_t *metadata;
+  guint tagid, etagid;
+  guint total;
+  int num_threads; // openmp threads for each image
+
+  // everything below is protected by the lock
+  dt_pthread_mutex_t lock;
+  pthread_cond_t cond;
+  GList *next;    // the next image to export
+  guint num;      // images handed out so far
+  guint in_flight;
+  size_t memory, memory_limit; // estimated memory of the images in flight
+  double fraction;
+  gboolean tag_change;
+} dt_control_export_run_t;
+
+// estimated memory needed to process an image, following the host memory
+// requirement of the tiling code for a module working on the full image.
+static size_t _export_memory_estimate(const int32_t imgid)
+{
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'r');
+  if(!image) return 0;
+  const size_t estimate = (size_t)2 * image->width * image->height * 4 * sizeof(float);
+  dt_image_cache_read_release(darktable.image_cache, image);
+  return estimate;
+}
+
+static void _export_image(dt_control_export_run_t *run, dt_imageio_module_data_t *fdata, const int imgid,
+                          const guint num)
+{
+  dt_control_export_t *settings = run->settings;
+  dt_imageio_module_storage_t *mstorage = run->mstorage;
+  gboolean tag_change = FALSE;
+
+  // progress message
+  char message[512] = { 0 };
+  snprintf(message, sizeof(message), _("exporting %d / %d to %s"), num, run->total, mstorage->name(mstorage));
+  // update the message. initialize_store() might have changed the number of images
+  dt_control_job_set_progress_message(run->job, message);
+
+  // remove 'changed' tag from image
+  if(dt_tag_detach(run->tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+  // make sure the 'exported' tag is set on the image
+  if(dt_tag_attach(run->etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
+
+  /* register export timestamp in cache */
+  dt_image_cache_set_export_timestamp(darktable.image_cache, imgid);
+
+  // check if image still exists:
+  const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
+  if(image)
+  {
+    char imgfilename[PATH_MAX] = { 0 };
+    gboolean from_cache = TRUE;
+    dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
+    if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
+    {
+      dt_control_log(_("image `%s' is currently unavailable"), image->filename);
+      fprintf(stderr, "image `%s' is currently unavailable\n", imgfilename);
+      // dt_image_remove(imgid);
+      dt_image_cache_read_release(darktable.image_cache, image);
+    }
+    else
+    {
+      dt_image_cache_read_release(darktable.image_cache, image);
+      if(mstorage->store(mstorage, settings->sdata, imgid, run->mformat, fdata, num, run->total,
+                         settings->high_quality, settings->upscale, settings->export_masks, settings->icc_type,
+                         settings->icc_filename, settings->icc_intent, run->metadata) != 0)
+        dt_control_job_cancel(run->job);
+    }
+  }
+
+  dt_pthread_mutex_lock(&run->lock);
+  run->tag_change |= tag_change;
+  run->fraction += 1.0 / run->total;
+  if(run->fraction > 1.0) run->fraction = 1.0;
+  dt_control_job_set_progress(run->job, run->fraction);
+  dt_pthread_mutex_unlock(&run->lock);
+}
+
+// takes images off the list until it is empty or the job got cancelled. an
+// image only starts once its estimated memory fits next to the images already
+// in flight, but nobody waits while nothing else is being exported.
+static void _export_images(dt_control_export_run_t *run, dt_imageio_module_data_t *fdata)
+{
+  dt_pthread_mutex_lock(&run->lock);
+  while(run->next && dt_control_job_get_state(run->job) != DT_JOB_STATE_CANCELLED)
+  {
+    const int imgid = GPOINTER_TO_INT(run->next->data);
+    const size_t memory = run->memory_limit ? _export_memory_estimate(imgid) : 0;
+    if(run->in_flight && run->memory + memory > run->memory_limit)
+    {
+      dt_pthread_cond_wait(&run->cond, &run->lock);
+      continue;
+    }
+
+    run->next = g_list_next(run->next);
+    const guint num = ++run->num;
+    run->in_flight++;
+    run->memory += memory;
+    dt_pthread_mutex_unlock(&run->lock);
+
+    _export_image(run, fdata, imgid, num);
+
+    dt_pthread_mutex_lock(&run->lock);
+    run->in_flight--;
+    run->memory -= memory;
+    pthread_cond_broadcast(&run->cond);
+  }
+  dt_pthread_mutex_unlock(&run->lock);
+}
+
+static void *_export_thread(void *arg)
+{
+  dt_control_export_run_t *run = (dt_control_export_run_t *)arg;
+  dt_pthread_setname("export");
+#ifdef _OPENMP
+  omp_set_num_threads(run->num_threads);
+#endif
+
+  // every thread needs its own fdata (one jpeg struct per thread etc). the
+  // format settings were synced to the first one, only copy what the job changed.
+  dt_imageio_module_data_t *fdata = run->mformat->get_params(run->mformat);
+  fdata->max_width = run->fdata->max_width;
+  fdata->max_height = run->fdata->max_height;
+  g_strlcpy(fdata->style, run->fdata->style, sizeof(fdata->style));
+  fdata->style_append = run->fdata->style_append;
+
+  _export_images(run, fdata);
+
+  run->mformat->free_params(run->mformat, fdata);
+  return NULL;
+}
+
 static int32_t dt_control_export_job_run(dt_job_t *job)
 {
   dt_control_image_enumerator_t *params = (dt_control_image_enumerator_t *)dt_control_job_get_params(job);
@@ -1306,8 +1449,6 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   const guint total = g_list_length(t);
   dt_control_log(ngettext("exporting %d image..", "exporting %d images..", total), total);
 
-  double fraction = 0;
-
   // set up the fdata struct
   fdata->max_width = (settings->max_width != 0 && w != 0) ? MIN(w, settings->max_width) : MAX(w, settings->max_width);
   fdata->max_height = (settings->max_height != 0 && h != 0) ? MIN(h, settings->max_height) : MAX(h, settings->max_height);
@@ -1328,54 +1469,56 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
     metadata.list = g_list_remove(metadata.list, metadata.list->data);
   }
 
-  while(t && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
-  {
-    const int imgid = GPOINTER_TO_INT(t->data);
-    t = g_list_next(t);
-    const guint num = total - g_list_length(t);
-
-    // progress message
-    char message[512] = { 0 };
-    snprintf(message, sizeof(message), _("exporting %d / %d to %s"), num, total, mstorage->name(mstorage));
-    // update the message. initialize_store() might have changed the number of images
-    dt_control_job_set_progress_message(job, message);
-
-    // remove 'changed' tag from image
-    if(dt_tag_detach(tagid, imgid, FALSE, FALSE)) tag_change = TRUE;
-    // make sure the 'exported' tag is set on the image
-    if(dt_tag_attach(etagid, imgid, FALSE, FALSE)) tag_change = TRUE;
-
-    /* register export timestamp in cache */
-    dt_image_cache_set_export_timestamp(darktable.image_cache, imgid);
-
-    // check if image still exists:
-    const dt_image_t *image = dt_image_cache_get(darktable.image_cache, (int32_t)imgid, 'r');
-    if(image)
-    {
-      char imgfilename[PATH_MAX] = { 0 };
-      gboolean from_cache = TRUE;
-      dt_image_full_path(image->id, imgfilename, sizeof(imgfilename), &from_cache);
-      if(!g_file_test(imgfilename, G_FILE_TEST_IS_REGULAR))
-      {
-        dt_control_log(_("image `%s' is currently unavailable"), image->filename);
-        fprintf(stderr, "image `%s' is currently unavailable\n", imgfilename);
-        // dt_image_remove(imgid);
-        dt_image_cache_read_release(darktable.image_cache, image);
-      }
-      else
-      {
-        dt_image_cache_read_release(darktable.image_cache, image);
-        if(mstorage->store(mstorage, sdata, imgid, mformat, fdata, num, total, settings->high_quality, settings->upscale,
-                           settings->export_masks, settings->icc_type, settings->icc_filename, settings->icc_intent,
-                           &metadata) != 0)
-          dt_control_job_cancel(job);
-      }
-    }
+  // several images are only exported at the same time if the storage can take it.
+  // each of them gets its share of the cores, small exports don't scale well on
+  // all of them.
+  int num_images = 1;
+  if(mstorage->parallel && mstorage->parallel(mstorage))
+    num_images = MIN(MIN(dt_conf_get_int("export_parallel_images"), darktable.num_openmp_threads), (int)total);
+  num_images = MAX(num_images, 1);
+
+  int host_memory_limit = dt_conf_get_int("host_memory_limit");
+  if(host_memory_limit != 0) host_memory_limit = CLAMPI(host_memory_limit, 500, 50000);
+
+  dt_control_export_run_t run = { 0 };
+  run.job = job;
+  run.settings = settings;
+  run.mformat = mformat;
+  run.mstorage = mstorage;
+  run.fdata = fdata;
+  run.metadata = &metadata;
+  run.tagid = tagid;
+  run.etagid = etagid;
+  run.total = total;
+  run.num_threads = MAX(1, darktable.num_openmp_threads / num_images);
+  run.next = t;
+  run.memory_limit = (size_t)host_memory_limit * 1024 * 1024;
+  dt_pthread_mutex_init(&run.lock, NULL);
+  pthread_cond_init(&run.cond, NULL);
+
+  dt_print(DT_DEBUG_PERF, "[export_job] exporting %d images at a time with %d threads each\n", num_images,
+           num_images > 1 ? run.num_threads : darktable.num_openmp_threads);
+
+  pthread_t *threads = g_malloc_n(num_images, sizeof(pthread_t));
+  int started = 0;
+  for(int k = 1; k < num_images; k++)
+    if(!dt_pthread_create(threads + started, _export_thread, &run)) started++;
+
+  // this thread does its share, too
+#ifdef _OPENMP
+  const int max_threads = omp_get_max_threads();
+  if(started) omp_set_num_threads(run.num_threads);
+#endif
+  _export_images(&run, fdata);
+#ifdef _OPENMP
+  omp_set_num_threads(max_threads);
+#endif
+  for(int k = 0; k < started; k++) pthread_join(threads[k], NULL);
+  g_free(threads);
 
-    fraction += 1.0 / total;
-    if(fraction > 1.0) fraction = 1.0;
-    dt_control_job_set_progress(job, fraction);
-  }
+  pthread_cond_destroy(&run.cond);
+  dt_pthread_mutex_destroy(&run.lock);
+  tag_change = run.tag_change;
   g_list_free_full(metadata.list, g_free);
 
   if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
@@ -1383,6 +1526,8 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
 end:
   // all threads free their fdata
   mformat->free_params(mformat, fdata);
+  // don't hold on to the grids of full size exports
+  dt_bilateral_free_pool();
 
   // notify the user via the window manager
   dt_ui_notify_user();
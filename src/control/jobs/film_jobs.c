@@ -17,9 +17,28 @@
 */
 #include "control/jobs/film_jobs.h"
 #include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
 #include "common/film.h"
+#include "common/image.h"
 #include <stdlib.h>
 
+// images whose metadata is read ahead of the one being imported
+#define DT_FILM_IMPORT_PREFETCH 32
+
+/* the metadata of the files is read by another thread, ahead of the job thread that writes the images to the
+ * data base one after the other. exiv2 only reads the metadata of one file at a time (exiv2_threadsafe), more
+ * threads would just wait on each other. the writes are not batched into transactions: the connection is shared
+ * with every other thread, which would end up in the batch or fail to start their own. */
+typedef struct dt_film_import_prefetch_t
+{
+  gchar **files;
+  dt_image_import_prefetch_t **prefetch;
+  gboolean *done;
+  GMutex lock;
+  GCond cond;
+} dt_film_import_prefetch_t;
+
 typedef struct dt_film_import1_t
 {
   dt_film_t *film;
@@ -133,6 +152,28 @@ int _film_filename_cmp(gchar *a, gchar *b)
   return ret;
 }
 
+static void _film_import_prefetch_run(gpointer data, gpointer user_data)
+{
+  dt_film_import_prefetch_t *p = (dt_film_import_prefetch_t *)user_data;
+  const int k = GPOINTER_TO_INT(data) - 1;
+  dt_image_import_prefetch_t *prefetch = dt_image_import_prefetch(p->files[k]);
+  g_mutex_lock(&p->lock);
+  p->prefetch[k] = prefetch;
+  p->done[k] = TRUE;
+  g_cond_broadcast(&p->cond);
+  g_mutex_unlock(&p->lock);
+}
+
+static dt_image_import_prefetch_t *_film_import_prefetch_wait(dt_film_import_prefetch_t *p, const int k)
+{
+  g_mutex_lock(&p->lock);
+  while(!p->done[k]) g_cond_wait(&p->cond, &p->lock);
+  dt_image_import_prefetch_t *prefetch = p->prefetch[k];
+  p->prefetch[k] = NULL;
+  g_mutex_unlock(&p->lock);
+  return prefetch;
+}
+
 static void dt_film_import1(dt_job_t *job, dt_film_t *film)
 {
   gboolean recursive = dt_conf_get_bool("ui_last/import_recursive");
@@ -200,11 +241,30 @@ static void dt_film_import1(dt_job_t *job, dt_film_t *film)
   dt_control_job_set_progress_message(job, message);
 
 
+  /* read the metadata ahead */
+  dt_film_import_prefetch_t p;
+  p.files = g_malloc_n(total, sizeof(gchar *));
+  p.prefetch = g_malloc0_n(total, sizeof(dt_image_import_prefetch_t *));
+  p.done = g_malloc0_n(total, sizeof(gboolean));
+  g_mutex_init(&p.lock);
+  g_cond_init(&p.cond);
+  int k = 0;
+  for(GList *l = images; l; l = g_list_next(l)) p.files[k++] = (gchar *)l->data;
+  GThreadPool *pool = g_thread_pool_new(_film_import_prefetch_run, &p, 1, FALSE, NULL);
+  int queued = 0;
+  const double start = dt_get_wtime();
+  // time the job thread spent waiting for metadata, what is left of it shows how much the read-ahead hides
+  double waited = 0.0;
+
   /* loop thru the images and import to current film roll */
   dt_film_t *cfr = film;
   GList *image = g_list_first(images);
+  int current = 0;
   do
   {
+    for(; queued < MIN(current + DT_FILM_IMPORT_PREFETCH, (int)total); queued++)
+      g_thread_pool_push(pool, GINT_TO_POINTER(queued + 1), NULL);
+
     gchar *cdn = g_path_get_dirname((const gchar *)image->data);
 
     /* check if we need to initialize a new filmroll */
@@ -253,14 +313,28 @@ static void dt_film_import1(dt_job_t *job, dt_film_t *film)
     g_free(cdn);
 
     /* import image */
-    dt_image_import(cfr->id, (const gchar *)image->data, FALSE);
+    const double wait_start = dt_get_wtime();
+    dt_image_import_prefetch_t *prefetch = _film_import_prefetch_wait(&p, current);
+    waited += dt_get_wtime() - wait_start;
+    dt_image_import_prefetched(cfr->id, (const gchar *)image->data, FALSE, prefetch);
+    dt_image_import_prefetch_free(prefetch);
+    current++;
 
     fraction += 1.0 / total;
     dt_control_job_set_progress(job, fraction);
 
-
   } while((image = g_list_next(image)) != NULL);
 
+  g_thread_pool_free(pool, FALSE, TRUE);
+  const double elapsed = dt_get_wtime() - start;
+  dt_print(DT_DEBUG_PERF,
+           "[film_import] %u images imported in %.3f secs (%.1f files/s), %.3f secs waiting for metadata\n", total,
+           elapsed, total / MAX(elapsed, 1e-6), waited);
+  g_mutex_clear(&p.lock);
+  g_cond_clear(&p.cond);
+  g_free(p.files);
+  g_free(p.prefetch);
+  g_free(p.done);
   g_list_free_full(images, g_free);
 
   // only redraw at the end, to not spam the cpu with exposure events
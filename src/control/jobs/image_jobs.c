@@ -24,6 +24,7 @@ typedef struct dt_image_load_t
 {
   int32_t imgid;
   dt_mipmap_size_t mip;
+  const void *owner;
 } dt_image_load_t;
 
 static int32_t dt_image_load_job_run(dt_job_t *job)
@@ -62,6 +63,26 @@ dt_job_t *dt_image_load_job_create(int32_t id, dt_mipmap_size_t mip)
   return job;
 }
 
+int32_t dt_image_load_job_get_imgid(const dt_job_t *job)
+{
+  if(dt_control_job_get_execute(job) != dt_image_load_job_run) return -1;
+  const dt_image_load_t *params = dt_control_job_get_params(job);
+  return params->imgid;
+}
+
+void dt_image_load_job_set_owner(dt_job_t *job, const void *owner)
+{
+  dt_image_load_t *params = dt_control_job_get_params(job);
+  params->owner = owner;
+}
+
+const void *dt_image_load_job_get_owner(const dt_job_t *job)
+{
+  if(dt_control_job_get_execute(job) != dt_image_load_job_run) return NULL;
+  const dt_image_load_t *params = dt_control_job_get_params(job);
+  return params->owner;
+}
+
 typedef struct dt_image_import_t
 {
   uint32_t film_id;
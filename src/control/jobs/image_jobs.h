@@ -24,6 +24,13 @@
 #include <inttypes.h>
 
 dt_job_t *dt_image_load_job_create(int32_t imgid, dt_mipmap_size_t mip);
+/** the image a job created by dt_image_load_job_create() loads, -1 for any other job. */
+int32_t dt_image_load_job_get_imgid(const dt_job_t *job);
+/** tags the job with whoever asked for the image, before it is added. jobs of different owners are
+ * queued separately, so one can drop its own without affecting the others. */
+void dt_image_load_job_set_owner(dt_job_t *job, const void *owner);
+/** the owner of a job created by dt_image_load_job_create(), NULL if it has none or is another job. */
+const void *dt_image_load_job_get_owner(const dt_job_t *job);
 
 dt_job_t *dt_image_import_job_create(uint32_t filmid, const char *filename);
 
@@ -382,20 +382,20 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
     switch(blend_csp)
     {
       case DEVELOP_BLEND_CS_LAB:
-        dt_develop_blendif_lab_make_mask(piece, (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid, roi_in, roi_out, mask);
+        DT_CODEPATH_SELECT(dt_develop_blendif_lab_make_mask)(piece, (const float *const restrict)ivoid,
+            (const float *const restrict)ovoid, roi_in, roi_out, mask);
         break;
       case DEVELOP_BLEND_CS_RGB_DISPLAY:
-        dt_develop_blendif_rgb_hsl_make_mask(piece, (const float *const restrict)ivoid,
-                                             (const float *const restrict)ovoid, roi_in, roi_out, mask);
+        DT_CODEPATH_SELECT(dt_develop_blendif_rgb_hsl_make_mask)(piece, (const float *const restrict)ivoid,
+            (const float *const restrict)ovoid, roi_in, roi_out, mask);
         break;
       case DEVELOP_BLEND_CS_RGB_SCENE:
-        dt_develop_blendif_rgb_jzczhz_make_mask(piece, (const float *const restrict)ivoid,
-                                                (const float *const restrict)ovoid, roi_in, roi_out, mask);
+        DT_CODEPATH_SELECT(dt_develop_blendif_rgb_jzczhz_make_mask)(piece, (const float *const restrict)ivoid,
+            (const float *const restrict)ovoid, roi_in, roi_out, mask);
         break;
       case DEVELOP_BLEND_CS_RAW:
-        dt_develop_blendif_raw_make_mask(piece, (const float *const restrict)ivoid,
-                                         (const float *const restrict)ovoid, roi_in, roi_out, mask);
+        DT_CODEPATH_SELECT(dt_develop_blendif_raw_make_mask)(piece, (const float *const restrict)ivoid,
+            (const float *const restrict)ovoid, roi_in, roi_out, mask);
         break;
       default:
         break;
@@ -497,20 +497,20 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
   switch(blend_csp)
   {
     case DEVELOP_BLEND_CS_LAB:
-      dt_develop_blendif_lab_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
+      DT_CODEPATH_SELECT(dt_develop_blendif_lab_blend)(piece, (const float *const restrict)ivoid,
+          (float *const restrict)ovoid, roi_in, roi_out, mask, request_mask_display);
       break;
     case DEVELOP_BLEND_CS_RGB_DISPLAY:
-      dt_develop_blendif_rgb_hsl_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                       roi_in, roi_out, mask, request_mask_display);
+      DT_CODEPATH_SELECT(dt_develop_blendif_rgb_hsl_blend)(piece, (const float *const restrict)ivoid,
+          (float *const restrict)ovoid, roi_in, roi_out, mask, request_mask_display);
       break;
     case DEVELOP_BLEND_CS_RGB_SCENE:
-      dt_develop_blendif_rgb_jzczhz_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                          roi_in, roi_out, mask, request_mask_display);
+      DT_CODEPATH_SELECT(dt_develop_blendif_rgb_jzczhz_blend)(piece, (const float *const restrict)ivoid,
+          (float *const restrict)ovoid, roi_in, roi_out, mask, request_mask_display);
       break;
     case DEVELOP_BLEND_CS_RAW:
-      dt_develop_blendif_raw_blend(piece, (const float *const restrict)ivoid, (float *const restrict)ovoid,
-                                   roi_in, roi_out, mask, request_mask_display);
+      DT_CODEPATH_SELECT(dt_develop_blendif_raw_blend)(piece, (const float *const restrict)ivoid,
+          (float *const restrict)ovoid, roi_in, roi_out, mask, request_mask_display);
       break;
     default:
       break;
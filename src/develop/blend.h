@@ -596,37 +596,41 @@ int dt_develop_blendif_init_masking_profile(struct dt_dev_pixelpipe_iop_t *piece
 
 /** color blending mask generation functions */
 
-void dt_develop_blendif_raw_make_mask(struct dt_dev_pixelpipe_iop_t *piece, const float *const a,
-                                      const float *const b, const struct dt_iop_roi_t *const roi_in,
-                                      const struct dt_iop_roi_t *const roi_out, float *const mask);
-void dt_develop_blendif_lab_make_mask(struct dt_dev_pixelpipe_iop_t *piece, const float *const a,
-                                      const float *const b, const struct dt_iop_roi_t *const roi_in,
-                                      const struct dt_iop_roi_t *const roi_out, float *const mask);
-void dt_develop_blendif_rgb_hsl_make_mask(struct dt_dev_pixelpipe_iop_t *piece, const float *const a,
-                                          const float *const b, const struct dt_iop_roi_t *const roi_in,
-                                          const struct dt_iop_roi_t *const roi_out, float *const mask);
-void dt_develop_blendif_rgb_jzczhz_make_mask(struct dt_dev_pixelpipe_iop_t *piece, const float *const a,
-                                             const float *const b, const struct dt_iop_roi_t *const roi_in,
-                                             const struct dt_iop_roi_t *const roi_out, float *const mask);
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_raw_make_mask,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, const float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     float *const mask));
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_lab_make_mask,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, const float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     float *const mask));
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_rgb_hsl_make_mask,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, const float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     float *const mask));
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_rgb_jzczhz_make_mask,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, const float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     float *const mask));
 
 /** color blending operators */
 
-void dt_develop_blendif_raw_blend(struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
-                                  const struct dt_iop_roi_t *const roi_in,
-                                  const struct dt_iop_roi_t *const roi_out, const float *const mask,
-                                  const dt_dev_pixelpipe_display_mask_t request_mask_display);
-void dt_develop_blendif_lab_blend(struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
-                                  const struct dt_iop_roi_t *const roi_in,
-                                  const struct dt_iop_roi_t *const roi_out, const float *const mask,
-                                  const dt_dev_pixelpipe_display_mask_t request_mask_display);
-void dt_develop_blendif_rgb_hsl_blend(struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
-                                      const struct dt_iop_roi_t *const roi_in,
-                                      const struct dt_iop_roi_t *const roi_out, const float *const mask,
-                                      const dt_dev_pixelpipe_display_mask_t request_mask_display);
-void dt_develop_blendif_rgb_jzczhz_blend(struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
-                                         const struct dt_iop_roi_t *const roi_in,
-                                         const struct dt_iop_roi_t *const roi_out, const float *const mask,
-                                         const dt_dev_pixelpipe_display_mask_t request_mask_display);
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_raw_blend,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     const float *const mask, const dt_dev_pixelpipe_display_mask_t request_mask_display));
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_lab_blend,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     const float *const mask, const dt_dev_pixelpipe_display_mask_t request_mask_display));
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_rgb_hsl_blend,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     const float *const mask, const dt_dev_pixelpipe_display_mask_t request_mask_display));
+DT_CODEPATH_DECLARE(void, dt_develop_blendif_rgb_jzczhz_blend,
+                    (struct dt_dev_pixelpipe_iop_t *piece, const float *const a, float *const b,
+                     const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out,
+                     const float *const mask, const dt_dev_pixelpipe_display_mask_t request_mask_display));
 
 
 /** gui related stuff */
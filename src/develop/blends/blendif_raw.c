@@ -43,9 +43,12 @@ static inline float clamp_simd(const float x)
   return fminf(fmaxf(x, 0.0f), 1.0f);
 }
 
-void dt_develop_blendif_raw_make_mask(struct dt_dev_pixelpipe_iop_t *piece, const float *const restrict a,
-                                      const float *const restrict b, const struct dt_iop_roi_t *const roi_in,
-                                      const struct dt_iop_roi_t *const roi_out, float *const restrict mask)
+void DT_CODEPATH_NAME(dt_develop_blendif_raw_make_mask)(struct dt_dev_pixelpipe_iop_t *piece,
+                                                        const float *const restrict a,
+                                                        const float *const restrict b,
+                                                        const struct dt_iop_roi_t *const roi_in,
+                                                        const struct dt_iop_roi_t *const roi_out,
+                                                        float *const restrict mask)
 {
   const dt_develop_blend_params_t *const d = (const dt_develop_blend_params_t *const)piece->blendop_data;
 
@@ -419,12 +422,12 @@ static _blend_row_func *_choose_blend_func(const unsigned int blend_mode)
 }
 
 
-void dt_develop_blendif_raw_blend(struct dt_dev_pixelpipe_iop_t *piece,
-                                  const float *const restrict a, float *const restrict b,
-                                  const struct dt_iop_roi_t *const roi_in,
-                                  const struct dt_iop_roi_t *const roi_out,
-                                  const float *const restrict mask,
-                                  const dt_dev_pixelpipe_display_mask_t request_mask_display)
+void DT_CODEPATH_NAME(dt_develop_blendif_raw_blend)(struct dt_dev_pixelpipe_iop_t *piece,
+                                                    const float *const restrict a, float *const restrict b,
+                                                    const struct dt_iop_roi_t *const roi_in,
+                                                    const struct dt_iop_roi_t *const roi_out,
+                                                    const float *const restrict mask,
+                                                    const dt_dev_pixelpipe_display_mask_t request_mask_display)
 {
   const dt_develop_blend_params_t *const d = (const dt_develop_blend_params_t *const)piece->blendop_data;
 
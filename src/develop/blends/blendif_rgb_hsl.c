@@ -243,9 +243,12 @@ static void _blendif_combine_channels(const float *const restrict pixels, float
   }
 }
 
-void dt_develop_blendif_rgb_hsl_make_mask(struct dt_dev_pixelpipe_iop_t *piece, const float *const restrict a,
-                                          const float *const restrict b, const struct dt_iop_roi_t *const roi_in,
-                                          const struct dt_iop_roi_t *const roi_out, float *const restrict mask)
+void DT_CODEPATH_NAME(dt_develop_blendif_rgb_hsl_make_mask)(struct dt_dev_pixelpipe_iop_t *piece,
+                                                            const float *const restrict a,
+                                                            const float *const restrict b,
+                                                            const struct dt_iop_roi_t *const roi_in,
+                                                            const struct dt_iop_roi_t *const roi_out,
+                                                            float *const restrict mask)
 {
   const dt_develop_blend_params_t *const d = (const dt_develop_blend_params_t *const)piece->blendop_data;
 
@@ -1351,12 +1354,12 @@ static inline void _copy_mask(const float *const restrict a, float *const restri
   for(size_t x = DT_BLENDIF_RGB_BCH; x < stride; x += DT_BLENDIF_RGB_CH) b[x] = a[x];
 }
 
-void dt_develop_blendif_rgb_hsl_blend(struct dt_dev_pixelpipe_iop_t *piece,
-                                      const float *const restrict a, float *const restrict b,
-                                      const struct dt_iop_roi_t *const roi_in,
-                                      const struct dt_iop_roi_t *const roi_out,
-                                      const float *const restrict mask,
-                                      const dt_dev_pixelpipe_display_mask_t request_mask_display)
+void DT_CODEPATH_NAME(dt_develop_blendif_rgb_hsl_blend)(struct dt_dev_pixelpipe_iop_t *piece,
+                                                        const float *const restrict a, float *const restrict b,
+                                                        const struct dt_iop_roi_t *const roi_in,
+                                                        const struct dt_iop_roi_t *const roi_out,
+                                                        const float *const restrict mask,
+                                                        const dt_dev_pixelpipe_display_mask_t request_mask_display)
 {
   const dt_develop_blend_params_t *const d = (const dt_develop_blend_params_t *const)piece->blendop_data;
 
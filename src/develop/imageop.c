@@ -178,6 +178,8 @@ static void default_process(struct dt_iop_module_t *self, struct dt_dev_pixelpip
 
   if(darktable.codepath.OPENMP_SIMD && self->process_plain)
     self->process_plain(self, piece, i, o, roi_in, roi_out);
+  else if(darktable.codepath.AVX2 && self->process_avx2)
+    self->process_avx2(self, piece, i, o, roi_in, roi_out);
 #if defined(__SSE__)
   else if(darktable.codepath.SSE2 && self->process_sse2)
     self->process_sse2(self, piece, i, o, roi_in, roi_out);
@@ -391,6 +393,8 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *op)
 
   if(!g_module_symbol(module->module, "process_sse2", (gpointer) & (module->process_sse2)))
     module->process_sse2 = NULL;
+  if(!g_module_symbol(module->module, "process_avx2", (gpointer) & (module->process_avx2)))
+    module->process_avx2 = NULL;
 
   if(!g_module_symbol(module->module, "process", (gpointer) & (module->process_plain))) goto error;
 
@@ -536,6 +540,7 @@ int dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t *so, dt
   module->process_tiling = so->process_tiling;
   module->process_plain = so->process_plain;
   module->process_sse2 = so->process_sse2;
+  module->process_avx2 = so->process_avx2;
   module->process_cl = so->process_cl;
   module->process_tiling_cl = so->process_tiling_cl;
   module->distort_transform = so->distort_transform;
@@ -1950,6 +1955,8 @@ void dt_iop_commit_params(dt_iop_module_t *module, dt_iop_params_t *params,
 
     dt_print(DT_DEBUG_PARAMS, "[params] commit for %s in pipe %i with hash %lu\n", module->op, pipe->type, (long unsigned int)piece->hash);
   }
+  // all hashes from here on down the pipe are outdated
+  dt_dev_pixelpipe_cache_hash_invalidate(pipe, piece);
   // printf("commit params hash += module %s: %lu, enabled = %d\n", piece->module->op, piece->hash,
   // piece->enabled);
 }
@@ -104,7 +104,8 @@ typedef enum dt_iop_flags_t
   IOP_FLAGS_NO_MASKS           = 1 << 10, // The module doesn't support masks (used with SUPPORT_BLENDING)
   IOP_FLAGS_FENCE              = 1 << 11, // No module can be moved pass this one
   IOP_FLAGS_ALLOW_FAST_PIPE    = 1 << 12, // Module can work with a fast pipe
-  IOP_FLAGS_UNSAFE_COPY        = 1 << 13  // Unsafe to copy as part of history
+  IOP_FLAGS_UNSAFE_COPY        = 1 << 13, // Unsafe to copy as part of history
+  IOP_FLAGS_TILING_PARALLEL    = 1 << 14  // Tiles may be processed concurrently in export pipes
 } dt_iop_flags_t;
 
 /** status of a module*/
@@ -272,6 +273,9 @@ typedef struct dt_iop_module_so_t
   void (*process_sse2)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                        const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
                        const struct dt_iop_roi_t *const roi_out);
+  void (*process_avx2)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                       const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
+                       const struct dt_iop_roi_t *const roi_out);
   int (*process_cl)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const void *const i,
                     void *const o, const struct dt_iop_roi_t *const roi_in,
                     const struct dt_iop_roi_t *const roi_out);
@@ -529,6 +533,10 @@ typedef struct dt_iop_module_t
   void (*process_sse2)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                        const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
                        const struct dt_iop_roi_t *const roi_out);
+  /** a variant process(), that runs the AVX2 or AVX-512 builds of its kernels. */
+  void (*process_avx2)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                       const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
+                       const struct dt_iop_roi_t *const roi_out);
   /** the opencl equivalent of process(). */
   int (*process_cl)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const void *const i,
                     void *const o, const struct dt_iop_roi_t *const roi_in,
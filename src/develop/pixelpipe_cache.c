@@ -17,20 +17,129 @@
 */
 
 #include "develop/pixelpipe_cache.h"
+#include "common/colorspaces.h"
+#include "common/mipmap_cache.h"
 #include "develop/format.h"
 #include "develop/pixelpipe_hb.h"
 #include "libs/lib.h"
+#include <glib/gstdio.h>
 #include <stdlib.h>
+#include <zlib.h>
 
 
-// TODO: make cache global (needs to be thread safe then)
-// plan:
-// - look at mipmap_cache.c, for the full buffer allocs
-// - do that, but for `large' and `regular' buffers (full + export/dr mode), so 2 caches
-//   (in fact, maybe 3, one for preview pipes?)
-// - have at most 3 read locks all the time per pipe, get them at create time
-//   ping, pong, and priority buffer (focused plugin)
-// - drop read by the time another is requested (with priority, drop that, or alternating ping and pong?)
+// the per-pipe cache below only holds the working buffers of one pipe. finished outputs are additionally
+// published to the process wide shared cache (see dt_dev_pixelpipe_cache_shared_*() at the end of this
+// file), which is thread safe and guarded by read locks per entry, much like common/cache.c.
+
+// mixes the pipe hashes once more, their low bits alone are not well distributed
+static inline uint32_t _index_slot(const dt_dev_pixelpipe_cache_t *cache, const uint64_t hash)
+{
+  return (uint32_t)((hash * 0x9e3779b97f4a7c15ull) >> 32) & cache->index_mask;
+}
+
+static inline int32_t _index_find(const dt_dev_pixelpipe_cache_t *cache, const uint64_t hash)
+{
+  for(uint32_t i = _index_slot(cache, hash);; i = (i + 1) & cache->index_mask)
+  {
+    const int32_t k = cache->index[i];
+    if(k < 0) return -1;
+    if(cache->hash[k] == hash) return k;
+  }
+}
+
+static inline void _index_insert(dt_dev_pixelpipe_cache_t *cache, const int32_t line)
+{
+  uint32_t i = _index_slot(cache, cache->hash[line]);
+  while(cache->index[i] >= 0) i = (i + 1) & cache->index_mask;
+  cache->index[i] = line;
+}
+
+// remove the line from the index while cache->hash[line] is still valid. uses backward shift deletion,
+// so there are no tombstones and probe sequences stay short.
+static void _index_remove(dt_dev_pixelpipe_cache_t *cache, const int32_t line)
+{
+  if(cache->hash[line] == (uint64_t)-1) return;
+  uint32_t i = _index_slot(cache, cache->hash[line]);
+  while(cache->index[i] != line)
+  {
+    if(cache->index[i] < 0) return; // not indexed
+    i = (i + 1) & cache->index_mask;
+  }
+  uint32_t j = i;
+  while(1)
+  {
+    j = (j + 1) & cache->index_mask;
+    if(cache->index[j] < 0) break;
+    const uint32_t k = _index_slot(cache, cache->hash[cache->index[j]]);
+    // entry at j may stay if its home slot k lies cyclically in (i, j]
+    if((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) continue;
+    cache->index[i] = cache->index[j];
+    i = j;
+  }
+  cache->index[i] = -1;
+}
+
+static inline void _lru_unlink(dt_dev_pixelpipe_cache_t *cache, const int32_t line)
+{
+  const int l = cache->important[line];
+  if(cache->prev[line] >= 0) cache->next[cache->prev[line]] = cache->next[line];
+  else cache->lru_head[l] = cache->next[line];
+  if(cache->next[line] >= 0) cache->prev[cache->next[line]] = cache->prev[line];
+  else cache->lru_tail[l] = cache->prev[line];
+  cache->lru_count[l]--;
+}
+
+// append to the most recently used end of the given list
+static inline void _lru_push_back(dt_dev_pixelpipe_cache_t *cache, const int32_t line, const int l)
+{
+  cache->important[line] = l;
+  cache->prev[line] = cache->lru_tail[l];
+  cache->next[line] = -1;
+  if(cache->lru_tail[l] >= 0) cache->next[cache->lru_tail[l]] = line;
+  else cache->lru_head[l] = line;
+  cache->lru_tail[l] = line;
+  cache->lru_count[l]++;
+}
+
+// prepend to the least recently used end of the regular list, used for lines not worth keeping
+static inline void _lru_push_front(dt_dev_pixelpipe_cache_t *cache, const int32_t line)
+{
+  cache->important[line] = 0;
+  cache->prev[line] = -1;
+  cache->next[line] = cache->lru_head[0];
+  if(cache->lru_head[0] >= 0) cache->prev[cache->lru_head[0]] = line;
+  else cache->lru_tail[0] = line;
+  cache->lru_head[0] = line;
+  cache->lru_count[0]++;
+}
+
+// mark the line as most recently used. important lines go to their own list, which may hold at most
+// half of the lines. if it grows beyond that, its oldest line is demoted to the regular list so it
+// ages out normally.
+static void _lru_touch(dt_dev_pixelpipe_cache_t *cache, const int32_t line, const int important)
+{
+  _lru_unlink(cache, line);
+  _lru_push_back(cache, line, important ? 1 : 0);
+  if(important && cache->lru_count[1] > MAX(1, cache->entries / 2))
+  {
+    const int32_t oldest = cache->lru_head[1];
+    _lru_unlink(cache, oldest);
+    _lru_push_back(cache, oldest, 0);
+  }
+}
+
+static inline int32_t _lru_victim(const dt_dev_pixelpipe_cache_t *cache)
+{
+  return cache->lru_head[0] >= 0 ? cache->lru_head[0] : cache->lru_head[1];
+}
+
+static void _line_invalidate(dt_dev_pixelpipe_cache_t *cache, const int32_t line)
+{
+  _index_remove(cache, line);
+  cache->basichash[line] = -1;
+  cache->hash[line] = -1;
+  ASAN_POISON_MEMORY_REGION(cache->data[line], cache->size[line]);
+}
 
 int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, size_t size)
 {
@@ -43,7 +152,20 @@ int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, si
 #endif
   cache->basichash = (uint64_t *)calloc(entries, sizeof(uint64_t));
   cache->hash = (uint64_t *)calloc(entries, sizeof(uint64_t));
-  cache->used = (int32_t *)calloc(entries, sizeof(int32_t));
+  cache->prev = (int32_t *)calloc(entries, sizeof(int32_t));
+  cache->next = (int32_t *)calloc(entries, sizeof(int32_t));
+  cache->important = (int8_t *)calloc(entries, sizeof(int8_t));
+  // keep the index at most half full
+  uint32_t index_size = 2;
+  while(index_size < 2 * (uint32_t)entries) index_size <<= 1;
+  cache->index = (int32_t *)malloc(sizeof(int32_t) * index_size);
+  cache->index_mask = index_size - 1;
+  for(uint32_t i = 0; i < index_size; i++) cache->index[i] = -1;
+  for(int l = 0; l < 2; l++)
+  {
+    cache->lru_head[l] = cache->lru_tail[l] = -1;
+    cache->lru_count[l] = 0;
+  }
   for(int k = 0; k < entries; k++)
   {
     cache->size[k] = size;
@@ -59,7 +181,7 @@ int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, si
     else cache->data[k] = 0;
     cache->basichash[k] = -1;
     cache->hash[k] = -1;
-    cache->used[k] = 0;
+    _lru_push_back(cache, k, 0);
   }
   cache->queries = cache->misses = 0;
   return 1;
@@ -86,40 +208,125 @@ void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache)
   free(cache->dsc);
   free(cache->basichash);
   free(cache->hash);
-  free(cache->used);
+  free(cache->index);
+  free(cache->prev);
+  free(cache->next);
+  free(cache->important);
   free(cache->size);
 }
 
+// mixes a value into the hash, using the splitmix64 finalizer. unlike the bernstein hash (djb2) this
+// was before, all bits of the input affect all bits of the result.
+static inline uint64_t _hash_mix(const uint64_t hash, const uint64_t value)
+{
+  uint64_t z = hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+static inline uint64_t _hash_mix_floats(uint64_t hash, const float *f, const int n)
+{
+  // two floats at a time instead of byte by byte
+  for(int i = 0; i < n; i += 2)
+  {
+    uint32_t bits[2] = { 0 };
+    memcpy(bits, f + i, sizeof(float) * MIN(2, n - i));
+    hash = _hash_mix(hash, ((uint64_t)bits[1] << 32) | bits[0]);
+  }
+  return hash;
+}
+
+static inline uint64_t _hash_color_picker(uint64_t hash, const dt_iop_module_t *module)
+{
+  if(darktable.lib->proxy.colorpicker.size)
+    return _hash_mix_floats(hash, module->color_picker_box, 4);
+  else
+    return _hash_mix_floats(hash, module->color_picker_point, 2);
+}
+
+// everything which changes the basic hash of all pieces at once. this is cheap, so we check it on each
+// query instead of tracking when it changes.
+static uint64_t _hash_context(const int imgid, const dt_dev_pixelpipe_t *pipe, const dt_develop_t *dev)
+{
+  uint64_t hash = _hash_mix(imgid, pipe->type & DT_DEV_PIXELPIPE_FAST);
+  if(dev && dev->gui_module)
+  {
+    const dt_iop_module_t *gui_module = dev->gui_module;
+    hash = _hash_mix(hash, (uint64_t)(uintptr_t)gui_module);
+    hash = _hash_mix(hash, gui_module->request_color_pick);
+    if(gui_module->request_color_pick != DT_REQUEST_COLORPICK_OFF) hash = _hash_color_picker(hash, gui_module);
+  }
+  return hash;
+}
+
+void dt_dev_pixelpipe_cache_hash_invalidate(struct dt_dev_pixelpipe_t *pipe,
+                                            const struct dt_dev_pixelpipe_iop_t *piece)
+{
+  dt_pthread_mutex_lock(&pipe->hash_mutex);
+  if(!piece)
+  {
+    pipe->hash_valid = -1;
+    pipe->hash_valid_node = NULL;
+  }
+  else
+  {
+    // the prefix up to (excluding) this piece stays valid
+    int k = 0;
+    for(GList *nodes = pipe->nodes; nodes && k < pipe->hash_valid; nodes = g_list_next(nodes), k++)
+    {
+      if(nodes->data == piece)
+      {
+        pipe->hash_valid = k;
+        pipe->hash_valid_node = nodes;
+        break;
+      }
+    }
+  }
+  dt_pthread_mutex_unlock(&pipe->hash_mutex);
+}
+
 uint64_t dt_dev_pixelpipe_cache_basichash(int imgid, struct dt_dev_pixelpipe_t *pipe, int module)
 {
-  // bernstein hash (djb2)
-  // the hash is made of imgid and the actual fast-pipe mode if activated
-  uint64_t hash = 5381 + imgid + (pipe->type & DT_DEV_PIXELPIPE_FAST);
-  // go through all modules up to module and compute a weird hash using the operation and params.
-  GList *pieces = pipe->nodes;
-  for(int k = 0; k < module && pieces; k++)
+  dt_pthread_mutex_lock(&pipe->hash_mutex);
+
+  dt_develop_t *dev = pipe->nodes ? ((dt_dev_pixelpipe_iop_t *)pipe->nodes->data)->module->dev : NULL;
+  const uint64_t context = _hash_context(imgid, pipe, dev);
+  if(pipe->hash_valid < 0 || context != pipe->hash_context)
+  {
+    // the hash is made of imgid and the actual fast-pipe mode if activated
+    pipe->hash_context = context;
+    pipe->hash_valid = 0;
+    pipe->hash_valid_node = pipe->nodes;
+  }
+  if(pipe->hash_prefix_size <= module)
+  {
+    const int size = MAX(module, (int)g_list_length(pipe->nodes)) + 1;
+    pipe->hash_prefix = (uint64_t *)realloc(pipe->hash_prefix, sizeof(uint64_t) * size);
+    pipe->hash_prefix_size = size;
+  }
+  if(pipe->hash_valid == 0) pipe->hash_prefix[0] = _hash_mix(5381 + imgid, pipe->type & DT_DEV_PIXELPIPE_FAST);
+
+  // extend the valid prefix up to module, going through all modules and computing a hash using the
+  // operation and params.
+  GList *pieces = pipe->hash_valid_node;
+  while(pipe->hash_valid < module && pieces)
   {
     dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)pieces->data;
-    dt_develop_t *dev = piece->module->dev;
+    uint64_t hash = pipe->hash_prefix[pipe->hash_valid];
     if(!(dev->gui_module && (dev->gui_module->operation_tags_filter() & piece->module->operation_tags())))
     {
-      hash = ((hash << 5) + hash) ^ piece->hash;
+      hash = _hash_mix(hash, piece->hash);
       if(piece->module->request_color_pick != DT_REQUEST_COLORPICK_OFF)
-      {
-        if(darktable.lib->proxy.colorpicker.size)
-        {
-          const char *str = (const char *)piece->module->color_picker_box;
-          for(size_t i = 0; i < sizeof(float) * 4; i++) hash = ((hash << 5) + hash) ^ str[i];
-        }
-        else
-        {
-          const char *str = (const char *)piece->module->color_picker_point;
-          for(size_t i = 0; i < sizeof(float) * 2; i++) hash = ((hash << 5) + hash) ^ str[i];
-        }
-      }
+        hash = _hash_color_picker(hash, piece->module);
     }
+    pipe->hash_prefix[++pipe->hash_valid] = hash;
     pieces = g_list_next(pieces);
   }
+  pipe->hash_valid_node = pieces;
+
+  const uint64_t hash = pipe->hash_prefix[MIN(module, pipe->hash_valid)];
+  dt_pthread_mutex_unlock(&pipe->hash_mutex);
   return hash;
 }
 
@@ -151,9 +358,11 @@ void dt_dev_pixelpipe_cache_fullhash(int imgid, const dt_iop_roi_t *roi, struct
 {
   uint64_t hash = *basichash = dt_dev_pixelpipe_cache_basichash(imgid, pipe, module);
   // also add scale, x and y:
-  const char *str = (const char *)roi;
-  for(size_t i = 0; i < sizeof(dt_iop_roi_t); i++)
-    hash = ((hash << 5) + hash) ^ str[i];
+  uint32_t scale;
+  memcpy(&scale, &roi->scale, sizeof(scale));
+  hash = _hash_mix(hash, ((uint64_t)(uint32_t)roi->x << 32) | (uint32_t)roi->y);
+  hash = _hash_mix(hash, ((uint64_t)(uint32_t)roi->width << 32) | (uint32_t)roi->height);
+  hash = _hash_mix(hash, scale);
   *fullhash = hash;
 }
 
@@ -166,10 +375,7 @@ uint64_t dt_dev_pixelpipe_cache_hash(int imgid, const dt_iop_roi_t *roi, dt_dev_
 
 int dt_dev_pixelpipe_cache_available(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash)
 {
-  // search for hash in cache
-  for(int32_t k = 0; k < cache->entries; k++)
-    if(cache->hash[k] == hash) return 1;
-  return 0;
+  return _index_find(cache, hash) >= 0;
 }
 
 int dt_dev_pixelpipe_cache_get_important(dt_dev_pixelpipe_cache_t *cache, const uint64_t basichash,
@@ -189,68 +395,57 @@ int dt_dev_pixelpipe_cache_get_weighted(dt_dev_pixelpipe_cache_t *cache, const u
                                         const size_t size, void **data, dt_iop_buffer_dsc_t **dsc, int weight)
 {
   cache->queries++;
-  *data = NULL;
-  int max_used = -1, max = 0;
-  size_t sz = 0;
-  for(int k = 0; k < cache->entries; k++)
+  // negative weights ask to keep this line around for longer
+  const int important = weight < 0;
+
+  const int32_t k = _index_find(cache, hash);
+  if(k >= 0 && cache->size[k] >= size)
   {
-    // search for hash in cache
-    if(cache->used[k] > max_used)
-    {
-      max_used = cache->used[k];
-      max = k;
-    }
-    cache->used[k]++; // age all entries
-    if(cache->hash[k] == hash)
-    {
-      *data = cache->data[k];
-      *dsc = &cache->dsc[k];
-      sz = cache->size[k];
-      cache->used[k] = weight; // this is the MRU entry
+    *data = cache->data[k];
+    *dsc = &cache->dsc[k];
+    _lru_touch(cache, k, important); // this is the MRU entry
 
-      ASAN_POISON_MEMORY_REGION(*data, sz);
-      ASAN_UNPOISON_MEMORY_REGION(*data, size);
-    }
+    ASAN_POISON_MEMORY_REGION(*data, cache->size[k]);
+    ASAN_UNPOISON_MEMORY_REGION(*data, size);
+    return 0;
   }
 
-  if(!*data || sz < size)
+  // reuse the line if the hash is there but the buffer too small, else kill the LRU entry
+  const int32_t line = k >= 0 ? k : _lru_victim(cache);
+  // printf("[pixelpipe_cache_get] hash not found, returning slot %d/%d weight %d\n", line, cache->entries,
+  // weight);
+  _index_remove(cache, line);
+  if(cache->size[line] < size)
   {
-    // kill LRU entry
-    // printf("[pixelpipe_cache_get] hash not found, returning slot %d/%d age %d\n", max, cache->entries,
-    // weight);
-    if(cache->size[max] < size)
-    {
-      dt_free_align(cache->data[max]);
-      cache->data[max] = (void *)dt_alloc_align(64, size);
-      cache->size[max] = size;
-    }
-    *data = cache->data[max];
-    sz = cache->size[max];
+    dt_free_align(cache->data[line]);
+    cache->data[line] = (void *)dt_alloc_align(64, size);
+    cache->size[line] = size;
+  }
+  *data = cache->data[line];
 
-    ASAN_POISON_MEMORY_REGION(*data, sz);
-    ASAN_UNPOISON_MEMORY_REGION(*data, size);
+  ASAN_POISON_MEMORY_REGION(*data, cache->size[line]);
+  ASAN_UNPOISON_MEMORY_REGION(*data, size);
 
-    // first, update our copy, then update the pointer to point at our copy
-    cache->dsc[max] = **dsc;
-    *dsc = &cache->dsc[max];
+  // first, update our copy, then update the pointer to point at our copy
+  cache->dsc[line] = **dsc;
+  *dsc = &cache->dsc[line];
 
-    cache->basichash[max] = basichash;
-    cache->hash[max] = hash;
-    cache->used[max] = weight;
-    cache->misses++;
-    return 1;
-  }
-  else
-    return 0;
+  cache->basichash[line] = basichash;
+  cache->hash[line] = hash;
+  _index_insert(cache, line);
+  _lru_touch(cache, line, important);
+  cache->misses++;
+  return 1;
 }
 
 void dt_dev_pixelpipe_cache_flush(dt_dev_pixelpipe_cache_t *cache)
 {
+  for(uint32_t i = 0; i <= cache->index_mask; i++) cache->index[i] = -1;
   for(int k = 0; k < cache->entries; k++)
   {
     cache->basichash[k] = -1;
     cache->hash[k] = -1;
-    cache->used[k] = 0;
+    if(cache->important[k]) _lru_touch(cache, k, 0);
     ASAN_POISON_MEMORY_REGION(cache->data[k], cache->size[k]);
   }
 }
@@ -261,10 +456,9 @@ void dt_dev_pixelpipe_cache_flush_all_but(dt_dev_pixelpipe_cache_t *cache, uint6
   {
     if (cache->basichash[k] == basichash)
       continue;
-    cache->basichash[k] = -1;
-    cache->hash[k] = -1;
-    cache->used[k] = 0;
-    ASAN_POISON_MEMORY_REGION(cache->data[k], cache->size[k]);
+    _line_invalidate(cache, k);
+    _lru_unlink(cache, k);
+    _lru_push_front(cache, k);
   }
 }
 
@@ -274,7 +468,7 @@ void dt_dev_pixelpipe_cache_reweight(dt_dev_pixelpipe_cache_t *cache, void *data
   {
     if(cache->data[k] == data)
     {
-      cache->used[k] = -cache->entries;
+      _lru_touch(cache, k, 1);
     }
   }
 }
@@ -285,24 +479,692 @@ void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *da
   {
     if(cache->data[k] == data)
     {
-      cache->basichash[k] = -1;
-      cache->hash[k] = -1;
-      ASAN_POISON_MEMORY_REGION(cache->data[k], cache->size[k]);
+      _line_invalidate(cache, k);
+      // no use keeping it, hand it out first
+      _lru_unlink(cache, k);
+      _lru_push_front(cache, k);
     }
   }
 }
 
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache)
 {
-  for(int k = 0; k < cache->entries; k++)
+  for(int l = 1; l >= 0; l--)
   {
-    printf("pixelpipe cacheline %d ", k);
-    printf("used %d by %" PRIu64 " (%" PRIu64 ")", cache->used[k], cache->hash[k], cache->basichash[k]);
-    printf("\n");
+    // most recently used first
+    for(int32_t k = cache->lru_tail[l]; k >= 0; k = cache->prev[k])
+    {
+      printf("pixelpipe cacheline %d ", k);
+      printf("%s by %" PRIu64 " (%" PRIu64 ")", l ? "important" : "regular", cache->hash[k], cache->basichash[k]);
+      printf("\n");
+    }
   }
   printf("cache hit rate so far: %.3f\n", (cache->queries - cache->misses) / (float)cache->queries);
 }
 
+typedef struct dt_dev_pixelpipe_cache_shared_entry_t
+{
+  uint64_t key;
+  uint64_t basichash;
+  uint64_t fingerprint; // identifies the image file, ids get reused after images are removed
+  int32_t imgid;
+  gboolean spill;       // worth writing to the disk tier when evicted
+  gboolean transient;   // too large for memory, straight from disk and freed on release
+  void *data;
+  size_t size;
+  dt_iop_buffer_dsc_t dsc;
+  dt_pthread_rwlock_t lock;
+  GList *link;
+} dt_dev_pixelpipe_cache_shared_entry_t;
+
+static inline int _shared_type_slot(const struct dt_dev_pixelpipe_t *pipe)
+{
+  const int type = pipe->type & DT_DEV_PIXELPIPE_ANY;
+  return type ? MIN(__builtin_ctz(type), DT_DEV_PIXELPIPE_CACHE_SHARED_TYPES - 1) : 0;
+}
+
+static inline uint64_t _hash_mix_profile(const uint64_t hash, const dt_colorspaces_color_profile_type_t type,
+                                         const char *filename, const dt_iop_color_intent_t intent)
+{
+  const uint64_t key = _hash_mix(hash, ((uint64_t)(uint32_t)type << 32) | (uint32_t)intent);
+  return _hash_mix(key, filename ? g_str_hash(filename) : 0);
+}
+
+// the output profile colorout converts to is not part of its params but comes from the pipe (export
+// overrides) or the global display settings, same as what colorout's commit_params() picks.
+static uint64_t _hash_mix_output_profile(const uint64_t hash, const struct dt_dev_pixelpipe_t *pipe)
+{
+  const dt_colorspaces_t *profiles = darktable.color_profiles;
+  if((pipe->type & DT_DEV_PIXELPIPE_EXPORT) == DT_DEV_PIXELPIPE_EXPORT)
+    return _hash_mix_profile(hash, pipe->icc_type, pipe->icc_filename, pipe->icc_intent);
+  if((pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL) == DT_DEV_PIXELPIPE_THUMBNAIL)
+  {
+    const dt_colorspaces_color_profile_type_t type = dt_mipmap_cache_get_colorspace();
+    return _hash_mix_profile(hash, type, type == DT_COLORSPACE_DISPLAY ? profiles->display_filename : "",
+                             profiles->display_intent);
+  }
+  if((pipe->type & DT_DEV_PIXELPIPE_PREVIEW2) == DT_DEV_PIXELPIPE_PREVIEW2)
+    return _hash_mix_profile(hash, profiles->display2_type, profiles->display2_filename,
+                             profiles->display2_intent);
+  uint64_t key = _hash_mix_profile(hash, profiles->display_type, profiles->display_filename,
+                                   profiles->display_intent);
+  // softproofing and gamut check only apply to the full pipe
+  if((pipe->type & DT_DEV_PIXELPIPE_FULL) == DT_DEV_PIXELPIPE_FULL && profiles->mode != DT_PROFILE_NORMAL)
+    key = _hash_mix_profile(_hash_mix(key, profiles->mode), profiles->softproof_type,
+                            profiles->softproof_filename, profiles->softproof_intent);
+  return key;
+}
+
+// modules are free to process differently depending on the pipe type (lower quality demosaicing for
+// previews etc), and the hashes only know about params and the region of interest relative to the pipe
+// input. so we also mix in what the pipe is, what it is working on and which profile it outputs to.
+static inline uint64_t _shared_key(const struct dt_dev_pixelpipe_t *pipe, const uint64_t hash)
+{
+  uint64_t key = _hash_mix(hash, pipe->type & (DT_DEV_PIXELPIPE_ANY | DT_DEV_PIXELPIPE_FAST));
+  key = _hash_mix(key, ((uint64_t)(uint32_t)pipe->iwidth << 32) | (uint32_t)pipe->iheight);
+  return _hash_mix_output_profile(key, pipe);
+}
+
+static uint64_t _shared_fingerprint(const struct dt_dev_pixelpipe_t *pipe)
+{
+  const dt_image_t *img = &pipe->image;
+  uint64_t hash = _hash_mix(g_str_hash(img->filename), img->film_id);
+  hash = _hash_mix(hash, ((uint64_t)(uint32_t)img->width << 32) | (uint32_t)img->height);
+  hash = _hash_mix(hash, g_str_hash(img->exif_datetime_taken));
+  // module params are stored raw, they are only comparable within one version
+  return _hash_mix(hash, g_str_hash(darktable_package_version));
+}
+
+static void _shared_entry_free(dt_dev_pixelpipe_cache_shared_entry_t *entry)
+{
+  dt_free_align(entry->data);
+  dt_pthread_rwlock_destroy(&entry->lock);
+  g_slice_free1(sizeof(*entry), entry);
+}
+
+// take a write locked entry out of the cache. cache->lock has to be held.
+static void _shared_entry_detach(dt_dev_pixelpipe_cache_shared_t *cache, dt_dev_pixelpipe_cache_shared_entry_t *entry)
+{
+  g_hash_table_remove(cache->hashtable, &entry->key);
+  cache->lru = g_list_delete_link(cache->lru, entry->link);
+  cache->cost -= entry->size;
+}
+
+// evict from the tip of the lru list until the additional bytes fit. skips entries still read locked by
+// other pipes. the evicted entries are returned write locked in *evicted, so they can be written to disk
+// after cache->lock has been dropped. cache->lock has to be held.
+static void _shared_gc(dt_dev_pixelpipe_cache_shared_t *cache, const size_t needed, GList **evicted)
+{
+  GList *l = cache->lru;
+  while(l && cache->cost + needed > cache->cost_quota)
+  {
+    dt_dev_pixelpipe_cache_shared_entry_t *entry = (dt_dev_pixelpipe_cache_shared_entry_t *)l->data;
+    l = g_list_next(l);
+    if(dt_pthread_rwlock_trywrlock(&entry->lock)) continue;
+    _shared_entry_detach(cache, entry);
+    *evicted = g_list_prepend(*evicted, entry);
+  }
+}
+
+// insert a new entry unless the key is there already, in which case the entry is freed. returns the
+// entry in the cache for this key. cache->lock has to be held.
+static dt_dev_pixelpipe_cache_shared_entry_t *_shared_insert(dt_dev_pixelpipe_cache_shared_t *cache,
+                                                             dt_dev_pixelpipe_cache_shared_entry_t *entry,
+                                                             GList **evicted)
+{
+  dt_dev_pixelpipe_cache_shared_entry_t *present
+      = (dt_dev_pixelpipe_cache_shared_entry_t *)g_hash_table_lookup(cache->hashtable, &entry->key);
+  if(present)
+  {
+    // another pipe was faster
+    _shared_entry_free(entry);
+    return present;
+  }
+  _shared_gc(cache, entry->size, evicted);
+  if(cache->cost + entry->size > cache->cost_quota)
+  {
+    // everything is in use, don't exceed the budget
+    _shared_entry_free(entry);
+    return NULL;
+  }
+  g_hash_table_insert(cache->hashtable, &entry->key, entry);
+  entry->link = g_list_append(NULL, entry);
+  cache->lru = g_list_concat(cache->lru, entry->link);
+  cache->cost += entry->size;
+  return entry;
+}
+
+/*
+ * disk tier.
+ *
+ * files are called <imgid>-<key>.pp and hold a header, a table with the compressed size of each chunk and
+ * the chunks themselves. the float codec is lossless: each 32 bit word is xor'ed with the same channel
+ * of the previous pixel, which zeroes sign, exponent and the leading mantissa bits in smooth areas.
+ * then the bytes of a chunk are split into four planes, so that zlib finds long runs even at its
+ * fastest setting. chunks restart the prediction, so they are decompressed in parallel.
+ */
+
+#define DT_PIXELPIPE_CACHE_DISK_VERSION 1
+// 32 bit words per chunk, 16MB
+#define DT_PIXELPIPE_CACHE_DISK_CHUNK ((size_t)1 << 22)
+
+typedef struct dt_dev_pixelpipe_cache_disk_header_t
+{
+  char magic[4];
+  int32_t version;
+  uint64_t key;
+  uint64_t fingerprint;
+  uint64_t size;
+  uint32_t chunks;
+  uint32_t channels;
+  dt_iop_buffer_dsc_t dsc;
+} dt_dev_pixelpipe_cache_disk_header_t;
+
+static void _disk_filename(const dt_dev_pixelpipe_cache_shared_t *cache, const int32_t imgid, const uint64_t key,
+                           char *filename, const size_t size)
+{
+  snprintf(filename, size, "%s/%d-%016" PRIx64 ".pp", cache->diskdir, imgid, key);
+}
+
+static void _disk_encode_chunk(const uint32_t *const in, uint8_t *const out, const size_t words, const int ch)
+{
+  const size_t planes = words; // bytes per plane
+  for(size_t i = 0; i < words; i++)
+  {
+    const uint32_t w = in[i] ^ (i >= ch ? in[i - ch] : 0);
+    out[i] = w & 0xff;
+    out[planes + i] = (w >> 8) & 0xff;
+    out[2 * planes + i] = (w >> 16) & 0xff;
+    out[3 * planes + i] = w >> 24;
+  }
+}
+
+static void _disk_decode_chunk(const uint8_t *const in, uint32_t *const out, const size_t words, const int ch)
+{
+  const size_t planes = words;
+  for(size_t i = 0; i < words; i++)
+  {
+    const uint32_t w = in[i] | ((uint32_t)in[planes + i] << 8) | ((uint32_t)in[2 * planes + i] << 16)
+                       | ((uint32_t)in[3 * planes + i] << 24);
+    out[i] = w ^ (i >= ch ? out[i - ch] : 0);
+  }
+}
+
+typedef struct _disk_file_t
+{
+  gchar *path;
+  time_t mtime;
+  size_t size;
+} _disk_file_t;
+
+static gint _disk_oldest_first(gconstpointer a, gconstpointer b)
+{
+  const time_t ta = ((const _disk_file_t *)a)->mtime, tb = ((const _disk_file_t *)b)->mtime;
+  return (ta > tb) - (ta < tb);
+}
+
+// remove the oldest files until we are below the quota again
+static void _disk_prune(dt_dev_pixelpipe_cache_shared_t *cache)
+{
+  GDir *dir = g_dir_open(cache->diskdir, 0, NULL);
+  if(!dir) return;
+  GArray *files = g_array_new(FALSE, FALSE, sizeof(_disk_file_t));
+  size_t used = 0;
+  const gchar *name;
+  while((name = g_dir_read_name(dir)))
+  {
+    if(!g_str_has_suffix(name, ".pp")) continue;
+    _disk_file_t f = { g_build_filename(cache->diskdir, name, NULL), 0, 0 };
+    GStatBuf st;
+    if(g_stat(f.path, &st))
+    {
+      g_free(f.path);
+      continue;
+    }
+    f.mtime = st.st_mtime;
+    f.size = st.st_size;
+    used += f.size;
+    g_array_append_val(files, f);
+  }
+  g_dir_close(dir);
+
+  g_array_sort(files, _disk_oldest_first);
+
+  for(guint i = 0; i < files->len; i++)
+  {
+    _disk_file_t *f = &g_array_index(files, _disk_file_t, i);
+    if(used > cache->disk_quota && !g_unlink(f->path)) used -= f->size;
+    g_free(f->path);
+  }
+  g_array_free(files, TRUE);
+  cache->disk_used = used;
+}
+
+// compress and write a buffer. runs on the writer thread, which is why the chunks aren't done in parallel:
+// it would compete with the pipes for the cores.
+static void _disk_write(dt_dev_pixelpipe_cache_shared_t *cache, const dt_dev_pixelpipe_cache_shared_entry_t *entry)
+{
+  const size_t words = entry->size / sizeof(uint32_t);
+  const uint32_t chunks = (words + DT_PIXELPIPE_CACHE_DISK_CHUNK - 1) / DT_PIXELPIPE_CACHE_DISK_CHUNK;
+  const int ch = MAX(1, entry->dsc.channels);
+  const uLong bound = compressBound(DT_PIXELPIPE_CACHE_DISK_CHUNK * sizeof(uint32_t));
+  uint64_t *csize = (uint64_t *)calloc(chunks, sizeof(uint64_t));
+  uint8_t *out = (uint8_t *)dt_alloc_align(64, (size_t)chunks * bound);
+  int err = !csize || !out;
+
+  const size_t chunk_words = MIN(DT_PIXELPIPE_CACHE_DISK_CHUNK, words);
+  uint8_t *planes = err ? NULL : (uint8_t *)dt_alloc_align(64, chunk_words * sizeof(uint32_t));
+  err |= !planes;
+  for(uint32_t c = 0; c < chunks && !err; c++)
+  {
+    const size_t start = (size_t)c * DT_PIXELPIPE_CACHE_DISK_CHUNK;
+    const size_t n = MIN(DT_PIXELPIPE_CACHE_DISK_CHUNK, words - start);
+    _disk_encode_chunk((const uint32_t *)entry->data + start, planes, n, ch);
+    uLongf len = bound;
+    if(compress2(out + (size_t)c * bound, &len, planes, n * sizeof(uint32_t), Z_BEST_SPEED) != Z_OK) err = 1;
+    csize[c] = len;
+  }
+  dt_free_align(planes);
+
+  char filename[PATH_MAX] = { 0 };
+  _disk_filename(cache, entry->imgid, entry->key, filename, sizeof(filename));
+  gchar *tmpname = g_strdup_printf("%s.tmp", filename);
+  FILE *f = err ? NULL : g_fopen(tmpname, "wb");
+  size_t written = 0;
+  if(f)
+  {
+    dt_dev_pixelpipe_cache_disk_header_t header = { { 'd', 't', 'p', 'c' }, DT_PIXELPIPE_CACHE_DISK_VERSION };
+    header.key = entry->key;
+    header.fingerprint = entry->fingerprint;
+    header.size = entry->size;
+    header.chunks = chunks;
+    header.channels = ch;
+    header.dsc = entry->dsc;
+    err = fwrite(&header, sizeof(header), 1, f) != 1 || fwrite(csize, sizeof(uint64_t), chunks, f) != chunks;
+    written = sizeof(header) + sizeof(uint64_t) * chunks;
+    for(uint32_t c = 0; c < chunks && !err; c++)
+    {
+      err = fwrite(out + (size_t)c * bound, 1, csize[c], f) != csize[c];
+      written += csize[c];
+    }
+    err |= fclose(f) != 0;
+    err = err || g_rename(tmpname, filename);
+    if(err)
+    {
+      g_unlink(tmpname);
+      written = 0;
+    }
+  }
+  g_free(tmpname);
+  dt_free_align(out);
+  free(csize);
+
+  if(written)
+  {
+    dt_pthread_mutex_lock(&cache->disk_lock);
+    cache->disk_writes++;
+    cache->disk_used += written;
+    if(cache->disk_used > cache->disk_quota) _disk_prune(cache);
+    dt_pthread_mutex_unlock(&cache->disk_lock);
+  }
+}
+
+// load a spilled buffer into a new, unlocked entry. the file is mapped and decoded right from there.
+static dt_dev_pixelpipe_cache_shared_entry_t *_disk_read(dt_dev_pixelpipe_cache_shared_t *cache,
+                                                         struct dt_dev_pixelpipe_t *pipe,
+                                                         const uint64_t key, const size_t size)
+{
+  char filename[PATH_MAX] = { 0 };
+  _disk_filename(cache, pipe->image.id, key, filename, sizeof(filename));
+  GMappedFile *file = g_mapped_file_new(filename, FALSE, NULL);
+  if(!file) return NULL;
+
+  const uint8_t *contents = (const uint8_t *)g_mapped_file_get_contents(file);
+  const size_t length = g_mapped_file_get_length(file);
+  const dt_dev_pixelpipe_cache_disk_header_t *header = (const dt_dev_pixelpipe_cache_disk_header_t *)contents;
+  const uint64_t fingerprint = _shared_fingerprint(pipe);
+  if(length < sizeof(*header) || memcmp(header->magic, "dtpc", 4)
+     || header->version != DT_PIXELPIPE_CACHE_DISK_VERSION || header->key != key
+     || header->fingerprint != fingerprint || header->size != size || header->channels < 1
+     || header->chunks != (size / sizeof(uint32_t) + DT_PIXELPIPE_CACHE_DISK_CHUNK - 1) / DT_PIXELPIPE_CACHE_DISK_CHUNK
+     || length < sizeof(*header) + sizeof(uint64_t) * header->chunks)
+  {
+    // stale, e.g. another image with a reused id
+    g_mapped_file_unref(file);
+    if(length >= sizeof(*header) && header->size == size) g_unlink(filename);
+    return NULL;
+  }
+
+  const uint32_t chunks = header->chunks;
+  const size_t words = size / sizeof(uint32_t);
+  const int ch = header->channels;
+  uint64_t *const offset = (uint64_t *)malloc(sizeof(uint64_t) * (chunks + 1));
+  const uint64_t *const csize = (const uint64_t *)(contents + sizeof(*header));
+  offset[0] = sizeof(*header) + sizeof(uint64_t) * chunks;
+  for(uint32_t c = 0; c < chunks; c++) offset[c + 1] = offset[c] + csize[c];
+
+  dt_dev_pixelpipe_cache_shared_entry_t *entry = NULL;
+  void *data = offset[chunks] <= length ? dt_alloc_align(64, size) : NULL;
+  int err = !data;
+  if(!err)
+  {
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(chunks, words, ch, contents, offset, data) \
+    reduction(|:err) schedule(dynamic)
+#endif
+    for(uint32_t c = 0; c < chunks; c++)
+    {
+      const size_t start = (size_t)c * DT_PIXELPIPE_CACHE_DISK_CHUNK;
+      const size_t n = MIN(DT_PIXELPIPE_CACHE_DISK_CHUNK, words - start);
+      uint8_t *planes = (uint8_t *)dt_alloc_align(64, n * sizeof(uint32_t));
+      uLongf len = n * sizeof(uint32_t);
+      if(!planes || uncompress(planes, &len, contents + offset[c], offset[c + 1] - offset[c]) != Z_OK
+         || len != n * sizeof(uint32_t))
+        err = 1;
+      else
+        _disk_decode_chunk(planes, (uint32_t *)data + start, n, ch);
+      dt_free_align(planes);
+    }
+  }
+
+  if(!err)
+  {
+    entry = (dt_dev_pixelpipe_cache_shared_entry_t *)g_slice_alloc(sizeof(dt_dev_pixelpipe_cache_shared_entry_t));
+    entry->key = key;
+    entry->basichash = 0;
+    entry->fingerprint = fingerprint;
+    entry->imgid = pipe->image.id;
+    entry->spill = FALSE; // it's on disk already
+    entry->transient = FALSE;
+    entry->data = data;
+    entry->size = size;
+    entry->dsc = header->dsc;
+    dt_pthread_rwlock_init(&entry->lock, NULL);
+    // keep recently used files from being pruned
+    g_utime(filename, NULL);
+  }
+  else
+    dt_free_align(data);
+
+  free(offset);
+  g_mapped_file_unref(file);
+  return entry;
+}
+
+static void *_disk_writer_thread(void *data)
+{
+  dt_dev_pixelpipe_cache_shared_t *cache = (dt_dev_pixelpipe_cache_shared_t *)data;
+  dt_pthread_setname("pipecache_disk");
+  dt_pthread_mutex_lock(&cache->queue_lock);
+  while(!cache->writer_stop)
+  {
+    dt_dev_pixelpipe_cache_shared_entry_t *entry
+        = (dt_dev_pixelpipe_cache_shared_entry_t *)g_queue_pop_head(cache->queue);
+    if(!entry)
+    {
+      dt_pthread_cond_wait(&cache->queue_cond, &cache->queue_lock);
+      continue;
+    }
+    dt_pthread_mutex_unlock(&cache->queue_lock);
+
+    _disk_write(cache, entry);
+
+    dt_pthread_mutex_lock(&cache->queue_lock);
+    // only now, so that the queue quota also covers the buffer being written
+    cache->queued -= entry->size;
+    _shared_entry_free(entry);
+  }
+  dt_pthread_mutex_unlock(&cache->queue_lock);
+  return NULL;
+}
+
+// hand an unlocked entry over to the writer thread, or free it if the queue is full already
+static void _disk_queue(dt_dev_pixelpipe_cache_shared_t *cache, dt_dev_pixelpipe_cache_shared_entry_t *entry)
+{
+  dt_pthread_mutex_lock(&cache->queue_lock);
+  if(cache->writer_running && cache->queued + entry->size <= cache->queue_quota)
+  {
+    cache->queued += entry->size;
+    g_queue_push_tail(cache->queue, entry);
+    pthread_cond_signal(&cache->queue_cond);
+    entry = NULL;
+  }
+  else
+    cache->disk_dropped++;
+  dt_pthread_mutex_unlock(&cache->queue_lock);
+  if(entry) _shared_entry_free(entry);
+}
+
+// queue evicted entries for the disk if they are worth it, free the others
+static void _shared_evicted_free(dt_dev_pixelpipe_cache_shared_t *cache, GList *evicted)
+{
+  for(GList *l = evicted; l; l = g_list_next(l))
+  {
+    dt_dev_pixelpipe_cache_shared_entry_t *entry = (dt_dev_pixelpipe_cache_shared_entry_t *)l->data;
+    dt_pthread_rwlock_unlock(&entry->lock);
+    if(cache->diskdir && entry->spill)
+      _disk_queue(cache, entry);
+    else
+      _shared_entry_free(entry);
+  }
+  g_list_free(evicted);
+}
+
+void dt_dev_pixelpipe_cache_shared_init(dt_dev_pixelpipe_cache_shared_t *cache, size_t cost_quota)
+{
+  memset(cache, 0, sizeof(*cache));
+  dt_pthread_mutex_init(&cache->lock, NULL);
+  dt_pthread_mutex_init(&cache->disk_lock, NULL);
+  dt_pthread_mutex_init(&cache->queue_lock, NULL);
+  cache->queue = g_queue_new();
+  cache->cost_quota = cost_quota;
+  cache->hashtable = g_hash_table_new(g_int64_hash, g_int64_equal);
+}
+
+void dt_dev_pixelpipe_cache_shared_set_disk(dt_dev_pixelpipe_cache_shared_t *cache, const char *dir,
+                                            size_t disk_quota)
+{
+  if(!cache->cost_quota || !disk_quota || g_mkdir_with_parents(dir, 0750)) return;
+  cache->diskdir = g_strdup(dir);
+  cache->disk_quota = disk_quota;
+  _disk_prune(cache);
+
+  // buffers waiting for the disk are held on top of the memory budget, keep that bounded
+  cache->queue_quota = cache->cost_quota / 2;
+  pthread_cond_init(&cache->queue_cond, NULL);
+  if(dt_pthread_create(&cache->writer, _disk_writer_thread, cache))
+  {
+    fprintf(stderr, "[pixelpipe_cache] could not start the disk writer, disk tier disabled\n");
+    pthread_cond_destroy(&cache->queue_cond);
+    g_free(cache->diskdir);
+    cache->diskdir = NULL;
+    return;
+  }
+  cache->writer_running = 1;
+}
+
+void dt_dev_pixelpipe_cache_shared_cleanup(dt_dev_pixelpipe_cache_shared_t *cache)
+{
+  if(cache->writer_running)
+  {
+    // lets the buffer being written finish, drops the rest
+    dt_pthread_mutex_lock(&cache->queue_lock);
+    cache->writer_stop = 1;
+    pthread_cond_signal(&cache->queue_cond);
+    dt_pthread_mutex_unlock(&cache->queue_lock);
+    pthread_join(cache->writer, NULL);
+    pthread_cond_destroy(&cache->queue_cond);
+    cache->writer_running = 0;
+  }
+  g_queue_free_full(cache->queue, (GDestroyNotify)_shared_entry_free);
+  g_hash_table_destroy(cache->hashtable);
+  for(GList *l = cache->lru; l; l = g_list_next(l))
+    _shared_entry_free((dt_dev_pixelpipe_cache_shared_entry_t *)l->data);
+  g_list_free(cache->lru);
+  g_free(cache->diskdir);
+  dt_pthread_mutex_destroy(&cache->queue_lock);
+  dt_pthread_mutex_destroy(&cache->disk_lock);
+  dt_pthread_mutex_destroy(&cache->lock);
+}
+
+dt_dev_pixelpipe_cache_shared_entry_t *dt_dev_pixelpipe_cache_shared_testget(dt_dev_pixelpipe_cache_shared_t *cache,
+                                                                             struct dt_dev_pixelpipe_t *pipe,
+                                                                             const uint64_t hash, const size_t size)
+{
+  if(!cache || !cache->cost_quota) return NULL;
+  const uint64_t key = _shared_key(pipe, hash);
+  const int slot = _shared_type_slot(pipe);
+
+  dt_pthread_mutex_lock(&cache->lock);
+  cache->queries[slot]++;
+  dt_dev_pixelpipe_cache_shared_entry_t *entry
+      = (dt_dev_pixelpipe_cache_shared_entry_t *)g_hash_table_lookup(cache->hashtable, &key);
+  if(entry)
+  {
+    // entries are never written after insertion, so the read lock only fails while it is being evicted
+    if(entry->size != size || dt_pthread_rwlock_tryrdlock(&entry->lock))
+    {
+      dt_pthread_mutex_unlock(&cache->lock);
+      return NULL;
+    }
+    // bubble up in lru list:
+    cache->lru = g_list_remove_link(cache->lru, entry->link);
+    cache->lru = g_list_concat(cache->lru, entry->link);
+    cache->hits[slot]++;
+    dt_pthread_mutex_unlock(&cache->lock);
+    return entry;
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+
+  if(!cache->diskdir) return NULL;
+  entry = _disk_read(cache, pipe, key, size);
+  if(!entry) return NULL;
+
+  if(size > cache->cost_quota / 4)
+  {
+    // hand it out without going through memory
+    entry->transient = TRUE;
+    dt_pthread_rwlock_rdlock(&entry->lock);
+    __sync_fetch_and_add(&cache->disk_hits[slot], 1);
+    return entry;
+  }
+
+  GList *evicted = NULL;
+  dt_pthread_mutex_lock(&cache->lock);
+  entry = _shared_insert(cache, entry, &evicted);
+  if(entry && dt_pthread_rwlock_tryrdlock(&entry->lock)) entry = NULL;
+  if(entry) cache->disk_hits[slot]++;
+  dt_pthread_mutex_unlock(&cache->lock);
+  _shared_evicted_free(cache, evicted);
+  return entry;
+}
+
+void dt_dev_pixelpipe_cache_shared_copy(const dt_dev_pixelpipe_cache_shared_entry_t *entry, void *data,
+                                        dt_iop_buffer_dsc_t *dsc)
+{
+  memcpy(data, entry->data, entry->size);
+  *dsc = entry->dsc;
+}
+
+void dt_dev_pixelpipe_cache_shared_release(dt_dev_pixelpipe_cache_shared_t *cache,
+                                           dt_dev_pixelpipe_cache_shared_entry_t *entry)
+{
+  dt_pthread_rwlock_unlock(&entry->lock);
+  if(entry->transient) _shared_entry_free(entry);
+}
+
+void dt_dev_pixelpipe_cache_shared_put(dt_dev_pixelpipe_cache_shared_t *cache, struct dt_dev_pixelpipe_t *pipe,
+                                       const uint64_t basichash, const uint64_t hash, const void *data,
+                                       const size_t size, const dt_iop_buffer_dsc_t *dsc)
+{
+  if(!cache || !cache->cost_quota || !data || !size) return;
+  const uint64_t key = _shared_key(pipe, hash);
+  // only the expensive full resolution work is worth the disk space
+  const gboolean spill = (pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_EXPORT))
+                         && !(size % sizeof(uint32_t))
+                         && (dsc->datatype == TYPE_FLOAT || dsc->datatype == TYPE_UINT16);
+
+  // don't let a single huge buffer flush everything else, these only go to the disk tier
+  const gboolean huge = size > cache->cost_quota / 4;
+  if(huge)
+  {
+    if(!cache->diskdir || !spill) return;
+    char filename[PATH_MAX] = { 0 };
+    _disk_filename(cache, pipe->image.id, key, filename, sizeof(filename));
+    if(g_file_test(filename, G_FILE_TEST_EXISTS)) return;
+    // don't bother copying what the writer has no room for
+    dt_pthread_mutex_lock(&cache->queue_lock);
+    const gboolean room = cache->queued + size <= cache->queue_quota;
+    if(!room) cache->disk_dropped++;
+    dt_pthread_mutex_unlock(&cache->queue_lock);
+    if(!room) return;
+  }
+  else
+  {
+    dt_pthread_mutex_lock(&cache->lock);
+    const gboolean present = g_hash_table_contains(cache->hashtable, &key);
+    dt_pthread_mutex_unlock(&cache->lock);
+    if(present) return;
+  }
+
+  // copy outside the lock, other pipes only need it for the bookkeeping
+  dt_dev_pixelpipe_cache_shared_entry_t *entry
+      = (dt_dev_pixelpipe_cache_shared_entry_t *)g_slice_alloc(sizeof(dt_dev_pixelpipe_cache_shared_entry_t));
+  entry->data = dt_alloc_align(64, size);
+  if(!entry->data)
+  {
+    g_slice_free1(sizeof(*entry), entry);
+    return;
+  }
+  memcpy(entry->data, data, size);
+  entry->key = key;
+  entry->basichash = basichash;
+  entry->fingerprint = _shared_fingerprint(pipe);
+  entry->imgid = pipe->image.id;
+  entry->spill = spill;
+  entry->transient = FALSE;
+  entry->size = size;
+  entry->dsc = *dsc;
+  dt_pthread_rwlock_init(&entry->lock, NULL);
+
+  if(huge)
+  {
+    _disk_queue(cache, entry);
+    return;
+  }
+
+  GList *evicted = NULL;
+  dt_pthread_mutex_lock(&cache->lock);
+  if(_shared_insert(cache, entry, &evicted) == entry) cache->inserts[_shared_type_slot(pipe)]++;
+  dt_pthread_mutex_unlock(&cache->lock);
+  _shared_evicted_free(cache, evicted);
+}
+
+void dt_dev_pixelpipe_cache_shared_print(dt_dev_pixelpipe_cache_shared_t *cache)
+{
+  if(!cache) return;
+  dt_pthread_mutex_lock(&cache->lock);
+  printf("[pixelpipe_cache] shared: %u entries, %.1f/%.1f MB\n", g_hash_table_size(cache->hashtable),
+         cache->cost / (1024.0 * 1024.0), cache->cost_quota / (1024.0 * 1024.0));
+  if(cache->diskdir)
+    printf("[pixelpipe_cache] shared disk: %" PRIu64 " buffers written, %" PRIu64
+           " dropped, %.1f/%.1f MB in `%s'\n",
+           cache->disk_writes, cache->disk_dropped, cache->disk_used / (1024.0 * 1024.0),
+           cache->disk_quota / (1024.0 * 1024.0),
+           cache->diskdir);
+  for(int k = 0; k < DT_DEV_PIXELPIPE_CACHE_SHARED_TYPES; k++)
+  {
+    if(!cache->queries[k] && !cache->inserts[k]) continue;
+    printf("[pixelpipe_cache] shared [%s]: %" PRIu64 " queries, %" PRIu64 " hits (%.1f%%), %" PRIu64
+           " from disk, %" PRIu64 " inserts\n",
+           dt_pixelpipe_name((dt_dev_pixelpipe_type_t)(1 << k)), cache->queries[k], cache->hits[k],
+           cache->queries[k] ? 100.0 * (cache->hits[k] + cache->disk_hits[k]) / cache->queries[k] : 0.0,
+           cache->disk_hits[k], cache->inserts[k]);
+  }
+  dt_pthread_mutex_unlock(&cache->lock);
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -18,16 +18,22 @@
 
 #pragma once
 
+#include "common/dtpthread.h"
+#include <glib.h>
 #include <inttypes.h>
 
 struct dt_dev_pixelpipe_t;
+struct dt_dev_pixelpipe_iop_t;
 struct dt_iop_buffer_dsc_t;
 struct dt_iop_roi_t;
+struct dt_dev_pixelpipe_cache_shared_entry_t;
 
 /**
  * implements a simple pixel cache suitable for caching float images
  * corresponding to history items and zoom/pan settings in the develop module.
- * it is optimized for very few entries (~5), so most operations are O(N).
+ * lookups by hash go through an open addressing index and replacement is a
+ * segmented lru (regular and important lines), so queries are O(1) also for
+ * large numbers of entries. only the lookups by buffer pointer are O(N).
  */
 
 typedef struct dt_dev_pixelpipe_cache_t
@@ -38,7 +44,15 @@ typedef struct dt_dev_pixelpipe_cache_t
   struct dt_iop_buffer_dsc_t *dsc;
   uint64_t *basichash;
   uint64_t *hash;
-  int32_t *used;
+  // hash -> cache line, linear probing, -1 marks an empty slot
+  int32_t *index;
+  uint32_t index_mask;
+  // intrusive doubly linked lru lists, [0] for regular and [1] for important lines.
+  // the head is the least recently used line.
+  int32_t *prev, *next;
+  int8_t *important;
+  int32_t lru_head[2], lru_tail[2];
+  int32_t lru_count[2];
 #ifdef HAVE_OPENCL
   void **gpu_mem;
 #endif
@@ -53,8 +67,12 @@ typedef struct dt_dev_pixelpipe_cache_t
 int dt_dev_pixelpipe_cache_init(dt_dev_pixelpipe_cache_t *cache, int entries, size_t size);
 void dt_dev_pixelpipe_cache_cleanup(dt_dev_pixelpipe_cache_t *cache);
 
-/** creates a hopefully unique hash from the complete module stack up to the module-th. */
+/** creates a hopefully unique hash from the complete module stack up to the module-th.
+ * the prefixes are memoized in the pipe, so this is O(1) unless something before module changed. */
 uint64_t dt_dev_pixelpipe_cache_basichash(int imgid, struct dt_dev_pixelpipe_t *pipe, int module);
+/** drop the memoized basic hashes from the given piece onward, or all of them if piece is NULL. */
+void dt_dev_pixelpipe_cache_hash_invalidate(struct dt_dev_pixelpipe_t *pipe,
+                                            const struct dt_dev_pixelpipe_iop_t *piece);
 /** creates a hopefully unique hash from the complete module stack up to the module-th, including current viewport. */
 uint64_t dt_dev_pixelpipe_cache_hash(int imgid, const struct dt_iop_roi_t *roi,
                                      struct dt_dev_pixelpipe_t *pipe, int module);
@@ -95,6 +113,83 @@ void dt_dev_pixelpipe_cache_invalidate(dt_dev_pixelpipe_cache_t *cache, void *da
 /** print out cache lines/hashes (debug). */
 void dt_dev_pixelpipe_cache_print(dt_dev_pixelpipe_cache_t *cache);
 
+/**
+ * process wide second level cache, shared by all pipes (full, preview, preview2, thumbnail and export).
+ * finished module outputs are copied in there, keyed by the full hash of the producing pipe, so that
+ * another pipe processing the same image with the same history and viewport does not have to compute
+ * them again. the per-pipe cache above stays the working set, this one only ever hands out copies.
+ * entries are read locked while being copied out, eviction never touches a locked entry.
+ */
+
+// one slot of statistics for each of the dt_dev_pixelpipe_type_t bits in DT_DEV_PIXELPIPE_ANY
+#define DT_DEV_PIXELPIPE_CACHE_SHARED_TYPES 5
+
+typedef struct dt_dev_pixelpipe_cache_shared_t
+{
+  dt_pthread_mutex_t lock; // guards the hashtable, lru list and cost
+
+  size_t cost;       // bytes currently held
+  size_t cost_quota; // memory budget in bytes, 0 disables the cache
+
+  GHashTable *hashtable; // stores (key, entry) pairs
+  GList *lru;            // last element is most recently used, first is about to be kicked from cache.
+
+  // optional second tier: evicted full and export pipe buffers are compressed to files in here.
+  // NULL if disabled.
+  gchar *diskdir;
+  dt_pthread_mutex_t disk_lock; // guards disk_used and pruning
+  size_t disk_used;
+  size_t disk_quota;
+
+  // buffers are compressed and written by a background thread, so the pipes never wait for the disk.
+  // what doesn't fit into the queue is dropped.
+  dt_pthread_mutex_t queue_lock; // guards everything below
+  pthread_cond_t queue_cond;
+  pthread_t writer;
+  int writer_running;
+  int writer_stop;
+  GQueue *queue;       // entries waiting to be written, owned by the queue
+  size_t queued;       // bytes in the queue
+  size_t queue_quota;  // bytes the queue may hold
+
+  // profiling, per pipe type:
+  uint64_t queries[DT_DEV_PIXELPIPE_CACHE_SHARED_TYPES];
+  uint64_t hits[DT_DEV_PIXELPIPE_CACHE_SHARED_TYPES];
+  uint64_t disk_hits[DT_DEV_PIXELPIPE_CACHE_SHARED_TYPES];
+  uint64_t inserts[DT_DEV_PIXELPIPE_CACHE_SHARED_TYPES];
+  uint64_t disk_writes;
+  uint64_t disk_dropped;
+} dt_dev_pixelpipe_cache_shared_t;
+
+/** sets up the shared cache with the given memory budget in bytes. */
+void dt_dev_pixelpipe_cache_shared_init(dt_dev_pixelpipe_cache_shared_t *cache, size_t cost_quota);
+/** enables the disk tier in the given directory, pruning it to the quota in bytes right away. */
+void dt_dev_pixelpipe_cache_shared_set_disk(dt_dev_pixelpipe_cache_shared_t *cache, const char *dir,
+                                            size_t disk_quota);
+void dt_dev_pixelpipe_cache_shared_cleanup(dt_dev_pixelpipe_cache_shared_t *cache);
+
+/** returns the read locked entry holding the output for the given pipe and hash, or NULL if there is none.
+ * falls back to the disk tier and promotes what it finds there back to memory.
+ * the buffer is only valid until dt_dev_pixelpipe_cache_shared_release() is called. */
+struct dt_dev_pixelpipe_cache_shared_entry_t *dt_dev_pixelpipe_cache_shared_testget(dt_dev_pixelpipe_cache_shared_t *cache,
+                                                                                     struct dt_dev_pixelpipe_t *pipe,
+                                                                                     const uint64_t hash,
+                                                                                     const size_t size);
+/** copies the buffer and its description of a locked entry to the given locations. */
+void dt_dev_pixelpipe_cache_shared_copy(const struct dt_dev_pixelpipe_cache_shared_entry_t *entry, void *data,
+                                        struct dt_iop_buffer_dsc_t *dsc);
+/** drops the read lock obtained by dt_dev_pixelpipe_cache_shared_testget(). */
+void dt_dev_pixelpipe_cache_shared_release(dt_dev_pixelpipe_cache_shared_t *cache,
+                                           struct dt_dev_pixelpipe_cache_shared_entry_t *entry);
+
+/** stores a copy of the given output buffer. does nothing if it is already there or exceeds the budget. */
+void dt_dev_pixelpipe_cache_shared_put(dt_dev_pixelpipe_cache_shared_t *cache, struct dt_dev_pixelpipe_t *pipe,
+                                       const uint64_t basichash, const uint64_t hash, const void *data,
+                                       const size_t size, const struct dt_iop_buffer_dsc_t *dsc);
+
+/** print out usage and hit rates per pipe type (debug). */
+void dt_dev_pixelpipe_cache_shared_print(dt_dev_pixelpipe_cache_shared_t *cache);
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -166,6 +166,12 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->backbuf_size = size;
   if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size)) return 0;
   pipe->cache_obsolete = 0;
+  dt_pthread_mutex_init(&(pipe->hash_mutex), NULL);
+  pipe->hash_prefix = NULL;
+  pipe->hash_prefix_size = 0;
+  pipe->hash_valid = -1;
+  pipe->hash_valid_node = NULL;
+  pipe->hash_context = 0;
   pipe->backbuf = NULL;
   pipe->backbuf_scale = 0.0f;
   pipe->backbuf_zoom_x = 0.0f;
@@ -231,6 +237,10 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   dt_pthread_mutex_destroy(&(pipe->backbuf_mutex));
   dt_pthread_mutex_destroy(&(pipe->busy_mutex));
+  free(pipe->hash_prefix);
+  pipe->hash_prefix = NULL;
+  pipe->hash_prefix_size = 0;
+  dt_pthread_mutex_destroy(&(pipe->hash_mutex));
   pipe->icc_type = DT_COLORSPACE_NONE;
   g_free(pipe->icc_filename);
   pipe->icc_filename = NULL;
@@ -274,6 +284,7 @@ void dt_dev_pixelpipe_cleanup_nodes(dt_dev_pixelpipe_t *pipe)
   }
   g_list_free(pipe->nodes);
   pipe->nodes = NULL;
+  dt_dev_pixelpipe_cache_hash_invalidate(pipe, NULL);
   // also cleanup iop here
   if(pipe->iop)
   {
@@ -329,6 +340,7 @@ void dt_dev_pixelpipe_create_nodes(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev)
     pipe->nodes = g_list_append(pipe->nodes, piece);
     modules = g_list_next(modules);
   }
+  dt_dev_pixelpipe_cache_hash_invalidate(pipe, NULL);
   dt_pthread_mutex_unlock(&pipe->busy_mutex); // safe for others to use/mess with the pipe now
 }
 
@@ -1170,6 +1182,20 @@ static int pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
   return 0; //no errors
 }
 
+// can the output of this module be exchanged with the shared cache? anything which has side effects
+// during processing (histograms, color pickers, raster masks for later modules) or depends on the
+// display state of darkroom has to be computed by the pipe itself.
+static gboolean _pixelpipe_cache_shared_usable(dt_dev_pixelpipe_t *pipe, dt_iop_module_t *module,
+                                               dt_dev_pixelpipe_iop_t *piece, const uint64_t hash)
+{
+  return darktable.pixelpipe_cache && module && hash
+         && pipe->mask_display == DT_DEV_PIXELPIPE_DISPLAY_NONE
+         && strcmp(module->op, "gamma") != 0
+         && module->request_color_pick == DT_REQUEST_COLORPICK_OFF
+         && !(piece->request_histogram & DT_REQUEST_ON)
+         && !(module->raster_mask.source.users && g_hash_table_size(module->raster_mask.source.users) > 0);
+}
+
 // recursive helper for process:
 static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
                                         void **cl_mem_output, dt_iop_buffer_dsc_t **out_format,
@@ -1237,6 +1263,20 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     // go to post-collect directly:
     goto post_process_collect_info;
   }
+  else if(_pixelpipe_cache_shared_usable(pipe, module, piece, hash))
+  {
+    // maybe another pipe of the same kind already did the work for us
+    struct dt_dev_pixelpipe_cache_shared_entry_t *entry
+        = dt_dev_pixelpipe_cache_shared_testget(darktable.pixelpipe_cache, pipe, hash, bufsize);
+    if(entry)
+    {
+      (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), basichash, hash, bufsize, output, out_format);
+      dt_dev_pixelpipe_cache_shared_copy(entry, *output, *out_format);
+      dt_dev_pixelpipe_cache_shared_release(darktable.pixelpipe_cache, entry);
+      piece->dsc_out = **out_format;
+      goto post_process_collect_info;
+    }
+  }
 
   // 2) if history changed or exit event, abort processing?
   // preview pipe: abort on all but zoom events (same buffer anyways)
@@ -2026,6 +2066,12 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     // in case we get this buffer from the cache in the future, cache some stuff:
     **out_format = piece->dsc_out = pipe->dsc;
 
+    // publish finished cpu buffers to the other pipes
+    if(*cl_mem_output == NULL && _pixelpipe_cache_shared_usable(pipe, module, piece, hash))
+      dt_dev_pixelpipe_cache_shared_put(darktable.pixelpipe_cache, pipe, basichash, hash, *output,
+                                        dt_iop_buffer_dsc_to_bpp(*out_format) * roi_out->width * roi_out->height,
+                                        *out_format);
+
     if(module == darktable.develop->gui_module)
     {
       // give the input buffer to the currently focused plugin more weight.
@@ -2302,7 +2348,11 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
 
   dt_iop_roi_t roi = (dt_iop_roi_t){ x, y, width, height, scale };
   // printf("pixelpipe homebrew process start\n");
-  if(darktable.unmuted & DT_DEBUG_DEV) dt_dev_pixelpipe_cache_print(&pipe->cache);
+  if(darktable.unmuted & DT_DEBUG_DEV)
+  {
+    dt_dev_pixelpipe_cache_print(&pipe->cache);
+    dt_dev_pixelpipe_cache_shared_print(darktable.pixelpipe_cache);
+  }
 
   // get a snapshot of mask list
   if(pipe->forms) g_list_free_full(pipe->forms, (void (*)(void *))dt_masks_free_form);
@@ -95,6 +95,15 @@ typedef struct dt_dev_pixelpipe_t
   dt_dev_pixelpipe_cache_t cache;
   // set to non-zero in order to obsolete old cache entries on next pixelpipe run
   int cache_obsolete;
+  // memoized basic hashes, hash_prefix[k] covers the first k pieces. see dt_dev_pixelpipe_cache_basichash()
+  dt_pthread_mutex_t hash_mutex;
+  uint64_t *hash_prefix;
+  int hash_prefix_size;
+  // hash_prefix[0..hash_valid] is up to date, hash_valid_node is the piece following it
+  int hash_valid;
+  GList *hash_valid_node;
+  // image, fast mode and focused module the prefixes have been computed for
+  uint64_t hash_context;
   // input buffer
   float *input;
   // width and height of input buffer
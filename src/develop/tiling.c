@@ -43,6 +43,10 @@
    Needs to be increased if tiling fails due to insufficient buffer sizes. */
 #define RESERVE 5
 
+/* number of threads per tile and maximum number of tiles when tiles are processed in parallel */
+#define TILING_TEAM_SIZE 4
+#define TILING_MAX_TEAMS 8
+
 
 /* greatest common divisor */
 static unsigned _gcd(unsigned a, unsigned b)
@@ -579,14 +583,282 @@ static int _fit_output_to_input_roi(struct dt_iop_module_t *self, struct dt_dev_
 }
 
 
+/* one tile of the cpu code path: the regions handed to process() and where the good part goes */
+typedef struct _tiling_tile_t
+{
+  size_t tx, ty;
+  dt_iop_roi_t iroi, oroi;
+  size_t ioffs, ooffs;   // offsets of the input tile and of the good part of the output into ivoid and ovoid
+  int origin_x, origin_y; // position of the good part inside the output tile
+  int good_wd, good_ht;
+  float processed_maximum[4];
+  double time;
+} _tiling_tile_t;
+
+/* all tiles of one module call, shared by the workers that process them */
+typedef struct _tiling_job_t
+{
+  struct dt_iop_module_t *self;
+  struct dt_dev_pixelpipe_iop_t *piece;
+  struct dt_dev_pixelpipe_t *pipe; // the real pipe, the workers' copies don't see its shutdown requests
+  const void *ivoid;
+  void *ovoid;
+  int in_bpp, out_bpp, ipitch, opitch;
+  _tiling_tile_t *tiles;
+  int num_tiles;
+  int next;    // next tile to be picked up, protected by lock
+  int aborted; // the pipe got shut down before all tiles were picked up, protected by lock
+  dt_pthread_mutex_t lock;
+  float processed_maximum_saved[4];
+  const char *caller;
+} _tiling_job_t;
+
+typedef struct _tiling_worker_t
+{
+  _tiling_job_t *job;
+  int num;
+  int num_threads; // size of the openmp team of this worker
+  void *input;
+  void *output;
+} _tiling_worker_t;
+
+static void _tiling_worker_run(_tiling_worker_t *w, struct dt_dev_pixelpipe_iop_t *piece)
+{
+  _tiling_job_t *job = w->job;
+  struct dt_iop_module_t *self = job->self;
+  const void *const ivoid = job->ivoid;
+  void *const ovoid = job->ovoid;
+  void *const input = w->input;
+  void *const output = w->output;
+  const int in_bpp = job->in_bpp;
+  const int out_bpp = job->out_bpp;
+  const int ipitch = job->ipitch;
+  const int opitch = job->opitch;
+
+  while(TRUE)
+  {
+    dt_pthread_mutex_lock(&job->lock);
+    if(dt_atomic_get_int(&job->pipe->shutdown)) job->aborted = TRUE;
+    const int t = job->aborted ? job->num_tiles : job->next++;
+    dt_pthread_mutex_unlock(&job->lock);
+    if(t >= job->num_tiles) break;
+
+    _tiling_tile_t *tile = job->tiles + t;
+    const double start = dt_get_wtime();
+
+    piece->pipe->tiling = 1;
+
+    /* prepare input tile buffer */
+    const size_t ioffs = tile->ioffs;
+    const size_t iwd = tile->iroi.width;
+    const size_t iht = tile->iroi.height;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(iht, in_bpp, input, ioffs, ipitch, ivoid, iwd) \
+    schedule(static)
+#endif
+    for(size_t j = 0; j < iht; j++)
+      memcpy((char *)input + j * iwd * in_bpp, (char *)ivoid + ioffs + j * ipitch, (size_t)iwd * in_bpp);
+
+    /* take original processed_maximum as starting point */
+    for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = job->processed_maximum_saved[k];
+
+    /* call process() of module */
+    self->process(self, piece, input, output, &tile->iroi, &tile->oroi);
+
+    for(int k = 0; k < 4; k++) tile->processed_maximum[k] = piece->pipe->dsc.processed_maximum[k];
+
+    /* copy "good" part of tile to output buffer */
+    const size_t ooffs = tile->ooffs;
+    const size_t owd = tile->oroi.width;
+    const size_t origin_x = tile->origin_x;
+    const size_t origin_y = tile->origin_y;
+    const size_t good_wd = tile->good_wd;
+    const size_t good_ht = tile->good_ht;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(good_ht, good_wd, ooffs, opitch, origin_x, origin_y, out_bpp, output, ovoid, owd) \
+    schedule(static)
+#endif
+    for(size_t j = 0; j < good_ht; j++)
+      memcpy((char *)ovoid + ooffs + j * opitch, (char *)output + ((j + origin_y) * owd + origin_x) * out_bpp,
+             good_wd * out_bpp);
+
+    tile->time = dt_get_wtime() - start;
+    dt_print(DT_DEBUG_TILING, "[%s] tile (%zu, %zu) of module '%s' took %.3f secs on worker %d\n", job->caller,
+             tile->tx, tile->ty, self->op, tile->time, w->num);
+  }
+}
+
+/* runs a worker with its own copy of piece and pipe: process() stores processed_maximum in there */
+static void _tiling_worker_run_copy(_tiling_worker_t *w)
+{
+  dt_dev_pixelpipe_t pipe = *w->job->piece->pipe;
+  dt_dev_pixelpipe_iop_t piece = *w->job->piece;
+  piece.pipe = &pipe;
+  _tiling_worker_run(w, &piece);
+}
+
+static void *_tiling_worker_thread(void *arg)
+{
+  _tiling_worker_t *w = (_tiling_worker_t *)arg;
+  dt_pthread_setname("tiling");
+#ifdef _OPENMP
+  omp_set_num_threads(w->num_threads);
+#endif
+  _tiling_worker_run_copy(w);
+  return NULL;
+}
+
+/* number of tiles to be processed at the same time. only export pipes do that, and only for modules
+   which declare that their process() may run concurrently on the same piece. every tile gets its own
+   team of threads and its own share of the memory budget, which has to leave room for at least
+   singlebuffer bytes per buffer of a tile. */
+static int _tiling_teams(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                         const dt_develop_tiling_t *tiling, const float available, const float singlebuffer)
+{
+  if(!(piece->pipe->type & DT_DEV_PIXELPIPE_EXPORT) || !(self->flags() & IOP_FLAGS_TILING_PARALLEL)) return 1;
+
+#ifdef _OPENMP
+  int teams = _min(omp_get_max_threads() / TILING_TEAM_SIZE, TILING_MAX_TEAMS);
+#else
+  int teams = 1;
+#endif
+  const float factor = fmax(tiling->factor, 1.0f);
+  while(teams > 1 && (available - (teams - 1) * tiling->overhead) / teams < factor * singlebuffer) teams--;
+
+  return _max(teams, 1);
+}
+
+/* process all tiles, with up to teams workers at the same time. returns non zero if not even
+   the buffers of a single worker could be allocated. */
+static int _process_tiles(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                          const void *const ivoid, void *const ovoid, _tiling_tile_t *tiles, const int num_tiles,
+                          const int in_bpp, const int out_bpp, const int ipitch, const int opitch,
+                          const int teams, const char *caller)
+{
+  size_t in_size = 0, out_size = 0;
+  for(int t = 0; t < num_tiles; t++)
+  {
+    in_size = MAX(in_size, (size_t)tiles[t].iroi.width * tiles[t].iroi.height * in_bpp);
+    out_size = MAX(out_size, (size_t)tiles[t].oroi.width * tiles[t].oroi.height * out_bpp);
+  }
+
+  _tiling_job_t job = { .self = self, .piece = piece, .ivoid = ivoid, .ovoid = ovoid, .in_bpp = in_bpp,
+                        .out_bpp = out_bpp, .ipitch = ipitch, .opitch = opitch, .tiles = tiles,
+                        .num_tiles = num_tiles, .next = 0, .aborted = FALSE, .caller = caller,
+                        .pipe = piece->pipe };
+  dt_pthread_mutex_init(&job.lock, NULL);
+
+  /* store processed_maximum to be re-used and aggregated */
+  for(int k = 0; k < 4; k++) job.processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
+
+  /* reserve input and output buffers for tiles, one pair per worker */
+  const int max_workers = _max(_min(teams, num_tiles), 1);
+  _tiling_worker_t *workers = calloc(max_workers, sizeof(_tiling_worker_t));
+  int num_workers = 0;
+  for(; num_workers < max_workers; num_workers++)
+  {
+    _tiling_worker_t *w = workers + num_workers;
+    w->job = &job;
+    w->num = num_workers;
+    w->input = dt_alloc_align(64, in_size);
+    w->output = dt_alloc_align(64, out_size);
+    if(w->input == NULL || w->output == NULL)
+    {
+      if(w->input != NULL) dt_free_align(w->input);
+      if(w->output != NULL) dt_free_align(w->output);
+      break;
+    }
+  }
+
+  if(num_workers == 0)
+  {
+    dt_print(DT_DEBUG_DEV, "[%s] could not alloc tile buffers for module '%s'\n", caller, self->op);
+    free(workers);
+    dt_pthread_mutex_destroy(&job.lock);
+    return 1;
+  }
+
+  const double start = dt_get_wtime();
+
+  if(num_workers == 1)
+  {
+    _tiling_worker_run(workers, piece);
+  }
+  else
+  {
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+#else
+    const int max_threads = 1;
+#endif
+    pthread_t *threads = calloc(num_workers, sizeof(pthread_t));
+    int started = 0;
+    for(int k = 0; k < num_workers; k++) workers[k].num_threads = _max(max_threads / num_workers, 1);
+    // workers which failed to start simply leave their tiles to the others
+    for(int k = 1; k < num_workers; k++)
+      if(!dt_pthread_create(threads + started, _tiling_worker_thread, workers + k)) started++;
+
+    // this thread does its share, too
+#ifdef _OPENMP
+    omp_set_num_threads(workers[0].num_threads);
+#endif
+    _tiling_worker_run_copy(workers);
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif
+    for(int k = 0; k < started; k++) pthread_join(threads[k], NULL);
+    free(threads);
+  }
+
+  if(job.aborted)
+  {
+    /* the output is going to be thrown away, don't bother with the remaining tiles */
+    for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = job.processed_maximum_saved[k];
+    dt_print(DT_DEBUG_TILING, "[%s] module '%s' aborted after %d of %d tiles, the pipe is shutting down\n",
+             caller, self->op, MIN(job.next, num_tiles), num_tiles);
+    goto cleanup;
+  }
+
+  /* aggregate resulting processed_maximum, the last tile wins like it always did */
+  /* TODO: check if there really can be differences between tiles and take
+           appropriate action (calculate minimum, maximum, average, ...?) */
+  double busy = 0.0;
+  for(int t = 0; t < num_tiles; t++)
+  {
+    for(int k = 0; k < 4; k++)
+      if(t > 0 && fabs(tiles[t].processed_maximum[k] - tiles[t - 1].processed_maximum[k]) > 1.0e-6f)
+        dt_print(DT_DEBUG_DEV, "[%s] processed_maximum[%d] differs between tiles in module '%s'\n", caller, k,
+                 self->op);
+    busy += tiles[t].time;
+  }
+
+  /* copy back final processed_maximum */
+  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = tiles[num_tiles - 1].processed_maximum[k];
+
+  dt_print(DT_DEBUG_TILING, "[%s] %d tiles of module '%s' took %.3f secs on %d worker(s), %.3f secs in tiles\n",
+           caller, num_tiles, self->op, dt_get_wtime() - start, num_workers, busy);
+
+cleanup:
+  for(int k = 0; k < num_workers; k++)
+  {
+    dt_free_align(workers[k].input);
+    dt_free_align(workers[k].output);
+  }
+  free(workers);
+  dt_pthread_mutex_destroy(&job.lock);
+  return 0;
+}
+
+
 /* simple tiling algorithm for roi_in == roi_out, i.e. for pixel to pixel modules/operations */
 static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                                         const void *const ivoid, void *const ovoid,
                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                                         const int in_bpp)
 {
-  void *input = NULL;
-  void *output = NULL;
+  _tiling_tile_t *tiles = NULL;
   dt_iop_buffer_dsc_t dsc;
   self->output_format(self, piece->pipe, piece, &dsc);
   const int out_bpp = dt_iop_buffer_dsc_to_bpp(&dsc);
@@ -624,7 +896,9 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   singlebuffer = fmax(singlebuffer, 2.0f * 1024.0f * 1024.0f);
   float factor = fmax(tiling.factor, 1.0f);
   float maxbuf = fmax(tiling.maxbuf, 1.0f);
-  singlebuffer = fmax(available / factor, singlebuffer);
+  /* tiles processed at the same time share the budget */
+  int teams = _tiling_teams(self, piece, &tiling, available, singlebuffer);
+  singlebuffer = fmax(available / (factor * teams), singlebuffer);
 
   int width = roi_in->width;
   int height = roi_in->height;
@@ -700,119 +974,56 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
            "[default_process_tiling_ptp] (%d x %d) tiles with max dimensions %d x %d and overlap %d\n",
            tiles_x, tiles_y, width, height, overlap);
 
-  /* reserve input and output buffers for tiles */
-  input = dt_alloc_align(64, (size_t)width * height * in_bpp);
-  if(input == NULL)
-  {
-    dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc input buffer for module '%s'\n",
-             self->op);
-    goto error;
-  }
-  output = dt_alloc_align(64, (size_t)width * height * out_bpp);
-  if(output == NULL)
-  {
-    dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] could not alloc output buffer for module '%s'\n",
-             self->op);
-    goto error;
-  }
-
-  /* store processed_maximum to be re-used and aggregated */
-  float processed_maximum_saved[4];
-  float processed_maximum_new[4] = { 1.0f };
-  for(int k = 0; k < 4; k++) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
-
+  /* all tiles in flight together with ivoid and ovoid have to fit into host memory */
+  const size_t buffers = (size_t)roi_out->width * roi_out->height * out_bpp
+                         + (size_t)roi_in->width * roi_in->height * in_bpp;
+  if(teams > 1
+     && !dt_tiling_piece_fits_host_memory(width, height, max_bpp, factor * teams, teams * tiling.overhead + buffers))
+    teams = 1;
 
-  /* iterate over tiles */
+  /* collect the tiles */
+  tiles = calloc((size_t)tiles_x * tiles_y, sizeof(_tiling_tile_t));
+  int num_tiles = 0;
   for(size_t tx = 0; tx < tiles_x; tx++)
   {
     const size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
-      piece->pipe->tiling = 1;
-
       const size_t ht = ty * tile_ht + height > roi_in->height ? roi_in->height - ty * tile_ht : height;
 
       /* no need to process end-tiles that are smaller than the total overlap area */
       if((wd <= 2 * overlap && tx > 0) || (ht <= 2 * overlap && ty > 0)) continue;
 
-      /* origin and region of effective part of tile, which we want to store later */
-      size_t origin[] = { 0, 0, 0 };
-      size_t region[] = { wd, ht, 1 };
+      _tiling_tile_t *tile = tiles + num_tiles++;
+      tile->tx = tx;
+      tile->ty = ty;
 
-      /* roi_in and roi_out for process_cl on subbuffer */
-      dt_iop_roi_t iroi = { roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
-      dt_iop_roi_t oroi = { roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
+      /* roi_in and roi_out for process() on the tile */
+      tile->iroi = (dt_iop_roi_t){ roi_in->x + tx * tile_wd, roi_in->y + ty * tile_ht, wd, ht, roi_in->scale };
+      tile->oroi = (dt_iop_roi_t){ roi_out->x + tx * tile_wd, roi_out->y + ty * tile_ht, wd, ht, roi_out->scale };
 
       /* offsets of tile into ivoid and ovoid */
-      size_t ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
-      size_t ooffs = (ty * tile_ht) * opitch + (tx * tile_wd) * out_bpp;
+      tile->ioffs = (ty * tile_ht) * ipitch + (tx * tile_wd) * in_bpp;
+      tile->ooffs = (ty * tile_ht) * opitch + (tx * tile_wd) * out_bpp;
 
+      /* origin and region of effective part of tile, corrected for overlap.
+         make sure that we only copy back the "good" part. */
+      tile->origin_x = tx > 0 ? overlap : 0;
+      tile->origin_y = ty > 0 ? overlap : 0;
+      tile->good_wd = wd - tile->origin_x;
+      tile->good_ht = ht - tile->origin_y;
+      tile->ooffs += tile->origin_y * opitch + tile->origin_x * out_bpp;
 
       dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] tile (%zu, %zu) with %zu x %zu at origin [%zu, %zu]\n",
                tx, ty, wd, ht, tx * tile_wd, ty * tile_ht);
-
-/* prepare input tile buffer */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(ht, in_bpp, ipitch, ivoid, wd) \
-      shared(input, width, ioffs) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < ht; j++)
-        memcpy((char *)input + j * wd * in_bpp, (char *)ivoid + ioffs + j * ipitch, (size_t)wd * in_bpp);
-
-      /* take original processed_maximum as starting point */
-      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
-
-      /* call process() of module */
-      self->process(self, piece, input, output, &iroi, &oroi);
-
-      /* aggregate resulting processed_maximum */
-      /* TODO: check if there really can be differences between tiles and take
-               appropriate action (calculate minimum, maximum, average, ...?) */
-      for(int k = 0; k < 4; k++)
-      {
-        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
-          dt_print(
-              DT_DEBUG_DEV,
-              "[default_process_tiling_ptp] processed_maximum[%d] differs between tiles in module '%s'\n", k,
-              self->op);
-        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
-      }
-
-      /* correct origin and region of tile for overlap.
-         make sure that we only copy back the "good" part. */
-      if(tx > 0)
-      {
-        origin[0] += overlap;
-        region[0] -= overlap;
-        ooffs += overlap * out_bpp;
-      }
-      if(ty > 0)
-      {
-        origin[1] += overlap;
-        region[1] -= overlap;
-        ooffs += overlap * opitch;
-      }
-
-/* copy "good" part of tile to output buffer */
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(opitch, out_bpp, ovoid, wd) \
-      shared(ooffs, output, width, origin, region) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < region[1]; j++)
-        memcpy((char *)ovoid + ooffs + j * opitch,
-               (char *)output + ((j + origin[1]) * wd + origin[0]) * out_bpp, (size_t)region[0] * out_bpp);
     }
   }
 
-  /* copy back final processed_maximum */
-  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+  if(_process_tiles(self, piece, ivoid, ovoid, tiles, num_tiles, in_bpp, out_bpp, ipitch, opitch, teams,
+                    "default_process_tiling_ptp"))
+    goto error;
 
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  free(tiles);
   piece->pipe->tiling = 0;
   return;
 
@@ -821,8 +1032,7 @@ error:
 // fall through
 
 fallback:
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  free(tiles);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_ptp] fall back to standard processing for module '%s'\n",
            self->op);
@@ -839,8 +1049,7 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
                                         const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
                                         const int in_bpp)
 {
-  void *input = NULL;
-  void *output = NULL;
+  _tiling_tile_t *tiles = NULL;
 
   //_print_roi(roi_in, "module roi_in");
   //_print_roi(roi_out, "module roi_out");
@@ -891,7 +1100,9 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
   singlebuffer = fmax(singlebuffer, 2.0f * 1024.0f * 1024.0f);
   float factor = fmax(tiling.factor, 1.0f);
   float maxbuf = fmax(tiling.maxbuf, 1.0f);
-  singlebuffer = fmax(available / factor, singlebuffer);
+  /* tiles processed at the same time share the budget */
+  int teams = _tiling_teams(self, piece, &tiling, available, singlebuffer);
+  singlebuffer = fmax(available / (factor * teams), singlebuffer);
 
   int width = _max(roi_in->width, roi_out->width);
   int height = _max(roi_in->height, roi_out->height);
@@ -983,17 +1194,19 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
            tiles_x, tiles_y, width, height);
 
 
-  /* store processed_maximum to be re-used and aggregated */
-  float processed_maximum_saved[4];
-  float processed_maximum_new[4] = { 1.0f };
-  for(int k = 0; k < 4; k++) processed_maximum_saved[k] = piece->pipe->dsc.processed_maximum[k];
+  /* all tiles in flight together with ivoid and ovoid have to fit into host memory */
+  const size_t buffers = (size_t)roi_out->width * roi_out->height * out_bpp
+                         + (size_t)roi_in->width * roi_in->height * in_bpp;
+  if(teams > 1
+     && !dt_tiling_piece_fits_host_memory(width, height, max_bpp, factor * teams, teams * tiling.overhead + buffers))
+    teams = 1;
 
-  /* iterate over tiles */
+  /* collect the tiles */
+  tiles = calloc((size_t)tiles_x * tiles_y, sizeof(_tiling_tile_t));
+  int num_tiles = 0;
   for(size_t tx = 0; tx < tiles_x; tx++)
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
-      piece->pipe->tiling = 1;
-
       /* the output dimensions of the good part of this specific tile */
       size_t wd = (tx + 1) * tile_wd > roi_out->width ? roi_out->width - tx * tile_wd : tile_wd;
       size_t ht = (ty + 1) * tile_ht > roi_out->height ? roi_out->height - ty * tile_ht : tile_ht;
@@ -1085,75 +1298,26 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
                tx, ty, iroi_full.width, iroi_full.height, iroi_full.x, iroi_full.y);
 
 
-      /* prepare input tile buffer */
-      input = dt_alloc_align(64, (size_t)iroi_full.width * iroi_full.height * in_bpp);
-      if(input == NULL)
-      {
-        dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] could not alloc input buffer for module '%s'\n",
-                 self->op);
-        goto error;
-      }
-      output = dt_alloc_align(64, (size_t)oroi_full.width * oroi_full.height * out_bpp);
-      if(output == NULL)
-      {
-        dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] could not alloc output buffer for module '%s'\n",
-                 self->op);
-        goto error;
-      }
+      _tiling_tile_t *tile = tiles + num_tiles++;
+      tile->tx = tx;
+      tile->ty = ty;
+      tile->iroi = iroi_full;
+      tile->oroi = oroi_full;
+      tile->ioffs = ioffs;
+      tile->ooffs = ooffs;
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(in_bpp, ipitch, ivoid) \
-      shared(input, ioffs, iroi_full) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < iroi_full.height; j++)
-        memcpy((char *)input + j * iroi_full.width * in_bpp, (char *)ivoid + ioffs + j * ipitch,
-               (size_t)iroi_full.width * in_bpp);
-
-      /* take original processed_maximum as starting point */
-      for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
-
-      /* call process() of module */
-      self->process(self, piece, input, output, &iroi_full, &oroi_full);
-
-      /* aggregate resulting processed_maximum */
-      /* TODO: check if there really can be differences between tiles and take
-               appropriate action (calculate minimum, maximum, average, ...?) */
-      for(int k = 0; k < 4; k++)
-      {
-        if(tx + ty > 0 && fabs(processed_maximum_new[k] - piece->pipe->dsc.processed_maximum[k]) > 1.0e-6f)
-          dt_print(
-              DT_DEBUG_DEV,
-              "[default_process_tiling_roi] processed_maximum[%d] differs between tiles in module '%s'\n", k,
-              self->op);
-        processed_maximum_new[k] = piece->pipe->dsc.processed_maximum[k];
-      }
-
-      /* copy "good" part of tile to output buffer */
-      const int origin_x = oroi_good.x - oroi_full.x;
-      const int origin_y = oroi_good.y - oroi_full.y;
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-      dt_omp_firstprivate(opitch, origin_x, origin_y, out_bpp, ovoid) \
-      shared(ooffs, output, oroi_good, oroi_full) \
-      schedule(static)
-#endif
-      for(size_t j = 0; j < oroi_good.height; j++)
-        memcpy((char *)ovoid + ooffs + j * opitch,
-               (char *)output + ((j + origin_y) * oroi_full.width + origin_x) * out_bpp,
-               (size_t)oroi_good.width * out_bpp);
-
-      dt_free_align(input);
-      dt_free_align(output);
-      input = output = NULL;
+      /* only the "good" part of the tile is copied to the output buffer */
+      tile->origin_x = oroi_good.x - oroi_full.x;
+      tile->origin_y = oroi_good.y - oroi_full.y;
+      tile->good_wd = oroi_good.width;
+      tile->good_ht = oroi_good.height;
     }
 
-  /* copy back final processed_maximum */
-  for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
+  if(_process_tiles(self, piece, ivoid, ovoid, tiles, num_tiles, in_bpp, out_bpp, ipitch, opitch, teams,
+                    "default_process_tiling_roi"))
+    goto error;
 
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  free(tiles);
   piece->pipe->tiling = 0;
   return;
 
@@ -1162,8 +1326,7 @@ error:
 // fall through
 
 fallback:
-  if(input != NULL) dt_free_align(input);
-  if(output != NULL) dt_free_align(output);
+  free(tiles);
   piece->pipe->tiling = 0;
   dt_print(DT_DEBUG_DEV, "[default_process_tiling_roi] fall back to standard processing for module '%s'\n",
            self->op);
@@ -74,32 +74,12 @@ static int _get_selection_count()
 // get imgid from rowid
 static int _thumb_get_imgid(int rowid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = dt_util_dstrcat(NULL, "SELECT imgid FROM memory.collected_images WHERE rowid=%d", rowid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_collected_imgid(darktable.collection, rowid);
 }
 // get rowid from imgid
 static int _thumb_get_rowid(int imgid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = dt_util_dstrcat(NULL, "SELECT rowid FROM memory.collected_images WHERE imgid=%d", imgid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_collected_rowid(darktable.collection, imgid);
 }
 
 // compute thumb_size, thumbs_per_row and rows for the current widget size
@@ -285,22 +265,12 @@ static void _thumbs_move(dt_culling_t *table, int move)
     }
     else
     {
-      sqlite3_stmt *stmt;
-      gchar *query = dt_util_dstrcat(NULL,
-                                     "SELECT COUNT(m.rowid) FROM memory.collected_images as m "
-                                     "WHERE m.rowid>%d",
-                                     table->offset);
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-      if(sqlite3_step(stmt) == SQLITE_ROW)
+      // number of images after the offset one
+      const int nb = MAX(0, dt_collection_collected_count(darktable.collection) - table->offset);
+      if(nb >= table->thumbs_count)
       {
-        const int nb = sqlite3_column_int(stmt, 0);
-        if(nb >= table->thumbs_count)
-        {
-          new_offset = table->offset + MIN(nb + 1 - table->thumbs_count, move);
-        }
+        new_offset = table->offset + MIN(nb + 1 - table->thumbs_count, move);
       }
-      g_free(query);
-      sqlite3_finalize(stmt);
       if(new_offset == table->offset)
       {
         dt_control_log(_("you have reached the end of your collection"));
@@ -1014,6 +984,7 @@ static void _thumbs_prefetch(dt_culling_t *table)
   // prefetch next image
   gchar *query;
   sqlite3_stmt *stmt;
+  int id = -1;
   dt_thumbnail_t *last = (dt_thumbnail_t *)g_list_last(table->list)->data;
   if(table->navigate_inside_selection)
   {
@@ -1026,28 +997,20 @@ static void _thumbs_prefetch(dt_culling_t *table)
                           "ORDER BY m.rowid "
                           "LIMIT 1",
                           last->imgid);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    g_free(query);
   }
   else
   {
-    query
-        = dt_util_dstrcat(NULL,
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m "
-                          "WHERE m.rowid > (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid "
-                          "LIMIT 1",
-                          last->imgid);
+    const int rowid = _thumb_get_rowid(last->imgid);
+    if(rowid > 0) id = _thumb_get_imgid(rowid + 1);
   }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
-  }
-  sqlite3_finalize(stmt);
-  g_free(query);
+  if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
 
   // prefetch previous image
+  id = -1;
   dt_thumbnail_t *prev = (dt_thumbnail_t *)g_list_first(table->list)->data;
   if(table->navigate_inside_selection)
   {
@@ -1060,25 +1023,17 @@ static void _thumbs_prefetch(dt_culling_t *table)
                           "ORDER BY m.rowid DESC "
                           "LIMIT 1",
                           prev->imgid);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    if(sqlite3_step(stmt) == SQLITE_ROW) id = sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+    g_free(query);
   }
   else
   {
-    query
-        = dt_util_dstrcat(NULL,
-                          "SELECT m.imgid "
-                          "FROM memory.collected_images AS m "
-                          "WHERE m.rowid < (SELECT mm.rowid FROM memory.collected_images AS mm WHERE mm.imgid=%d) "
-                          "ORDER BY m.rowid DESC "
-                          "LIMIT 1",
-                          prev->imgid);
-  }
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    const int id = sqlite3_column_int(stmt, 0);
-    if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
+    const int rowid = _thumb_get_rowid(prev->imgid);
+    if(rowid > 1) id = _thumb_get_imgid(rowid - 1);
   }
-  sqlite3_finalize(stmt);
+  if(id > 0) dt_mipmap_cache_get(darktable.mipmap_cache, NULL, id, mip, DT_MIPMAP_PREFETCH, 'r');
 }
 
 static gboolean _thumbs_recreate_list_at(dt_culling_t *table, const int offset)
@@ -25,6 +25,7 @@
 #include "common/focus_peaking.h"
 #include "common/grouping.h"
 #include "common/image_cache.h"
+#include "common/mipmap_cache.h"
 #include "common/ratings.h"
 #include "common/selection.h"
 #include "common/variables.h"
@@ -101,9 +102,7 @@ static void _image_update_group_tooltip(dt_thumbnail_t *thumb)
 
   // and the other images
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id, version, filename FROM main.images WHERE group_id = ?1", -1, &stmt,
-                              NULL);
+  stmt = dt_database_get_statement(darktable.db, "SELECT id, version, filename FROM main.images WHERE group_id = ?1");
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, thumb->groupid);
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -122,7 +121,7 @@ static void _image_update_group_tooltip(dt_thumbnail_t *thumb)
       }
     }
   }
-  sqlite3_finalize(stmt);
+  dt_database_release_statement(darktable.db, stmt);
 
   // and the number of grouped images
   gchar *ttf = dt_util_dstrcat(NULL, "%d %s\n%s", nb, _("grouped images"), tt);
@@ -418,6 +417,7 @@ static gboolean _event_image_draw(GtkWidget *widget, cairo_t *cr, gpointer user_
     {
       gboolean res;
       cairo_surface_t *img_surf = NULL;
+      dt_mipmap_cache_set_load_owner(thumb->load_owner);
       if(thumb->zoomable)
       {
         if(thumb->zoom > 1.0f) thumb->zoom = MIN(thumb->zoom, dt_thumbnail_get_zoom100(thumb));
@@ -427,6 +427,7 @@ static gboolean _event_image_draw(GtkWidget *widget, cairo_t *cr, gpointer user_
       {
         res = dt_view_image_get_surface(thumb->imgid, image_w, image_h, &img_surf, FALSE);
       }
+      dt_mipmap_cache_set_load_owner(NULL);
 
       if(res)
       {
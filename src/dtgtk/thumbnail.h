@@ -135,6 +135,8 @@ typedef struct
   gboolean display_focus; // do we display rectangles to show focused part of the image
 
   gboolean busy; // should we show the busy message ?
+
+  const void *load_owner; // tags the image loads this thumbnail schedules, see dt_mipmap_cache_set_load_owner()
 } dt_thumbnail_t;
 
 dt_thumbnail_t *dt_thumbnail_new(int width, int height, int imgid, int rowid, dt_thumbnail_overlay_t over,
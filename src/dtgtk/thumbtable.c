@@ -21,6 +21,7 @@
 #include "common/colorlabels.h"
 #include "common/debug.h"
 #include "common/history.h"
+#include "common/image_cache.h"
 #include "common/ratings.h"
 #include "common/selection.h"
 #include "control/control.h"
@@ -84,6 +85,23 @@ static int _thumbs_get_prefs_size(dt_thumbtable_t *table)
   return i;
 }
 
+// thumbnails of this table which were requested for display but are no longer on screen
+static gboolean _thumbs_load_is_stale(dt_job_t *job, void *data)
+{
+  dt_thumbtable_t *table = (dt_thumbtable_t *)data;
+  // loads for other views and plain prefetches (no deadline) are left alone
+  if(dt_image_load_job_get_owner(job) != table || dt_control_job_get_deadline(job) == 0.0) return FALSE;
+  const int32_t imgid = dt_image_load_job_get_imgid(job);
+  return g_list_find_custom(table->list, GINT_TO_POINTER(imgid), _list_compare_by_imgid) == NULL;
+}
+
+static void _thumbs_discard_stale_loads(dt_thumbtable_t *table)
+{
+  const int count
+      = dt_control_discard_jobs(darktable.control, DT_JOB_QUEUE_SYSTEM_FG, _thumbs_load_is_stale, table);
+  if(count > 0) dt_print(DT_DEBUG_LIGHTTABLE, "[thumbtable] dropped %d thumbnail loads out of view\n", count);
+}
+
 // update thumbtable class and overlays mode, depending on size categorie
 static void _thumbs_update_overlays_mode(dt_thumbtable_t *table)
 {
@@ -216,32 +234,12 @@ static dt_thumbnail_t *_thumb_get_under_mouse(dt_thumbtable_t *table)
 // get imgid from rowid
 static int _thumb_get_imgid(int rowid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = dt_util_dstrcat(NULL, "SELECT imgid FROM memory.collected_images WHERE rowid=%d", rowid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_collected_imgid(darktable.collection, rowid);
 }
 // get rowid from imgid
 static int _thumb_get_rowid(int imgid)
 {
-  int id = -1;
-  sqlite3_stmt *stmt;
-  gchar *query = dt_util_dstrcat(NULL, "SELECT rowid FROM memory.collected_images WHERE imgid=%d", imgid);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-  {
-    id = sqlite3_column_int(stmt, 0);
-  }
-  g_free(query);
-  sqlite3_finalize(stmt);
-  return id;
+  return dt_collection_collected_rowid(darktable.collection, imgid);
 }
 
 // get the coordinate of the rectangular area used by all the loaded thumbs
@@ -403,12 +401,7 @@ static gboolean _thumbtable_update_scrollbars(dt_thumbtable_t *table)
   table->code_scrolling = TRUE;
 
   // get the total number of images
-  int nbid = 1;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT COUNT(*) FROM memory.collected_images", -1,
-                              &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW) nbid = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  const int nbid = dt_collection_collected_count(darktable.collection);
 
   // the number of line before
   int lbefore = (table->offset - 1) / table->thumbs_per_row;
@@ -480,7 +473,6 @@ static int _thumbs_remove_unneeded(dt_thumbtable_t *table)
 static int _thumbs_load_needed(dt_thumbtable_t *table)
 {
   if(g_list_length(table->list) == 0) return 0;
-  sqlite3_stmt *stmt;
   int changed = 0;
 
   // we rememeber image margins for new thumbs (this limit flickering)
@@ -497,20 +489,22 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
     int space = first->y;
     if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP) space = first->x;
     const int nb_to_load = space / table->thumb_size + (space % table->thumb_size != 0);
-    gchar *query = dt_util_dstrcat(
-        NULL, "SELECT rowid, imgid FROM memory.collected_images WHERE rowid<%d ORDER BY rowid DESC LIMIT %d",
-        first->rowid, nb_to_load * table->thumbs_per_row);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    // the rows just before the first one, closest first
+    const int nbids = MIN(nb_to_load * table->thumbs_per_row, first->rowid - 1);
+    int *imgids = g_malloc_n(MAX(nbids, 1), sizeof(int));
+    dt_collection_collected_imgids(darktable.collection, first->rowid - nbids, nbids, imgids);
+    dt_image_cache_prefetch(darktable.image_cache, imgids, nbids);
     int posx = first->x;
     int posy = first->y;
     _pos_get_previous(table, &posx, &posy);
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    for(int k = nbids - 1; k >= 0; k--)
     {
       if(posy < table->view_height) // we don't load invisible thumbs
       {
         dt_thumbnail_t *thumb
-            = dt_thumbnail_new(table->thumb_size, table->thumb_size, sqlite3_column_int(stmt, 1),
-                               sqlite3_column_int(stmt, 0), table->overlays, FALSE, table->show_tooltips);
+            = dt_thumbnail_new(table->thumb_size, table->thumb_size, imgids[k], first->rowid - nbids + k,
+                               table->overlays, FALSE, table->show_tooltips);
+        thumb->load_owner = table;
         if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
         {
           thumb->single_click = TRUE;
@@ -526,8 +520,7 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
       }
       _pos_get_previous(table, &posx, &posy);
     }
-    g_free(query);
-    sqlite3_finalize(stmt);
+    g_free(imgids);
   }
 
   // we load images at the end
@@ -542,20 +535,25 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
     int space = table->view_height - (last->y + table->thumb_size);
     if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP) space = table->view_width - (last->x + table->thumb_size);
     const int nb_to_load = space / table->thumb_size + (space % table->thumb_size != 0);
-    gchar *query = dt_util_dstrcat(
-        NULL, "SELECT rowid, imgid FROM memory.collected_images WHERE rowid>%d ORDER BY rowid LIMIT %d",
-        last->rowid, nb_to_load * table->thumbs_per_row);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+    const int nbmax = nb_to_load * table->thumbs_per_row;
+    // we read the images of the next page too, the scroll usually goes on in the same direction
+    const int ahead = table->rows * table->thumbs_per_row;
+    int *imgids = g_malloc_n(MAX(nbmax + ahead, 1), sizeof(int));
+    const int nbread
+        = dt_collection_collected_imgids(darktable.collection, last->rowid + 1, nbmax + ahead, imgids);
+    dt_image_cache_prefetch(darktable.image_cache, imgids, nbread);
+    const int nbids = MIN(nbread, nbmax);
     int posx = last->x;
     int posy = last->y;
     _pos_get_next(table, &posx, &posy);
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    for(int k = 0; k < nbids; k++)
     {
       if(posy + table->thumb_size >= 0) // we don't load invisible thumbs
       {
         dt_thumbnail_t *thumb
-            = dt_thumbnail_new(table->thumb_size, table->thumb_size, sqlite3_column_int(stmt, 1),
-                               sqlite3_column_int(stmt, 0), table->overlays, FALSE, table->show_tooltips);
+            = dt_thumbnail_new(table->thumb_size, table->thumb_size, imgids[k], last->rowid + 1 + k,
+                               table->overlays, FALSE, table->show_tooltips);
+        thumb->load_owner = table;
         if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
         {
           thumb->single_click = TRUE;
@@ -571,8 +569,7 @@ static int _thumbs_load_needed(dt_thumbtable_t *table)
       }
       _pos_get_next(table, &posx, &posy);
     }
-    g_free(query);
-    sqlite3_finalize(stmt);
+    g_free(imgids);
   }
 
   return changed;
@@ -617,12 +614,7 @@ static gboolean _move(dt_thumbtable_t *table, const int x, const int y, gboolean
       if(table->thumbs_per_row == 1 && posy < 0 && g_list_length(table->list) == 1)
       {
         // special case for zoom == 1 as we don't want any space under last image (the image would have disappear)
-        int nbid = 1;
-        sqlite3_stmt *stmt;
-        DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT COUNT(*) FROM memory.collected_images",
-                                    -1, &stmt, NULL);
-        if(sqlite3_step(stmt) == SQLITE_ROW) nbid = sqlite3_column_int(stmt, 0);
-        sqlite3_finalize(stmt);
+        const int nbid = dt_collection_collected_count(darktable.collection);
         if(nbid <= last->rowid) return FALSE;
       }
       else
@@ -676,7 +668,11 @@ static gboolean _move(dt_thumbtable_t *table, const int x, const int y, gboolean
   int changed = _thumbs_load_needed(table);
 
   // we remove the images not visible on screen
-  changed += _thumbs_remove_unneeded(table);
+  const int removed = _thumbs_remove_unneeded(table);
+  changed += removed;
+
+  // and forget about loading them
+  if(removed > 0) _thumbs_discard_stale_loads(table);
 
   // if there has been changed, we recompute thumbs area
   if(changed > 0) _pos_compute_area(table);
@@ -1720,7 +1716,6 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
 
     const double start = dt_get_wtime();
     table->dragging = FALSE;
-    sqlite3_stmt *stmt;
     dt_print(DT_DEBUG_LIGHTTABLE,
              "reload thumbs from db. force=%d w=%d h=%d zoom=%d rows=%d size=%d offset=%d centering=%d...\n",
              force, table->view_width, table->view_height, table->thumbs_per_row, table->rows, table->thumb_size,
@@ -1783,14 +1778,18 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
     // we add the thumbs
     GList *newlist = NULL;
     int nbnew = 0;
-    gchar *query
-        = dt_util_dstrcat(NULL, "SELECT rowid, imgid FROM memory.collected_images WHERE rowid>=%d LIMIT %d",
-                          offset, table->rows * table->thumbs_per_row - empty_start);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    while(sqlite3_step(stmt) == SQLITE_ROW)
+    const int first = MAX(1, offset);
+    const int nbmax = table->rows * table->thumbs_per_row - empty_start;
+    // the image structs of the visible thumbs and of the next page are read with one query
+    const int ahead = table->rows * table->thumbs_per_row;
+    int *imgids = g_malloc_n(MAX(nbmax + ahead, 1), sizeof(int));
+    const int nbread = dt_collection_collected_imgids(darktable.collection, first, nbmax + ahead, imgids);
+    dt_image_cache_prefetch(darktable.image_cache, imgids, nbread);
+    const int nbids = MIN(nbread, nbmax);
+    for(int k = 0; k < nbids; k++)
     {
-      const int nrow = sqlite3_column_int(stmt, 0);
-      const int nid = sqlite3_column_int(stmt, 1);
+      const int nrow = first + k;
+      const int nid = imgids[k];
 
       // first, we search if the thumb is already here
       GList *tl = g_list_find_custom(table->list, GINT_TO_POINTER(nid), _list_compare_by_imgid);
@@ -1817,6 +1816,7 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
         // we create a completly new thumb
         dt_thumbnail_t *thumb = dt_thumbnail_new(table->thumb_size, table->thumb_size, nid, nrow, table->overlays,
                                                  FALSE, table->show_tooltips);
+        thumb->load_owner = table;
         if(table->mode == DT_THUMBTABLE_MODE_FILMSTRIP)
         {
           thumb->single_click = TRUE;
@@ -1834,10 +1834,12 @@ void dt_thumbtable_full_redraw(dt_thumbtable_t *table, gboolean force)
       // if it's the offset, we record the imgid
       if(nrow == table->offset) table->offset_imgid = nid;
     }
+    g_free(imgids);
 
     // now we cleanup all remaining thumbs from old table->list and set it again
     g_list_free_full(table->list, _list_remove_thumb);
     table->list = newlist;
+    _thumbs_discard_stale_loads(table);
 
     _pos_compute_area(table);
 
@@ -2415,12 +2417,7 @@ static gboolean _filemanager_key_move(dt_thumbtable_t *table, dt_thumbtable_move
 
   int newrowid = baserowid;
   // last rowid of the current collection
-  int maxrowid = 1;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT MAX(rowid) FROM memory.collected_images", -1,
-                              &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW) maxrowid = sqlite3_column_int(stmt, 0);
-  sqlite3_finalize(stmt);
+  const int maxrowid = dt_collection_collected_count(darktable.collection);
 
   // classic keys
   if(move == DT_THUMBTABLE_MOVE_LEFT && baserowid > 1)
@@ -2492,12 +2489,7 @@ static gboolean _zoomable_key_move(dt_thumbtable_t *table, dt_thumbtable_move_t
     moved = _zoomable_ensure_rowid_visibility(table, 1);
   else if(move == DT_THUMBTABLE_MOVE_END)
   {
-    int maxrowid = 1;
-    sqlite3_stmt *stmt;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT MAX(rowid) FROM memory.collected_images",
-                                -1, &stmt, NULL);
-    if(sqlite3_step(stmt) == SQLITE_ROW) maxrowid = sqlite3_column_int(stmt, 0);
-    sqlite3_finalize(stmt);
+    const int maxrowid = dt_collection_collected_count(darktable.collection);
     moved = _zoomable_ensure_rowid_visibility(table, maxrowid);
   }
   else if(move == DT_THUMBTABLE_MOVE_ALIGN)
@@ -17,6 +17,7 @@
 */
 
 #include <glib.h>    // for g_mkdir_with_parents, _
+#include <glib/gstdio.h> // for g_unlink
 #include <gtk/gtk.h> // for gtk_init_check
 #include <libintl.h> // for bind_textdomain_codeset, etc
 #include <limits.h>  // for PATH_MAX
@@ -26,13 +27,13 @@
 #include <stdio.h>   // for fprintf, stderr, snprintf, NULL, etc
 #include <stdlib.h>  // for exit, EXIT_FAILURE
 #include <string.h>  // for strcmp
-#include <unistd.h>  // for access, R_OK
 
 #include "common/darktable.h"    // for darktable, darktable_t, dt_cleanup, etc
 #include "common/database.h"     // for dt_database_get
 #include "common/debug.h"        // for DT_DEBUG_SQLITE3_PREPARE_V2
 #include "common/mipmap_cache.h" // for dt_mipmap_size_t, etc
 #include "common/file_location.h"
+#include "common/dtpthread.h"     // for dt_pthread_create
 #include "common/history.h"      // for dt_history_hash_set_mipmap
 #include "config.h"              // for GETTEXT_PACKAGE, etc
 #include "control/conf.h"        // for dt_conf_get_bool
@@ -45,29 +46,157 @@
 #include "win/main_wrapper.h"
 #endif
 
-static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip, const int32_t min_imgid, const int32_t max_imgid)
+// written now and then, so that an interrupted run can pick up where it stopped
+#define CHECKPOINT_INTERVAL 5.0
+
+typedef struct dt_generate_cache_t
+{
+  dt_mipmap_size_t min_mip, max_mip;
+  int32_t min_imgid, max_imgid;
+
+  // the images to work on, in ascending order, and whether their thumbnails
+  // are outdated by a later edit
+  int32_t *imgids;
+  gboolean *stale;
+  gboolean *done;
+  size_t image_count;
+
+  // everything below is protected by the lock
+  dt_pthread_mutex_t lock;
+  size_t next;        // next image to hand out to a worker
+  size_t done_prefix; // all images before this one are finished
+  size_t counter, skipped;
+  double mip_time[DT_MIPMAP_F];
+  size_t mip_count[DT_MIPMAP_F];
+  double last_checkpoint;
+  char checkpoint[PATH_MAX];
+} dt_generate_cache_t;
+
+static void _write_checkpoint(dt_generate_cache_t *gc)
+{
+  if(!gc->done_prefix) return;
+  char *contents = g_strdup_printf("%d %d %d %d %d\n", gc->min_mip, gc->max_mip, gc->min_imgid, gc->max_imgid,
+                                   gc->imgids[gc->done_prefix - 1]);
+  // writes to a temporary file and renames it, so it is never torn
+  if(!g_file_set_contents(gc->checkpoint, contents, -1, NULL))
+    fprintf(stderr, _("warning: could not write checkpoint '%s'\n"), gc->checkpoint);
+  g_free(contents);
+}
+
+// returns the last image id finished by an earlier run with the same arguments, or -1
+static int32_t _read_checkpoint(const dt_generate_cache_t *gc)
+{
+  gchar *contents = NULL;
+  if(!g_file_get_contents(gc->checkpoint, &contents, NULL, NULL)) return -1;
+  int min_mip, max_mip, min_imgid, max_imgid, done_imgid;
+  const gboolean match = sscanf(contents, "%d %d %d %d %d", &min_mip, &max_mip, &min_imgid, &max_imgid,
+                                &done_imgid) == 5
+                         && min_mip == gc->min_mip && max_mip == gc->max_mip && min_imgid == gc->min_imgid
+                         && max_imgid == gc->max_imgid;
+  g_free(contents);
+  return match ? done_imgid : -1;
+}
+
+static void *_generate_cache_worker(void *arg)
 {
-  fprintf(stderr, _("creating cache directories\n"));
-  for(dt_mipmap_size_t k = min_mip; k <= max_mip; k++)
+  dt_generate_cache_t *gc = (dt_generate_cache_t *)arg;
+  dt_pthread_setname("generate-cache");
+
+  while(TRUE)
   {
-    char dirname[PATH_MAX] = { 0 };
-    snprintf(dirname, sizeof(dirname), "%s.d/%d", darktable.mipmap_cache->cachedir, k);
+    dt_pthread_mutex_lock(&gc->lock);
+    const size_t i = gc->next++;
+    dt_pthread_mutex_unlock(&gc->lock);
+    if(i >= gc->image_count) break;
+
+    const int32_t imgid = gc->imgids[i];
+    double mip_time[DT_MIPMAP_F] = { 0.0 };
+    gboolean generated = FALSE;
+
+    // thumbnails of an older version of the edit are no good
+    if(gc->stale[i]) dt_mipmap_cache_remove(darktable.mipmap_cache, imgid);
+
+    for(int k = gc->max_mip; k >= gc->min_mip && k >= 0; k--)
+    {
+      // if the thumbnail is already on disc - do nothing
+      if(dt_mipmap_cache_is_on_disk(darktable.mipmap_cache, imgid, k)) continue;
+
+      // else, generate thumbnail and store in mipmap cache.
+      const double start = dt_get_wtime();
+      dt_mipmap_buffer_t buf;
+      dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
+      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+      mip_time[k] = dt_get_wtime() - start;
+      generated = TRUE;
+    }
 
-    fprintf(stderr, _("creating cache directory '%s'\n"), dirname);
-    if(g_mkdir_with_parents(dirname, 0750))
+    if(generated)
     {
-      fprintf(stderr, _("could not create directory '%s'!\n"), dirname);
-      return 1;
+      // and immediately write thumbs to disc and remove from mipmap cache.
+      dt_mimap_cache_evict(darktable.mipmap_cache, imgid);
     }
+    // thumbnail in sync with image
+    if(generated || gc->stale[i]) dt_history_hash_set_mipmap(imgid);
+
+    dt_pthread_mutex_lock(&gc->lock);
+    gc->done[i] = TRUE;
+    gc->counter++;
+    if(!generated) gc->skipped++;
+    for(int k = gc->min_mip; k <= gc->max_mip; k++)
+    {
+      if(mip_time[k] == 0.0) continue;
+      gc->mip_time[k] += mip_time[k];
+      gc->mip_count[k]++;
+    }
+    while(gc->done_prefix < gc->image_count && gc->done[gc->done_prefix]) gc->done_prefix++;
+    const double now = dt_get_wtime();
+    if(now - gc->last_checkpoint > CHECKPOINT_INTERVAL)
+    {
+      _write_checkpoint(gc);
+      gc->last_checkpoint = now;
+    }
+    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d)%s\n", gc->counter, gc->image_count,
+            100.0 * gc->counter / (float)gc->image_count, imgid, generated ? "" : _(" up to date"));
+    dt_pthread_mutex_unlock(&gc->lock);
+  }
+  return NULL;
+}
+
+static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mipmap_size_t max_mip,
+                                    const int32_t min_imgid, const int32_t max_imgid, const int jobs,
+                                    const gboolean restart)
+{
+  // the thumbnails of all sizes go into one pack file per size in here
+  char dirname[PATH_MAX] = { 0 };
+  snprintf(dirname, sizeof(dirname), "%s.d", darktable.mipmap_cache->cachedir);
+
+  fprintf(stderr, _("creating cache directory '%s'\n"), dirname);
+  if(g_mkdir_with_parents(dirname, 0750))
+  {
+    fprintf(stderr, _("could not create directory '%s'!\n"), dirname);
+    return 1;
   }
 
+  dt_generate_cache_t gc = { 0 };
+  gc.min_mip = min_mip;
+  gc.max_mip = max_mip;
+  gc.min_imgid = min_imgid;
+  gc.max_imgid = max_imgid;
+  snprintf(gc.checkpoint, sizeof(gc.checkpoint), "%s/generate-cache.checkpoint", dirname);
+
+  const int32_t resume_imgid = restart ? -1 : _read_checkpoint(&gc);
+  if(resume_imgid >= 0)
+    fprintf(stderr, _("resuming an interrupted run after image %d\n"), resume_imgid);
+
   // some progress counter
   sqlite3_stmt *stmt;
-  size_t image_count = 0, counter = 0;
+  size_t image_count = 0;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
+                              "SELECT COUNT(*) FROM main.images WHERE id >= ?1 AND id <= ?2 AND id > ?3", -1,
+                              &stmt, 0);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, resume_imgid);
   if(sqlite3_step(stmt) == SQLITE_ROW)
   {
     image_count = sqlite3_column_int(stmt, 0);
@@ -87,39 +216,60 @@ static int generate_thumbnail_cache(const dt_mipmap_size_t min_mip, const dt_mip
     }
   }
 
-  // go through all images:
+  // collect all images up front, together with whether their thumbnails are
+  // older than their history. images without history are never stale.
+  gc.imgids = g_malloc_n(MAX(image_count, 1), sizeof(int32_t));
+  gc.stale = g_malloc0_n(MAX(image_count, 1), sizeof(gboolean));
+  gc.done = g_malloc0_n(MAX(image_count, 1), sizeof(gboolean));
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT id FROM main.images WHERE id >= ?1 AND id <= ?2", -1, &stmt, 0);
+                              "SELECT i.id, h.imgid IS NOT NULL AND h.mipmap_hash IS NOT h.current_hash"
+                              " FROM main.images AS i"
+                              " LEFT JOIN main.history_hash AS h ON h.imgid = i.id"
+                              " WHERE i.id >= ?1 AND i.id <= ?2 AND i.id > ?3"
+                              " ORDER BY i.id",
+                              -1, &stmt, 0);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, min_imgid);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_imgid);
-  while(sqlite3_step(stmt) == SQLITE_ROW)
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, resume_imgid);
+  while(sqlite3_step(stmt) == SQLITE_ROW && gc.image_count < image_count)
   {
-    const int32_t imgid = sqlite3_column_int(stmt, 0);
-
-    counter++;
-    fprintf(stderr, "image %zu/%zu (%.02f%%) (id:%d)\n", counter, image_count, 100.0 * counter / (float)image_count, imgid);
-
-    for(int k = max_mip; k >= min_mip && k >= 0; k--)
-    {
-      char filename[PATH_MAX] = { 0 };
-      snprintf(filename, sizeof(filename), "%s.d/%d/%d.jpg", darktable.mipmap_cache->cachedir, k, imgid);
-
-      // if the thumbnail is already on disc - do nothing
-      if(!access(filename, R_OK)) continue;
-
-      // else, generate thumbnail and store in mipmap cache.
-      dt_mipmap_buffer_t buf;
-      dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, k, DT_MIPMAP_BLOCKING, 'r');
-      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
-    }
+    gc.imgids[gc.image_count] = sqlite3_column_int(stmt, 0);
+    gc.stale[gc.image_count] = sqlite3_column_int(stmt, 1);
+    gc.image_count++;
+  }
+  sqlite3_finalize(stmt);
 
-    // and immediately write thumbs to disc and remove from mipmap cache.
-    dt_mimap_cache_evict(darktable.mipmap_cache, imgid);
-    // thumbnail in sync with image
-    dt_history_hash_set_mipmap(imgid);
+  // go through all images:
+  const int num_workers = MAX(1, MIN(jobs, (int)gc.image_count));
+  pthread_t *workers = g_malloc_n(num_workers, sizeof(pthread_t));
+  dt_pthread_mutex_init(&gc.lock, NULL);
+  const double start = dt_get_wtime();
+  gc.last_checkpoint = start;
+  int started = 0;
+  for(; started < num_workers; started++)
+    if(dt_pthread_create(workers + started, _generate_cache_worker, &gc)) break;
+  // no threads at all: do the work right here
+  if(!started) _generate_cache_worker(&gc);
+  for(int k = 0; k < started; k++) pthread_join(workers[k], NULL);
+  const double elapsed = dt_get_wtime() - start;
+  dt_pthread_mutex_destroy(&gc.lock);
+  g_free(workers);
+
+  // all done, the next run starts from scratch
+  g_unlink(gc.checkpoint);
+
+  fprintf(stderr, _("%zu images in %.02f s (%.02f images/s) with %d threads, %zu were up to date\n"), gc.counter,
+          elapsed, elapsed > 0.0 ? gc.counter / elapsed : 0.0, MAX(started, 1), gc.skipped);
+  for(int k = max_mip; k >= min_mip && k >= 0; k--)
+  {
+    if(!gc.mip_count[k]) continue;
+    fprintf(stderr, _("mip %d: %zu thumbnails, %.02f s, %.02f ms per thumbnail\n"), k, gc.mip_count[k],
+            gc.mip_time[k], 1000.0 * gc.mip_time[k] / gc.mip_count[k]);
   }
 
-  sqlite3_finalize(stmt);
+  g_free(gc.imgids);
+  g_free(gc.stale);
+  g_free(gc.done);
   fprintf(stderr, "done\n");
 
   return 0;
@@ -131,13 +281,20 @@ static void usage(const char *progname)
           "usage: %s [-h, --help; --version]\n"
           "  [--min-mip <0-8> (default = 0)] [-m, --max-mip <0-8> (default = 2)]\n"
           "  [--min-imgid <N>] [--max-imgid <N>]\n"
+          "  [-j, --jobs <N> (default = 1)] [--restart]\n"
           "  [--core <darktable options>]\n"
           "\n"
           "When multiple mipmap sizes are requested, the biggest one is computed\n"
           "while the rest are quickly downsampled.\n"
           "\n"
           "The --min-imgid and --max-imgid specify the range of internal image ID\n"
-          "numbers to work on.\n",
+          "numbers to work on.\n"
+          "\n"
+          "With --jobs several images are processed at the same time. Each of them\n"
+          "still uses all cores, so consider limiting that with --core -t <N>.\n"
+          "\n"
+          "Images whose thumbnails are on disk and match their history are skipped.\n"
+          "An interrupted run continues where it stopped, unless --restart is given.\n",
           progname);
 }
 
@@ -163,6 +320,8 @@ int main(int argc, char *arg[])
   dt_mipmap_size_t max_mip = DT_MIPMAP_2;
   int32_t min_imgid = 0;
   int32_t max_imgid = INT32_MAX;
+  int jobs = 1;
+  gboolean restart = FALSE;
 
   int k;
   for(k = 1; k < argc; k++)
@@ -198,6 +357,15 @@ int main(int argc, char *arg[])
       k++;
       max_imgid = (int32_t)MIN(MAX(atoi(arg[k]), 0), INT32_MAX);
     }
+    else if((!strcmp(arg[k], "-j") || !strcmp(arg[k], "--jobs")) && argc > k + 1)
+    {
+      k++;
+      jobs = MIN(MAX(atoi(arg[k]), 1), 256);
+    }
+    else if(!strcmp(arg[k], "--restart"))
+    {
+      restart = TRUE;
+    }
     else if(!strcmp(arg[k], "--core"))
     {
       // everything from here on should be passed to the core
@@ -251,7 +419,7 @@ int main(int argc, char *arg[])
 
   fprintf(stderr, _("creating complete lighttable thumbnail cache\n"));
 
-  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid))
+  if(generate_thumbnail_cache(min_mip, max_mip, min_imgid, max_imgid, jobs, restart))
   {
     free(m_arg);
     exit(EXIT_FAILURE);
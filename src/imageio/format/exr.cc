@@ -25,6 +25,7 @@
 
 #include <OpenEXR/ImfChannelList.h>
 #include <OpenEXR/ImfFrameBuffer.h>
+#include <OpenEXR/ImfOutputFile.h>
 #include <OpenEXR/ImfStandardAttributes.h>
 #include <OpenEXR/ImfThreading.h>
 #include <OpenEXR/ImfTiledOutputFile.h>
@@ -97,20 +98,12 @@ void cleanup(dt_imageio_module_format_t *self)
 {
 }
 
-int write_image(dt_imageio_module_data_t *tmp, const char *filename, const void *in_tmp,
-                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
-                void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+// sets up everything but the layout of the pixels in the file
+static void _add_attributes(Imf::Header &header, dt_colorspaces_color_profile_type_t over_type,
+                            const char *over_filename, void *exif, int exif_len, int imgid)
 {
-  const dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
-
-  Imf::setGlobalThreadCount(dt_get_num_threads());
-
   Imf::Blob exif_blob(exif_len, (uint8_t *)exif);
 
-  Imf::Header header(exr->global.width, exr->global.height, 1, Imath::V2f(0, 0), 1, Imf::INCREASING_Y,
-                     (Imf::Compression)exr->compression);
-
   char comment[1024];
   snprintf(comment, sizeof(comment), "Developed using %s", darktable_package_string);
 
@@ -195,30 +188,97 @@ icc_end:
   header.channels().insert("R", Imf::Channel(Imf::PixelType::FLOAT));
   header.channels().insert("G", Imf::Channel(Imf::PixelType::FLOAT));
   header.channels().insert("B", Imf::Channel(Imf::PixelType::FLOAT));
+}
+
+// slices for 4 floats per pixel starting at in, which holds row y of the image
+static void _insert_slices(Imf::FrameBuffer &data, const float *in, const int width, const int y)
+{
+  const size_t ystride = 4 * sizeof(float) * width;
+  // the frame buffer is addressed with the coordinates in the file
+  char *base = (char *)in - (size_t)y * ystride;
+
+  data.insert("R", Imf::Slice(Imf::PixelType::FLOAT, base + 0 * sizeof(float), 4 * sizeof(float), ystride));
+  data.insert("G", Imf::Slice(Imf::PixelType::FLOAT, base + 1 * sizeof(float), 4 * sizeof(float), ystride));
+  data.insert("B", Imf::Slice(Imf::PixelType::FLOAT, base + 2 * sizeof(float), 4 * sizeof(float), ystride));
+}
+
+int write_image(dt_imageio_module_data_t *tmp, const char *filename, const void *in_tmp,
+                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  const dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
+
+  Imf::setGlobalThreadCount(dt_get_num_threads());
+
+  Imf::Header header(exr->global.width, exr->global.height, 1, Imath::V2f(0, 0), 1, Imf::INCREASING_Y,
+                     (Imf::Compression)exr->compression);
+  _add_attributes(header, over_type, over_filename, exif, exif_len, imgid);
 
   header.setTileDescription(Imf::TileDescription(100, 100, Imf::ONE_LEVEL));
 
   Imf::TiledOutputFile file(filename, header);
 
   Imf::FrameBuffer data;
+  _insert_slices(data, (const float *)in_tmp, exr->global.width, 0);
 
-  const float *in = (const float *)in_tmp;
+  file.setFrameBuffer(data);
+  file.writeTiles(0, file.numXTiles() - 1, 0, file.numYTiles() - 1);
 
-  data.insert("R", Imf::Slice(Imf::PixelType::FLOAT, (char *)(in + 0), 4 * sizeof(float),
-                              4 * sizeof(float) * exr->global.width));
+  return 0;
+}
 
-  data.insert("G", Imf::Slice(Imf::PixelType::FLOAT, (char *)(in + 1), 4 * sizeof(float),
-                              4 * sizeof(float) * exr->global.width));
+// streamed images are written as scan lines, tiles would need several bands at once
+void *write_image_begin(dt_imageio_module_data_t *tmp, const char *filename,
+                        dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                        void *exif, int exif_len, int imgid)
+{
+  const dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
 
-  data.insert("B", Imf::Slice(Imf::PixelType::FLOAT, (char *)(in + 2), 4 * sizeof(float),
-                              4 * sizeof(float) * exr->global.width));
+  Imf::setGlobalThreadCount(dt_get_num_threads());
 
-  file.setFrameBuffer(data);
-  file.writeTiles(0, file.numXTiles() - 1, 0, file.numYTiles() - 1);
+  try
+  {
+    Imf::Header header(exr->global.width, exr->global.height, 1, Imath::V2f(0, 0), 1, Imf::INCREASING_Y,
+                       (Imf::Compression)exr->compression);
+    _add_attributes(header, over_type, over_filename, exif, exif_len, imgid);
+    return new Imf::OutputFile(filename, header);
+  }
+  catch(const std::exception &e)
+  {
+    fprintf(stderr, "[exr export] error: %s\n", e.what());
+    return NULL;
+  }
+}
 
+int write_image_rows(dt_imageio_module_data_t *tmp, void *handle, const void *in, const int rows)
+{
+  const dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
+  Imf::OutputFile *file = (Imf::OutputFile *)handle;
+
+  try
+  {
+    Imf::FrameBuffer data;
+    _insert_slices(data, (const float *)in, exr->global.width, file->currentScanLine());
+    file->setFrameBuffer(data);
+    file->writePixels(rows);
+  }
+  catch(const std::exception &e)
+  {
+    fprintf(stderr, "[exr export] error: %s\n", e.what());
+    return 1;
+  }
   return 0;
 }
 
+int write_image_end(dt_imageio_module_data_t *tmp, void *handle)
+{
+  Imf::OutputFile *file = (Imf::OutputFile *)handle;
+  const int rc = file->currentScanLine() == tmp->height ? 0 : 1;
+  delete file;
+  return rc;
+}
+
 size_t params_size(dt_imageio_module_format_t *self)
 {
   return sizeof(dt_imageio_exr_t);
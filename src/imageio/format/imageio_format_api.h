@@ -80,6 +80,15 @@ int write_image(struct dt_imageio_module_data_t *data, const char *filename, con
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
                 const gboolean export_masks);
+/* optional streaming version of write_image() for images too large to be kept in memory as a whole.
+   write_image_begin() returns NULL if the file can't be written like that with the given settings,
+   write_image_rows() is called with the next rows of the image, top to bottom, in the layout write_image()
+   gets, write_image_end() finishes the file. both return != 0 on error. */
+void *write_image_begin(struct dt_imageio_module_data_t *data, const char *filename,
+                        dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                        void *exif, int exif_len, int imgid);
+int write_image_rows(struct dt_imageio_module_data_t *data, void *handle, const void *in, const int rows);
+int write_image_end(struct dt_imageio_module_data_t *data, void *handle);
 /* flag that describes the available precision/levels of output format. mainly used for dithering. */
 int levels(struct dt_imageio_module_data_t *data);
 
@@ -117,15 +117,21 @@ static void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, char *prof
   png_free(ping, text);
 }
 
-int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid,
-                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
-                void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+typedef struct dt_imageio_png_stream_t
+{
+  FILE *f;
+  png_structp png_ptr;
+  png_infop info_ptr;
+} dt_imageio_png_stream_t;
+
+void *write_image_begin(dt_imageio_module_data_t *p_tmp, const char *filename,
+                        dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                        void *exif, int exif_len, int imgid)
 {
   dt_imageio_png_t *p = (dt_imageio_png_t *)p_tmp;
   const int width = p->global.width, height = p->global.height;
   FILE *f = g_fopen(filename, "wb");
-  if(!f) return 1;
+  if(!f) return NULL;
 
   png_structp png_ptr;
   png_infop info_ptr;
@@ -134,7 +140,7 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
   if(!png_ptr)
   {
     fclose(f);
-    return 1;
+    return NULL;
   }
 
   info_ptr = png_create_info_struct(png_ptr);
@@ -142,14 +148,14 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
   {
     fclose(f);
     png_destroy_write_struct(&png_ptr, NULL);
-    return 1;
+    return NULL;
   }
 
   if(setjmp(png_jmpbuf(png_ptr)))
   {
     fclose(f);
     png_destroy_write_struct(&png_ptr, &info_ptr);
-    return 1;
+    return NULL;
   }
 
   png_init_io(png_ptr, f);
@@ -201,28 +207,54 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
    */
   png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
 
-  png_bytep *row_pointers = dt_alloc_align(64, (size_t)height * sizeof(png_bytep));
+  /* swap bytes of 16 bit files to most significant bit first */
+  if(p->bpp > 8) png_set_swap(png_ptr);
 
-  if(p->bpp > 8)
-  {
-    /* swap bytes of 16 bit files to most significant bit first */
-    png_set_swap(png_ptr);
+  dt_imageio_png_stream_t *s = malloc(sizeof(dt_imageio_png_stream_t));
+  s->f = f;
+  s->png_ptr = png_ptr;
+  s->info_ptr = info_ptr;
+  return s;
+}
 
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
-  }
+int write_image_rows(dt_imageio_module_data_t *p_tmp, void *handle, const void *in, const int rows)
+{
+  dt_imageio_png_t *p = (dt_imageio_png_t *)p_tmp;
+  dt_imageio_png_stream_t *s = (dt_imageio_png_stream_t *)handle;
+
+  if(setjmp(png_jmpbuf(s->png_ptr))) return 1;
+
+  const size_t rowsize = (size_t)4 * p->global.width * (p->bpp > 8 ? sizeof(uint16_t) : sizeof(uint8_t));
+  for(int i = 0; i < rows; i++) png_write_row(s->png_ptr, (png_bytep)in + i * rowsize);
+  return 0;
+}
+
+int write_image_end(dt_imageio_module_data_t *p_tmp, void *handle)
+{
+  dt_imageio_png_stream_t *s = (dt_imageio_png_stream_t *)handle;
+  int rc = 0;
+
+  if(setjmp(png_jmpbuf(s->png_ptr)))
+    rc = 1;
   else
-  {
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
-  }
+    png_write_end(s->png_ptr, s->info_ptr);
 
-  png_write_image(png_ptr, row_pointers);
+  png_destroy_write_struct(&s->png_ptr, &s->info_ptr);
+  fclose(s->f);
+  free(s);
+  return rc;
+}
 
-  dt_free_align(row_pointers);
+int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid,
+                dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
+                const gboolean export_masks)
+{
+  void *handle = write_image_begin(p_tmp, filename, over_type, over_filename, exif, exif_len, imgid);
+  if(!handle) return 1;
 
-  png_write_end(png_ptr, info_ptr);
-  png_destroy_write_struct(&png_ptr, &info_ptr);
-  fclose(f);
-  return 0;
+  const int rc = write_image_rows(p_tmp, handle, ivoid, p_tmp->height);
+  return write_image_end(p_tmp, handle) || rc;
 }
 
 static int __attribute__((__unused__)) read_header(const char *filename, dt_imageio_module_data_t *p_tmp)
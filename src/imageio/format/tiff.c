@@ -57,6 +57,62 @@ typedef struct dt_imageio_tiff_gui_t
   GtkWidget *shortfiles;
 } dt_imageio_tiff_gui_t;
 
+typedef struct dt_imageio_tiff_stream_t
+{
+  TIFF *tif;
+  char *filename;
+  void *exif;
+  int exif_len;
+  gboolean bigtiff;
+  void *rowdata;
+  uint32_t row;
+} dt_imageio_tiff_stream_t;
+
+// the output profile of the image serialized for embedding, NULL if there is none
+static uint8_t *_get_profile(const int imgid, dt_colorspaces_color_profile_type_t over_type,
+                             const char *over_filename, uint32_t *profile_len)
+{
+  uint8_t *profile = NULL;
+  *profile_len = 0;
+  if(imgid > 0)
+  {
+    cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
+    cmsSaveProfileToMem(out_profile, 0, profile_len);
+    if(*profile_len > 0)
+    {
+      profile = malloc(*profile_len);
+      if(profile) cmsSaveProfileToMem(out_profile, profile, profile_len);
+    }
+  }
+  return profile;
+}
+
+static void _set_compression(TIFF *tif, const dt_imageio_tiff_t *d)
+{
+  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
+  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
+  // "software vendors. This code should be considered obsolete. We recommend"
+  // "that TIFF implementations recognize and read the obsolete code but only"
+  // "write the official compression code (0x0008)."
+  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
+  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
+  if(d->compress == 1)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+  else if(d->compress == 2)
+  {
+    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
+    if(d->bpp == 32)
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
+    else
+      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
+  }
+}
+
 
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
@@ -79,20 +135,11 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 #endif
   int rc = 1; // default to error
 
-  if(imgid > 0)
+  profile = _get_profile(imgid, over_type, over_filename, &profile_len);
+  if(profile_len > 0 && !profile)
   {
-    cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid, over_type, over_filename)->profile;
-    cmsSaveProfileToMem(out_profile, 0, &profile_len);
-    if(profile_len > 0)
-    {
-      profile = malloc(profile_len);
-      if(!profile)
-      {
-        rc = 1;
-        goto exit;
-      }
-      cmsSaveProfileToMem(out_profile, profile, &profile_len);
-    }
+    rc = 1;
+    goto exit;
   }
 
   uint16_t n_pages = 1;
@@ -127,28 +174,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 
   TIFFSetField(tif, TIFFTAG_DOCUMENTNAME, filename);
 
-  // http://partners.adobe.com/public/developer/en/tiff/TIFFphotoshop.pdf (dated 2002)
-  // "A proprietary ZIP/Flate compression code (0x80b2) has been used by some"
-  // "software vendors. This code should be considered obsolete. We recommend"
-  // "that TIFF implementations recognize and read the obsolete code but only"
-  // "write the official compression code (0x0008)."
-  // http://www.awaresystems.be/imaging/tiff/tifftags/compression.html
-  // http://www.awaresystems.be/imaging/tiff/tifftags/predictor.html
-  if(d->compress == 1)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
-  else if(d->compress == 2)
-  {
-    TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-    if(d->bpp == 32)
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
-    else
-      TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
-    TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-  }
+  _set_compression(tif, d);
 
   if(profile != NULL)
   {
@@ -389,21 +415,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
         else
           TIFFSetField(tif, TIFFTAG_PAGENAME, piece->module->name());
 
-        if(d->compress == 1)
-        {
-          TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-          TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_NONE);
-          TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-        }
-        else if(d->compress == 2)
-        {
-          TIFFSetField(tif, TIFFTAG_COMPRESSION, COMPRESSION_ADOBE_DEFLATE);
-          if(d->bpp == 32)
-            TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_FLOATINGPOINT);
-          else
-            TIFFSetField(tif, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
-          TIFFSetField(tif, TIFFTAG_ZIPQUALITY, (uint16_t)d->compresslevel);
-        }
+        _set_compression(tif, d);
 
         if(resolution > 0)
         {
@@ -545,6 +557,115 @@ exit:
   return rc;
 }
 
+void *write_image_begin(dt_imageio_module_data_t *d_tmp, const char *filename,
+                        dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
+                        void *exif, int exif_len, int imgid)
+{
+  const dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+
+  // telling grayscale images apart needs all pixels at once
+  if(dt_conf_key_exists("plugins/imageio/format/tiff/shortfile")
+     && dt_conf_get_int("plugins/imageio/format/tiff/shortfile"))
+    return NULL;
+
+  const uint16_t layers = 3;
+  const size_t rowsize = (d->global.width * layers) * d->bpp / 8;
+
+  dt_imageio_tiff_stream_t *s = calloc(1, sizeof(dt_imageio_tiff_stream_t));
+  s->rowdata = malloc(rowsize);
+  s->filename = g_strdup(filename);
+  s->exif = exif;
+  s->exif_len = exif_len;
+  // classic tiff can't address more than 4 GB
+  s->bigtiff = (double)rowsize * d->global.height > 4.0e9;
+
+#ifdef _WIN32
+  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+  s->tif = TIFFOpenW(wfilename, s->bigtiff ? "wl8" : "wl");
+  g_free(wfilename);
+#else
+  s->tif = TIFFOpen(filename, s->bigtiff ? "wl8" : "wl");
+#endif
+
+  uint32_t profile_len = 0;
+  uint8_t *profile = _get_profile(imgid, over_type, over_filename, &profile_len);
+
+  if(!s->tif || !s->rowdata || (profile_len > 0 && !profile))
+  {
+    if(s->tif) TIFFClose(s->tif);
+    free(profile);
+    free(s->rowdata);
+    g_free(s->filename);
+    free(s);
+    return NULL;
+  }
+
+  TIFFSetField(s->tif, TIFFTAG_SUBFILETYPE, 0);
+  TIFFSetField(s->tif, TIFFTAG_DOCUMENTNAME, filename);
+  _set_compression(s->tif, d);
+  if(profile != NULL) TIFFSetField(s->tif, TIFFTAG_ICCPROFILE, profile_len, profile);
+  free(profile);
+
+  TIFFSetField(s->tif, TIFFTAG_SAMPLESPERPIXEL, layers);
+  TIFFSetField(s->tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
+  TIFFSetField(s->tif, TIFFTAG_SAMPLEFORMAT, (d->bpp == 32) ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT);
+  TIFFSetField(s->tif, TIFFTAG_IMAGEWIDTH, (uint32_t)d->global.width);
+  TIFFSetField(s->tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->global.height);
+  TIFFSetField(s->tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_RGB);
+  TIFFSetField(s->tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(s->tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(s->tif, 0));
+
+  const int resolution = dt_conf_get_int("metadata/resolution");
+  if(resolution > 0)
+  {
+    TIFFSetField(s->tif, TIFFTAG_XRESOLUTION, (float)resolution);
+    TIFFSetField(s->tif, TIFFTAG_YRESOLUTION, (float)resolution);
+    TIFFSetField(s->tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
+  }
+
+  return s;
+}
+
+int write_image_rows(dt_imageio_module_data_t *d_tmp, void *handle, const void *in_void, const int rows)
+{
+  const dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+  dt_imageio_tiff_stream_t *s = (dt_imageio_tiff_stream_t *)handle;
+  const size_t bytes = d->bpp / 8;
+
+  for(int y = 0; y < rows; y++, s->row++)
+  {
+    const uint8_t *in = (const uint8_t *)in_void + (size_t)4 * y * d->global.width * bytes;
+    uint8_t *out = (uint8_t *)s->rowdata;
+    for(int x = 0; x < d->global.width; x++, in += 4 * bytes, out += 3 * bytes) memcpy(out, in, 3 * bytes);
+
+    if(TIFFWriteScanline(s->tif, s->rowdata, s->row, 0) == -1) return 1;
+  }
+  return 0;
+}
+
+int write_image_end(dt_imageio_module_data_t *d_tmp, void *handle)
+{
+  const dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
+  dt_imageio_tiff_stream_t *s = (dt_imageio_tiff_stream_t *)handle;
+  int rc = s->row == d->global.height ? 0 : 1;
+
+  // close the file before adding exif data
+  TIFFClose(s->tif);
+
+  // exiv2 doesn't know about bigtiff
+  if(!rc && s->exif && !s->bigtiff)
+  {
+    rc = dt_exif_write_blob(s->exif, s->exif_len, s->filename, d->compress > 0);
+    // Until we get symbolic error status codes, if rc is 1, return 0
+    rc = (rc == 1) ? 0 : 1;
+  }
+
+  free(s->rowdata);
+  g_free(s->filename);
+  free(s);
+  return rc;
+}
+
 #if 0
 int dt_imageio_tiff_read_header(const char *filename, dt_imageio_tiff_t *tiff)
 {
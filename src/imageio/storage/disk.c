@@ -49,6 +49,16 @@ typedef enum dt_disk_onconflict_actions_t
   DT_EXPORT_ONCONFLICT_SKIP = 2
 } dt_disk_onconflict_actions_t;
 
+// files being written by the export jobs right now, so that images exported at the same time don't
+// pick the same name. guarded by darktable.plugin_threadsafe.
+static GHashTable *_exporting = NULL;
+static pthread_cond_t _exporting_cond = PTHREAD_COND_INITIALIZER;
+
+static gboolean _exporting_contains(const char *filename)
+{
+  return _exporting && g_hash_table_contains(_exporting, filename);
+}
+
 // gui data
 typedef struct disk_t
 {
@@ -306,7 +316,7 @@ try_again:
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_UNIQUEFILENAME)
     {
       int seq = 1;
-      while(g_file_test(filename, G_FILE_TEST_EXISTS))
+      while(g_file_test(filename, G_FILE_TEST_EXISTS) || _exporting_contains(filename))
       {
         snprintf(c, filename_free_space, "_%.2d.%s", seq, ext);
         seq++;
@@ -315,7 +325,7 @@ try_again:
 
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_SKIP)
     {
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
+      if(g_file_test(filename, G_FILE_TEST_EXISTS) || _exporting_contains(filename))
       {
         dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
         fprintf(stderr, "[export_job] skipping `%s'\n", filename);
@@ -324,13 +334,29 @@ try_again:
         return 0;
       }
     }
+
+    if(!fail)
+    {
+      // overwriting: wait for another image going to the same file, the last one wins as in a serial export
+      while(_exporting_contains(filename))
+        dt_pthread_cond_wait(&_exporting_cond, &darktable.plugin_threadsafe);
+      if(!_exporting) _exporting = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+      g_hash_table_add(_exporting, g_strdup(filename));
+    }
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
   if(fail) return 1;
 
   /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, export_masks, icc_type,
-                       icc_filename, icc_intent, self, sdata, num, total, metadata) != 0)
+  const int err = dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, export_masks,
+                                    icc_type, icc_filename, icc_intent, self, sdata, num, total, metadata);
+
+  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+  g_hash_table_remove(_exporting, filename);
+  pthread_cond_broadcast(&_exporting_cond);
+  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+
+  if(err)
   {
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
@@ -343,6 +369,12 @@ try_again:
   return 0;
 }
 
+int parallel(dt_imageio_module_storage_t *self)
+{
+  // file names are picked under darktable.plugin_threadsafe, taking the ones still being written into account
+  return TRUE;
+}
+
 size_t params_size(dt_imageio_module_storage_t *self)
 {
   return sizeof(dt_imageio_disk_t) - sizeof(void *);
@@ -394,6 +394,12 @@ END:
   g_free(sourcefile);
 }
 
+int parallel(dt_imageio_module_storage_t *self)
+{
+  // the page list is only touched under darktable.plugin_threadsafe
+  return TRUE;
+}
+
 void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *dd)
 {
   dt_imageio_latex_t *d = (dt_imageio_latex_t *)dd;
@@ -24,6 +24,7 @@
 #include "common/bilateralcl.h"
 #include "common/locallaplacian.h"
 #include "common/locallaplaciancl.h"
+#include "control/conf.h"
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
@@ -74,7 +75,16 @@ typedef struct dt_iop_bilat_params_v1_t
 }
 dt_iop_bilat_params_v1_t;
 
-typedef dt_iop_bilat_params_t dt_iop_bilat_data_t;
+typedef struct dt_iop_bilat_data_t
+{
+  dt_iop_bilat_mode_t mode;
+  float sigma_r;
+  float sigma_s;
+  float detail;
+  float midtone;
+  local_laplacian_workspace_t *ws; // pyramids of the local laplacian filter, kept for the next run of this pipe
+}
+dt_iop_bilat_data_t;
 
 typedef struct dt_iop_bilat_gui_data_t
 {
@@ -106,7 +116,8 @@ const char *description(struct dt_iop_module_t *self)
 // some additional flags (self explanatory i think):
 int flags()
 {
-  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_INCLUDE_IN_STYLES | IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING
+         | IOP_FLAGS_TILING_PARALLEL;
 }
 
 // where does it appear in the gui?
@@ -273,7 +284,11 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 {
   dt_iop_bilat_params_t *p = (dt_iop_bilat_params_t *)p1;
   dt_iop_bilat_data_t *d = (dt_iop_bilat_data_t *)piece->data;
-  *d = *p;
+  d->mode = p->mode;
+  d->sigma_r = p->sigma_r;
+  d->sigma_s = p->sigma_s;
+  d->detail = p->detail;
+  d->midtone = p->midtone;
 
 #ifdef HAVE_OPENCL
   if(d->mode == s_mode_bilateral)
@@ -284,14 +299,29 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 }
 
 
+// bytes of local laplacian pyramids the pipe may keep between runs. only the darkroom pipes process the
+// same image over and over, the others let go of them right away.
+static size_t _workspace_budget(const dt_dev_pixelpipe_t *pipe)
+{
+  if(!(pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_PREVIEW | DT_DEV_PIXELPIPE_PREVIEW2))) return 0;
+  const int host_memory_limit = dt_conf_get_int("host_memory_limit");
+  // no limit configured, keep them as long as the pipe lives
+  if(host_memory_limit <= 0) return SIZE_MAX;
+  return (size_t)host_memory_limit * 1024 * 1024 / 4;
+}
+
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = calloc(1, sizeof(dt_iop_bilat_data_t));
+  dt_iop_bilat_data_t *d = calloc(1, sizeof(dt_iop_bilat_data_t));
+  d->ws = local_laplacian_workspace_init();
+  piece->data = d;
 }
 
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_bilat_data_t *d = (dt_iop_bilat_data_t *)piece->data;
+  local_laplacian_workspace_free(d->ws);
   free(piece->data);
   piece->data = NULL;
 }
@@ -320,7 +350,9 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
   }
   else // s_mode_local_laplacian
   {
-    local_laplacian_sse2(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+    local_laplacian_sse2(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, d->ws,
+                         0);
+    local_laplacian_workspace_trim(d->ws, _workspace_budget(piece->pipe));
   }
 
   if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(i, o, roi_in->width, roi_in->height);
@@ -349,7 +381,9 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   }
   else // s_mode_local_laplacian
   {
-    local_laplacian(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, 0);
+    local_laplacian(i, o, roi_in->width, roi_in->height, d->midtone, d->sigma_s, d->sigma_r, d->detail, d->ws,
+                    0);
+    local_laplacian_workspace_trim(d->ws, _workspace_budget(piece->pipe));
   }
 
   if(piece->pipe->mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) dt_iop_alpha_copy(i, o, roi_in->width, roi_in->height);
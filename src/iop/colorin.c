@@ -107,6 +107,9 @@ typedef struct dt_iop_colorin_data_t
   cmsHTRANSFORM *xform_cam_Lab;
   cmsHTRANSFORM *xform_cam_nrgb;
   cmsHTRANSFORM *xform_nrgb_Lab;
+  dt_colorspaces_clut_t *clut_cam_Lab; // sampled versions of the transforms above, NULL if they don't sample well
+  dt_colorspaces_clut_t *clut_cam_nrgb;
+  dt_colorspaces_clut_t *clut_nrgb_Lab;
   float lut[3][LUT_SAMPLES];
   float cmatrix[9];
   float nmatrix[9];
@@ -913,6 +916,16 @@ static void process_cmatrix(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t
   }
 }
 
+// lcms transform through the sampled table if we have one
+static inline void do_transform(cmsHTRANSFORM xform, const dt_colorspaces_clut_t *const clut,
+                                const float *const in, float *const out, const int npixels)
+{
+  if(clut)
+    dt_colorspaces_clut_apply(clut, in, out, npixels);
+  else
+    cmsDoTransform(xform, in, out, npixels);
+}
+
 static void process_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
                              void *const ovoid, const dt_iop_roi_t *const roi_in,
                              const dt_iop_roi_t *const roi_out)
@@ -940,11 +953,11 @@ static void process_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, out, out, roi_out->width);
+      do_transform(d->xform_cam_Lab, d->clut_cam_Lab, out, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, out, out, roi_out->width);
+      do_transform(d->xform_cam_nrgb, d->clut_cam_nrgb, out, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -955,7 +968,7 @@ static void process_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
         }
       }
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      do_transform(d->xform_nrgb_Lab, d->clut_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -981,11 +994,11 @@ static void process_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixelpipe_
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, in, out, roi_out->width);
+      do_transform(d->xform_cam_Lab, d->clut_cam_Lab, in, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, in, out, roi_out->width);
+      do_transform(d->xform_cam_nrgb, d->clut_cam_nrgb, in, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -996,7 +1009,7 @@ static void process_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixelpipe_
         }
       }
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      do_transform(d->xform_nrgb_Lab, d->clut_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -1330,11 +1343,11 @@ static void process_sse2_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, out, out, roi_out->width);
+      do_transform(d->xform_cam_Lab, d->clut_cam_Lab, out, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, out, out, roi_out->width);
+      do_transform(d->xform_cam_nrgb, d->clut_cam_nrgb, out, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -1347,7 +1360,7 @@ static void process_sse2_lcms2_bm(struct dt_iop_module_t *self, dt_dev_pixelpipe
       }
       _mm_sfence();
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      do_transform(d->xform_nrgb_Lab, d->clut_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -1374,11 +1387,11 @@ static void process_sse2_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixel
     // convert to (L,a/L,b/L) to be able to change L without changing saturation.
     if(!d->nrgb)
     {
-      cmsDoTransform(d->xform_cam_Lab, in, out, roi_out->width);
+      do_transform(d->xform_cam_Lab, d->clut_cam_Lab, in, out, roi_out->width);
     }
     else
     {
-      cmsDoTransform(d->xform_cam_nrgb, in, out, roi_out->width);
+      do_transform(d->xform_cam_nrgb, d->clut_cam_nrgb, in, out, roi_out->width);
 
       float *rgbptr = (float *)out;
       for(int j = 0; j < roi_out->width; j++, rgbptr += 4)
@@ -1391,7 +1404,7 @@ static void process_sse2_lcms2_proper(struct dt_iop_module_t *self, dt_dev_pixel
       }
       _mm_sfence();
 
-      cmsDoTransform(d->xform_nrgb_Lab, out, out, roi_out->width);
+      do_transform(d->xform_nrgb_Lab, d->clut_nrgb_Lab, out, out, roi_out->width);
     }
   }
 }
@@ -1488,6 +1501,10 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
       d->nrgb = NULL;
   }
 
+  dt_colorspaces_clut_free(d->clut_cam_Lab);
+  dt_colorspaces_clut_free(d->clut_cam_nrgb);
+  dt_colorspaces_clut_free(d->clut_nrgb_Lab);
+  d->clut_cam_Lab = d->clut_cam_nrgb = d->clut_nrgb_Lab = NULL;
   if(d->xform_cam_Lab)
   {
     cmsDeleteTransform(d->xform_cam_Lab);
@@ -1713,6 +1730,27 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
     }
   }
 
+  // most of what makes it here is a LUT profile, sample the transforms into tables to be evaluated without lcms.
+  // raw data beyond the range of the tables still goes through lcms. the tables are shared between pipes.
+  const float min[3] = { 0.0f, 0.0f, 0.0f }, max[3] = { 1.0f, 1.0f, 1.0f };
+  const size_t npixels = (size_t)pipe->iwidth * pipe->iheight;
+  if(d->xform_cam_Lab)
+  {
+    gchar *key = dt_colorspaces_clut_key(d->input, Lab, NULL, p->intent, 0);
+    d->clut_cam_Lab = dt_colorspaces_clut_create(d->xform_cam_Lab, min, max, NULL, 1.0f, key, npixels);
+    g_free(key);
+  }
+  if(d->xform_cam_nrgb && d->xform_nrgb_Lab)
+  {
+    gchar *key = dt_colorspaces_clut_key(d->input, d->nrgb, NULL, p->intent, 0);
+    d->clut_cam_nrgb
+        = dt_colorspaces_clut_create(d->xform_cam_nrgb, min, max, d->xform_nrgb_Lab, 1.0f, key, npixels);
+    g_free(key);
+    key = dt_colorspaces_clut_key(d->nrgb, Lab, NULL, p->intent, 0);
+    d->clut_nrgb_Lab = dt_colorspaces_clut_create(d->xform_nrgb_Lab, min, max, NULL, 1.0f, key, npixels);
+    g_free(key);
+  }
+
   d->nonlinearlut = 0;
 
   // now try to initialize unbounded mode:
@@ -1749,12 +1787,19 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
   d->xform_cam_Lab = NULL;
   d->xform_cam_nrgb = NULL;
   d->xform_nrgb_Lab = NULL;
+  d->clut_cam_Lab = NULL;
+  d->clut_cam_nrgb = NULL;
+  d->clut_nrgb_Lab = NULL;
 }
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_colorin_data_t *d = (dt_iop_colorin_data_t *)piece->data;
   if(d->input && d->clear_input) dt_colorspaces_cleanup_profile(d->input);
+  dt_colorspaces_clut_free(d->clut_cam_Lab);
+  dt_colorspaces_clut_free(d->clut_cam_nrgb);
+  dt_colorspaces_clut_free(d->clut_nrgb_Lab);
+  d->clut_cam_Lab = d->clut_cam_nrgb = d->clut_nrgb_Lab = NULL;
   if(d->xform_cam_Lab)
   {
     cmsDeleteTransform(d->xform_cam_Lab);
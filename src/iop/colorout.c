@@ -55,6 +55,7 @@ typedef struct dt_iop_colorout_data_t
   float lut[3][LUT_SAMPLES];
   float cmatrix[9];
   cmsHTRANSFORM *xform;
+  dt_colorspaces_clut_t *clut; // xform sampled into a table, NULL if it doesn't sample well
   float unbounded_coeffs[3][3]; // for extrapolation of shaper curves
 } dt_iop_colorout_data_t;
 
@@ -447,7 +448,10 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
       const float *in = ((float *)ivoid) + (size_t)ch * k * roi_out->width;
       float *out = ((float *)ovoid) + (size_t)ch * k * roi_out->width;
 
-      cmsDoTransform(d->xform, in, out, roi_out->width);
+      if(d->clut)
+        dt_colorspaces_clut_apply(d->clut, in, out, roi_out->width);
+      else
+        cmsDoTransform(d->xform, in, out, roi_out->width);
 
       if(gamutcheck)
       {
@@ -526,7 +530,10 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
       const float *in = ((float *)ivoid) + (size_t)ch * k * roi_out->width;
       float *out = ((float *)ovoid) + (size_t)ch * k * roi_out->width;
 
-      cmsDoTransform(d->xform, in, out, roi_out->width);
+      if(d->clut)
+        dt_colorspaces_clut_apply(d->clut, in, out, roi_out->width);
+      else
+        cmsDoTransform(d->xform, in, out, roi_out->width);
 
       if(gamutcheck)
       {
@@ -592,6 +599,8 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 
   d->mode = (pipe->type & DT_DEV_PIXELPIPE_FULL) == DT_DEV_PIXELPIPE_FULL ? darktable.color_profiles->mode : DT_PROFILE_NORMAL;
 
+  dt_colorspaces_clut_free(d->clut);
+  d->clut = NULL;
   if(d->xform)
   {
     cmsDeleteTransform(d->xform);
@@ -752,6 +761,24 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
     }
   }
 
+  // sample whatever the matrix path can't handle into a table, as long as it's close enough to lcms when
+  // compared in Lab. the gamut check marks pixels by their exact output, leave that to lcms.
+  if(d->xform && d->mode != DT_PROFILE_GAMUTCHECK)
+  {
+    cmsHTRANSFORM to_lab
+        = cmsCreateTransform(output, output_format, Lab, TYPE_LabA_FLT, INTENT_RELATIVE_COLORIMETRIC, 0);
+    if(to_lab)
+    {
+      // shared between pipes, by the contents of the profiles as display profiles change under the same name
+      const float min[3] = { 0.0f, -128.0f, -128.0f }, max[3] = { 100.0f, 128.0f, 128.0f };
+      gchar *key = dt_colorspaces_clut_key(Lab, output, softproof, out_intent, transformFlags);
+      d->clut = dt_colorspaces_clut_create(d->xform, min, max, to_lab, 1.0f, key,
+                                           (size_t)pipe->iwidth * pipe->iheight);
+      g_free(key);
+      cmsDeleteTransform(to_lab);
+    }
+  }
+
   if(out_type == DT_COLORSPACE_DISPLAY || out_type == DT_COLORSPACE_DISPLAY2)
     pthread_rwlock_unlock(&darktable.color_profiles->xprofile_lock);
 
@@ -786,11 +813,14 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
   piece->data = calloc(1, sizeof(dt_iop_colorout_data_t));
   dt_iop_colorout_data_t *d = (dt_iop_colorout_data_t *)piece->data;
   d->xform = NULL;
+  d->clut = NULL;
 }
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
   dt_iop_colorout_data_t *d = (dt_iop_colorout_data_t *)piece->data;
+  dt_colorspaces_clut_free(d->clut);
+  d->clut = NULL;
   if(d->xform)
   {
     cmsDeleteTransform(d->xform);
@@ -27,6 +27,7 @@
 #include "develop/develop.h"
 #include "develop/imageop.h"
 #include "develop/imageop_math.h"
+#include "develop/openmp_maths.h"
 #include "develop/imageop_gui.h"
 #include "develop/tiling.h"
 #include "gui/accelerators.h"
@@ -56,6 +57,7 @@ typedef enum dt_iop_demosaic_method_t
   DT_IOP_DEMOSAIC_PPG = 0,   // $DESCRIPTION: "PPG (fast)"
   DT_IOP_DEMOSAIC_AMAZE = 1, // $DESCRIPTION: "AMaZE (slow)"
   DT_IOP_DEMOSAIC_VNG4 = 2,  // $DESCRIPTION: "VNG4"
+  DT_IOP_DEMOSAIC_RCD = 5,   // $DESCRIPTION: "RCD"
   DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME = 3, // $DESCRIPTION: "passthrough (monochrome) (experimental)"
   DT_IOP_DEMOSAIC_PASSTHROUGH_COLOR = 4, // $DESCRIPTION: "photosite color (debug)"
   // methods for x-trans images
@@ -239,6 +241,9 @@ static const char* method2string(dt_iop_demosaic_method_t method)
     case DT_IOP_DEMOSAIC_VNG4:
       string = "VNG4";
       break;
+    case DT_IOP_DEMOSAIC_RCD:
+      string = "RCD";
+      break;
     case DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME:
       string = "passthrough monochrome";
       break;
@@ -2713,6 +2718,350 @@ static void demosaic_ppg(float *const out, const float *const in, const dt_iop_r
   if(median) dt_free_align((float *)input);
 }
 
+/*
+ * RCD - Ratio Corrected Demosaicing, by Luis Sanz Rodriguez (luis.sanz.rodriguez(at)gmail(dot)com)
+ *
+ * Works on square tiles of RCD_TILESIZE pixels overlapping by RCD_BORDER on each side, so that all
+ * intermediate buffers of a thread fit into its cache and the tiles can be handled in parallel.
+ * Only the inner RCD_TILEVALID pixels of a tile are written, the outer RCD_BORDER pixels of the
+ * image are interpolated from their 3x3 neighbourhood like in PPG.
+ */
+#define RCD_TILESIZE 112
+#define RCD_BORDER 9
+#define RCD_TILEVALID (RCD_TILESIZE - 2 * RCD_BORDER)
+#define RCD_EPS 1e-5f
+#define RCD_EPSSQ 1e-10f
+
+static void rcd_border_interpolate(float *const out, const float *const in, const int width, const int height,
+                                   const uint32_t filters, const int border)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(out, in, width, height, filters, border) \
+  schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    for(int i = 0; i < width; i++)
+    {
+      // skip the part the tiles have written
+      if(i == border && j >= border && j < height - border) i = MAX(border, width - border);
+      if(i == width) break;
+
+      float sum[8] = { 0.0f };
+      for(int y = MAX(0, j - 1); y < MIN(height, j + 2); y++)
+        for(int x = MAX(0, i - 1); x < MIN(width, i + 2); x++)
+        {
+          const int f = FC(y, x, filters);
+          sum[f] += in[(size_t)y * width + x];
+          sum[f + 4]++;
+        }
+      const int f = FC(j, i, filters);
+      for(int c = 0; c < 3; c++)
+      {
+        if(c != f && sum[c + 4] > 0.0f)
+          out[4 * ((size_t)j * width + i) + c] = sum[c] / sum[c + 4];
+        else
+          out[4 * ((size_t)j * width + i) + c] = in[(size_t)j * width + i];
+      }
+      out[4 * ((size_t)j * width + i) + 3] = 0.0f;
+    }
+  }
+}
+
+static void rcd_demosaic(float *const out, const float *const in, const dt_iop_roi_t *const roi_out,
+                         const dt_iop_roi_t *const roi_in, const uint32_t filters)
+{
+  // we demosaic at 1:1, see process()
+  const int width = roi_in->width;
+  const int height = roi_in->height;
+  assert(roi_out->width == width && roi_out->height == height);
+
+  rcd_border_interpolate(out, in, width, height, filters, RCD_BORDER);
+  if(width < 2 * RCD_BORDER + 1 || height < 2 * RCD_BORDER + 1) return;
+
+  const int num_vertical = 1 + (height - 2 * RCD_BORDER - 1) / RCD_TILEVALID;
+  const int num_horizontal = 1 + (width - 2 * RCD_BORDER - 1) / RCD_TILEVALID;
+
+  const int w1 = RCD_TILESIZE, w2 = 2 * RCD_TILESIZE, w3 = 3 * RCD_TILESIZE, w4 = 4 * RCD_TILESIZE;
+  const size_t tilesize = (size_t)RCD_TILESIZE * RCD_TILESIZE;
+
+#ifdef _OPENMP
+#pragma omp parallel default(none) \
+  dt_omp_firstprivate(out, in, width, height, filters, num_vertical, num_horizontal, w1, w2, w3, w4, tilesize)
+#endif
+  {
+    // per thread buffers, the high pass filters of step 1 and step 4 share their memory
+    float *const buffers = dt_alloc_align(64, 9 * tilesize * sizeof(float));
+    float *const cfa = buffers;
+    float *const VH_Dir = buffers + tilesize;
+    float *const PQ_Dir = buffers + 2 * tilesize;
+    float *const lpf = buffers + 3 * tilesize;
+    float *const V_Hpf = buffers + 4 * tilesize;
+    float *const H_Hpf = buffers + 5 * tilesize;
+    float *const P_Hpf = V_Hpf;
+    float *const Q_Hpf = H_Hpf;
+    float *const rgb[3] = { buffers + 6 * tilesize, buffers + 7 * tilesize, buffers + 8 * tilesize };
+    // the outermost rows and columns of a tile are read but never computed, keep them finite
+    memset(buffers, 0, 9 * tilesize * sizeof(float));
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic) collapse(2)
+#endif
+    for(int tile_vertical = 0; tile_vertical < num_vertical; tile_vertical++)
+    {
+      for(int tile_horizontal = 0; tile_horizontal < num_horizontal; tile_horizontal++)
+      {
+        const int rowStart = tile_vertical * RCD_TILEVALID;
+        const int colStart = tile_horizontal * RCD_TILEVALID;
+        const int tileRows = MIN(height - rowStart, RCD_TILESIZE);
+        const int tileCols = MIN(width - colStart, RCD_TILESIZE);
+
+        // Step 0: fill the tile, negative values would break the ratios below
+        for(int row = 0; row < tileRows; row++)
+        {
+          for(int col = 0, indx = row * RCD_TILESIZE; col < tileCols; col++, indx++)
+          {
+            const float val = fmaxf(in[(size_t)(rowStart + row) * width + colStart + col], 0.0f);
+            cfa[indx] = rgb[FC(rowStart + row, colStart + col, filters)][indx] = val;
+          }
+        }
+
+        // Step 1: Find cardinal and diagonal interpolation directions
+        // Step 1.1: Calculate the square of the vertical and horizontal color difference high pass filter
+        for(int row = 3; row < tileRows - 3; row++)
+        {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+          for(int col = 3; col < tileCols - 3; col++)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+            V_Hpf[indx] = sqf((cfa[indx - w3] - cfa[indx - w1] - cfa[indx + w1] + cfa[indx + w3])
+                              - 3.0f * (cfa[indx - w2] + cfa[indx + w2]) + 6.0f * cfa[indx]);
+            H_Hpf[indx] = sqf((cfa[indx - 3] - cfa[indx - 1] - cfa[indx + 1] + cfa[indx + 3])
+                              - 3.0f * (cfa[indx - 2] + cfa[indx + 2]) + 6.0f * cfa[indx]);
+          }
+        }
+
+        // Step 1.2: Obtain the vertical and horizontal directional discrimination strength
+        for(int row = 4; row < tileRows - 4; row++)
+        {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+          for(int col = 4; col < tileCols - 4; col++)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+            const float V_Stat = fmaxf(RCD_EPSSQ, V_Hpf[indx - w1] + V_Hpf[indx] + V_Hpf[indx + w1]);
+            const float H_Stat = fmaxf(RCD_EPSSQ, H_Hpf[indx - 1] + H_Hpf[indx] + H_Hpf[indx + 1]);
+            VH_Dir[indx] = V_Stat / (V_Stat + H_Stat);
+          }
+        }
+
+        // Step 2: Low pass filter incorporating green, red and blue local samples from the raw data
+        for(int row = 2; row < tileRows - 2; row++)
+        {
+          for(int col = 2 + (FC(rowStart + row, colStart + 2, filters) & 1); col < tileCols - 2; col += 2)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+            lpf[indx] = 0.25f * cfa[indx]
+                        + 0.125f * (cfa[indx - w1] + cfa[indx + w1] + cfa[indx - 1] + cfa[indx + 1])
+                        + 0.0625f * (cfa[indx - w1 - 1] + cfa[indx - w1 + 1] + cfa[indx + w1 - 1] + cfa[indx + w1 + 1]);
+          }
+        }
+
+        // Step 3: Populate the green channel at blue and red CFA positions
+        for(int row = 4; row < tileRows - 4; row++)
+        {
+          for(int col = 4 + (FC(rowStart + row, colStart + 4, filters) & 1); col < tileCols - 4; col += 2)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+
+            // Cardinal gradients
+            const float N_Grad = RCD_EPS + fabsf(cfa[indx - w1] - cfa[indx + w1]) + fabsf(cfa[indx] - cfa[indx - w2])
+                                 + fabsf(cfa[indx - w1] - cfa[indx - w3]) + fabsf(cfa[indx - w2] - cfa[indx - w4]);
+            const float S_Grad = RCD_EPS + fabsf(cfa[indx - w1] - cfa[indx + w1]) + fabsf(cfa[indx] - cfa[indx + w2])
+                                 + fabsf(cfa[indx + w1] - cfa[indx + w3]) + fabsf(cfa[indx + w2] - cfa[indx + w4]);
+            const float W_Grad = RCD_EPS + fabsf(cfa[indx - 1] - cfa[indx + 1]) + fabsf(cfa[indx] - cfa[indx - 2])
+                                 + fabsf(cfa[indx - 1] - cfa[indx - 3]) + fabsf(cfa[indx - 2] - cfa[indx - 4]);
+            const float E_Grad = RCD_EPS + fabsf(cfa[indx - 1] - cfa[indx + 1]) + fabsf(cfa[indx] - cfa[indx + 2])
+                                 + fabsf(cfa[indx + 1] - cfa[indx + 3]) + fabsf(cfa[indx + 2] - cfa[indx + 4]);
+
+            // Cardinal pixel estimations
+            const float lpfc = 2.0f * lpf[indx];
+            const float N_Est = cfa[indx - w1] * lpfc / (RCD_EPS + lpf[indx] + lpf[indx - w2]);
+            const float S_Est = cfa[indx + w1] * lpfc / (RCD_EPS + lpf[indx] + lpf[indx + w2]);
+            const float W_Est = cfa[indx - 1] * lpfc / (RCD_EPS + lpf[indx] + lpf[indx - 2]);
+            const float E_Est = cfa[indx + 1] * lpfc / (RCD_EPS + lpf[indx] + lpf[indx + 2]);
+
+            // Vertical and horizontal estimations
+            const float V_Est = (S_Grad * N_Est + N_Grad * S_Est) / (N_Grad + S_Grad);
+            const float H_Est = (W_Grad * E_Est + E_Grad * W_Est) / (E_Grad + W_Grad);
+
+            // G@B and G@R interpolation, using the refined vertical and horizontal local discrimination
+            const float VH_Central_Value = VH_Dir[indx];
+            const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1]
+                                                          + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
+            const float VH_Disc = (fabsf(0.5f - VH_Central_Value) < fabsf(0.5f - VH_Neighbourhood_Value))
+                                      ? VH_Neighbourhood_Value
+                                      : VH_Central_Value;
+
+            rgb[1][indx] = VH_Disc * H_Est + (1.0f - VH_Disc) * V_Est;
+          }
+        }
+
+        // Step 4: Populate the red and blue channels
+        // Step 4.1: Calculate the square of the P/Q diagonals color difference high pass filter
+        for(int row = 3; row < tileRows - 3; row++)
+        {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+          for(int col = 3; col < tileCols - 3; col++)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+            P_Hpf[indx] = sqf((cfa[indx - w3 - 3] - cfa[indx - w1 - 1] - cfa[indx + w1 + 1] + cfa[indx + w3 + 3])
+                              - 3.0f * (cfa[indx - w2 - 2] + cfa[indx + w2 + 2]) + 6.0f * cfa[indx]);
+            Q_Hpf[indx] = sqf((cfa[indx - w3 + 3] - cfa[indx - w1 + 1] - cfa[indx + w1 - 1] + cfa[indx + w3 - 3])
+                              - 3.0f * (cfa[indx - w2 + 2] + cfa[indx + w2 - 2]) + 6.0f * cfa[indx]);
+          }
+        }
+
+        // Step 4.2: Obtain the P/Q diagonal directional discrimination strength
+        for(int row = 4; row < tileRows - 4; row++)
+        {
+          for(int col = 4 + (FC(rowStart + row, colStart + 4, filters) & 1); col < tileCols - 4; col += 2)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+            const float P_Stat = fmaxf(RCD_EPSSQ, P_Hpf[indx - w1 - 1] + P_Hpf[indx] + P_Hpf[indx + w1 + 1]);
+            const float Q_Stat = fmaxf(RCD_EPSSQ, Q_Hpf[indx - w1 + 1] + Q_Hpf[indx] + Q_Hpf[indx + w1 - 1]);
+            PQ_Dir[indx] = P_Stat / (P_Stat + Q_Stat);
+          }
+        }
+
+        // Step 4.3: Populate the red and blue channels at blue and red CFA positions
+        for(int row = 4; row < tileRows - 4; row++)
+        {
+          const int col0 = 4 + (FC(rowStart + row, colStart + 4, filters) & 1);
+          const int c = 2 - FC(rowStart + row, colStart + col0, filters);
+          float *const rgbc = rgb[c];
+          const float *const rgb1 = rgb[1];
+          for(int col = col0; col < tileCols - 4; col += 2)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+
+            // Refined P/Q diagonal local discrimination
+            const float PQ_Central_Value = PQ_Dir[indx];
+            const float PQ_Neighbourhood_Value = 0.25f * (PQ_Dir[indx - w1 - 1] + PQ_Dir[indx - w1 + 1]
+                                                          + PQ_Dir[indx + w1 - 1] + PQ_Dir[indx + w1 + 1]);
+            const float PQ_Disc = (fabsf(0.5f - PQ_Central_Value) < fabsf(0.5f - PQ_Neighbourhood_Value))
+                                      ? PQ_Neighbourhood_Value
+                                      : PQ_Central_Value;
+
+            // Diagonal gradients
+            const float NW_Grad = RCD_EPS + fabsf(rgbc[indx - w1 - 1] - rgbc[indx + w1 + 1])
+                                  + fabsf(rgbc[indx - w1 - 1] - rgbc[indx - w3 - 3])
+                                  + fabsf(rgb1[indx] - rgb1[indx - w2 - 2]);
+            const float NE_Grad = RCD_EPS + fabsf(rgbc[indx - w1 + 1] - rgbc[indx + w1 - 1])
+                                  + fabsf(rgbc[indx - w1 + 1] - rgbc[indx - w3 + 3])
+                                  + fabsf(rgb1[indx] - rgb1[indx - w2 + 2]);
+            const float SW_Grad = RCD_EPS + fabsf(rgbc[indx - w1 + 1] - rgbc[indx + w1 - 1])
+                                  + fabsf(rgbc[indx + w1 - 1] - rgbc[indx + w3 - 3])
+                                  + fabsf(rgb1[indx] - rgb1[indx + w2 - 2]);
+            const float SE_Grad = RCD_EPS + fabsf(rgbc[indx - w1 - 1] - rgbc[indx + w1 + 1])
+                                  + fabsf(rgbc[indx + w1 + 1] - rgbc[indx + w3 + 3])
+                                  + fabsf(rgb1[indx] - rgb1[indx + w2 + 2]);
+
+            // Diagonal colour differences
+            const float NW_Est = rgbc[indx - w1 - 1] - rgb1[indx - w1 - 1];
+            const float NE_Est = rgbc[indx - w1 + 1] - rgb1[indx - w1 + 1];
+            const float SW_Est = rgbc[indx + w1 - 1] - rgb1[indx + w1 - 1];
+            const float SE_Est = rgbc[indx + w1 + 1] - rgb1[indx + w1 + 1];
+
+            // P/Q estimations
+            const float P_Est = (NW_Grad * SE_Est + SE_Grad * NW_Est) / (NW_Grad + SE_Grad);
+            const float Q_Est = (NE_Grad * SW_Est + SW_Grad * NE_Est) / (NE_Grad + SW_Grad);
+
+            // R@B and B@R interpolation
+            rgbc[indx] = rgb1[indx] + PQ_Disc * Q_Est + (1.0f - PQ_Disc) * P_Est;
+          }
+        }
+
+        // Step 4.4: Populate the red and blue channels at green CFA positions
+        for(int row = 4; row < tileRows - 4; row++)
+        {
+          for(int col = 4 + (FC(rowStart + row, colStart + 5, filters) & 1); col < tileCols - 4; col += 2)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+
+            // Refined vertical and horizontal local discrimination
+            const float VH_Central_Value = VH_Dir[indx];
+            const float VH_Neighbourhood_Value = 0.25f * (VH_Dir[indx - w1 - 1] + VH_Dir[indx - w1 + 1]
+                                                          + VH_Dir[indx + w1 - 1] + VH_Dir[indx + w1 + 1]);
+            const float VH_Disc = (fabsf(0.5f - VH_Central_Value) < fabsf(0.5f - VH_Neighbourhood_Value))
+                                      ? VH_Neighbourhood_Value
+                                      : VH_Central_Value;
+
+            const float *const rgb1 = rgb[1];
+            const float N1 = RCD_EPS + fabsf(rgb1[indx] - rgb1[indx - w2]);
+            const float S1 = RCD_EPS + fabsf(rgb1[indx] - rgb1[indx + w2]);
+            const float W1 = RCD_EPS + fabsf(rgb1[indx] - rgb1[indx - 2]);
+            const float E1 = RCD_EPS + fabsf(rgb1[indx] - rgb1[indx + 2]);
+
+            for(int c = 0; c <= 2; c += 2)
+            {
+              float *const rgbc = rgb[c];
+              const float SNabs = fabsf(rgbc[indx - w1] - rgbc[indx + w1]);
+              const float EWabs = fabsf(rgbc[indx - 1] - rgbc[indx + 1]);
+
+              // Cardinal gradients
+              const float N_Grad = N1 + SNabs + fabsf(rgbc[indx - w1] - rgbc[indx - w3]);
+              const float S_Grad = S1 + SNabs + fabsf(rgbc[indx + w1] - rgbc[indx + w3]);
+              const float W_Grad = W1 + EWabs + fabsf(rgbc[indx - 1] - rgbc[indx - 3]);
+              const float E_Grad = E1 + EWabs + fabsf(rgbc[indx + 1] - rgbc[indx + 3]);
+
+              // Cardinal colour differences
+              const float N_Est = rgbc[indx - w1] - rgb1[indx - w1];
+              const float S_Est = rgbc[indx + w1] - rgb1[indx + w1];
+              const float W_Est = rgbc[indx - 1] - rgb1[indx - 1];
+              const float E_Est = rgbc[indx + 1] - rgb1[indx + 1];
+
+              // Vertical and horizontal estimations
+              const float V_Est = (N_Grad * S_Est + S_Grad * N_Est) / (N_Grad + S_Grad);
+              const float H_Est = (E_Grad * W_Est + W_Grad * E_Est) / (E_Grad + W_Grad);
+
+              // R@G and B@G interpolation
+              rgbc[indx] = rgb1[indx] + VH_Disc * H_Est + (1.0f - VH_Disc) * V_Est;
+            }
+          }
+        }
+
+        // Step 5: write the valid part of the tile, the neighbouring tiles cover its border
+        for(int row = RCD_BORDER; row < tileRows - RCD_BORDER; row++)
+        {
+          float *const dest = out + 4 * ((size_t)(rowStart + row) * width + colStart);
+          for(int col = RCD_BORDER; col < tileCols - RCD_BORDER; col++)
+          {
+            const int indx = row * RCD_TILESIZE + col;
+            dest[4 * col] = fmaxf(0.0f, rgb[0][indx]);
+            dest[4 * col + 1] = fmaxf(0.0f, rgb[1][indx]);
+            dest[4 * col + 2] = fmaxf(0.0f, rgb[2][indx]);
+            dest[4 * col + 3] = 0.0f;
+          }
+        }
+      }
+    }
+    dt_free_align(buffers);
+  }
+}
+
+#undef RCD_TILESIZE
+#undef RCD_BORDER
+#undef RCD_TILEVALID
+#undef RCD_EPS
+#undef RCD_EPSSQ
+
 void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const float *const in,
                   float *const out, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -2960,6 +3309,8 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
           dt_colorspaces_cygm_to_rgb(piece->pipe->dsc.processed_maximum, 1, data->CAM_to_RGB);
         }
       }
+      else if(demosaicing_method == DT_IOP_DEMOSAIC_RCD)
+        rcd_demosaic(tmp, in, &roo, &roi, piece->pipe->dsc.filters);
       else if(demosaicing_method != DT_IOP_DEMOSAIC_AMAZE)
         demosaic_ppg(tmp, in, &roo, &roi, piece->pipe->dsc.filters,
                      data->median_thrs); // wanted ppg or zoomed out a lot and quality is limited to 1
@@ -4687,9 +5038,10 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
   if((demosaicing_method == DT_IOP_DEMOSAIC_PPG) ||
       (demosaicing_method == DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME) ||
       (demosaicing_method == DT_IOP_DEMOSAIC_PASSTHROUGH_COLOR) ||
-      (demosaicing_method == DT_IOP_DEMOSAIC_AMAZE))
+      (demosaicing_method == DT_IOP_DEMOSAIC_AMAZE) ||
+      (demosaicing_method == DT_IOP_DEMOSAIC_RCD))
   {
-    // Bayer pattern with PPG, Passthrough or Amaze
+    // Bayer pattern with PPG, Passthrough, Amaze or RCD
     tiling->factor = 1.0f + ioratio;         // in + out
 
     if(full_scale_demosaicing && unscaled)
@@ -4703,7 +5055,8 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     tiling->overhead = 0;
     tiling->xalign = 2;
     tiling->yalign = 2;
-    tiling->overlap = 5; // take care of border handling
+    // take care of border handling, RCD needs 9 pixels around each of its own tiles
+    tiling->overlap = (demosaicing_method == DT_IOP_DEMOSAIC_RCD) ? 10 : 5;
   }
   else if(((demosaicing_method ==  DT_IOP_DEMOSAIC_MARKESTEIJN) ||
            (demosaicing_method ==  DT_IOP_DEMOSAIC_MARKESTEIJN_3) ||
@@ -4877,7 +5230,11 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *params, dt_dev
     d->median_thrs = 0.0f;
   }
 
-  if(d->demosaicing_method == DT_IOP_DEMOSAIC_AMAZE)
+  // thumbnails are rendered in bulk while browsing, RCD gets close to AMaZE in a fraction of its time
+  if(d->demosaicing_method == DT_IOP_DEMOSAIC_AMAZE && (pipe->type & DT_DEV_PIXELPIPE_THUMBNAIL))
+    d->demosaicing_method = DT_IOP_DEMOSAIC_RCD;
+
+  if(d->demosaicing_method == DT_IOP_DEMOSAIC_AMAZE || d->demosaicing_method == DT_IOP_DEMOSAIC_RCD)
   {
     d->median_thrs = 0.0f;
   }
@@ -4894,6 +5251,9 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *params, dt_dev
     case DT_IOP_DEMOSAIC_VNG4:
       piece->process_cl_ready = 1;
       break;
+    case DT_IOP_DEMOSAIC_RCD:
+      piece->process_cl_ready = 0;
+      break;
     case DT_IOP_DEMOSAIC_PASSTHROUGH_MONOCHROME:
       piece->process_cl_ready = 1;
       break;
@@ -4977,7 +5337,8 @@ void gui_update(struct dt_iop_module_t *self)
     gtk_widget_hide(g->greeneq);
   }
 
-  if(p->demosaicing_method == DT_IOP_DEMOSAIC_AMAZE || p->demosaicing_method == DT_IOP_DEMOSAIC_VNG4)
+  if(p->demosaicing_method == DT_IOP_DEMOSAIC_AMAZE || p->demosaicing_method == DT_IOP_DEMOSAIC_VNG4
+     || p->demosaicing_method == DT_IOP_DEMOSAIC_RCD)
   {
     gtk_widget_hide(g->median_thrs);
   }
@@ -5059,11 +5420,11 @@ void gui_init(struct dt_iop_module_t *self)
   GtkWidget *box_raw = self->widget = gtk_box_new(GTK_ORIENTATION_VERTICAL, DT_BAUHAUS_SPACE);
 
   g->demosaic_method_bayer = dt_bauhaus_combobox_from_params(self, "demosaicing_method");
-  for(int i=0;i<6;i++) dt_bauhaus_combobox_remove_at(g->demosaic_method_bayer, 5);
+  for(int i=0;i<6;i++) dt_bauhaus_combobox_remove_at(g->demosaic_method_bayer, 6);
   gtk_widget_set_tooltip_text(g->demosaic_method_bayer, _("demosaicing raw data method"));
 
   g->demosaic_method_xtrans = dt_bauhaus_combobox_from_params(self, "demosaicing_method");
-  for(int i=0;i<5;i++) dt_bauhaus_combobox_remove_at(g->demosaic_method_xtrans, 0);
+  for(int i=0;i<6;i++) dt_bauhaus_combobox_remove_at(g->demosaic_method_xtrans, 0);
   gtk_widget_set_tooltip_text(g->demosaic_method_xtrans, _("demosaicing raw data method"));
 
   g->median_thrs = dt_bauhaus_slider_from_params(self, "median_thrs");
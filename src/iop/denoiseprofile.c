@@ -2565,6 +2565,22 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
 }
 #endif
 
+#ifdef HAVE_CODEPATH_CLONES
+void process_avx2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
+                  void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  dt_iop_denoiseprofile_params_t *d = (dt_iop_denoiseprofile_params_t *)piece->data;
+  if(d->mode == MODE_NLMEANS || d->mode == MODE_NLMEANS_AUTO)
+    process_nlmeans_cpu(piece, ivoid, ovoid, roi_in, roi_out, DT_CODEPATH_SELECT(nlmeans_denoise));
+  else if(d->mode == MODE_WAVELETS || d->mode == MODE_WAVELETS_AUTO)
+    // the denoising decomposition has no wider build, only the synthesis does
+    process_wavelets(self, piece, ivoid, ovoid, roi_in, roi_out, eaw_dn_decompose_sse,
+                     DT_CODEPATH_SELECT(eaw_synthesize));
+  else
+    process_variance(self, piece, ivoid, ovoid, roi_in, roi_out);
+}
+#endif
+
 static inline unsigned infer_radius_from_profile(const float a)
 {
   return MIN((unsigned)(1.0f + a * 15000.0f + a * a * 300000.0f), 8);
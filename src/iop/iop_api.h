@@ -198,6 +198,12 @@ void process_sse2(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
                   const struct dt_iop_roi_t *const roi_out);
 #endif
 
+/** a variant process(), that runs the AVX2 or AVX-512 builds of its kernels, see DT_CODEPATH_SELECT(). */
+/** can be provided by each IOP, takes precedence over process_sse2() if the cpu supports AVX2. */
+void process_avx2(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const void *const i,
+                  void *const o, const struct dt_iop_roi_t *const roi_in,
+                  const struct dt_iop_roi_t *const roi_out);
+
 #ifdef HAVE_OPENCL
 /** the opencl equivalent of process(). */
 int process_cl(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, cl_mem dev_in,
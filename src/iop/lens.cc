@@ -116,6 +116,30 @@ typedef struct dt_iop_lensfun_gui_data_t
   dt_pthread_mutex_t lock;
 } dt_iop_lensfun_gui_data_t;
 
+// distance in pixels between the nodes of a distortion map
+#define LENS_MAP_STEP 8
+// number of distortion maps kept around for the pipes
+#define LENS_MAP_CACHE 6
+
+// lensfun evaluates its distortion, TCA and projection models for every single pixel. instead we sample
+// them once on a coarse grid over the whole image and interpolate in between. the maps are shared by all
+// pipes working on the same lens setup and image size, so panning in darkroom and exporting a batch of
+// images taken with the same lens only pay for the grid once.
+typedef struct dt_iop_lensfun_map_t
+{
+  uint64_t hash;        // lens setup, see commit_params()
+  int width, height;    // image size the modifier has been initialized for
+  int mods_filter;      // corrections requested from lensfun
+  int modflags;         // corrections lensfun will actually do
+  lfModifier *modifier;
+  float *grid;          // 6 coordinates (x and y for red, green, blue) per node, NULL if there's nothing to distort
+  int cols, rows;
+  gboolean nan_nodes;   // lensfun couldn't map some of the nodes, see do_nan_checks
+  int users;
+  gboolean cached;
+  uint64_t last_used;
+} dt_iop_lensfun_map_t;
+
 typedef struct dt_iop_lensfun_global_data_t
 {
   lfDatabase *db;
@@ -124,6 +148,9 @@ typedef struct dt_iop_lensfun_global_data_t
   int kernel_lens_distort_lanczos2;
   int kernel_lens_distort_lanczos3;
   int kernel_lens_vignette;
+  dt_pthread_mutex_t map_lock;
+  dt_iop_lensfun_map_t *maps[LENS_MAP_CACHE];
+  uint64_t map_clock;
 } dt_iop_lensfun_global_data_t;
 
 typedef struct dt_iop_lensfun_data_t
@@ -140,6 +167,7 @@ typedef struct dt_iop_lensfun_data_t
   gboolean do_nan_checks;
   gboolean tca_override;
   lfLensCalibTCA custom_tca;
+  uint64_t map_hash;
 } dt_iop_lensfun_data_t;
 
 
@@ -367,6 +395,192 @@ static lfModifier * get_modifier(int *mods_done, int w, int h, const dt_iop_lens
   return mod;
 }
 
+static void _map_free(dt_iop_lensfun_map_t *map)
+{
+  delete map->modifier;
+  if(map->grid) dt_free_align(map->grid);
+  free(map);
+}
+
+// get the distortion map for the lens setup of d on an image of w x h pixels, building it if needed.
+// hand it back with _map_release() when done.
+static dt_iop_lensfun_map_t *_map_acquire(dt_iop_lensfun_global_data_t *gd, const dt_iop_lensfun_data_t *d,
+                                          const int w, const int h, const int mods_filter)
+{
+  dt_pthread_mutex_lock(&gd->map_lock);
+
+  for(int k = 0; k < LENS_MAP_CACHE; k++)
+  {
+    dt_iop_lensfun_map_t *map = gd->maps[k];
+    if(map && map->hash == d->map_hash && map->width == w && map->height == h && map->mods_filter == mods_filter)
+    {
+      map->users++;
+      map->last_used = ++gd->map_clock;
+      dt_pthread_mutex_unlock(&gd->map_lock);
+      return map;
+    }
+  }
+
+  dt_iop_lensfun_map_t *map = (dt_iop_lensfun_map_t *)calloc(1, sizeof(dt_iop_lensfun_map_t));
+  map->hash = d->map_hash;
+  map->width = w;
+  map->height = h;
+  map->mods_filter = mods_filter;
+  map->users = 1;
+  map->last_used = ++gd->map_clock;
+
+  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
+  map->modifier = get_modifier(&map->modflags, w, h, d, mods_filter);
+  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+
+  if(map->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  {
+    // one node beyond the last pixel in each direction
+    const int cols = map->cols = w / LENS_MAP_STEP + 2;
+    const int rows = map->rows = h / LENS_MAP_STEP + 2;
+    float *const grid = map->grid = (float *)dt_alloc_align(64, sizeof(float) * 6 * cols * rows);
+    const lfModifier *const modifier = map->modifier;
+    int nan_nodes = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(cols, rows, grid, modifier) \
+    reduction(| : nan_nodes) \
+    schedule(static)
+#endif
+    for(int j = 0; j < rows; j++)
+    {
+      for(int i = 0; i < cols; i++)
+      {
+        float *const node = grid + (size_t)6 * (j * cols + i);
+        modifier->ApplySubpixelGeometryDistortion(i * LENS_MAP_STEP, j * LENS_MAP_STEP, 1, 1, node);
+        for(int c = 0; c < 6; c++) nan_nodes |= !isfinite(node[c]);
+      }
+    }
+    map->nan_nodes = nan_nodes;
+  }
+
+  dt_print(DT_DEBUG_PERF, "[lens] distortion map for %dx%d, %dx%d nodes\n", w, h, map->cols, map->rows);
+
+  // keep it in a free slot or in place of the least recently used map nobody is working with
+  int slot = -1;
+  for(int k = 0; k < LENS_MAP_CACHE; k++)
+  {
+    if(!gd->maps[k])
+    {
+      slot = k;
+      break;
+    }
+    if(gd->maps[k]->users == 0 && (slot < 0 || gd->maps[k]->last_used < gd->maps[slot]->last_used)) slot = k;
+  }
+  if(slot >= 0)
+  {
+    if(gd->maps[slot]) _map_free(gd->maps[slot]);
+    gd->maps[slot] = map;
+    map->cached = TRUE;
+  }
+
+  dt_pthread_mutex_unlock(&gd->map_lock);
+  return map;
+}
+
+static void _map_release(dt_iop_lensfun_global_data_t *gd, dt_iop_lensfun_map_t *map)
+{
+  dt_pthread_mutex_lock(&gd->map_lock);
+  if(--map->users == 0 && !map->cached) _map_free(map);
+  dt_pthread_mutex_unlock(&gd->map_lock);
+}
+
+// same as lfModifier::ApplySubpixelGeometryDistortion() for a single point, interpolated from the map
+static inline void _map_distort_point(const dt_iop_lensfun_map_t *const map, const float x, const float y,
+                                      float *const out)
+{
+  const float fx = x * (1.0f / LENS_MAP_STEP);
+  const float fy = y * (1.0f / LENS_MAP_STEP);
+
+  if(!(fx >= 0.0f && fy >= 0.0f && fx < map->cols - 1 && fy < map->rows - 1))
+  {
+    // outside of the image
+    map->modifier->ApplySubpixelGeometryDistortion(x, y, 1, 1, out);
+    return;
+  }
+
+  const int i = (int)fx;
+  const int j = (int)fy;
+  const float wx = fx - i;
+  const float wy = fy - j;
+  const float *const n00 = map->grid + (size_t)6 * (j * map->cols + i);
+  const float *const n01 = n00 + 6;
+  const float *const n10 = n00 + (size_t)6 * map->cols;
+  const float *const n11 = n10 + 6;
+
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for(int c = 0; c < 6; c++)
+  {
+    const float top = n00[c] + wx * (n01[c] - n00[c]);
+    const float bottom = n10[c] + wx * (n11[c] - n10[c]);
+    out[c] = top + wy * (bottom - top);
+  }
+
+  // don't grow the areas lensfun can't map by a whole cell
+  if(map->nan_nodes)
+  {
+    for(int c = 0; c < 6; c++)
+    {
+      if(!isfinite(out[c]))
+      {
+        map->modifier->ApplySubpixelGeometryDistortion(x, y, 1, 1, out);
+        break;
+      }
+    }
+  }
+}
+
+// same as lfModifier::ApplySubpixelGeometryDistortion() for a row of pixels
+static void _map_distort_row(const dt_iop_lensfun_map_t *const map, const int x, const int y, const int width,
+                             float *const out)
+{
+  const float fy = y * (1.0f / LENS_MAP_STEP);
+  if(map->nan_nodes || x < 0 || !(fy >= 0.0f && fy < map->rows - 1)
+     || (x + width - 1) / LENS_MAP_STEP + 1 >= map->cols)
+  {
+    for(int k = 0; k < width; k++) _map_distort_point(map, x + k, y, out + 6 * k);
+    return;
+  }
+
+  // blend the two rows of nodes once per cell, then only interpolate horizontally
+  const int j = (int)fy;
+  const float wy = fy - j;
+  const float *const row0 = map->grid + (size_t)6 * j * map->cols;
+  const float *const row1 = row0 + (size_t)6 * map->cols;
+  float left[6], right[6];
+  int i = -1;
+  for(int k = 0; k < width; k++)
+  {
+    const int xx = x + k;
+    if(xx / LENS_MAP_STEP != i)
+    {
+      i = xx / LENS_MAP_STEP;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int c = 0; c < 6; c++)
+      {
+        left[c] = row0[6 * i + c] + wy * (row1[6 * i + c] - row0[6 * i + c]);
+        right[c] = row0[6 * i + 6 + c] + wy * (row1[6 * i + 6 + c] - row0[6 * i + 6 + c]);
+      }
+    }
+    const float wx = (xx - i * LENS_MAP_STEP) * (1.0f / LENS_MAP_STEP);
+    float *const o = out + 6 * k;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int c = 0; c < 6; c++) o[c] = left[c] + wx * (right[c] - left[c]);
+  }
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
              const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -387,12 +601,10 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 
   const float orig_w = roi_in->scale * piece->buf_in.width, orig_h = roi_in->scale * piece->buf_in.height;
 
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-
-  int modflags;
-  lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
-
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
+  dt_iop_lensfun_map_t *map = _map_acquire(gd, d, orig_w, orig_h, LF_MODIFY_ALL);
+  lfModifier *modifier = map->modifier;
+  const int modflags = map->modflags;
 
   const struct dt_interpolation *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF);
 
@@ -409,13 +621,13 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(bufsize, ch, ch_width, d, interpolation, ivoid, \
                           mask_display, ovoid, roi_in, roi_out) \
-      shared(buf, modifier) \
+      shared(buf, map) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = ((float *)buf) + (size_t)bufsize * dt_get_thread_num();
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, bufptr);
+        _map_distort_row(map, roi_out->x, roi_out->y + y, roi_out->width, bufptr);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -512,14 +724,13 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(buf2size, ch, ch_width, d, interpolation, mask_display, ovoid, roi_in, roi_out) \
-      shared(buf2, buf, modifier) \
+      shared(buf2, buf, map) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = ((float *)buf2) + (size_t)buf2size * dt_get_thread_num();
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width,
-                                                  1, buf2ptr);
+        _map_distort_row(map, roi_out->x, roi_out->y + y, roi_out->width, buf2ptr);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -564,7 +775,7 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
     }
     dt_free_align(buf);
   }
-  delete modifier;
+  _map_release(gd, map);
 
   if(self->dev->gui_attached && g && (piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW) == DT_DEV_PIXELPIPE_PREVIEW)
   {
@@ -587,6 +798,7 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   cl_int err = -999;
 
   float *tmpbuf = NULL;
+  dt_iop_lensfun_map_t *map = NULL;
   lfModifier *modifier = NULL;
 
   const int devid = piece->pipe->devid;
@@ -651,9 +863,9 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   dev_tmpbuf = (cl_mem)dt_opencl_alloc_device_buffer(devid, tmpbuflen);
   if(dev_tmpbuf == NULL) goto error;
 
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-  modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  map = _map_acquire(gd, d, orig_w, orig_h, LF_MODIFY_ALL);
+  modifier = map->modifier;
+  modflags = map->modflags;
 
   if(d->inverse)
   {
@@ -663,13 +875,13 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(tmpbufwidth, roi_out) \
-      shared(tmpbuf, d, modifier) \
+      shared(tmpbuf, d, map) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, pi);
+        _map_distort_row(map, roi_out->x, roi_out->y + y, roi_out->width, pi);
       }
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
@@ -780,13 +992,13 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(tmpbufwidth, roi_out) \
-      shared(tmpbuf, d, modifier) \
+      shared(tmpbuf, d, map) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, pi);
+        _map_distort_row(map, roi_out->x, roi_out->y + y, roi_out->width, pi);
       }
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
@@ -824,14 +1036,14 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   dt_opencl_release_mem_object(dev_tmpbuf);
   dt_opencl_release_mem_object(dev_tmp);
   if(tmpbuf != NULL) dt_free_align(tmpbuf);
-  if(modifier != NULL) delete modifier;
+  if(map != NULL) _map_release(gd, map);
   return TRUE;
 
 error:
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_tmpbuf);
   if(tmpbuf != NULL) dt_free_align(tmpbuf);
-  if(modifier != NULL) delete modifier;
+  if(map != NULL) _map_release(gd, map);
   dt_print(DT_DEBUG_OPENCL, "[opencl_lens] couldn't enqueue kernel! %d\n", err);
   return FALSE;
 }
@@ -862,10 +1074,10 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return 0;
 
   const float orig_w = piece->buf_in.width, orig_h = piece->buf_in.height;
-  int modflags;
-  const lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
+  dt_iop_lensfun_map_t *map = _map_acquire(gd, d, orig_w, orig_h, LF_MODIFY_ALL);
 
-  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  if(map->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
     float *buf = (float *)malloc(2 * 3 * sizeof(float));
     for(size_t i = 0; i < points_count * 2; i += 2)
@@ -876,7 +1088,7 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
       // often after 2 or 3 loops.
       for(int k=0; k<10; k++)
       {
-        modifier->ApplySubpixelGeometryDistortion(p1, p2, 1, 1, buf);
+        _map_distort_point(map, p1, p2, buf);
         const float dist1 = points[i]     - buf[0];
         const float dist2 = points[i + 1] - buf[3];
         if(fabs(dist1) < .5f && fabs(dist2) < .5f) break; // we have converged
@@ -890,7 +1102,7 @@ int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, floa
     free(buf);
   }
 
-  delete modifier;
+  _map_release(gd, map);
   return 1;
 }
 
@@ -902,22 +1114,22 @@ int distort_backtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return 0;
 
   const float orig_w = piece->buf_in.width, orig_h = piece->buf_in.height;
-  int modflags;
-  const lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
+  dt_iop_lensfun_map_t *map = _map_acquire(gd, d, orig_w, orig_h, LF_MODIFY_ALL);
 
-  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  if(map->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
     float *buf = (float *)malloc(2 * 3 * sizeof(float));
     for(size_t i = 0; i < points_count * 2; i += 2)
     {
-      modifier->ApplySubpixelGeometryDistortion(points[i], points[i + 1], 1, 1, buf);
+      _map_distort_point(map, points[i], points[i + 1], buf);
       points[i] = buf[0];
       points[i + 1] = buf[3];
     }
     free(buf);
   }
 
-  delete modifier;
+  _map_release(gd, map);
   return 1;
 }
 
@@ -934,16 +1146,14 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
   }
 
   const float orig_w = roi_in->scale * piece->buf_in.width, orig_h = roi_in->scale * piece->buf_in.height;
-  dt_pthread_mutex_lock(&darktable.plugin_threadsafe);
-  int modflags;
-  lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, /*LF_MODIFY_TCA |*/ LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE);
-
-  dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
+  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
+  dt_iop_lensfun_map_t *map = _map_acquire(gd, d, orig_w, orig_h,
+                                           /*LF_MODIFY_TCA |*/ LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE);
 
-  if(!(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE)))
+  if(!(map->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE)))
   {
     memcpy(out, in, sizeof(float) * roi_out->width * roi_out->height);
-    delete modifier;
+    _map_release(gd, map);
     return;
   }
 
@@ -956,13 +1166,13 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(bufsize, d, in, interpolation, out, roi_in, roi_out) \
-  shared(buf, modifier) \
+  shared(buf, map) \
   schedule(static)
 #endif
   for(int y = 0; y < roi_out->height; y++)
   {
     float *bufptr = buf + bufsize * dt_get_thread_num();
-    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, bufptr);
+    _map_distort_row(map, roi_out->x, roi_out->y + y, roi_out->width, bufptr);
 
     // reverse transform the global coords from lf to our buffer
     float *_out = out + (size_t)y * roi_out->width;
@@ -982,7 +1192,7 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
     }
   }
   dt_free_align(buf);
-  delete modifier;
+  _map_release(gd, map);
 }
 
 void modify_roi_out(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, dt_iop_roi_t *roi_out,
@@ -1001,10 +1211,10 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
   if(!d->lens || !d->lens->Maker || d->crop <= 0.0f) return;
 
   const float orig_w = roi_in->scale * piece->buf_in.width, orig_h = roi_in->scale * piece->buf_in.height;
-  int modflags;
-  lfModifier *modifier = get_modifier(&modflags, orig_w, orig_h, d, LF_MODIFY_ALL);
+  dt_iop_lensfun_global_data_t *gd = (dt_iop_lensfun_global_data_t *)self->global_data;
+  dt_iop_lensfun_map_t *map = _map_acquire(gd, d, orig_w, orig_h, LF_MODIFY_ALL);
 
-  if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
+  if(map->modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
   {
     const int xoff = roi_in->x;
     const int yoff = roi_in->y;
@@ -1024,32 +1234,32 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
 #pragma omp parallel default(none) \
     dt_omp_firstprivate(aheight, awidth, buf, height, nbpoints, width, xoff, \
                         xstep, yoff, ystep) \
-    shared(modifier) reduction(min : xm, ym) reduction(max : xM, yM)
+    shared(map) reduction(min : xm, ym) reduction(max : xM, yM)
 #endif
     {
 #ifdef _OPENMP
 #pragma omp for schedule(static)
 #endif
       for(int i = 0; i < awidth; i++)
-        modifier->ApplySubpixelGeometryDistortion(xoff + i * xstep, yoff, 1, 1, buf + 6 * i);
+        _map_distort_point(map, xoff + i * xstep, yoff, buf + 6 * i);
 
 #ifdef _OPENMP
 #pragma omp for schedule(static)
 #endif
       for(int i = 0; i < awidth; i++)
-        modifier->ApplySubpixelGeometryDistortion(xoff + i * xstep, yoff + (height - 1), 1, 1, buf + 6 * (awidth + i));
+        _map_distort_point(map, xoff + i * xstep, yoff + (height - 1), buf + 6 * (awidth + i));
 
 #ifdef _OPENMP
 #pragma omp for schedule(static)
 #endif
       for(int j = 0; j < aheight; j++)
-        modifier->ApplySubpixelGeometryDistortion(xoff, yoff + j * ystep, 1, 1, buf + 6 * (2 * awidth + j));
+        _map_distort_point(map, xoff, yoff + j * ystep, buf + 6 * (2 * awidth + j));
 
 #ifdef _OPENMP
 #pragma omp for schedule(static)
 #endif
       for(int j = 0; j < aheight; j++)
-        modifier->ApplySubpixelGeometryDistortion(xoff + (width - 1), yoff + j * ystep, 1, 1, buf + 6 * (2 * awidth + aheight + j));
+        _map_distort_point(map, xoff + (width - 1), yoff + j * ystep, buf + 6 * (2 * awidth + aheight + j));
 
 #ifdef _OPENMP
 #pragma omp barrier
@@ -1089,7 +1299,7 @@ void modify_roi_in(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *
     roi_in->width = CLAMP(roi_in->width, 1, (int)ceilf(orig_w) - roi_in->x);
     roi_in->height = CLAMP(roi_in->height, 1, (int)ceilf(orig_h) - roi_in->y);
   }
-  delete modifier;
+  _map_release(gd, map);
 }
 
 void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
@@ -1183,6 +1393,14 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   d->do_nan_checks = TRUE;
   d->tca_override = p->tca_override;
 
+  // identifies the lens setup of the distortion maps, the image size goes into the custom TCA
+  const dt_image_t *img = &self->dev->image_storage;
+  const int size[2] = { img->width, img->height };
+  uint64_t hash = 5381;
+  for(size_t k = 0; k < sizeof(dt_iop_lensfun_params_t); k++) hash = ((hash << 5) + hash) ^ ((const char *)p)[k];
+  for(size_t k = 0; k < sizeof(size); k++) hash = ((hash << 5) + hash) ^ ((const char *)size)[k];
+  d->map_hash = hash;
+
   /*
    * there are certain situations when LensFun can return NAN coordinated.
    * most common case would be when the FOV is increased.
@@ -1226,6 +1444,7 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_lens_distort_lanczos2 = dt_opencl_create_kernel(program, "lens_distort_lanczos2");
   gd->kernel_lens_distort_lanczos3 = dt_opencl_create_kernel(program, "lens_distort_lanczos3");
   gd->kernel_lens_vignette = dt_opencl_create_kernel(program, "lens_vignette");
+  dt_pthread_mutex_init(&gd->map_lock, NULL);
 
   lfDatabase *dt_iop_lensfun_db = new lfDatabase;
   gd->db = (lfDatabase *)dt_iop_lensfun_db;
@@ -1406,6 +1625,9 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos2);
   dt_opencl_free_kernel(gd->kernel_lens_distort_lanczos3);
   dt_opencl_free_kernel(gd->kernel_lens_vignette);
+  for(int k = 0; k < LENS_MAP_CACHE; k++)
+    if(gd->maps[k]) _map_free(gd->maps[k]);
+  dt_pthread_mutex_destroy(&gd->map_lock);
   free(module->data);
   module->data = NULL;
 }
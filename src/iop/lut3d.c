@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <dirent.h>
+#include <glib/gstdio.h>
 #if defined (_WIN32)
 #include "win/getdelim.h"
 #endif // defined (_WIN32)
@@ -49,6 +50,9 @@ DT_MODULE_INTROSPECTION(3, dt_iop_lut3d_params_t)
 #define DT_IOP_LUT3D_MAX_LUTNAME 128
 #define DT_IOP_LUT3D_CLUT_LEVEL 48
 #define DT_IOP_LUT3D_MAX_KEYPOINTS 2048
+// number of parsed lut files kept around for other pipes, and the largest one worth keeping
+#define DT_IOP_LUT3D_CACHE 8
+#define DT_IOP_LUT3D_CACHE_MAX_BYTES (64 << 20)
 
 typedef enum dt_iop_lut3d_colorspace_t
 {
@@ -99,9 +103,23 @@ typedef enum dt_lut3d_cols_t
 
 const char invalid_filepath_prefix[] = "INVALID >> ";
 
+// a parsed lut, shared by all pipes using the same file
+typedef struct dt_iop_lut3d_clut_t
+{
+  gchar *path;        // file it was read from, NULL for compressed luts which come with the params
+  gint64 mtime;
+  gint64 size;
+  float *clut;
+  uint16_t level;
+  int users;          // pipes holding it, it's freed by the last one if it didn't make it into the cache
+  gboolean cached;
+  uint64_t last_used;
+} dt_iop_lut3d_clut_t;
+
 typedef struct dt_iop_lut3d_data_t
 {
   dt_iop_lut3d_params_t params;
+  dt_iop_lut3d_clut_t *entry; // where clut comes from, don't free clut directly
   float *clut;  // cube lut pointer
   uint16_t level; // cube_size
 } dt_iop_lut3d_data_t;
@@ -112,6 +130,9 @@ typedef struct dt_iop_lut3d_global_data_t
   int kernel_lut3d_trilinear;
   int kernel_lut3d_pyramid;
   int kernel_lut3d_none;
+  dt_pthread_mutex_t clut_lock;
+  dt_iop_lut3d_clut_t *cluts[DT_IOP_LUT3D_CACHE];
+  uint64_t clut_clock;
 } dt_iop_lut3d_global_data_t;
 
 #ifdef HAVE_GMIC
@@ -199,81 +220,86 @@ int legacy_params(dt_iop_module_t *self, const void *const old_params, const int
 
   return 1;
 }
+
+// the kernels below work on blocks of this many pixels: first the cell and the weights of every pixel are
+// computed side by side, then the nodes are fetched and blended per channel. both loops vectorise.
+#define LUT3D_BLOCK 8
+
+// node index of the lower corner of the cell and the position inside of it for the n pixels of a block starting at
+// in. the unused lanes of a short block point at the first cell.
+static inline void lut3d_cells(const float *const in, const int n, const uint16_t level, int *const color,
+                               float rgbd[3][LUT3D_BLOCK])
+{
+  const float scale = (float)(level - 1);
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for(int l = 0; l < LUT3D_BLOCK; l++)
+  {
+    int rgbi[3];
+    for(int c = 0; c < 3; c++)
+    {
+      const float v = (l < n) ? CLAMPS(in[4 * l + c], 0.0f, 1.0f) * scale : 0.0f;
+      rgbi[c] = CLAMP((int)v, 0, level - 2);
+      rgbd[c][l] = v - rgbi[c];
+    }
+    color[l] = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
+  }
+}
+
+static inline void lut3d_store(const float *const in, float *const out, const int n, float res[3][LUT3D_BLOCK])
+{
+  for(int l = 0; l < n; l++)
+  {
+    for(int c = 0; c < 3; c++) out[4 * l + c] = res[c][l];
+    out[4 * l + 3] = in[4 * l + 3];
+  }
+}
+
 // From `HaldCLUT_correct.c' by Eskil Steenberg (http://www.quelsolaar.com) (BSD licensed)
 void correct_pixel_trilinear(const float *const in, float *const out,
                              const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
   const int level2 = level * level;
+  const size_t blocks = (pixel_nb + LUT3D_BLOCK - 1) / LUT3D_BLOCK;
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
-  dt_omp_firstprivate(clut, in, level, level2, out, pixel_nb) \
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(blocks, clut, in, level, level2, out, pixel_nb) \
   schedule(static)
 #endif
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  for(size_t b = 0; b < blocks; b++)
   {
-    float *const input = ((float *const)in) + k;
-    float *const output = ((float *const)out) + k;
-
-    int rgbi[3], i, j;
-    float tmp[6];
-    float rgbd[3];
-
-    for(int c = 0; c < 3; ++c) input[c] = fminf(fmaxf(input[c], 0.0f), 1.0f);
-
-    rgbd[0] = input[0] * (float)(level - 1);
-    rgbd[1] = input[1] * (float)(level - 1);
-    rgbd[2] = input[2] * (float)(level - 1);
-
-    rgbi[0] = CLAMP((int)rgbd[0], 0, level - 2);
-    rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
-    rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
-
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    i = color * 3;  // P000
-    j = (color + 1) * 3;  // P100
-
-    tmp[0] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[1] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[2] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    i = (color + level) * 3;  // P010
-    j = (color + level + 1) * 3;  //P110
-
-    tmp[3] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[4] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[5] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    output[0] = tmp[0] * (1 - rgbd[1]) + tmp[3] * rgbd[1];
-    output[1] = tmp[1] * (1 - rgbd[1]) + tmp[4] * rgbd[1];
-    output[2] = tmp[2] * (1 - rgbd[1]) + tmp[5] * rgbd[1];
+    const size_t k = b * LUT3D_BLOCK;
+    const int n = MIN(LUT3D_BLOCK, pixel_nb - k);
+    int color[LUT3D_BLOCK];
+    float rgbd[3][LUT3D_BLOCK], res[3][LUT3D_BLOCK];
+    lut3d_cells(in + 4 * k, n, level, color, rgbd);
 
-    i = (color + level2) * 3;  // P001
-    j = (color + level2 + 1) * 3;  // P101
-
-    tmp[0] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[1] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[2] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    i = (color + level + level2) * 3;  // P011
-    j = (color + level + level2 + 1) * 3;  // P111
-
-    tmp[3] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[4] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[5] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    tmp[0] = tmp[0] * (1 - rgbd[1]) + tmp[3] * rgbd[1];
-    tmp[1] = tmp[1] * (1 - rgbd[1]) + tmp[4] * rgbd[1];
-    tmp[2] = tmp[2] * (1 - rgbd[1]) + tmp[5] * rgbd[1];
-
-    output[0] = output[0] * (1 - rgbd[2]) + tmp[0] * rgbd[2];
-    output[1] = output[1] * (1 - rgbd[2]) + tmp[1] * rgbd[2];
-    output[2] = output[2] * (1 - rgbd[2]) + tmp[2] * rgbd[2];
- }
+    for(int c = 0; c < 3; c++)
+    {
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int l = 0; l < LUT3D_BLOCK; l++)
+      {
+        // indexes of P000 to P111 in clut
+        const int i000 = color[l] * 3 + c;
+        const int i010 = i000 + level * 3;
+        const int i001 = i000 + level2 * 3;
+        const int i011 = i001 + level * 3;
+        const float r = rgbd[0][l], g = rgbd[1][l], bl = rgbd[2][l];
+
+        const float c00 = clut[i000] * (1 - r) + clut[i000 + 3] * r;
+        const float c10 = clut[i010] * (1 - r) + clut[i010 + 3] * r;
+        const float c01 = clut[i001] * (1 - r) + clut[i001 + 3] * r;
+        const float c11 = clut[i011] * (1 - r) + clut[i011 + 3] * r;
+        const float c0 = c00 * (1 - g) + c10 * g;
+        const float c1 = c01 * (1 - g) + c11 * g;
+        res[c][l] = c0 * (1 - bl) + c1 * bl;
+      }
+    }
+    lut3d_store(in + 4 * k, out + 4 * k, n, res);
+  }
 }
 
 // from OpenColorIO
@@ -282,85 +308,57 @@ void correct_pixel_tetrahedral(const float *const in, float *const out,
                                const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
   const int level2 = level * level;
+  const size_t blocks = (pixel_nb + LUT3D_BLOCK - 1) / LUT3D_BLOCK;
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
-  dt_omp_firstprivate(clut, in, level, level2, out, pixel_nb) \
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(blocks, clut, in, level, level2, out, pixel_nb) \
   schedule(static)
 #endif
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  for(size_t b = 0; b < blocks; b++)
   {
-    float *const input = ((float *const)in) + k;
-    float *const output = ((float *const)out) + k;
-
-    int rgbi[3];
-    float rgbd[3];
-    for(int c = 0; c < 3; ++c) input[c] = fminf(fmaxf(input[c], 0.0f), 1.0f);
-
-    rgbd[0] = input[0] * (float)(level - 1);
-    rgbd[1] = input[1] * (float)(level - 1);
-    rgbd[2] = input[2] * (float)(level - 1);
-
-    rgbi[0] = CLAMP((int)rgbd[0], 0, level - 2);
-    rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
-    rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
-
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    const int i000 = color * 3;                     // P000
-    const int i100 = i000 + 3;                      // P100
-    const int i010 = (color + level) * 3;           // P010
-    const int i110 = i010 + 3;                      // P110
-    const int i001 = (color + level2) * 3;          // P001
-    const int i101 = i001 + 3;                      // P101
-    const int i011 = (color + level + level2) * 3;  // P011
-    const int i111 = i011 + 3;                      // P111
-
-    if (rgbd[0] > rgbd[1])
+    const size_t k = b * LUT3D_BLOCK;
+    const int n = MIN(LUT3D_BLOCK, pixel_nb - k);
+    int color[LUT3D_BLOCK], ia[LUT3D_BLOCK], ib[LUT3D_BLOCK];
+    float rgbd[3][LUT3D_BLOCK], w[4][LUT3D_BLOCK], res[3][LUT3D_BLOCK];
+    lut3d_cells(in + 4 * k, n, level, color, rgbd);
+
+    // the tetrahedron goes from P000 to P111 through ia and ib, stepping along the largest delta first.
+    // selects rather than branches, so all lanes take the same path.
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for(int l = 0; l < LUT3D_BLOCK; l++)
     {
-      if (rgbd[1] > rgbd[2])
-      {
-        output[0] = (1-rgbd[0])*clut[i000] + (rgbd[0]-rgbd[1])*clut[i100] + (rgbd[1]-rgbd[2])*clut[i110] + rgbd[2]*clut[i111];
-        output[1] = (1-rgbd[0])*clut[i000+1] + (rgbd[0]-rgbd[1])*clut[i100+1] + (rgbd[1]-rgbd[2])*clut[i110+1] + rgbd[2]*clut[i111+1];
-        output[2] = (1-rgbd[0])*clut[i000+2] + (rgbd[0]-rgbd[1])*clut[i100+2] + (rgbd[1]-rgbd[2])*clut[i110+2] + rgbd[2]*clut[i111+2];
-      }
-      else if (rgbd[0] > rgbd[2])
-      {
-        output[0] = (1-rgbd[0])*clut[i000] + (rgbd[0]-rgbd[2])*clut[i100] + (rgbd[2]-rgbd[1])*clut[i101] + rgbd[1]*clut[i111];
-        output[1] = (1-rgbd[0])*clut[i000+1] + (rgbd[0]-rgbd[2])*clut[i100+1] + (rgbd[2]-rgbd[1])*clut[i101+1] + rgbd[1]*clut[i111+1];
-        output[2] = (1-rgbd[0])*clut[i000+2] + (rgbd[0]-rgbd[2])*clut[i100+2] + (rgbd[2]-rgbd[1])*clut[i101+2] + rgbd[1]*clut[i111+2];
-      }
-      else
-      {
-        output[0] = (1-rgbd[2])*clut[i000] + (rgbd[2]-rgbd[0])*clut[i001] + (rgbd[0]-rgbd[1])*clut[i101] + rgbd[1]*clut[i111];
-        output[1] = (1-rgbd[2])*clut[i000+1] + (rgbd[2]-rgbd[0])*clut[i001+1] + (rgbd[0]-rgbd[1])*clut[i101+1] + rgbd[1]*clut[i111+1];
-        output[2] = (1-rgbd[2])*clut[i000+2] + (rgbd[2]-rgbd[0])*clut[i001+2] + (rgbd[0]-rgbd[1])*clut[i101+2] + rgbd[1]*clut[i111+2];
-      }
+      const float r = rgbd[0][l], g = rgbd[1][l], bl = rgbd[2][l];
+      const int dr = 3, dg = level * 3, db = level2 * 3;
+      const int rg = r > g, gb = g > bl, rb = r > bl;
+      // step of the largest and of the middle delta
+      const int first = rg ? (rb ? dr : db) : (gb ? dg : db);
+      const int second = rg ? (gb ? dg : (rb ? db : dr)) : (gb ? (rb ? dr : db) : dg);
+      const float hi = MAX(r, MAX(g, bl)), lo = MIN(r, MIN(g, bl));
+      const float mid = r + g + bl - hi - lo;
+      ia[l] = color[l] * 3 + first;
+      ib[l] = ia[l] + second;
+      w[0][l] = 1.0f - hi;
+      w[1][l] = hi - mid;
+      w[2][l] = mid - lo;
+      w[3][l] = lo;
     }
-    else
+
+    for(int c = 0; c < 3; c++)
     {
-      if (rgbd[2] > rgbd[1])
-      {
-        output[0] = (1-rgbd[2])*clut[i000] + (rgbd[2]-rgbd[1])*clut[i001] + (rgbd[1]-rgbd[0])*clut[i011] + rgbd[0]*clut[i111];
-        output[1] = (1-rgbd[2])*clut[i000+1] + (rgbd[2]-rgbd[1])*clut[i001+1] + (rgbd[1]-rgbd[0])*clut[i011+1] + rgbd[0]*clut[i111+1];
-        output[2] = (1-rgbd[2])*clut[i000+2] + (rgbd[2]-rgbd[1])*clut[i001+2] + (rgbd[1]-rgbd[0])*clut[i011+2] + rgbd[0]*clut[i111+2];
-      }
-      else if (rgbd[2] > rgbd[0])
-      {
-        output[0] = (1-rgbd[1])*clut[i000] + (rgbd[1]-rgbd[2])*clut[i010] + (rgbd[2]-rgbd[0])*clut[i011] + rgbd[0]*clut[i111];
-        output[1] = (1-rgbd[1])*clut[i000+1] + (rgbd[1]-rgbd[2])*clut[i010+1] + (rgbd[2]-rgbd[0])*clut[i011+1] + rgbd[0]*clut[i111+1];
-        output[2] = (1-rgbd[1])*clut[i000+2] + (rgbd[1]-rgbd[2])*clut[i010+2] + (rgbd[2]-rgbd[0])*clut[i011+2] + rgbd[0]*clut[i111+2];
-      }
-      else
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int l = 0; l < LUT3D_BLOCK; l++)
       {
-        output[0] = (1-rgbd[1])*clut[i000] + (rgbd[1]-rgbd[0])*clut[i010] + (rgbd[0]-rgbd[2])*clut[i110] + rgbd[2]*clut[i111];
-        output[1] = (1-rgbd[1])*clut[i000+1] + (rgbd[1]-rgbd[0])*clut[i010+1] + (rgbd[0]-rgbd[2])*clut[i110+1] + rgbd[2]*clut[i111+1];
-        output[2] = (1-rgbd[1])*clut[i000+2] + (rgbd[1]-rgbd[0])*clut[i010+2] + (rgbd[0]-rgbd[2])*clut[i110+2] + rgbd[2]*clut[i111+2];
+        const int i000 = color[l] * 3 + c;
+        const int i111 = i000 + 3 + (level + level2) * 3;
+        res[c][l] = w[0][l] * clut[i000] + w[1][l] * clut[ia[l] + c] + w[2][l] * clut[ib[l] + c]
+                    + w[3][l] * clut[i111];
       }
     }
+    lut3d_store(in + 4 * k, out + 4 * k, n, res);
   }
 }
 
@@ -370,73 +368,57 @@ void correct_pixel_pyramid(const float *const in, float *const out,
                            const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
   const int level2 = level * level;
+  const size_t blocks = (pixel_nb + LUT3D_BLOCK - 1) / LUT3D_BLOCK;
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
-  dt_omp_firstprivate(clut, in, level, level2, out, pixel_nb) \
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(blocks, clut, in, level, level2, out, pixel_nb) \
   schedule(static)
 #endif
-  for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
+  for(size_t b = 0; b < blocks; b++)
   {
-    float *const input = ((float *const)in) + k;
-    float *const output = ((float *const)out) + k;
+    const size_t k = b * LUT3D_BLOCK;
+    const int n = MIN(LUT3D_BLOCK, pixel_nb - k);
+    int color[LUT3D_BLOCK];
+    float rgbd[3][LUT3D_BLOCK], res[3][LUT3D_BLOCK];
+    lut3d_cells(in + 4 * k, n, level, color, rgbd);
 
-    int rgbi[3];
-    float rgbd[3];
-    for(int c = 0; c < 3; ++c) input[c] = fminf(fmaxf(input[c], 0.0f), 1.0f);
-
-    rgbd[0] = input[0] * (float)(level - 1);
-    rgbd[1] = input[1] * (float)(level - 1);
-    rgbd[2] = input[2] * (float)(level - 1);
-
-    rgbi[0] = CLAMP((int)rgbd[0], 0, level - 2);
-    rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
-    rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
-
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    const int i000 = color * 3;                     // P000
-    const int i100 = i000 + 3;                      // P100
-    const int i010 = (color + level) * 3;           // P010
-    const int i110 = i010 + 3;                      // P110
-    const int i001 = (color + level2) * 3;          // P001
-    const int i101 = i001 + 3;                      // P101
-    const int i011 = (color + level + level2) * 3;  // P011
-    const int i111 = i011 + 3;                      // P111
-
-    if (rgbd[1] > rgbd[0] && rgbd[2] > rgbd[0])
-    {
-      output[0] = clut[i000] + (clut[i111]-clut[i011])*rgbd[0] + (clut[i010]-clut[i000])*rgbd[1] + (clut[i001]-clut[i000])*rgbd[2]
-        + (clut[i011]-clut[i001]-clut[i010]+clut[i000])*rgbd[1]*rgbd[2];
-      output[1] = clut[i000+1] + (clut[i111+1]-clut[i011+1])*rgbd[0] + (clut[i010+1]-clut[i000+1])*rgbd[1] + (clut[i001+1]-clut[i000+1])*rgbd[2]
-        + (clut[i011+1]-clut[i001+1]-clut[i010+1]+clut[i000+1])*rgbd[1]*rgbd[2];
-      output[2] = clut[i000+2] + (clut[i111+2]-clut[i011+2])*rgbd[0] + (clut[i010+2]-clut[i000+2])*rgbd[1] + (clut[i001+2]-clut[i000+2])*rgbd[2]
-        + (clut[i011+2]-clut[i001+2]-clut[i010+2]+clut[i000+2])*rgbd[1]*rgbd[2];
-    }
-    else if (rgbd[0] > rgbd[1] && rgbd[2] > rgbd[1])
+    for(int c = 0; c < 3; c++)
     {
-      output[0] = clut[i000] + (clut[i100]-clut[i000])*rgbd[0] + (clut[i111]-clut[i101])*rgbd[1] + (clut[i001]-clut[i000])*rgbd[2]
-        + (clut[i101]-clut[i001]-clut[i100]+clut[i000])*rgbd[0]*rgbd[2];
-      output[1] = clut[i000+1] + (clut[i100+1]-clut[i000+1])*rgbd[0] + (clut[i111+1]-clut[i101+1])*rgbd[1] + (clut[i001+1]-clut[i000+1])*rgbd[2]
-        + (clut[i101+1]-clut[i001+1]-clut[i100+1]+clut[i000+1])*rgbd[0]*rgbd[2];
-      output[2] = clut[i000+2] + (clut[i100+2]-clut[i000+2])*rgbd[0] + (clut[i111]-clut[i101+2])*rgbd[1] + (clut[i001+2]-clut[i000+2])*rgbd[2]
-        + (clut[i101+2]-clut[i001+2]-clut[i100+2]+clut[i000+2])*rgbd[0]*rgbd[2];
-    }
-    else
-    {
-      output[0] = clut[i000] + (clut[i100]-clut[i000])*rgbd[0] + (clut[i010]-clut[i000])*rgbd[1] + (clut[i111]-clut[i110])*rgbd[2]
-        + (clut[i110]-clut[i100]-clut[i010]+clut[i000])*rgbd[0]*rgbd[1];
-      output[1] = clut[i000+1] + (clut[i100+1]-clut[i000+1])*rgbd[0] + (clut[i010+1]-clut[i000+1])*rgbd[1] + (clut[i111+1]-clut[i110+1])*rgbd[2]
-        + (clut[i110+1]-clut[i100+1]-clut[i010+1]+clut[i000+1])*rgbd[0]*rgbd[1];
-      output[2] = clut[i000+2] + (clut[i100+2]-clut[i000+2])*rgbd[0] + (clut[i010+2]-clut[i000+2])*rgbd[1] + (clut[i111+2]-clut[i110+2])*rgbd[2]
-        + (clut[i110+2]-clut[i100+2]-clut[i010+2]+clut[i000+2])*rgbd[0]*rgbd[1];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+      for(int l = 0; l < LUT3D_BLOCK; l++)
+      {
+        // indexes of P000 to P111 in clut
+        const int i000 = color[l] * 3 + c;
+        const int i100 = i000 + 3;
+        const int i010 = i000 + level * 3;
+        const int i110 = i010 + 3;
+        const int i001 = i000 + level2 * 3;
+        const int i101 = i001 + 3;
+        const int i011 = i001 + level * 3;
+        const int i111 = i011 + 3;
+        const float r = rgbd[0][l], g = rgbd[1][l], bl = rgbd[2][l];
+
+        // the pyramid with its apex at P111 the pixel falls into, all three are evaluated and selected from
+        const float pr = clut[i000] + (clut[i111] - clut[i011]) * r + (clut[i010] - clut[i000]) * g
+                         + (clut[i001] - clut[i000]) * bl
+                         + (clut[i011] - clut[i001] - clut[i010] + clut[i000]) * g * bl;
+        const float pg = clut[i000] + (clut[i100] - clut[i000]) * r + (clut[i111] - clut[i101]) * g
+                         + (clut[i001] - clut[i000]) * bl
+                         + (clut[i101] - clut[i001] - clut[i100] + clut[i000]) * r * bl;
+        const float pb = clut[i000] + (clut[i100] - clut[i000]) * r + (clut[i010] - clut[i000]) * g
+                         + (clut[i111] - clut[i110]) * bl
+                         + (clut[i110] - clut[i100] - clut[i010] + clut[i000]) * r * g;
+        res[c][l] = (g > r && bl > r) ? pr : (r > g && bl > g) ? pg : pb;
+      }
     }
+    lut3d_store(in + 4 * k, out + 4 * k, n, res);
   }
 }
 
+#undef LUT3D_BLOCK
+
 void get_cache_filename(const char *const lutname, char *const cache_filename)
 {
   char *cache_dir = g_build_filename(g_get_user_cache_dir(), "gmic", NULL);
@@ -1113,6 +1095,13 @@ void filepath_set_unix_separator(char *filepath)
     if (filepath[i]=='\\') filepath[i] = '/';
 }
 
+static void free_clut(dt_iop_lut3d_clut_t *entry)
+{
+  if(entry->clut) dt_free_align(entry->clut);
+  g_free(entry->path);
+  free(entry);
+}
+
 void init_global(dt_iop_module_so_t *module)
 {
   const int program = 28; // rgbcurve.cl, from programs.conf
@@ -1123,6 +1112,9 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_lut3d_trilinear = dt_opencl_create_kernel(program, "lut3d_trilinear");
   gd->kernel_lut3d_pyramid = dt_opencl_create_kernel(program, "lut3d_pyramid");
   gd->kernel_lut3d_none = dt_opencl_create_kernel(program, "lut3d_none");
+  dt_pthread_mutex_init(&gd->clut_lock, NULL);
+  memset(gd->cluts, 0, sizeof(gd->cluts));
+  gd->clut_clock = 0;
 
 #ifdef HAVE_GMIC
   // make sure the cache dir exists
@@ -1140,11 +1132,14 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_lut3d_trilinear);
   dt_opencl_free_kernel(gd->kernel_lut3d_pyramid);
   dt_opencl_free_kernel(gd->kernel_lut3d_none);
+  for(int k = 0; k < DT_IOP_LUT3D_CACHE; k++)
+    if(gd->cluts[k]) free_clut(gd->cluts[k]);
+  dt_pthread_mutex_destroy(&gd->clut_lock);
   free(module->data);
   module->data = NULL;
 }
 
-static int calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
+static int calculate_clut(dt_iop_lut3d_params_t *const p, const char *const fullpath, float **clut)
 {
   uint16_t level = 0;
   const char *filepath = p->filepath;
@@ -1157,10 +1152,8 @@ static int calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
   else
   { // read the file
 #endif  // HAVE_GMIC
-    gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
-    if (filepath[0] && lutfolder[0])
+    if (fullpath)
     {
-      char *fullpath = g_build_filename(lutfolder, filepath, NULL);
       if (g_str_has_suffix (filepath, ".png") || g_str_has_suffix (filepath, ".PNG"))
       {
         level = calculate_clut_haldclut(p, fullpath, clut);
@@ -1173,15 +1166,97 @@ static int calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
       {
         level = calculate_clut_3dl(fullpath, clut);
       }
-      g_free(fullpath);
     }
-    g_free(lutfolder);
 #ifdef HAVE_GMIC
   }
 #endif // HAVE_GMIC
   return level;
 }
 
+// get the parsed lut for p, reading the file only if no other pipe did since it was last modified.
+// hand it back with release_clut() when done.
+static dt_iop_lut3d_clut_t *acquire_clut(dt_iop_lut3d_global_data_t *gd, dt_iop_lut3d_params_t *const p)
+{
+  gchar *fullpath = NULL;
+  GStatBuf st = { 0 };
+  gboolean cacheable = FALSE;
+#ifdef HAVE_GMIC
+  if (!(p->nb_keypoints && p->filepath[0]))
+#endif // HAVE_GMIC
+  {
+    gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
+    if (p->filepath[0] && lutfolder[0])
+    {
+      fullpath = g_build_filename(lutfolder, p->filepath, NULL);
+      cacheable = !g_stat(fullpath, &st);
+    }
+    g_free(lutfolder);
+  }
+
+  dt_pthread_mutex_lock(&gd->clut_lock);
+
+  if(cacheable)
+  {
+    for(int k = 0; k < DT_IOP_LUT3D_CACHE; k++)
+    {
+      dt_iop_lut3d_clut_t *entry = gd->cluts[k];
+      if(entry && entry->mtime == st.st_mtime && entry->size == st.st_size && !strcmp(entry->path, fullpath))
+      {
+        entry->users++;
+        entry->last_used = ++gd->clut_clock;
+        dt_pthread_mutex_unlock(&gd->clut_lock);
+        g_free(fullpath);
+        return entry;
+      }
+    }
+  }
+
+  // parse it while holding the lock, parallel exports most likely want the very same file
+  dt_iop_lut3d_clut_t *entry = (dt_iop_lut3d_clut_t *)calloc(1, sizeof(dt_iop_lut3d_clut_t));
+  entry->users = 1;
+  entry->last_used = ++gd->clut_clock;
+  entry->level = calculate_clut(p, fullpath, &entry->clut);
+
+  const size_t bytes = (size_t)entry->level * entry->level * entry->level * 3 * sizeof(float);
+  if(cacheable && entry->level && bytes <= DT_IOP_LUT3D_CACHE_MAX_BYTES)
+  {
+    entry->path = fullpath;
+    entry->mtime = st.st_mtime;
+    entry->size = st.st_size;
+    fullpath = NULL;
+
+    // keep it in a free slot or in place of the least recently used lut nobody is working with
+    int slot = -1;
+    for(int k = 0; k < DT_IOP_LUT3D_CACHE; k++)
+    {
+      if(!gd->cluts[k])
+      {
+        slot = k;
+        break;
+      }
+      if(gd->cluts[k]->users == 0 && (slot < 0 || gd->cluts[k]->last_used < gd->cluts[slot]->last_used))
+        slot = k;
+    }
+    if(slot >= 0)
+    {
+      if(gd->cluts[slot]) free_clut(gd->cluts[slot]);
+      gd->cluts[slot] = entry;
+      entry->cached = TRUE;
+    }
+  }
+
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+  g_free(fullpath);
+  return entry;
+}
+
+static void release_clut(dt_iop_lut3d_global_data_t *gd, dt_iop_lut3d_clut_t *entry)
+{
+  dt_pthread_mutex_lock(&gd->clut_lock);
+  if(--entry->users == 0 && !entry->cached) free_clut(entry);
+  dt_pthread_mutex_unlock(&gd->clut_lock);
+}
+
 #ifdef HAVE_GMIC
 static gboolean list_match_string(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, dt_iop_lut3d_gui_data_t *g)
 {
@@ -1351,16 +1426,18 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 {
   dt_iop_lut3d_params_t *p = (dt_iop_lut3d_params_t *)p1;
   dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;
+  dt_iop_lut3d_global_data_t *gd = (dt_iop_lut3d_global_data_t *)self->global_data;
 
   if (strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
   { // new clut file
-    if (d->clut)
+    if (d->entry)
     { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
+      release_clut(gd, d->entry);
+      d->entry = NULL;
     }
-    d->level = calculate_clut(p, &d->clut);
+    d->entry = acquire_clut(gd, p);
+    d->clut = d->entry->clut;
+    d->level = d->entry->level;
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1370,6 +1447,7 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
   piece->data = malloc(sizeof(dt_iop_lut3d_data_t));
   dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;
   memcpy(&d->params, self->default_params, sizeof(dt_iop_lut3d_params_t));
+  d->entry = NULL;
   d->clut = NULL;
   d->level = 0;
   d->params.filepath[0] = '\0';
@@ -1377,9 +1455,11 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;;
-  if (d->clut)
-    dt_free_align(d->clut);
+  dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;
+  dt_iop_lut3d_global_data_t *gd = (dt_iop_lut3d_global_data_t *)self->global_data;
+  if (d->entry)
+    release_clut(gd, d->entry);
+  d->entry = NULL;
   d->clut = NULL;
   d->level = 0;
   free(piece->data);
@@ -130,7 +130,7 @@ int default_group()
 
 int flags()
 {
-  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING;
+  return IOP_FLAGS_SUPPORTS_BLENDING | IOP_FLAGS_ALLOW_TILING | IOP_FLAGS_TILING_PARALLEL;
 }
 
 #if defined(HAVE_OPENCL) && !USE_NEW_IMPL_CL
@@ -453,6 +453,14 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
 }
 #endif
 
+#ifdef HAVE_CODEPATH_CLONES
+void process_avx2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
+                  void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  process_cpu(piece, ivoid, ovoid, roi_in, roi_out, DT_CODEPATH_SELECT(nlmeans_denoise));
+}
+#endif
+
 void init_global(dt_iop_module_so_t *module)
 {
   const int program = 5; // nlmeans.cl, from programs.conf
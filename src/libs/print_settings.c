@@ -217,7 +217,7 @@ static int _print_job_run(dt_job_t *job)
 
   dt_print(DT_DEBUG_PRINT, "[print] max image size %d x %d (at resolution %d)\n", max_width, max_height, params->prt.printer.resolution);
 
-  dt_imageio_module_format_t buf;
+  dt_imageio_module_format_t buf = { 0 };
   buf.mime = mime;
   buf.levels = levels;
   buf.bpp = bpp;
@@ -0,0 +1,172 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// checks the fused blur of dt_bilateral_blur() against the previous three separate passes over the grid
+// and compares their throughput, as well as that of the whole filter as the modules use it.
+// links against libdarktable, see the Makefile in this directory.
+#include "common/bilateral.h"
+#include "common/darktable.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// one pass of the blur as it was before, in place along the axis with stride offset3
+static void blur_line_reference(float *buf, const int offset1, const int offset2, const int offset3,
+                                const int size1, const int size2, const int size3, const int derivative)
+{
+  const float w0 = derivative ? 0.0f : 6.f / 16.f;
+  const float w1 = 4.f / 16.f;
+  const float w2 = derivative ? 2.f / 16.f : 1.f / 16.f;
+  // the derivative subtracts the nodes before the current one
+  const float sign = derivative ? -1.0f : 1.0f;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(size1, size2, size3, offset1, offset2, offset3, w0, w1, w2, sign) \
+  shared(buf)
+#endif
+  for(int k = 0; k < size1; k++)
+  {
+    for(int j = 0; j < size2; j++)
+    {
+      float *const line = buf + (size_t)k * offset1 + (size_t)j * offset2;
+      float tmp1 = 0.0f, tmp2 = 0.0f;
+      for(int i = 0; i < size3; i++)
+      {
+        const float tmp3 = line[(size_t)i * offset3];
+        const float n1 = i + 1 < size3 ? line[(size_t)(i + 1) * offset3] : 0.0f;
+        const float n2 = i + 2 < size3 ? line[(size_t)(i + 2) * offset3] : 0.0f;
+        line[(size_t)i * offset3] = w0 * tmp3 + w1 * (n1 + sign * tmp2) + w2 * (n2 + sign * tmp1);
+        tmp1 = tmp2;
+        tmp2 = tmp3;
+      }
+    }
+  }
+}
+
+static void blur_reference(const dt_bilateral_t *b)
+{
+  const int ox = b->size_z;
+  const int oy = b->size_x * b->size_z;
+  const int oz = 1;
+  blur_line_reference(b->buf, oz, oy, ox, b->size_z, b->size_y, b->size_x, 0);
+  blur_line_reference(b->buf, oz, ox, oy, b->size_z, b->size_x, b->size_y, 0);
+  blur_line_reference(b->buf, ox, oy, oz, b->size_x, b->size_y, b->size_z, 1);
+}
+
+static void bench(const int width, const int height, const float sigma_s, const float sigma_r)
+{
+  const size_t size = (size_t)4 * width * height;
+  float *in = dt_alloc_align(64, size * sizeof(float));
+  float *out = dt_alloc_align(64, size * sizeof(float));
+  assert(in && out);
+
+  // smooth gradients with some noise on top, which is what the grid is there to tell apart
+  srand(width + height);
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      float *const px = in + 4 * ((size_t)j * width + i);
+      px[0] = 50.0f + 40.0f * sinf(i * 0.003f) * cosf(j * 0.004f) + 10.0f * rand() / (float)RAND_MAX;
+      px[1] = px[2] = px[3] = 0.5f;
+    }
+
+  dt_bilateral_t *ref = dt_bilateral_init(width, height, sigma_s, sigma_r);
+  dt_bilateral_t *b = dt_bilateral_init(width, height, sigma_s, sigma_r);
+  assert(ref && ref->buf && b && b->buf);
+  dt_bilateral_splat(ref, in);
+  dt_bilateral_splat(b, in);
+
+  const size_t size_x = ref->size_x, size_y = ref->size_y, size_z = ref->size_z;
+  const size_t grid = size_x * size_y * size_z;
+  float maxval = 0.0f;
+  for(size_t k = 0; k < grid; k++) maxval = fmaxf(maxval, fabsf(ref->buf[k]));
+  const int runs = 5;
+
+  // the blur isn't idempotent, time repeated runs but only compare the first one
+  double start = dt_get_wtime();
+  for(int k = 0; k < runs; k++) blur_reference(ref);
+  const double passes = (dt_get_wtime() - start) / runs;
+  start = dt_get_wtime();
+  dt_bilateral_blur(b);
+  double fused = dt_get_wtime() - start;
+
+  float maxdiff = 0.0f;
+  dt_bilateral_t *check = dt_bilateral_init(width, height, sigma_s, sigma_r);
+  dt_bilateral_splat(check, in);
+  blur_reference(check);
+  for(size_t k = 0; k < grid; k++) maxdiff = fmaxf(maxdiff, fabsf(check->buf[k] - b->buf[k]));
+  assert(maxdiff <= 1e-5f * fmaxf(1.0f, maxval));
+  dt_bilateral_free(check);
+
+  start = dt_get_wtime();
+  for(int k = 1; k < runs; k++) dt_bilateral_blur(b);
+  fused = (fused + dt_get_wtime() - start) / runs;
+
+  dt_bilateral_free(ref);
+  dt_bilateral_free(b);
+
+  // the whole filter as shadows and highlights or local contrast run it, the grids come from the pool after
+  // the first round
+  start = dt_get_wtime();
+  for(int k = 0; k < runs; k++)
+  {
+    dt_bilateral_t *f = dt_bilateral_init(width, height, sigma_s, sigma_r);
+    dt_bilateral_splat(f, in);
+    dt_bilateral_blur(f);
+    dt_bilateral_slice(f, in, out, -1.0f);
+    dt_bilateral_free(f);
+  }
+  const double filter = (dt_get_wtime() - start) / runs;
+
+  const double mnodes = grid / 1e6;
+  fprintf(stderr, "[bench] %5dx%-5d grid %4zux%4zux%2zu: separate passes %7.1f Mnodes/s, fused %7.1f Mnodes/s "
+                  "(%.2fx), whole filter %6.1f Mpix/s\n",
+          width, height, size_x, size_y, size_z, mnodes / passes,
+          mnodes / fused, passes / fused, width * (double)height / 1e6 / filter);
+
+  dt_free_align(in);
+  dt_free_align(out);
+}
+
+int main(int argc, char *arg[])
+{
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#else
+  darktable.num_openmp_threads = 1;
+#endif
+  // sigmas as the modules pass them for a preview and for exports
+  const int sizes[][2] = { { 1024, 768 }, { 4000, 3000 }, { 6000, 4000 } };
+  const float sigmas[][2] = { { 4.0f, 20.0f }, { 32.0f, 10.0f }, { 100.0f, 4.0f } };
+  for(int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+    for(int k = 0; k < (int)(sizeof(sigmas) / sizeof(sigmas[0])); k++)
+      bench(sizes[s][0], sizes[s][1], sigmas[k][0], sigmas[k][1]);
+  dt_bilateral_free_pool();
+  fprintf(stderr, "[passed] fused blur matches the separate passes\n");
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
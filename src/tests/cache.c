@@ -16,15 +16,10 @@
     along with darktable.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-
-#define DT_UNIT_TEST
-// define dt alloc, so we don't need to include the rest of dt:
-#define dt_alloc_align(A, B) malloc(B)
-#define MAX(a, b) ((a) > (b) ? (a) : (b))
-
-// unit test for the concurrent hopscotch hashmap and the LRU cache built on top of it.
+// unit test and contention benchmark for the sharded LRU cache.
+// links against libdarktable, see the Makefile in this directory.
 #include "common/cache.h"
-#include "common/cache.c"
+#include "common/darktable.h"
 
 #include <assert.h>
 #include <stdio.h>
@@ -33,98 +28,187 @@
 #include <omp.h>
 #endif
 
-int32_t alloc_dummy(void *data, const uint32_t key, int32_t *cost, void **buf)
+static void alloc_dummy(void *data, dt_cache_entry_t *entry)
 {
-  *cost = 1; // also the default
-  *buf = (void *)(long int)key;
-  // request write lock for our buffer?
-  return 0;
+  entry->cost = 1; // also the default
+  entry->data_size = sizeof(uint32_t);
+  entry->data = malloc(entry->data_size);
+  *(uint32_t *)entry->data = entry->key;
 }
 
-int main(int argc, char *arg[])
+static void cleanup_dummy(void *data, dt_cache_entry_t *entry)
 {
-  dt_cache_t cache;
-  // dt_cache_init(&cache, 110000, 16, 64, 100000);
-  // really hammer it, make quota insanely low:
-  dt_cache_init(&cache, 110000, 16, 64, 100);
-  dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+  free(entry->data);
+}
+
+// walks the lru lists of all shards in both directions and checks them against
+// the hashtables and the cost counter. only call while no other thread uses the cache.
+static int check_consistency(dt_cache_t *cache)
+{
+  int total = 0;
+  size_t cost = 0;
+  for(int k = 0; k < DT_CACHE_SHARDS; k++)
+  {
+    dt_cache_shard_t *shard = cache->shard + k;
+    int forward = 0, backward = 0;
+    for(dt_cache_entry_t *e = shard->lru_head; e; e = e->lru_next)
+    {
+      assert(g_hash_table_lookup(shard->hashtable, GINT_TO_POINTER(e->key)) == e);
+      assert(*(uint32_t *)e->data == e->key);
+      assert(e->lru_next || shard->lru_tail == e);
+      cost += e->cost;
+      forward++;
+    }
+    for(dt_cache_entry_t *e = shard->lru_tail; e; e = e->lru_prev) backward++;
+    assert(forward == backward);
+    assert(forward == g_hash_table_size(shard->hashtable));
+    total += forward;
+  }
+  assert(cost == dt_cache_get_cost(cache));
+  return total;
+}
 
+static void insert_concurrently(dt_cache_t *cache, const int num)
+{
 #ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache, stderr) num_threads(16)
+#pragma omp parallel for default(none) schedule(guided) shared(cache) firstprivate(num) num_threads(16)
 #endif
-  for(int k = 0; k < 100000; k++)
+  for(int k = 0; k < num; k++)
   {
-    void *data = (void *)(long int)k;
-    const int size = 0; // dt_cache_size(&cache);
-    const int con1 = dt_cache_contains(&cache, k);
-    const int val1 = (int)(long int)dt_cache_read_get(&cache, k);
-    const int val2 = (int)(long int)dt_cache_read_get(&cache, k);
-    // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1, val2,
-    // con1, con2);
-    const int con2 = dt_cache_contains(&cache, k);
+    const int con1 = dt_cache_contains(cache, k);
+    // a newly allocated entry comes back write locked, so nobody can evict it
+    // before we had a look:
+    dt_cache_entry_t *entry = dt_cache_get(cache, k, 'r');
+    const uint32_t val1 = *(uint32_t *)entry->data;
+    const int con2 = dt_cache_contains(cache, k);
+    dt_cache_release(cache, entry);
     assert(con1 == 0);
     assert(con2 == 1);
-    assert(val2 == k);
-    dt_cache_read_release(&cache, k);
-    dt_cache_read_release(&cache, k);
+    assert(val1 == k);
+    (void)con1;
+    (void)con2;
+    (void)val1;
+
+    // may have been evicted in between, then it is simply allocated again.
+    entry = dt_cache_get(cache, k, 'r');
+    assert(*(uint32_t *)entry->data == k);
+    dt_cache_release(cache, entry);
   }
-  dt_cache_print_locked(&cache);
-  // fprintf(stderr, "\n");
-  fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
-
-  const int size = dt_cache_size(&cache);
-  const int lru_cnt = lru_check_consistency(&cache);
-  const int lru_cnt_r = lru_check_consistency_reverse(&cache);
-  // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-  assert(size == lru_cnt);
-  assert(lru_cnt_r == lru_cnt);
-  fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
+}
+
+// every thread reads random keys out of a set which fits into the cache, so all
+// time is spent in lookup and lru maintenance.
+static void bench_contention(const int keys, const int lookups)
+{
+  dt_cache_t cache;
+  dt_cache_init(&cache, 0, keys * 2);
+  dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+  dt_cache_set_cleanup_callback(&cache, cleanup_dummy, NULL);
+  for(int k = 0; k < keys; k++) dt_cache_release(&cache, dt_cache_get(&cache, k, 'w'));
 
+  for(int threads = 1; threads <= 32; threads *= 2)
+  {
+    const double start = dt_get_wtime();
+#ifdef _OPENMP
+#pragma omp parallel default(none) shared(cache) firstprivate(keys, lookups) num_threads(threads)
+#endif
+    {
+#ifdef _OPENMP
+      uint32_t state = 0x2545F491u * (omp_get_thread_num() + 1);
+#else
+      uint32_t state = 0x2545F491u;
+#endif
+      for(int k = 0; k < lookups; k++)
+      {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        dt_cache_entry_t *entry = dt_cache_get(&cache, state % keys, 'r');
+        dt_cache_release(&cache, entry);
+      }
+    }
+    const double end = dt_get_wtime();
+    fprintf(stderr, "[bench] %2d threads, %d keys: %6.2f M lookups/s\n", threads, keys,
+            threads * (double)lookups / (end - start) * 1e-6);
+  }
+  assert(check_consistency(&cache) == keys);
   dt_cache_cleanup(&cache);
+}
+
+int main(int argc, char *arg[])
+{
+  {
+    dt_cache_t cache;
+    // really hammer it, make quota insanely low:
+    dt_cache_init(&cache, 0, 100);
+    dt_cache_set_allocate_callback(&cache, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache, cleanup_dummy, NULL);
+
+    insert_concurrently(&cache, 100000);
+    fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
 
+    const int size = check_consistency(&cache);
+    fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
 
+    for(int k = 0; k < 100000; k++) dt_cache_remove(&cache, k);
+    assert(check_consistency(&cache) == 0);
+    assert(dt_cache_get_cost(&cache) == 0);
+    fprintf(stderr, "[passed] removing all entries\n");
+    dt_cache_cleanup(&cache);
+  }
 
   {
     // now a harder case: a cache with only one entry and a lot of threads fighting over it:
     dt_cache_t cache2;
-    // really hammer it, make quota insanely low:
-    // capacity 1 num threads 1 cache line size 64 ignored, quota 2 (80% => 1)
-    dt_cache_init(&cache2, 1, 1, 64, 2);
+    // quota 2 (80% => 1)
+    dt_cache_init(&cache2, 0, 2);
     dt_cache_set_allocate_callback(&cache2, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache2, cleanup_dummy, NULL);
 
-#ifdef _OPENMP
-#pragma omp parallel for default(none) schedule(guided) shared(cache2, stderr) num_threads(16)
-#endif
-    for(int k = 0; k < 100000; k++)
-    {
-      void *data = (void *)(long int)k;
-      const int size = 0; // dt_cache_size(&cache);
-      const int con1 = dt_cache_contains(&cache2, k);
-      const int val1 = (int)(long int)dt_cache_read_get(&cache2, k);
-      const int val2 = (int)(long int)dt_cache_read_get(&cache2, k);
-      // fprintf(stderr, "\rinserted number %d, size %d, value %d - %d, contains %d - %d", k, size, val1,
-      // val2, con1, con2);
-      const int con2 = dt_cache_contains(&cache2, k);
-      assert(con1 == 0);
-      assert(con2 == 1);
-      assert(val2 == k);
-      dt_cache_read_release(&cache2, k);
-      dt_cache_read_release(&cache2, k);
-    }
-    dt_cache_print_locked(&cache2);
-    // fprintf(stderr, "\n");
+    insert_concurrently(&cache2, 100000);
     fprintf(stderr, "[passed] inserting 100000 entries concurrently\n");
 
-    const int size = dt_cache_size(&cache2);
-    const int lru_cnt = lru_check_consistency(&cache2);
-    const int lru_cnt_r = lru_check_consistency_reverse(&cache2);
-    // fprintf(stderr, "lru list contains %d|%d/%d entries\n", lru_cnt, lru_cnt_r, size);
-    assert(size == lru_cnt);
-    assert(lru_cnt_r == lru_cnt);
+    const int size = check_consistency(&cache2);
     fprintf(stderr, "[passed] cache lru consistency after removals, have %d entries left.\n", size);
     dt_cache_cleanup(&cache2);
   }
 
+  {
+    // entries which are write locked must survive garbage collection
+    dt_cache_t cache3;
+    dt_cache_init(&cache3, 0, 10);
+    dt_cache_set_allocate_callback(&cache3, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache3, cleanup_dummy, NULL);
+    dt_cache_entry_t *pinned = dt_cache_get(&cache3, 4711, 'w');
+    for(int k = 0; k < 1000; k++) dt_cache_release(&cache3, dt_cache_get(&cache3, k, 'w'));
+    dt_cache_gc(&cache3, 0.0f);
+    assert(dt_cache_contains(&cache3, 4711));
+    assert(dt_cache_get_cost(&cache3) == 1);
+    dt_cache_release(&cache3, pinned);
+    dt_cache_gc(&cache3, 0.0f);
+    assert(check_consistency(&cache3) == 0);
+    fprintf(stderr, "[passed] garbage collection skips locked entries\n");
+    dt_cache_cleanup(&cache3);
+  }
+
+  {
+    // the background reclaimer keeps the fill between its watermarks
+    dt_cache_t cache4;
+    dt_cache_init(&cache4, 0, 1000);
+    dt_cache_set_allocate_callback(&cache4, alloc_dummy, NULL);
+    dt_cache_set_cleanup_callback(&cache4, cleanup_dummy, NULL);
+    dt_cache_start_gc_thread(&cache4, "cache gc", 0.5f, 0.8f);
+    insert_concurrently(&cache4, 100000);
+    // the thread may still be working on the last request
+    for(int k = 0; k < 1000 && dt_cache_get_cost(&cache4) > 800; k++) g_usleep(1000);
+    assert(dt_cache_get_cost(&cache4) <= 800);
+    dt_cache_cleanup(&cache4);
+    fprintf(stderr, "[passed] background garbage collection\n");
+  }
+
+  bench_contention(64, 1 << 20);
+  bench_contention(4096, 1 << 20);
+
   exit(0);
 }
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -0,0 +1,286 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// checks the AVX2 and AVX-512 builds of the kernels listed in src/CMakeLists.txt against
+// their plain C version and compares the throughput of all variants the cpu supports.
+// links against libdarktable, see the Makefile in this directory.
+#include "common/darktable.h"
+#include "common/eaw.h"
+#include "common/interpolation.h"
+#include "common/nlmeans_core.h"
+#include "develop/blend.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef HAVE_CODEPATH_CLONES
+int main(int argc, char *arg[])
+{
+  fprintf(stderr, "[skipped] libdarktable was built without the AVX2 and AVX-512 codepaths\n");
+  exit(0);
+}
+#else
+
+#define WIDTH 4000
+#define HEIGHT 3000
+#define RUNS 3
+
+typedef enum variant_t
+{
+  PLAIN = 0,
+  AVX2,
+  AVX512,
+  VARIANTS
+} variant_t;
+
+static const char *variant_name[VARIANTS] = { "plain", "avx2", "avx512" };
+
+static int supported(const variant_t v)
+{
+  if(v == AVX2) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  if(v == AVX512) return __builtin_cpu_supports("avx512f") && supported(AVX2);
+  return 1;
+}
+
+static float *random_buffer(const size_t size, const float scale)
+{
+  float *buf = dt_alloc_align(64, size * sizeof(float));
+  assert(buf);
+  for(size_t k = 0; k < size; k++) buf[k] = scale * rand() / (float)RAND_MAX;
+  return buf;
+}
+
+// largest difference to the plain result, relative to its magnitude. the wider builds may contract
+// multiplications and additions into fma instructions, so they don't always round the same way.
+static float difference(const float *const a, const float *const b, const size_t size)
+{
+  float diff = 0.0f;
+  for(size_t k = 0; k < size; k++) diff = fmaxf(diff, fabsf(a[k] - b[k]) / fmaxf(1.0f, fabsf(a[k])));
+  return diff;
+}
+
+static void report(const char *kernel, const variant_t v, const double seconds, const double mpix,
+                   const float diff)
+{
+  fprintf(stderr, "[bench] %-24s %-6s %8.1f Mpix/s, max difference %g\n", kernel, variant_name[v],
+          mpix / seconds, diff);
+  assert(diff < 1e-3f);
+}
+
+static void bench_eaw(void)
+{
+  const size_t size = (size_t)4 * WIDTH * HEIGHT;
+  float *in = random_buffer(size, 1.0f);
+  // the plain results of both stages, and those of the variant under test
+  float *ref_coarse = dt_alloc_align(64, size * sizeof(float));
+  float *ref_detail = dt_alloc_align(64, size * sizeof(float));
+  float *ref_syn = dt_alloc_align(64, size * sizeof(float));
+  float *coarse = dt_alloc_align(64, size * sizeof(float));
+  float *detail = dt_alloc_align(64, size * sizeof(float));
+  float *syn = dt_alloc_align(64, size * sizeof(float));
+  const float threshold[4] = { 0.01f, 0.02f, 0.02f, 0.0f };
+  const float boost[4] = { 1.2f, 1.1f, 1.1f, 1.0f };
+  eaw_decompose_t decompose[VARIANTS] = { eaw_decompose, eaw_decompose_avx2, eaw_decompose_avx512 };
+  eaw_synthesize_t synthesize[VARIANTS] = { eaw_synthesize, eaw_synthesize_avx2, eaw_synthesize_avx512 };
+
+  for(variant_t v = PLAIN; v < VARIANTS; v++)
+  {
+    if(!supported(v)) continue;
+    float *res_coarse = v == PLAIN ? ref_coarse : coarse;
+    float *res_detail = v == PLAIN ? ref_detail : detail;
+    float *res_syn = v == PLAIN ? ref_syn : syn;
+    double start = dt_get_wtime();
+    for(int k = 0; k < RUNS; k++) decompose[v](res_coarse, in, res_detail, 2, 0.01f, WIDTH, HEIGHT);
+    const double dec = (dt_get_wtime() - start) / RUNS;
+    report("eaw_decompose", v, dec, WIDTH * HEIGHT / 1e6,
+           fmaxf(difference(ref_coarse, res_coarse, size), difference(ref_detail, res_detail, size)));
+
+    // every variant puts together the same plain decomposition, so this only compares the synthesis
+    start = dt_get_wtime();
+    for(int k = 0; k < RUNS; k++) synthesize[v](res_syn, ref_coarse, ref_detail, threshold, boost, WIDTH, HEIGHT);
+    const double syn_t = (dt_get_wtime() - start) / RUNS;
+    report("eaw_synthesize", v, syn_t, WIDTH * HEIGHT / 1e6, difference(ref_syn, res_syn, size));
+  }
+
+  dt_free_align(in);
+  dt_free_align(ref_coarse);
+  dt_free_align(ref_detail);
+  dt_free_align(ref_syn);
+  dt_free_align(coarse);
+  dt_free_align(detail);
+  dt_free_align(syn);
+}
+
+static void bench_nlmeans(void)
+{
+  // the search window makes this one a lot slower, use a smaller image
+  const int width = WIDTH / 2, height = HEIGHT / 2;
+  const size_t size = (size_t)4 * width * height;
+  float *in = random_buffer(size, 100.0f);
+  float *ref = dt_alloc_align(64, size * sizeof(float));
+  float *out = dt_alloc_align(64, size * sizeof(float));
+  const float norm[4] = { 0.01f, 0.01f, 0.01f, 1.0f };
+  const dt_iop_roi_t roi = { 0, 0, width, height, 1.0f };
+  const dt_nlmeans_param_t params = { .scattering = 0.0f,
+                                      .scale = 1.0f,
+                                      .luma = 0.5f,
+                                      .chroma = 1.0f,
+                                      .center_weight = -1.0f,
+                                      .sharpness = 0.0f,
+                                      .patch_radius = 2,
+                                      .search_radius = 5,
+                                      .decimate = 0,
+                                      .norm = norm,
+                                      .pipetype = DT_DEV_PIXELPIPE_FULL };
+  void (*denoise[VARIANTS])(const float *const, float *const, const dt_iop_roi_t *const,
+                            const dt_iop_roi_t *const, const dt_nlmeans_param_t *const)
+      = { nlmeans_denoise, nlmeans_denoise_avx2, nlmeans_denoise_avx512 };
+
+  for(variant_t v = PLAIN; v < VARIANTS; v++)
+  {
+    if(!supported(v)) continue;
+    float *res = v == PLAIN ? ref : out;
+    const double start = dt_get_wtime();
+    for(int k = 0; k < RUNS; k++) denoise[v](in, res, &roi, &roi, &params);
+    const double t = (dt_get_wtime() - start) / RUNS;
+    report("nlmeans_denoise", v, t, width * height / 1e6, difference(ref, res, size));
+  }
+
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+static void bench_resample(void)
+{
+  const int owidth = WIDTH * 2 / 3, oheight = HEIGHT * 2 / 3;
+  const size_t size = (size_t)4 * owidth * oheight;
+  float *in = random_buffer((size_t)4 * WIDTH * HEIGHT, 1.0f);
+  float *ref = dt_alloc_align(64, size * sizeof(float));
+  float *out = dt_alloc_align(64, size * sizeof(float));
+  const dt_iop_roi_t roi_in = { 0, 0, WIDTH, HEIGHT, 1.0f };
+  const dt_iop_roi_t roi_out = { 0, 0, owidth, oheight, 2.0f / 3.0f };
+  const struct dt_interpolation *itor = dt_interpolation_new(DT_INTERPOLATION_LANCZOS3);
+  void (*resample[VARIANTS])(const struct dt_interpolation *, float *, const dt_iop_roi_t *const, const int32_t,
+                             const float *const, const dt_iop_roi_t *const, const int32_t)
+      = { dt_interpolation_resample, dt_interpolation_resample_avx2, dt_interpolation_resample_avx512 };
+
+  for(variant_t v = PLAIN; v < VARIANTS; v++)
+  {
+    if(!supported(v)) continue;
+    float *res = v == PLAIN ? ref : out;
+    const double start = dt_get_wtime();
+    for(int k = 0; k < RUNS; k++)
+      resample[v](itor, res, &roi_out, owidth * 4 * sizeof(float), in, &roi_in, WIDTH * 4 * sizeof(float));
+    const double t = (dt_get_wtime() - start) / RUNS;
+    report("dt_interpolation_resample", v, t, owidth * oheight / 1e6, difference(ref, res, size));
+  }
+
+  dt_free_align(in);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+static void bench_blendif(void)
+{
+  const size_t size = (size_t)WIDTH * HEIGHT;
+  float *a = random_buffer(size, 1.0f);
+  float *b = random_buffer(size, 1.0f);
+  // the pipe hands in the mask with the opacity already applied
+  const float opacity = 80.0f;
+  float *mask = random_buffer(size, opacity / 100.0f);
+  float *ref = dt_alloc_align(64, size * sizeof(float));
+  float *out = dt_alloc_align(64, size * sizeof(float));
+  const dt_iop_roi_t roi = { 0, 0, WIDTH, HEIGHT, 1.0f };
+  dt_develop_blend_params_t params = { 0 };
+  params.mask_mode = DEVELOP_MASK_ENABLED;
+  params.opacity = opacity;
+  dt_dev_pixelpipe_iop_t piece = { 0 };
+  piece.colors = 1;
+  piece.blendop_data = &params;
+  void (*blend[VARIANTS])(struct dt_dev_pixelpipe_iop_t *, const float *const, float *const,
+                          const struct dt_iop_roi_t *const, const struct dt_iop_roi_t *const, const float *const,
+                          const dt_dev_pixelpipe_display_mask_t)
+      = { dt_develop_blendif_raw_blend, dt_develop_blendif_raw_blend_avx2, dt_develop_blendif_raw_blend_avx512 };
+  // a plain product, one with a branch per pixel and one with a square root
+  const struct
+  {
+    unsigned int mode;
+    const char *name;
+  } modes[] = { { DEVELOP_BLEND_MULTIPLY, "blendif_raw multiply" },
+                { DEVELOP_BLEND_OVERLAY, "blendif_raw overlay" },
+                { DEVELOP_BLEND_SOFTLIGHT, "blendif_raw softlight" } };
+
+  for(size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++)
+  {
+    params.blend_mode = modes[m].mode;
+    for(variant_t v = PLAIN; v < VARIANTS; v++)
+    {
+      if(!supported(v)) continue;
+      float *res = v == PLAIN ? ref : out;
+      double t = 0.0;
+      for(int k = 0; k < RUNS; k++)
+      {
+        // the operator blends into its output, start from the same one every time
+        memcpy(res, b, size * sizeof(float));
+        const double start = dt_get_wtime();
+        blend[v](&piece, a, res, &roi, &roi, mask, DT_DEV_PIXELPIPE_DISPLAY_NONE);
+        t += dt_get_wtime() - start;
+      }
+      // make sure there is something to compare
+      if(v == PLAIN) assert(difference(b, ref, size) > 1e-2f);
+      report(modes[m].name, v, t / RUNS, size / 1e6, difference(ref, res, size));
+    }
+  }
+
+  dt_free_align(a);
+  dt_free_align(b);
+  dt_free_align(mask);
+  dt_free_align(ref);
+  dt_free_align(out);
+}
+
+int main(int argc, char *arg[])
+{
+  // the plain variants are only reachable through the public entry points on the plain codepath
+  darktable.codepath.OPENMP_SIMD = 1;
+#ifdef _OPENMP
+  darktable.num_openmp_threads = omp_get_num_procs();
+#else
+  darktable.num_openmp_threads = 1;
+#endif
+  srand(42);
+
+  bench_eaw();
+  bench_nlmeans();
+  bench_resample();
+  bench_blendif();
+  fprintf(stderr, "[passed] all variants match the plain codepath\n");
+  exit(0);
+}
+#endif
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,372 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// checks dt_gaussian_blur() against the previous column by column implementation
+// and compares their throughput at a few image sizes. the 4 channel SSE path of
+// dt_gaussian_blur_4c() is checked against its previous version as well.
+// links against libdarktable, see the Makefile in this directory.
+#include "common/darktable.h"
+#include "common/gaussian.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#define CLAMPF(a, mn, mx) ((a) < (mn) ? (mn) : ((a) > (mx) ? (mx) : (a)))
+#define MMCLAMPPS(a, mn, mx) (_mm_min_ps((mx), _mm_max_ps((a), (mn))))
+
+// coefficients of the zero order filter, as in common/gaussian.c
+static void gauss_params(const float sigma, float *a0, float *a1, float *a2, float *a3, float *b1, float *b2,
+                         float *coefp, float *coefn)
+{
+  const float alpha = 1.695f / sigma;
+  const float ema = exp(-alpha);
+  const float ema2 = exp(-2.0f * alpha);
+  const float k = (1.0f - ema) * (1.0f - ema) / (1.0f + (2.0f * alpha * ema) - ema2);
+  *b1 = -2.0f * ema;
+  *b2 = ema2;
+  *a0 = k;
+  *a1 = k * (alpha - 1.0f) * ema;
+  *a2 = k * (alpha + 1.0f) * ema;
+  *a3 = -k * ema2;
+  *coefp = (*a0 + *a1) / (1.0f + *b1 + *b2);
+  *coefn = (*a2 + *a3) / (1.0f + *b1 + *b2);
+}
+
+// the blur as it was before the vertical pass worked on blocks of columns
+static void blur_reference(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  const int width = g->width;
+  const int height = g->height;
+  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
+
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+
+  gauss_params(g->sigma, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+
+  float *temp = g->buf;
+
+  float *Labmax = g->max;
+  float *Labmin = g->min;
+
+// vertical blur column by column
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, width, height, ch) \
+  shared(temp, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  schedule(static)
+#endif
+  for(int i = 0; i < width; i++)
+  {
+    float xp[4] = {0.0f};
+    float yb[4] = {0.0f};
+    float yp[4] = {0.0f};
+    float xc[4] = {0.0f};
+    float yc[4] = {0.0f};
+    float xn[4] = {0.0f};
+    float xa[4] = {0.0f};
+    float yn[4] = {0.0f};
+    float ya[4] = {0.0f};
+
+    // forward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
+      yb[k] = xp[k] * coefp;
+      yp[k] = yb[k];
+      xc[k] = yc[k] = xn[k] = xa[k] = yn[k] = ya[k] = 0.0f;
+    }
+
+    for(int j = 0; j < height; j++)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
+        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+
+        temp[offset + k] = yc[k];
+
+        xp[k] = xc[k];
+        yb[k] = yp[k];
+        yp[k] = yc[k];
+      }
+    }
+
+    // backward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
+      xa[k] = xn[k];
+      yn[k] = xn[k] * coefn;
+      ya[k] = yn[k];
+    }
+
+    for(int j = height - 1; j > -1; j--)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
+
+        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+
+        xa[k] = xn[k];
+        xn[k] = xc[k];
+        ya[k] = yn[k];
+        yn[k] = yc[k];
+
+        temp[offset + k] += yc[k];
+      }
+    }
+  }
+
+// horizontal blur line by line
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(out, ch, width, height) \
+  shared(temp, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    float xp[4] = {0.0f};
+    float yb[4] = {0.0f};
+    float yp[4] = {0.0f};
+    float xc[4] = {0.0f};
+    float yc[4] = {0.0f};
+    float xn[4] = {0.0f};
+    float xa[4] = {0.0f};
+    float yn[4] = {0.0f};
+    float ya[4] = {0.0f};
+
+    // forward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xp[k] = CLAMPF(temp[(size_t)j * width * ch + k], Labmin[k], Labmax[k]);
+      yb[k] = xp[k] * coefp;
+      yp[k] = yb[k];
+      xc[k] = yc[k] = xn[k] = xa[k] = yn[k] = ya[k] = 0.0f;
+    }
+
+    for(int i = 0; i < width; i++)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
+        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
+
+        out[offset + k] = yc[k];
+
+        xp[k] = xc[k];
+        yb[k] = yp[k];
+        yp[k] = yc[k];
+      }
+    }
+
+    // backward filter
+    for(int k = 0; k < ch; k++)
+    {
+      xn[k] = CLAMPF(temp[((size_t)(j + 1) * width - 1) * ch + k], Labmin[k], Labmax[k]);
+      xa[k] = xn[k];
+      yn[k] = xn[k] * coefn;
+      ya[k] = yn[k];
+    }
+
+    for(int i = width - 1; i > -1; i--)
+    {
+      size_t offset = ((size_t)j * width + i) * ch;
+
+      for(int k = 0; k < ch; k++)
+      {
+        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
+
+        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+
+        xa[k] = xn[k];
+        xn[k] = xc[k];
+        ya[k] = yn[k];
+        yn[k] = yc[k];
+
+        out[offset + k] += yc[k];
+      }
+    }
+  }
+}
+
+#if defined(__SSE__)
+// one recursive pass of the previous SSE version, forward into dst or backward added to it.
+// it groups the terms as a0 * x + (a1 * x' - (b1 * y' + b2 * y'')), unlike the plain C code.
+#define SSE_STEP(x0, x1, y0, y1, c0, c1)                                                                         \
+  _mm_add_ps(_mm_mul_ps(x0, _mm_set_ps1(c0)),                                                                    \
+             _mm_sub_ps(_mm_mul_ps(x1, _mm_set_ps1(c1)),                                                         \
+                        _mm_add_ps(_mm_mul_ps(y0, _mm_set_ps1(b1)), _mm_mul_ps(y1, _mm_set_ps1(b2)))))
+
+static void sse_line(const float *const src, float *const dst, const size_t stride, const int n, const __m128 min,
+                     const __m128 max, const float a0, const float a1, const float a2, const float a3,
+                     const float b1, const float b2, const float coefp, const float coefn)
+{
+  __m128 xp = MMCLAMPPS(_mm_load_ps(src), min, max);
+  __m128 yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
+  __m128 yp = yb;
+  for(int i = 0; i < n; i++)
+  {
+    const __m128 xc = MMCLAMPPS(_mm_load_ps(src + i * stride), min, max);
+    const __m128 yc = SSE_STEP(xc, xp, yp, yb, a0, a1);
+    _mm_store_ps(dst + i * stride, yc);
+    xp = xc;
+    yb = yp;
+    yp = yc;
+  }
+
+  __m128 xn = MMCLAMPPS(_mm_load_ps(src + (n - 1) * stride), min, max);
+  __m128 xa = xn;
+  __m128 yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
+  __m128 ya = yn;
+  for(int i = n - 1; i > -1; i--)
+  {
+    const __m128 xc = MMCLAMPPS(_mm_load_ps(src + i * stride), min, max);
+    const __m128 yc = SSE_STEP(xn, xa, yn, ya, a2, a3);
+    xa = xn;
+    xn = xc;
+    ya = yn;
+    yn = yc;
+    _mm_store_ps(dst + i * stride, _mm_add_ps(_mm_load_ps(dst + i * stride), yc));
+  }
+}
+
+// dt_gaussian_blur_4c() as it was before, column by column and then line by line
+static void blur_reference_4c_sse(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  const int width = g->width;
+  const int height = g->height;
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+  gauss_params(g->sigma, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
+  const __m128 max = _mm_set_ps(g->max[3], g->max[2], g->max[1], g->max[0]);
+  const __m128 min = _mm_set_ps(g->min[3], g->min[2], g->min[1], g->min[0]);
+  float *temp = g->buf;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, temp, width, height, min, max, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  schedule(static)
+#endif
+  for(int i = 0; i < width; i++)
+    sse_line(in + (size_t)4 * i, temp + (size_t)4 * i, (size_t)4 * width, height, min, max, a0, a1, a2, a3, b1,
+             b2, coefp, coefn);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(out, temp, width, height, min, max, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+    sse_line(temp + (size_t)4 * width * j, out + (size_t)4 * width * j, 4, width, min, max, a0, a1, a2, a3, b1,
+             b2, coefp, coefn);
+}
+#endif
+
+static void bench(const int width, const int height, const int ch)
+{
+  const size_t size = (size_t)width * height * ch;
+  float *in = dt_alloc_align(64, size * sizeof(float));
+  float *out = dt_alloc_align(64, size * sizeof(float));
+  float *ref = dt_alloc_align(64, size * sizeof(float));
+  assert(in && out && ref);
+
+  srand(width + height + ch);
+  for(size_t k = 0; k < size; k++) in[k] = 100.0f * rand() / (float)RAND_MAX;
+
+  const float max[4] = { 100.0f, 100.0f, 100.0f, 100.0f };
+  const float min[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  dt_gaussian_t *g = dt_gaussian_init(width, height, ch, max, min, 20.0f, DT_IOP_GAUSSIAN_ZERO);
+  assert(g);
+
+  blur_reference(g, in, ref);
+  dt_gaussian_blur(g, in, out);
+  float maxdiff = 0.0f;
+  for(size_t k = 0; k < size; k++) maxdiff = fmaxf(maxdiff, fabsf(out[k] - ref[k]));
+  assert(maxdiff < 1e-3f);
+
+  const int runs = 5;
+  double start = dt_get_wtime();
+  for(int k = 0; k < runs; k++) blur_reference(g, in, ref);
+  const double columns = (dt_get_wtime() - start) / runs;
+
+  start = dt_get_wtime();
+  for(int k = 0; k < runs; k++) dt_gaussian_blur(g, in, out);
+  const double blocks = (dt_get_wtime() - start) / runs;
+
+  const double mpix = width * (double)height / 1e6;
+  fprintf(stderr, "[bench] %5dx%-5d %d channels: column by column %7.1f Mpix/s, blocked %7.1f Mpix/s (%.2fx)\n",
+          width, height, ch, mpix / columns, mpix / blocks, columns / blocks);
+
+#if defined(__SSE__)
+  if(ch == 4 && __builtin_cpu_supports("sse2"))
+  {
+    // the blocked vertical pass follows the plain C grouping of the terms, so the SSE path no longer matches
+    // its previous version bit for bit. the rounding differs by some 3e-4 per pass on data up to 100, a few
+    // tens of ulps, and stays there as the filter is stable. allow 2e-5 of the range.
+    const dt_codepath_t codepath = darktable.codepath;
+    darktable.codepath.OPENMP_SIMD = 0;
+    darktable.codepath.SSE2 = 1;
+    blur_reference_4c_sse(g, in, ref);
+    dt_gaussian_blur_4c(g, in, out);
+    float ssediff = 0.0f;
+    for(size_t k = 0; k < size; k++) ssediff = fmaxf(ssediff, fabsf(out[k] - ref[k]));
+    assert(ssediff < 2e-5f * max[0]);
+
+    start = dt_get_wtime();
+    for(int k = 0; k < runs; k++) blur_reference_4c_sse(g, in, ref);
+    const double sse_columns = (dt_get_wtime() - start) / runs;
+    start = dt_get_wtime();
+    for(int k = 0; k < runs; k++) dt_gaussian_blur_4c(g, in, out);
+    const double sse_blocks = (dt_get_wtime() - start) / runs;
+    fprintf(stderr, "[bench] %5dx%-5d sse:        column by column %7.1f Mpix/s, blocked %7.1f Mpix/s (%.2fx), "
+                    "max difference %g\n",
+            width, height, mpix / sse_columns, mpix / sse_blocks, sse_columns / sse_blocks, ssediff);
+    darktable.codepath = codepath;
+  }
+#endif
+
+  dt_gaussian_free(g);
+  dt_free_align(in);
+  dt_free_align(out);
+  dt_free_align(ref);
+}
+
+int main(int argc, char *arg[])
+{
+  const int sizes[][2] = { { 1024, 768 }, { 4000, 3000 }, { 6000, 4000 }, { 8688, 5792 } };
+  for(int ch = 1; ch <= 4; ch += 3)
+    for(int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) bench(sizes[s][0], sizes[s][1], ch);
+  fprintf(stderr, "[passed] blocked vertical passes match the column by column ones\n");
+  exit(0);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,183 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2020 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for develop/pixelpipe_cache.c, followed by a small
+ * benchmark of the lookup cost for growing numbers of cache lines.
+ *
+ * Please see README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <cmocka.h>
+
+#include "common/darktable.h"
+#include "develop/format.h"
+#include "develop/pixelpipe_cache.h"
+
+#define LINE_SIZE 64
+
+/*
+ * HELPERS
+ */
+
+// request the cache line for hash, returns 1 on a miss (like the cache itself)
+static int get(dt_dev_pixelpipe_cache_t *cache, const uint64_t hash, const int weight, void **data)
+{
+  dt_iop_buffer_dsc_t dsc = { 0 };
+  dt_iop_buffer_dsc_t *pdsc = &dsc;
+  return dt_dev_pixelpipe_cache_get_weighted(cache, hash, hash, LINE_SIZE, data, &pdsc, weight);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_hit_and_miss(void **state)
+{
+  dt_dev_pixelpipe_cache_t cache;
+  assert_int_equal(dt_dev_pixelpipe_cache_init(&cache, 4, LINE_SIZE), 1);
+
+  void *data[5] = { NULL };
+  for(int k = 1; k <= 4; k++) assert_int_equal(get(&cache, k, 0, &data[k]), 1);
+  for(int k = 1; k <= 4; k++) assert_true(dt_dev_pixelpipe_cache_available(&cache, k));
+  assert_false(dt_dev_pixelpipe_cache_available(&cache, 99));
+
+  // hits hand out the very same buffer again
+  void *hit = NULL;
+  assert_int_equal(get(&cache, 2, 0, &hit), 0);
+  assert_ptr_equal(hit, data[2]);
+
+  dt_dev_pixelpipe_cache_flush(&cache);
+  for(int k = 1; k <= 4; k++) assert_false(dt_dev_pixelpipe_cache_available(&cache, k));
+
+  dt_dev_pixelpipe_cache_cleanup(&cache);
+}
+
+static void test_lru_eviction(void **state)
+{
+  dt_dev_pixelpipe_cache_t cache;
+  assert_int_equal(dt_dev_pixelpipe_cache_init(&cache, 3, LINE_SIZE), 1);
+
+  void *data = NULL;
+  for(int k = 1; k <= 3; k++) get(&cache, k, 0, &data);
+  // make 1 the most recently used, so 2 is the one to go
+  assert_int_equal(get(&cache, 1, 0, &data), 0);
+  assert_int_equal(get(&cache, 4, 0, &data), 1);
+
+  assert_true(dt_dev_pixelpipe_cache_available(&cache, 1));
+  assert_false(dt_dev_pixelpipe_cache_available(&cache, 2));
+  assert_true(dt_dev_pixelpipe_cache_available(&cache, 3));
+  assert_true(dt_dev_pixelpipe_cache_available(&cache, 4));
+
+  dt_dev_pixelpipe_cache_cleanup(&cache);
+}
+
+static void test_important(void **state)
+{
+  dt_dev_pixelpipe_cache_t cache;
+  assert_int_equal(dt_dev_pixelpipe_cache_init(&cache, 4, LINE_SIZE), 1);
+
+  void *data = NULL;
+  get(&cache, 1, -cache.entries, &data);
+  // plenty of regular traffic must not push out the important line
+  for(int k = 2; k < 20; k++) get(&cache, k, 0, &data);
+  assert_true(dt_dev_pixelpipe_cache_available(&cache, 1));
+
+  // but a later important line demotes it to age out normally
+  get(&cache, 100, -cache.entries, &data);
+  get(&cache, 101, -cache.entries, &data);
+  for(int k = 20; k < 30; k++) get(&cache, k, 0, &data);
+  assert_false(dt_dev_pixelpipe_cache_available(&cache, 1));
+  assert_true(dt_dev_pixelpipe_cache_available(&cache, 101));
+
+  dt_dev_pixelpipe_cache_cleanup(&cache);
+}
+
+static void test_invalidate(void **state)
+{
+  dt_dev_pixelpipe_cache_t cache;
+  assert_int_equal(dt_dev_pixelpipe_cache_init(&cache, 4, LINE_SIZE), 1);
+
+  void *data[5] = { NULL };
+  for(int k = 1; k <= 4; k++) get(&cache, k, 0, &data[k]);
+  dt_dev_pixelpipe_cache_invalidate(&cache, data[3]);
+  assert_false(dt_dev_pixelpipe_cache_available(&cache, 3));
+  for(int k = 1; k <= 4; k++)
+    if(k != 3) assert_true(dt_dev_pixelpipe_cache_available(&cache, k));
+
+  // the invalidated line is the first to be reused
+  void *reused = NULL;
+  assert_int_equal(get(&cache, 5, 0, &reused), 1);
+  assert_ptr_equal(reused, data[3]);
+  for(int k = 1; k <= 5; k++)
+    if(k != 3) assert_true(dt_dev_pixelpipe_cache_available(&cache, k));
+
+  dt_dev_pixelpipe_cache_cleanup(&cache);
+}
+
+/*
+ * BENCHMARK
+ */
+
+static void bench_lookup(void **state)
+{
+  const int sizes[] = { 8, 64, 512, 4096 };
+  for(int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    const int entries = sizes[s];
+    dt_dev_pixelpipe_cache_t cache;
+    assert_int_equal(dt_dev_pixelpipe_cache_init(&cache, entries, LINE_SIZE), 1);
+
+    void *data = NULL;
+    for(int k = 0; k < entries; k++) get(&cache, 1000 + 37 * k, 0, &data);
+
+    const int runs = 1000000;
+    int found = 0;
+    const double start = dt_get_wtime();
+    for(int r = 0; r < runs; r++)
+    {
+      const uint64_t hash = 1000 + 37 * (r % entries);
+      found += dt_dev_pixelpipe_cache_available(&cache, hash);
+      found += (get(&cache, hash, 0, &data) == 0);
+    }
+    const double end = dt_get_wtime();
+    assert_int_equal(found, 2 * runs);
+
+    printf("[pixelpipe_cache] %5d entries: %.1f ns per lookup\n", entries, 1e9 * (end - start) / (2.0 * runs));
+    dt_dev_pixelpipe_cache_cleanup(&cache);
+  }
+}
+
+int main()
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_hit_and_miss),
+    cmocka_unit_test(test_lru_eviction),
+    cmocka_unit_test(test_important),
+    cmocka_unit_test(test_invalidate),
+    cmocka_unit_test(bench_lookup)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
@@ -17,6 +17,7 @@
 */
 /** this is the view for the darkroom module.  */
 #include "bauhaus/bauhaus.h"
+#include "common/bilateral.h"
 #include "common/collection.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
@@ -1061,16 +1062,12 @@ static void dt_dev_jump_image(dt_develop_t *dev, int diff, gboolean by_key)
   int new_id = -1;
 
   // we new offset and imgid after the jump
-  sqlite3_stmt *stmt;
-  gchar *query = dt_util_dstrcat(NULL, "SELECT rowid, imgid "
-                                          "FROM memory.collected_images "
-                                          "WHERE rowid=(SELECT rowid FROM memory.collected_images WHERE imgid=%d)+%d",
-                                 imgid, diff);
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  const int rowid = dt_collection_collected_rowid(darktable.collection, imgid);
+  const int jump_id = rowid > 0 ? dt_collection_collected_imgid(darktable.collection, rowid + diff) : -1;
+  if(jump_id > 0)
   {
-    new_offset = sqlite3_column_int(stmt, 0);
-    new_id = sqlite3_column_int(stmt, 1);
+    new_offset = rowid + diff;
+    new_id = jump_id;
   }
   else if(diff > 0)
   {
@@ -1084,23 +1081,13 @@ static void dt_dev_jump_image(dt_develop_t *dev, int diff, gboolean by_key)
     // if we are here, that means that the current is not anymore in the list
     // in this case, let's use the image before current offset
     new_offset = MAX(1, dt_ui_thumbtable(darktable.gui->ui)->offset - 1);
-    sqlite3_stmt *stmt2;
-    gchar *query2 = dt_util_dstrcat(NULL, "SELECT imgid FROM memory.collected_images WHERE rowid=%d", new_offset);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query2, -1, &stmt2, NULL);
-    if(sqlite3_step(stmt2) == SQLITE_ROW)
-    {
-      new_id = sqlite3_column_int(stmt2, 0);
-    }
-    else
+    new_id = dt_collection_collected_imgid(darktable.collection, new_offset);
+    if(new_id < 0)
     {
       new_id = dt_ui_thumbtable(darktable.gui->ui)->offset_imgid;
       new_offset = dt_ui_thumbtable(darktable.gui->ui)->offset;
     }
-    g_free(query2);
-    sqlite3_finalize(stmt2);
   }
-  g_free(query);
-  sqlite3_finalize(stmt);
 
   if(new_id < 0 || new_id == imgid) return;
 
@@ -3140,6 +3127,9 @@ void leave(dt_view_t *self)
   dt_pthread_mutex_unlock(&dev->preview2_pipe_mutex);
   dt_pthread_mutex_unlock(&dev->preview_pipe_mutex);
 
+  // the grids kept for editing are of no use outside of darkroom
+  dt_bilateral_free_pool();
+
   // cleanup visible masks
   if(dev->form_gui)
   {
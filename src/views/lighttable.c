@@ -197,16 +197,9 @@ static void _lighttable_check_layout(dt_view_t *self)
     if(!lib->already_started)
     {
       int id = lib->thumbtable_offset;
-      sqlite3_stmt *stmt;
-      gchar *query = dt_util_dstrcat(NULL, "SELECT rowid FROM memory.collected_images WHERE imgid=%d",
-                                     dt_conf_get_int("plugins/lighttable/culling_last_id"));
-      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-      if(sqlite3_step(stmt) == SQLITE_ROW)
-      {
-        id = sqlite3_column_int(stmt, 0);
-      }
-      g_free(query);
-      sqlite3_finalize(stmt);
+      const int last_id = dt_conf_get_int("plugins/lighttable/culling_last_id");
+      const int rowid = dt_collection_collected_rowid(darktable.collection, last_id);
+      if(rowid > 0) id = rowid;
 
       dt_culling_init(lib->culling, id);
     }
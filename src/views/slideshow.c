@@ -167,7 +167,7 @@ static void _set_delay(dt_slideshow_t *d, int value)
 
 static int process_image(dt_slideshow_t *d, dt_slideshow_slot_t slot)
 {
-  dt_imageio_module_format_t buf;
+  dt_imageio_module_format_t buf = { 0 };
   buf.mime = mime;
   buf.levels = levels;
   buf.bpp = bpp;
@@ -430,15 +430,8 @@ void enter(dt_view_t *self)
 
   if(imgid > 0)
   {
-    sqlite3_stmt *stmt;
-    gchar *query = dt_util_dstrcat(NULL, "SELECT rowid FROM memory.collected_images WHERE imgid=%d", imgid);
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      selrank = sqlite3_column_int(stmt, 0) - 1;
-    }
-    g_free(query);
-    sqlite3_finalize(stmt);
+    const int rowid = dt_collection_collected_rowid(darktable.collection, imgid);
+    if(rowid > 0) selrank = rowid - 1;
   }
 
   d->buf[S_CURRENT].rank = selrank == -1 ? dt_thumbtable_get_offset(dt_ui_thumbtable(darktable.gui->ui)) : selrank;
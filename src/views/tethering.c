@@ -355,7 +355,7 @@ static void _expose_tethered_mode(dt_view_t *self, cairo_t *cr, int32_t width, i
     }
 
     // update the histogram
-    dt_imageio_module_format_t format;
+    dt_imageio_module_format_t format = { 0 };
     _tethering_format_t dat;
     format.bpp = _tethering_bpp;
     format.write_image = _tethering_write_image;
@@ -48,6 +48,7 @@ while [ "$#" -ge 1 ] ; do
   case ${option} in
   -h|--help)
     echo "Delete thumbnails of images that are no longer in darktable's library"
+    echo "(only the single .jpg files of older versions, darktable purges its thumbnail packs itself)"
     echo "Usage:   $0 [options]"
     echo ""
     echo "Options:"
@@ -114,8 +115,11 @@ fi
 id_list=$(mktemp -t darktable-tmp.XXXXXX)
 sqlite3 "${library}" "select id from images order by id" > "${id_list}"
 
-# iterate over cached mipmaps and check for each if the image is in the db
-find "${cache_dir}" -type f | while read -r mipmap; do
+# iterate over cached mipmaps and check for each if the image is in the db.
+# only thumbnails of older versions are kept as one <mip>/<imgid>.jpg file each, these are handled here.
+# newer versions keep all thumbnails of one mip level in <mip>.pack, darktable drops the ones of images no
+# longer in the library itself when it closes the packs. never touch those files here.
+find "${cache_dir}" -mindepth 2 -type f -name '*.jpg' | while read -r mipmap; do
   # get the image id from the filename
   id=$(echo "${mipmap}" | sed 's,.*/\([0-9]*\).*,\1,')
   # ... and delete it if it's not in the library